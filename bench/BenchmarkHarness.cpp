@@ -0,0 +1,211 @@
+#include "BenchmarkHarness.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<std::uint64_t> allocations{0};
+
+struct RegisteredBenchmark {
+    std::string name;
+    BenchmarkFunction function;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    std::uint64_t iterations;
+    double nsPerOp;
+    double framesPerSecond;
+    double bytesPerSecond;
+    double allocationsPerOp;
+};
+
+// Function-local so benchmarks registered from static initializers in other files find it
+std::vector<RegisteredBenchmark>& registry() {
+    static std::vector<RegisteredBenchmark> benchmarks;
+    return benchmarks;
+}
+
+} // namespace
+
+// Every allocation in the program goes through here, so allocations/op can be reported
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+// The rings ask for cache-line aligned storage, which takes the aligned overloads
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    if (void* memory = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+std::uint64_t allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+BenchmarkState::BenchmarkState(std::uint64_t iterations) : iterationCount(iterations) {}
+
+void BenchmarkState::resetTimer() {
+    running = true;
+    startAllocations = allocationCount();
+    startTime = std::chrono::steady_clock::now();
+}
+
+void BenchmarkState::stopTimer() {
+    if (running) {
+        elapsed = std::chrono::steady_clock::now() - startTime;
+        allocations = allocationCount() - startAllocations;
+        running = false;
+    }
+}
+
+void registerBenchmark(const std::string& name, BenchmarkFunction function) {
+    registry().push_back(RegisteredBenchmark{name, function});
+}
+
+/*
+BenchmarkRunner finds a suitable iteration count for each benchmark, runs it and collects
+the results.
+*/
+class BenchmarkRunner{
+public:
+    explicit BenchmarkRunner(double minSeconds) : minSeconds(minSeconds) {}
+
+    // Grows the iteration count until a run lasts at least 'minSeconds'
+    BenchmarkResult run(const RegisteredBenchmark& benchmark) const {
+        std::uint64_t iterations = 1;
+        for (;;) {
+            BenchmarkState state(iterations);
+            state.resetTimer();
+            benchmark.function(state);
+            state.stopTimer();
+            const double seconds = std::chrono::duration<double>(state.elapsed).count();
+            if (seconds >= minSeconds || iterations >= MAX_ITERATIONS) {
+                return makeResult(benchmark.name, state, seconds);
+            }
+            // Aim a little past the target, but never grow more than tenfold at once
+            const double predicted = seconds > 0 ? iterations * minSeconds * 1.4 / seconds : iterations * 10.0;
+            const double grown = std::min(predicted, iterations * 10.0);
+            iterations = std::max<std::uint64_t>(iterations + 1, static_cast<std::uint64_t>(grown));
+        }
+    }
+
+private:
+    static constexpr std::uint64_t MAX_ITERATIONS = 1000000000;
+    const double minSeconds;
+
+    static BenchmarkResult makeResult(const std::string& name, const BenchmarkState& state, double seconds) {
+        const double iterations = static_cast<double>(state.iterationCount);
+        BenchmarkResult result;
+        result.name = name;
+        result.iterations = state.iterationCount;
+        result.nsPerOp = seconds * 1e9 / iterations;
+        result.framesPerSecond = seconds > 0 ? iterations * state.framesPerIteration / seconds : 0;
+        result.bytesPerSecond = seconds > 0 ? iterations * state.bytesPerIteration / seconds : 0;
+        result.allocationsPerOp = static_cast<double>(state.allocations) / iterations;
+        return result;
+    }
+};
+
+namespace {
+
+void printTable(const std::vector<BenchmarkResult>& results) {
+    std::printf("%-44s %12s %12s %14s %14s %10s\n", "Benchmark", "Iterations", "ns/op", "frames/s", "bytes/s", "allocs/op");
+    for (const BenchmarkResult& result : results) {
+        std::printf("%-44s %12llu %12.2f %14.4g %14.4g %10.3f\n", result.name.c_str(),
+                    static_cast<unsigned long long>(result.iterations), result.nsPerOp,
+                    result.framesPerSecond, result.bytesPerSecond, result.allocationsPerOp);
+    }
+}
+
+void writeJson(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    out << "{\n  \"context\": {\"hardware_threads\": " << std::thread::hardware_concurrency() << "},\n";
+    out << "  \"benchmarks\": [\n";
+    for (std::size_t index = 0; index < results.size(); ++index) {
+        const BenchmarkResult& result = results[index];
+        out << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+            << ", \"ns_per_op\": " << result.nsPerOp
+            << ", \"frames_per_second\": " << result.framesPerSecond
+            << ", \"bytes_per_second\": " << result.bytesPerSecond
+            << ", \"allocations_per_op\": " << result.allocationsPerOp << "}"
+            << (index + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+} // namespace
+
+int benchmarkMain(int argc, char** argv) {
+    std::string filter;
+    std::string jsonPath;
+    double minSeconds = 0.2;
+    for (int index = 1; index < argc; ++index) {
+        const std::string argument = argv[index];
+        if (argument.rfind("--filter=", 0) == 0) {
+            filter = argument.substr(9);
+        } else if (argument.rfind("--min-time=", 0) == 0) {
+            minSeconds = std::atof(argument.c_str() + 11);
+        } else if (argument.rfind("--json=", 0) == 0) {
+            jsonPath = argument.substr(7);
+        } else {
+            std::cerr << "Unknown option: " << argument << "\n"
+                      << "Usage: " << argv[0] << " [--filter=TEXT] [--min-time=SEC] [--json=FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    BenchmarkRunner runner(minSeconds);
+    std::vector<BenchmarkResult> results;
+    for (const RegisteredBenchmark& benchmark : registry()) {
+        if (benchmark.name.find(filter) != std::string::npos) {
+            results.push_back(runner.run(benchmark));
+        }
+    }
+
+    // JSON on standard output replaces the table, so the output can be piped directly
+    if (jsonPath == "-") {
+        writeJson(std::cout, results);
+        return 0;
+    }
+    printTable(results);
+    if (!jsonPath.empty()) {
+        std::ofstream file(jsonPath);
+        if (!file) {
+            std::cerr << "Cannot write " << jsonPath << std::endl;
+            return 1;
+        }
+        writeJson(file, results);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef BENCHMARK_HARNESS_H    // This will ensure no repeat definition of this header file.
+#define BENCHMARK_HARNESS_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+A small, dependency-free benchmark harness in the style of Google Benchmark. A benchmark is
+a function that performs 'state.iterations()' operations; the harness calls it with growing
+iteration counts until one run lasts long enough to be measured, then reports:
+
+* ns/op, where one operation is one iteration of the benchmark,
+* frames/s and bytes/s, from the frames and bytes the benchmark says each iteration moves,
+* allocations/op, counted by replacing the global operator new.
+
+The results can also be written as JSON, so a pipeline can diff two runs.
+*/
+class BenchmarkState{
+public:
+    explicit BenchmarkState(std::uint64_t iterations);
+
+    std::uint64_t iterations() const { return iterationCount; }
+
+    // How much traffic one iteration moves; used for frames/s and bytes/s.
+    void setFramesPerIteration(double frames) { framesPerIteration = frames; }
+    void setBytesPerIteration(double bytes) { bytesPerIteration = bytes; }
+
+    // Restarts the clock and the allocation counter, so set-up work is not measured.
+    void resetTimer();
+
+    // Stops the clock; anything done afterwards (tear-down, joining threads) is not measured.
+    void stopTimer();
+
+private:
+    friend class BenchmarkRunner;
+
+    const std::uint64_t iterationCount;
+    double framesPerIteration = 0;
+    double bytesPerIteration = 0;
+
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::duration elapsed{};
+    std::uint64_t startAllocations = 0;
+    std::uint64_t allocations = 0;
+    bool running = false;
+};
+
+using BenchmarkFunction = void (*)(BenchmarkState& state);
+
+// Adds a benchmark to the list run by benchmarkMain(). Names are usually "Group/Variant/Size".
+void registerBenchmark(const std::string& name, BenchmarkFunction function);
+
+// Number of global operator new calls since the program started, on all threads.
+std::uint64_t allocationCount();
+
+// Runs the registered benchmarks. Options:
+//   --filter=TEXT     only run benchmarks whose name contains TEXT
+//   --min-time=SEC    run each benchmark for at least SEC seconds (default 0.2)
+//   --json=FILE       also write the results to FILE as JSON ("-" for standard output)
+int benchmarkMain(int argc, char** argv);
+
+// Keeps the compiler from optimizing away a value the benchmark computed.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+
+#endif  // End BENCHMARK_HARNESS_H
@@ -0,0 +1,117 @@
+// Microbenchmarks for the Data Link Layer frame code (see DESIGN.md, section 15) and the
+// compression of frame batches (section 24).
+#include "BenchmarkHarness.h"
+#include "../src/Compression.h"
+#include "../src/Crc32.h"
+#include "../src/EthernetFrame.h"
+#include "../src/LinkImpairment.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+template <std::size_t Size, bool Accelerated>
+void crc(BenchmarkState& state) {
+    const std::vector<char> bytes(Size, 'x');
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    std::uint32_t checksum = 0;
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        checksum = Accelerated ? crc32(bytes.data(), Size, checksum) : crc32Portable(bytes.data(), Size, checksum);
+    }
+    doNotOptimize(checksum);
+}
+
+// A payload wrapped into a frame and unwrapped again, with both FCS computations
+template <std::size_t Size>
+void encapsulateDecapsulate(BenchmarkState& state) {
+    const MacAddress destination = MacAddress::fromValue(0x020000000001);
+    const MacAddress source = MacAddress::fromValue(0x020000000002);
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        RawPacket packet = RawPacket::withHeadroom(EthernetFrame::HEADER_SIZE, Size);
+        EthernetFrame::encapsulate(packet, destination, source, EtherType::IPV4);
+        doNotOptimize(EthernetFrame::decapsulate(packet));
+    }
+}
+
+// A RemoteLink batch of 1518-byte frames: a counter each, zero padding, and random bytes
+// filling 'RandomPercent' of every payload
+template <std::size_t RandomPercent, bool Decompress>
+void compressBatch(BenchmarkState& state) {
+    constexpr std::size_t FRAMES = 64;
+    constexpr std::size_t SIZE = 1518;
+    std::vector<char> batch(FRAMES * SIZE, 0);
+    std::uint32_t seed = 1;
+    for (std::size_t frame = 0; frame < FRAMES; ++frame) {
+        char* bytes = batch.data() + frame * SIZE;
+        bytes[0] = static_cast<char>(frame);
+        for (std::size_t index = 0; index < SIZE * RandomPercent / 100; ++index) {
+            seed = seed * 1664525 + 1013904223;
+            bytes[64 + index % (SIZE - 64)] = static_cast<char>(seed >> 24);
+        }
+    }
+    std::vector<char> compressed;
+    std::vector<char> restored(batch.size());
+    compressBlock(batch.data(), batch.size(), compressed);
+    state.setBytesPerIteration(static_cast<double>(batch.size()));
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        if (Decompress) {
+            doNotOptimize(decompressBlock(compressed.data(), compressed.size(), restored.data(), restored.size()));
+        } else {
+            compressBlock(batch.data(), batch.size(), compressed);
+            doNotOptimize(compressed.data());
+        }
+    }
+}
+
+// Impairment verdicts for a burst of 256 frames: judge() per frame, or judgeBatch() by columns
+template <bool Columnar>
+void judgeBurst(BenchmarkState& state) {
+    constexpr std::size_t BURST = 256;
+    ImpairmentConfig config;
+    config.lossModel = LossModel::Bernoulli;
+    config.lossProbability = 0.01;
+    config.duplicateProbability = 0.001;
+    config.corruptProbability = 0.001;
+    LinkImpairment impairment(config);
+    std::vector<std::uint32_t> lengths(BURST, 64);
+    ImpairmentVerdicts verdicts;
+    verdicts.resize(BURST);
+    state.setFramesPerIteration(BURST);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        if (Columnar) {
+            impairment.judgeBatch(lengths.data(), BURST, 0, verdicts);
+        } else {
+            for (std::size_t frame = 0; frame < BURST; ++frame) {
+                verdicts.set(frame, impairment.judge(lengths[frame], 0));
+            }
+        }
+        doNotOptimize(verdicts.drop.data());
+    }
+}
+
+const bool registered = [] {
+    registerBenchmark(std::string("Crc32/") + crc32Implementation() + "/64", crc<64, true>);
+    registerBenchmark(std::string("Crc32/") + crc32Implementation() + "/1518", crc<1518, true>);
+    registerBenchmark(std::string("Crc32/") + crc32Implementation() + "/9000", crc<9000, true>);
+    registerBenchmark("Crc32/slicing-by-8/1518", crc<1518, false>);
+    registerBenchmark("Crc32/slicing-by-8/9000", crc<9000, false>);
+    registerBenchmark("EthernetEncapsulateDecapsulate/64", encapsulateDecapsulate<64>);
+    registerBenchmark("EthernetEncapsulateDecapsulate/1500", encapsulateDecapsulate<1500>);
+    registerBenchmark("EthernetEncapsulateDecapsulate/9000", encapsulateDecapsulate<9000>);
+    registerBenchmark("CompressBatch/Zeros", compressBatch<0, false>);
+    registerBenchmark("CompressBatch/HalfRandom", compressBatch<50, false>);
+    registerBenchmark("CompressBatch/Random", compressBatch<100, false>);
+    registerBenchmark("DecompressBatch/Zeros", compressBatch<0, true>);
+    registerBenchmark("DecompressBatch/HalfRandom", compressBatch<50, true>);
+    registerBenchmark("JudgeBurst/FrameByFrame", judgeBurst<false>);
+    registerBenchmark("JudgeBurst/Columnar", judgeBurst<true>);
+    return true;
+}();
+
+} // namespace
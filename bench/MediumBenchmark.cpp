@@ -0,0 +1,434 @@
+// Microbenchmarks for the NetworkMedium hot paths (see DESIGN.md, section 11).
+#include "BenchmarkHarness.h"
+#include "../src/BasicMedium.h"
+#include "../src/Checkpoint.h"
+#include "../src/NetworkMedium.h"
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t BURST_SIZE = 256;
+
+const char* backendName(MediumBackend backend) {
+    switch (backend) {
+    case MediumBackend::SpscRing:
+        return "SpscRing";
+    case MediumBackend::MpscRing:
+        return "MpscRing";
+    case MediumBackend::Broadcast:
+        return "Broadcast";
+    case MediumBackend::SharedMemory:
+        return "SharedMemory";
+    case MediumBackend::Queue:
+        break;
+    }
+    return "Queue";
+}
+
+// One frame built, sent by move and received into a reused packet, per iteration
+template <MediumBackend Backend, std::size_t Size>
+void sendReceive(BenchmarkState& state) {
+    NetworkMedium medium(Backend);
+    RawPacket received;
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        medium.sendPacket(RawPacket(Size, 'x'));
+        medium.tryReceive(received);
+        doNotOptimize(received.data.data());
+    }
+}
+
+// SendReceive through a shared-memory segment, which copies the frame in and out
+template <std::size_t Size>
+void sendReceiveShared(BenchmarkState& state) {
+    const std::string name = "/netemu-bench-" + std::to_string(getpid());
+    SharedFrameRing::remove(name);
+    SharedFrameRing::create(name, SharedRingConfig{256, 9000});
+    NetworkMedium medium(name);
+    SharedFrameRing::remove(name);
+    RawPacket received;
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        medium.sendPacket(RawPacket(Size, 'x'));
+        medium.tryReceive(received);
+        doNotOptimize(received.data.data());
+    }
+}
+
+// The same frame sent by const reference, so the medium has to copy it
+template <std::size_t Size>
+void sendCopyReceive(BenchmarkState& state) {
+    NetworkMedium medium;
+    const RawPacket packet(Size, 'x');
+    RawPacket received;
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        medium.sendPacket(packet);
+        medium.tryReceive(received);
+        doNotOptimize(received.data.data());
+    }
+}
+
+// What a poll loop pays when nothing has arrived
+// SendReceive with a capture tap on the medium; the file goes to /dev/null
+template <std::size_t Size, std::uint32_t SampleEvery>
+void sendReceiveCaptured(BenchmarkState& state) {
+    CaptureConfig config;
+    config.path = "/dev/null";
+    config.snapLength = 128;
+    config.sampleEvery = SampleEvery;
+    CaptureTap tap(config);
+    NetworkMedium medium;
+    medium.attachCapture(tap, "bench");
+    RawPacket received;
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        medium.sendPacket(RawPacket(Size, 'x'));
+        medium.tryReceive(received);
+        doNotOptimize(received.data.data());
+    }
+    state.stopTimer();
+}
+
+// SendReceive with metrics enabled, the histograms recording one frame in 'SampleEvery'
+template <MediumBackend Backend, std::size_t Size, std::uint32_t SampleEvery>
+void sendReceiveMetrics(BenchmarkState& state) {
+    NetworkMedium medium(Backend);
+    medium.enableMetrics(SampleEvery);
+    RawPacket received;
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        medium.sendPacket(RawPacket(Size, 'x'));
+        medium.tryReceive(received);
+        doNotOptimize(received.data.data());
+    }
+}
+
+template <MediumBackend Backend>
+void emptyPoll(BenchmarkState& state) {
+    NetworkMedium medium(Backend);
+    RawPacket received;
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        doNotOptimize(medium.hasPackets());
+        doNotOptimize(medium.tryReceive(received));
+    }
+}
+
+// A burst of frames is queued, then drained with one receiveBatch() call
+template <MediumBackend Backend, std::size_t Size>
+void burstFillDrain(BenchmarkState& state) {
+    NetworkMedium medium(Backend);
+    std::vector<RawPacket> drained;
+    drained.reserve(BURST_SIZE);
+    state.setFramesPerIteration(BURST_SIZE);
+    state.setBytesPerIteration(BURST_SIZE * Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        for (std::size_t frame = 0; frame < BURST_SIZE; ++frame) {
+            medium.sendPacket(RawPacket(Size, 'x'));
+        }
+        drained.clear();
+        medium.receiveBatch(drained, BURST_SIZE);
+        doNotOptimize(drained.data());
+    }
+}
+
+// BurstFillDrain, with the burst sent by one sendBatch() call
+template <MediumBackend Backend, std::size_t Size>
+void batchFillDrain(BenchmarkState& state) {
+    NetworkMedium medium(Backend);
+    std::vector<RawPacket> burst(BURST_SIZE);
+    std::vector<RawPacket> drained;
+    drained.reserve(BURST_SIZE);
+    state.setFramesPerIteration(BURST_SIZE);
+    state.setBytesPerIteration(BURST_SIZE * Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        for (RawPacket& packet : burst) {
+            packet = RawPacket(Size, 'x');
+        }
+        medium.sendBatch(burst);
+        drained.clear();
+        medium.receiveBatch(drained, BURST_SIZE);
+        doNotOptimize(drained.data());
+    }
+}
+
+// A burst through a lossy medium: frame by frame, or as a FrameBatch judged column by column
+template <bool Columnar>
+void impairedBurst(BenchmarkState& state) {
+    ImpairmentConfig impairment;
+    impairment.lossModel = LossModel::Bernoulli;
+    impairment.lossProbability = 0.01;
+    impairment.duplicateProbability = 0.001;
+    impairment.corruptProbability = 0.001;
+    NetworkMedium medium;
+    medium.setImpairment(impairment);
+    medium.enableMetrics(64);
+    FrameBatch batch(BURST_SIZE);
+    std::vector<RawPacket> drained;
+    drained.reserve(2 * BURST_SIZE);
+    state.setFramesPerIteration(BURST_SIZE);
+    state.setBytesPerIteration(BURST_SIZE * 64.0);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        if (Columnar) {
+            batch.clear();
+            for (std::size_t frame = 0; frame < BURST_SIZE; ++frame) {
+                batch.push(RawPacket(64, 'x'));
+            }
+            medium.sendBatch(batch);
+        } else {
+            for (std::size_t frame = 0; frame < BURST_SIZE; ++frame) {
+                medium.sendPacket(RawPacket(64, 'x'));
+            }
+        }
+        drained.clear();
+        medium.receiveBatch(drained, 2 * BURST_SIZE);
+        doNotOptimize(drained.data());
+    }
+}
+
+// One frame delivered to every receiver of a broadcast bus
+template <std::size_t Receivers>
+void broadcastFanOut(BenchmarkState& state) {
+    NetworkMedium medium(MediumBackend::Broadcast);
+    std::vector<ReceiverId> receivers;
+    for (std::size_t index = 0; index < Receivers; ++index) {
+        receivers.push_back(medium.attachReceiver());
+    }
+    SharedPacket received;
+    state.setFramesPerIteration(Receivers);
+    state.setBytesPerIteration(Receivers * 64.0);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        medium.sendPacket(RawPacket(64, 'x'));
+        for (ReceiverId receiver : receivers) {
+            medium.tryReceive(receiver, received);
+        }
+        doNotOptimize(received.get());
+    }
+}
+
+// BurstFillDrain with the burst spread over 'Flows' UDP flows, through a flow queue of the
+// given policy (every frame is classified on the way in and scheduled on the way out) or a FIFO
+template <bool Scheduled, FlowPolicy Policy, std::size_t Flows, std::size_t Size>
+void flowQueueFillDrain(BenchmarkState& state) {
+    NetworkMedium medium;
+    if (Scheduled) {
+        FlowQueueConfig config;
+        config.policy = Policy;
+        medium.setFlowQueue(config);
+    }
+    std::vector<RawPacket> templates;
+    for (std::size_t flow = 0; flow < Flows; ++flow) {
+        RawPacket frame(Size, 0);
+        frame.data[12] = 0x08;                              // IPv4
+        frame.data[14] = 0x45;
+        frame.data[15] = static_cast<char>(flow << 5);      // Precedence, for StrictPriority
+        frame.data[23] = 17;                                // UDP
+        frame.data[29] = static_cast<char>(flow);           // Source address
+        frame.data[35] = static_cast<char>(flow >> 8);      // Source port
+        templates.push_back(std::move(frame));
+    }
+    std::vector<RawPacket> drained;
+    drained.reserve(BURST_SIZE);
+    state.setFramesPerIteration(BURST_SIZE);
+    state.setBytesPerIteration(BURST_SIZE * Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        for (std::size_t frame = 0; frame < BURST_SIZE; ++frame) {
+            medium.sendPacket(templates[frame % Flows]);
+        }
+        drained.clear();
+        medium.receiveBatch(drained, BURST_SIZE);
+        doNotOptimize(drained.data());
+    }
+}
+
+// A medium holding 'Frames' queued frames is saved into a checkpoint (in memory), or restored from a mapped one
+template <bool Restore, std::size_t Frames, std::size_t Size>
+void checkpointMedium(BenchmarkState& state) {
+    NetworkMedium medium;
+    for (std::size_t index = 0; index < Frames; ++index) {
+        medium.sendPacket(RawPacket(Size, 'x'));
+    }
+    const std::string path = "/tmp/netemu-bench-" + std::to_string(getpid()) + ".ckpt";
+    CheckpointWriter saved;
+    saved.beginSection("medium");
+    medium.saveState(saved);
+    saved.save(path);
+    CheckpointFile checkpoint(path);
+    std::remove(path.c_str());
+    state.setFramesPerIteration(Frames);
+    state.setBytesPerIteration(static_cast<double>(Frames * Size));
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        if (Restore) {
+            CheckpointReader reader = checkpoint.section("medium");
+            medium.restoreState(reader);
+            doNotOptimize(medium.packetCount());
+        } else {
+            CheckpointWriter writer;
+            writer.beginSection("medium");
+            medium.saveState(writer);
+            doNotOptimize(writer.size());
+        }
+    }
+}
+
+// Producers and one consumer on their own threads; every iteration is one frame end to end
+template <MediumBackend Backend, std::size_t Producers, std::size_t Size>
+void producerConsumer(BenchmarkState& state) {
+    NetworkMedium medium(Backend);
+    const std::uint64_t total = state.iterations();
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+
+    std::vector<std::thread> producers;
+    for (std::size_t producer = 0; producer < Producers; ++producer) {
+        const std::uint64_t count = total / Producers + (producer < total % Producers ? 1 : 0);
+        producers.emplace_back([&medium, count]() {
+            for (std::uint64_t sent = 0; sent < count; ++sent) {
+                RawPacket packet(Size, 'x');
+                while (!medium.sendPacket(std::move(packet))) {
+                    std::this_thread::yield();  // Ring full; let the consumer catch up
+                }
+            }
+        });
+    }
+    RawPacket received;
+    for (std::uint64_t count = 0; count < total;) {
+        if (medium.tryReceive(received)) {
+            ++count;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    state.stopTimer();
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+}
+
+// SendReceive on a BasicMedium, whose features are fixed at compile time
+template <typename Medium, std::size_t Size>
+void sendReceiveBasic(BenchmarkState& state) {
+    Medium medium(1024);
+    RawPacket received;
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        medium.sendPacket(RawPacket(Size, 'x'));
+        medium.tryReceive(received);
+        doNotOptimize(received.data.data());
+    }
+}
+
+// ProducerConsumer with one producer, on a BasicMedium
+template <typename Medium, std::size_t Size>
+void producerConsumerBasic(BenchmarkState& state) {
+    Medium medium(1024);
+    const std::uint64_t total = state.iterations();
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+
+    std::thread producer([&medium, total]() {
+        for (std::uint64_t sent = 0; sent < total; ++sent) {
+            RawPacket packet(Size, 'x');
+            while (!medium.sendPacket(std::move(packet))) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    RawPacket received;
+    for (std::uint64_t count = 0; count < total;) {
+        if (medium.tryReceive(received)) {
+            ++count;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    state.stopTimer();
+    producer.join();
+}
+
+template <MediumBackend Backend, std::size_t Size>
+void registerSendReceive() {
+    registerBenchmark(std::string("SendReceive/") + backendName(Backend) + "/" + std::to_string(Size),
+                      sendReceive<Backend, Size>);
+}
+
+template <MediumBackend Backend>
+void registerBackend() {
+    registerSendReceive<Backend, 64>();
+    registerSendReceive<Backend, 256>();
+    registerSendReceive<Backend, 1518>();
+    registerSendReceive<Backend, 9000>();
+    registerBenchmark(std::string("EmptyPoll/") + backendName(Backend), emptyPoll<Backend>);
+    registerBenchmark(std::string("BurstFillDrain/") + backendName(Backend) + "/64", burstFillDrain<Backend, 64>);
+    registerBenchmark(std::string("BurstFillDrain/") + backendName(Backend) + "/1518", burstFillDrain<Backend, 1518>);
+    registerBenchmark(std::string("BatchFillDrain/") + backendName(Backend) + "/64", batchFillDrain<Backend, 64>);
+    registerBenchmark(std::string("BatchFillDrain/") + backendName(Backend) + "/1518", batchFillDrain<Backend, 1518>);
+}
+
+void registerMediumBenchmarks() {
+    registerBackend<MediumBackend::Queue>();
+    registerBackend<MediumBackend::SpscRing>();
+    registerBackend<MediumBackend::MpscRing>();
+    registerBenchmark("SendReceive/SharedMemory/64", sendReceiveShared<64>);
+    registerBenchmark("SendReceive/SharedMemory/1518", sendReceiveShared<1518>);
+    registerBenchmark("SendCopyReceive/Queue/64", sendCopyReceive<64>);
+    registerBenchmark("SendCopyReceive/Queue/1518", sendCopyReceive<1518>);
+    registerBenchmark("SendCopyReceive/Queue/9000", sendCopyReceive<9000>);
+    registerBenchmark("SendReceiveCaptured/Queue/1518", sendReceiveCaptured<1518, 1>);
+    registerBenchmark("SendReceiveCaptured/Queue/1518/Sample100", sendReceiveCaptured<1518, 100>);
+    registerBenchmark("SendReceiveMetrics/Queue/64", sendReceiveMetrics<MediumBackend::Queue, 64, 1>);
+    registerBenchmark("SendReceiveMetrics/Queue/64/Sample64", sendReceiveMetrics<MediumBackend::Queue, 64, 64>);
+    registerBenchmark("SendReceiveMetrics/SpscRing/64", sendReceiveMetrics<MediumBackend::SpscRing, 64, 1>);
+    registerBenchmark("SendReceiveMetrics/MpscRing/64", sendReceiveMetrics<MediumBackend::MpscRing, 64, 1>);
+    registerBenchmark("ImpairedBurst/FrameByFrame/64", impairedBurst<false>);
+    registerBenchmark("ImpairedBurst/FrameBatch/64", impairedBurst<true>);
+    registerBenchmark("FlowQueueFillDrain/Fifo/64flows/64", flowQueueFillDrain<false, FlowPolicy::Drr, 64, 64>);
+    registerBenchmark("FlowQueueFillDrain/Drr/64flows/64", flowQueueFillDrain<true, FlowPolicy::Drr, 64, 64>);
+    registerBenchmark("FlowQueueFillDrain/FqCodel/64flows/64", flowQueueFillDrain<true, FlowPolicy::FqCodel, 64, 64>);
+    registerBenchmark("FlowQueueFillDrain/FqCodel/1flow/64", flowQueueFillDrain<true, FlowPolicy::FqCodel, 1, 64>);
+    registerBenchmark("FlowQueueFillDrain/StrictPriority/8flows/64", flowQueueFillDrain<true, FlowPolicy::StrictPriority, 8, 64>);
+    registerBenchmark("CheckpointSave/Queue/1024x1518", checkpointMedium<false, 1024, 1518>);
+    registerBenchmark("CheckpointRestore/Queue/1024x1518", checkpointMedium<true, 1024, 1518>);
+    registerBenchmark("BroadcastFanOut/8", broadcastFanOut<8>);
+    registerBenchmark("BroadcastFanOut/64", broadcastFanOut<64>);
+    registerBenchmark("ProducerConsumer/SpscRing/1x1/64", producerConsumer<MediumBackend::SpscRing, 1, 64>);
+    registerBenchmark("ProducerConsumer/SpscRing/1x1/1518", producerConsumer<MediumBackend::SpscRing, 1, 1518>);
+    registerBenchmark("ProducerConsumer/MpscRing/4x1/64", producerConsumer<MediumBackend::MpscRing, 4, 64>);
+    registerBenchmark("SendReceive/PointToPointLink/64", sendReceiveBasic<PointToPointLink<1024>, 64>);
+    registerBenchmark("SendReceive/PointToPointLink/1518", sendReceiveBasic<PointToPointLink<1024>, 1518>);
+    registerBenchmark("SendReceive/BasicMedium/Mpsc+Metrics/64",
+                      sendReceiveBasic<BasicMedium<MpscStorage, FixedCapacity<1024>, NoImpairment, WithMetrics>, 64>);
+    registerBenchmark("ProducerConsumer/PointToPointLink/1x1/64", producerConsumerBasic<PointToPointLink<1024>, 64>);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    registerMediumBenchmarks();
+    return benchmarkMain(argc, argv);
+}
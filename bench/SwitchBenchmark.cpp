@@ -0,0 +1,80 @@
+// Microbenchmarks for the learning switch and its MAC table (see DESIGN.md, section 16).
+#include "BenchmarkHarness.h"
+#include "../src/EthernetFrame.h"
+#include "../src/LearningSwitch.h"
+#include "../src/MacTable.h"
+#include "../src/Random.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::uint64_t FIRST_ADDRESS = 0x020000000000;
+
+// Lookups of random known addresses
+template <std::size_t Entries>
+void macTableLookup(BenchmarkState& state) {
+    MacTable table(Entries, 0);
+    for (std::uint64_t index = 0; index < Entries; ++index) {
+        table.learn(FIRST_ADDRESS + index, static_cast<PortId>(index % 48), 0);
+    }
+    constexpr std::size_t BATCH = 32;
+    std::vector<std::uint64_t> addresses(1 << 20);
+    Xoshiro256 random(7);
+    for (std::uint64_t& address : addresses) {
+        address = FIRST_ADDRESS + random.next() % Entries;
+    }
+    state.setFramesPerIteration(BATCH);
+    state.resetTimer();
+    std::size_t offset = 0;
+    PortId sum = 0;
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        const std::uint64_t* batch = addresses.data() + offset;
+        for (std::size_t index = 0; index < BATCH; ++index) {
+            sum += table.lookup(batch[index], 0);
+        }
+        offset = (offset + BATCH) % addresses.size();
+    }
+    doNotOptimize(sum);
+}
+
+// Frames between two hosts through a switch whose table already knows both of them
+void switchForward(BenchmarkState& state) {
+    Topology topology;
+    const NodeId hub = topology.addNode("switch");
+    const NodeId first = topology.addNode("first");
+    const NodeId second = topology.addNode("second");
+    topology.connect(first, hub);
+    topology.connect(second, hub);
+    LearningSwitch bridge("switch", topology.getPorts(hub));
+    const MacAddress firstAddress = MacAddress::fromValue(FIRST_ADDRESS + 1);
+    const MacAddress secondAddress = MacAddress::fromValue(FIRST_ADDRESS + 2);
+    bridge.getMacTable().learn(firstAddress.value(), 0, 0);
+    bridge.getMacTable().learn(secondAddress.value(), 1, 0);
+    NetworkMedium& in = *topology.getPort(first, 0).tx;
+    NetworkMedium& out = *topology.getPort(second, 0).rx;
+    const RawPacket frame = EthernetFrame::build(secondAddress, firstAddress, EtherType::IPV4, PacketView());
+
+    constexpr std::size_t BATCH = 32;
+    state.setFramesPerIteration(BATCH);
+    std::vector<RawPacket> received;
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        for (std::size_t index = 0; index < BATCH; ++index) {
+            in.sendPacket(frame);
+        }
+        bridge.poll(0);
+        received.clear();
+        out.receiveBatch(received, BATCH);
+    }
+    doNotOptimize(received.size());
+}
+
+const bool registered = [] {
+    registerBenchmark("MacTableLookup/1k", macTableLookup<1024>);
+    registerBenchmark("MacTableLookup/1M", macTableLookup<1048576>);
+    registerBenchmark("SwitchForward/64", switchForward);
+    return true;
+}();
+
+} // namespace
@@ -0,0 +1,58 @@
+// Microbenchmarks for the trace points (see DESIGN.md, section 31).
+#include "BenchmarkHarness.h"
+#include "../src/Trace.h"
+#include <cstdint>
+
+namespace {
+
+// One trace point per iteration, with the tracer recording every 'Period'th one (0: stopped).
+// TraceScope is used directly, so that this runs without building with NETEMU_TRACE.
+template <std::uint32_t Period>
+void scope(BenchmarkState& state) {
+    Tracer& tracer = Tracer::instance();
+    tracer.clear();
+    if (Period != 0) {
+        tracer.start(Period);
+    }
+    std::uint64_t sum = 0;
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        TraceScope scope(TraceCategory::Medium, "TraceBenchmark::scope");
+        sum += i;
+        doNotOptimize(sum);
+    }
+    tracer.stop();
+    tracer.clear();
+}
+
+// A scope with two nested scopes per iteration, as a send through an impaired medium makes
+template <std::uint32_t Period>
+void nested(BenchmarkState& state) {
+    Tracer& tracer = Tracer::instance();
+    tracer.clear();
+    tracer.start(Period);
+    std::uint64_t sum = 0;
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        TraceScope outer(TraceCategory::Scheduler, "TraceBenchmark::outer");
+        {
+            TraceScope middle(TraceCategory::Medium, "TraceBenchmark::middle");
+            TraceScope inner(TraceCategory::Impairment, "TraceBenchmark::inner");
+            sum += i;
+            doNotOptimize(sum);
+        }
+    }
+    tracer.stop();
+    tracer.clear();
+}
+
+const bool registered = [] {
+    registerBenchmark("TraceScope/Stopped", scope<0>);
+    registerBenchmark("TraceScope/Every", scope<1>);
+    registerBenchmark("TraceScope/1in64", scope<64>);
+    registerBenchmark("TraceScope/Nested3/Every", nested<1>);
+    registerBenchmark("TraceScope/Nested3/1in64", nested<64>);
+    return true;
+}();
+
+} // namespace
@@ -0,0 +1,68 @@
+// Microbenchmarks for the traffic generators (see DESIGN.md, section 30).
+#include "BenchmarkHarness.h"
+#include "../src/EthernetFrame.h"
+#include "../src/TrafficGenerator.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+// A generator at 100 Gbit/s into a medium without a wire, which the generator drains itself
+// (the same medium is both sides of its port); every iteration is one frame, sent and received
+template <TrafficPattern Pattern, std::size_t Size>
+void generate(BenchmarkState& state) {
+    EventScheduler scheduler;
+    NetworkMedium medium;
+    Port port;
+    port.tx = &medium;
+    port.rx = &medium;
+    TrafficConfig config;
+    config.pattern = Pattern;
+    config.bitsPerSecond = 100000000000ull;
+    config.frameSize = Size;
+    config.flows = 16;
+    config.maxFrames = state.iterations();
+    TrafficGenerator generator("generator", port, trafficEndpoint(0), {trafficEndpoint(1), trafficEndpoint(2)}, config);
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    generator.start(scheduler);
+    while (!generator.isFinished()) {
+        scheduler.step();
+    }
+    generator.poll(scheduler.now());
+    doNotOptimize(generator.getCounters().received);
+}
+
+// The hand-written loop the generators replace: every frame built and sent on its own
+template <std::size_t Size>
+void buildAndSend(BenchmarkState& state) {
+    NetworkMedium medium;
+    const MacAddress destination = trafficEndpoint(1).mac;
+    const MacAddress source = trafficEndpoint(0).mac;
+    std::vector<char> payload(Size - EthernetFrame::HEADER_SIZE - EthernetFrame::FCS_SIZE, 0);
+    std::vector<RawPacket> received;
+    state.setFramesPerIteration(1);
+    state.setBytesPerIteration(Size);
+    state.resetTimer();
+    for (std::uint64_t i = 0; i < state.iterations(); ++i) {
+        payload[0] = static_cast<char>(i);
+        medium.sendPacket(EthernetFrame::build(destination, source, EtherType::IPV4, PacketView(payload.data(), payload.size())));
+        if (medium.packetCount() == 256) {
+            received.clear();
+            medium.receiveBatch(received, 256);
+        }
+    }
+    doNotOptimize(received.size());
+}
+
+const bool registered = [] {
+    registerBenchmark("TrafficGenerator/ConstantRate/64", generate<TrafficPattern::ConstantRate, 64>);
+    registerBenchmark("TrafficGenerator/ConstantRate/1518", generate<TrafficPattern::ConstantRate, 1518>);
+    registerBenchmark("TrafficGenerator/Poisson/64", generate<TrafficPattern::Poisson, 64>);
+    registerBenchmark("BuildAndSend/64", buildAndSend<64>);
+    registerBenchmark("BuildAndSend/1518", buildAndSend<1518>);
+    return true;
+}();
+
+} // namespace
@@ -0,0 +1,301 @@
+#ifndef BASIC_MEDIUM_H    // This will ensure no repeat definition of this header file.
+#define BASIC_MEDIUM_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "LinkImpairment.h"
+#include "Metrics.h"
+#include "PacketRing.h"
+#include "RawPacket.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/*
+BasicMedium is a medium whose features are chosen at compile time, for links that need
+only some of what NetworkMedium offers. Each feature is a policy class:
+
+- Storage: how frames wait for the receiver (QueueStorage, SpscStorage, MpscStorage).
+- Capacity: a bound chosen at run time (DynamicCapacity) or a compile-time constant
+  (FixedCapacity<N>), which lets the rings mask their indices with an immediate value.
+- Impairment: NoImpairment, or WithImpairment for loss, duplication and corruption.
+- Stats: NoStats, or WithMetrics for the counters and occupancy histogram of MediumMetrics.
+- Packet: the type carried, RawPacket unless the link moves something else.
+
+A disabled policy is an empty class whose functions do nothing, so it takes no space and
+leaves no branch behind: PointToPointLink below compiles down to the ring buffer alone.
+There are no virtual functions anywhere.
+
+NetworkMedium remains the medium of the nodes, hosts and simulations: it picks its backend
+at run time and adds virtual time, broadcasting, blocking receives and capture, none of which
+fit a medium whose every feature is fixed at compile time. BasicMedium has no clock, so delays
+and bandwidth caps do not apply; an impairment is judged at time 0.
+*/
+
+// Number of bytes a packet counts for in the statistics and the impairment stage.
+template <typename Packet>
+std::size_t payloadBytes(const Packet& packet) {
+    if constexpr (requires { packet.data.size(); }) {
+        return packet.data.size();
+    } else {
+        return sizeof(Packet);
+    }
+}
+
+// The capacity is given to the constructor; 0 leaves QueueStorage unbounded.
+struct DynamicCapacity {
+    static constexpr std::size_t value = 0;
+};
+
+// The capacity is the power of two 'N', fixed at compile time.
+template <std::size_t N>
+struct FixedCapacity {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "A fixed medium capacity must be a power of two");
+    static constexpr std::size_t value = N;
+};
+
+// Single-threaded queue, like the Queue backend; bounded only if given a capacity.
+template <typename Packet, typename Capacity>
+class QueueStorage{
+public:
+    static constexpr bool CONCURRENT_SENDERS = false;
+
+    explicit QueueStorage(std::size_t capacity = Capacity::value) : limit(Capacity::value != 0 ? Capacity::value : capacity) {}
+
+    bool tryPush(Packet& packet) {
+        if (bounded() && queue.size() >= capacity()) {
+            return false;
+        }
+        queue.push_back(std::move(packet));
+        return true;
+    }
+
+    bool tryPop(Packet& out) {
+        if (queue.empty()) {
+            return false;
+        }
+        out = std::move(queue.front());
+        queue.pop_front();
+        return true;
+    }
+
+    bool empty() const { return queue.empty(); }
+    std::size_t size() const { return queue.size(); }
+
+    // 0 if the queue is unbounded.
+    std::size_t capacity() const { return Capacity::value != 0 ? Capacity::value : limit; }
+
+private:
+    UnboundedRing<Packet> queue;
+    std::size_t limit;
+
+    constexpr bool bounded() const { return Capacity::value != 0 || limit != 0; }
+};
+
+// One sending and one receiving thread, like the SpscRing backend.
+template <typename Packet, typename Capacity>
+class SpscStorage{
+public:
+    static constexpr bool CONCURRENT_SENDERS = false;
+
+    explicit SpscStorage(std::size_t capacity = Capacity::value) : ring(capacity) {}
+
+    bool tryPush(Packet& packet) { return ring.tryPush(packet); }
+    bool tryPop(Packet& out) { return ring.tryPop(out); }
+    bool empty() const { return ring.empty(); }
+    std::size_t size() const { return ring.size(); }
+    std::size_t capacity() const { return ring.capacity(); }
+
+private:
+    SpscRing<Packet, Capacity::value> ring;
+};
+
+// Any number of sending threads and one receiving thread, like the MpscRing backend.
+template <typename Packet, typename Capacity>
+class MpscStorage{
+public:
+    static constexpr bool CONCURRENT_SENDERS = true;
+
+    explicit MpscStorage(std::size_t capacity = Capacity::value) : ring(capacity) {}
+
+    bool tryPush(Packet& packet) { return ring.tryPush(packet); }
+    bool tryPop(Packet& out) { return ring.tryPop(out); }
+    bool empty() const { return ring.empty(); }
+    std::size_t size() const { return ring.size(); }
+    std::size_t capacity() const { return ring.capacity(); }
+
+private:
+    MpscRing<Packet, Capacity::value> ring;
+};
+
+// Every frame reaches the wire as it was sent.
+struct NoImpairment {
+    static constexpr bool ENABLED = false;
+
+    ImpairmentVerdict judge(std::size_t, SimTime) { return ImpairmentVerdict(); }
+};
+
+// Frames are judged by a LinkImpairment (loss, duplication and corruption; see above for delays).
+// The medium must have a single sender, since judging a frame updates the impairment's state;
+// BasicMedium does not accept it together with MpscStorage.
+class WithImpairment{
+public:
+    static constexpr bool ENABLED = true;
+
+    explicit WithImpairment(const ImpairmentConfig& config = ImpairmentConfig()) : impairment(config) {}
+
+    ImpairmentVerdict judge(std::size_t frameBytes, SimTime now) { return impairment.judge(frameBytes, now); }
+
+    const LinkImpairment& get() const { return impairment; }
+
+private:
+    LinkImpairment impairment;
+};
+
+// Nothing is counted.
+struct NoStats {
+    static constexpr bool ENABLED = false;
+
+    explicit NoStats(bool = false) {}
+    void countSent(std::size_t) {}
+    void countRefused() {}
+    void countDropped() {}
+    void countReceived(std::size_t, std::size_t) {}
+};
+
+// Counts frames in a MediumMetrics, and samples the occupancy seen by the receiver.
+// Frames carry no timestamp here, so the sojourn histogram stays empty.
+class WithMetrics{
+public:
+    static constexpr bool ENABLED = true;
+
+    explicit WithMetrics(bool concurrentSenders, std::uint32_t histogramSampleEvery = 64)
+        : metrics(concurrentSenders, histogramSampleEvery) {}
+
+    void countSent(std::size_t bytes) { metrics.countSent(bytes); }
+    void countRefused() { metrics.countRefused(); }
+    void countDropped() { metrics.countDropped(); }
+
+    void countReceived(std::size_t bytes, std::size_t stillWaiting) {
+        metrics.countReceived(bytes);
+        if (metrics.sampleHistograms()) {
+            metrics.recordOccupancy(stillWaiting);
+        }
+    }
+
+    const MediumMetrics& get() const { return metrics; }
+
+private:
+    MediumMetrics metrics;
+};
+
+template <template <typename, typename> class Storage = QueueStorage, typename Capacity = DynamicCapacity,
+          typename Impairment = NoImpairment, typename Stats = NoStats, typename Packet = RawPacket>
+class BasicMedium{
+    static_assert(!(Impairment::ENABLED && Storage<Packet, Capacity>::CONCURRENT_SENDERS),
+                  "WithImpairment needs a single sender; use QueueStorage or SpscStorage");
+
+public:
+    explicit BasicMedium(std::size_t capacity = Capacity::value, Impairment impairmentPolicy = Impairment())
+        : storage(capacity), impairment(std::move(impairmentPolicy)), stats(Storage<Packet, Capacity>::CONCURRENT_SENDERS) {}
+
+    BasicMedium(const BasicMedium&) = delete;
+    BasicMedium& operator=(const BasicMedium&) = delete;
+
+    // Puts a packet on the medium. Returns false, leaving 'packet' with the caller, if the
+    // medium is full; a frame lost to the impairment stage counts as sent.
+    bool sendPacket(Packet&& packet) {
+        stats.countSent(payloadBytes(packet));
+        if constexpr (Impairment::ENABLED) {
+            const ImpairmentVerdict verdict = impairment.judge(payloadBytes(packet), 0);
+            if (verdict.drop) {
+                stats.countDropped();
+                return true;
+            }
+            if (verdict.duplicate || (CAN_CORRUPT && verdict.corruptBit >= 0)) {
+                return pushImpaired(packet, verdict);
+            }
+        }
+        return push(packet);
+    }
+
+    // Moves the oldest packet into 'out' and returns true, or returns false if there is none.
+    bool tryReceive(Packet& out) {
+        if (!storage.tryPop(out)) {
+            return false;
+        }
+        if constexpr (Stats::ENABLED) {
+            stats.countReceived(payloadBytes(out), storage.size());
+        }
+        return true;
+    }
+
+    // The oldest packet, or an empty packet if there is none.
+    Packet receivePacket() {
+        Packet packet;
+        tryReceive(packet);
+        return packet;
+    }
+
+    bool hasPackets() const { return !storage.empty(); }
+    std::size_t packetCount() const { return storage.size(); }
+    std::size_t capacity() const { return storage.capacity(); }
+
+    const MediumMetrics& getMetrics() const requires Stats::ENABLED { return stats.get(); }
+    const LinkImpairment& getImpairment() const requires Impairment::ENABLED { return impairment.get(); }
+
+private:
+    Storage<Packet, Capacity> storage;
+    [[no_unique_address]] Impairment impairment;
+    [[no_unique_address]] Stats stats;
+
+    // Only packets with a 'data' buffer can have a bit flipped.
+    static constexpr bool CAN_CORRUPT = requires(Packet& packet) { packet.data[0] ^= char(1); };
+
+    bool push(Packet& packet) {
+        if (storage.tryPush(packet)) {
+            return true;
+        }
+        stats.countRefused();
+        return false;
+    }
+
+    // The verdict is acted on only once the storage takes the packet: a refused packet goes back
+    // to the sender as it was (corruption is done on a copy), and no duplicate is sent. A
+    // duplicate that does not fit counts as dropped, since the sender's packet got through.
+    bool pushImpaired(Packet& packet, const ImpairmentVerdict& verdict) {
+        Packet duplicate;
+        if (verdict.duplicate) {
+            duplicate = packet;
+        }
+        if (CAN_CORRUPT && verdict.corruptBit >= 0) {
+            Packet corrupted(packet);
+            flipBit(corrupted, verdict.corruptBit);
+            if (!push(corrupted)) {
+                return false;
+            }
+            packet = Packet();
+            if (verdict.duplicate) {
+                flipBit(duplicate, verdict.corruptBit);
+            }
+        } else if (!push(packet)) {
+            return false;
+        }
+        if (verdict.duplicate && !storage.tryPush(duplicate)) {
+            stats.countDropped();
+        }
+        return true;
+    }
+
+    static void flipBit(Packet& packet, std::int64_t bit) {
+        if constexpr (CAN_CORRUPT) {
+            packet.data[static_cast<std::size_t>(bit / 8)] ^= static_cast<char>(1 << (bit % 8));
+        }
+    }
+};
+
+// A bare point-to-point link: a fixed-size SPSC ring and nothing else.
+template <std::size_t Capacity = 4096, typename Packet = RawPacket>
+using PointToPointLink = BasicMedium<SpscStorage, FixedCapacity<Capacity>, NoImpairment, NoStats, Packet>;
+
+
+#endif  // End BASIC_MEDIUM_H
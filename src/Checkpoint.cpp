@@ -0,0 +1,189 @@
+#include "Checkpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::uint64_t MAGIC = 0x54504B43554D454Eull;     // "NEMUCKPT" on a little-endian machine
+constexpr std::uint32_t VERSION = 2;
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr std::size_t ALIGNMENT = 8;
+
+// Magic, version, byte order mark and section count
+constexpr std::size_t HEADER_SIZE = 24;
+
+std::size_t padded(std::size_t length) {
+    return (length + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+template <typename T>
+T readAt(const char* bytes) {
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+} // namespace
+
+// The header is written now; its section count is filled in by save()
+CheckpointWriter::CheckpointWriter() {
+    put(MAGIC);
+    put(VERSION);
+    put(BYTE_ORDER_MARK);
+    put<std::uint64_t>(0);
+}
+
+void CheckpointWriter::append(const void* bytes, std::size_t length) {
+    if (length == 0) {
+        return;
+    }
+    const std::size_t offset = buffer.size();
+    buffer.resize(offset + length);
+    std::memcpy(buffer.data() + offset, bytes, length);
+}
+
+void CheckpointWriter::pad() {
+    buffer.resize(padded(buffer.size()), 0);
+}
+
+// Section layout: name length, reserved word, body length, name, padding, body, padding
+void CheckpointWriter::beginSection(const std::string& name) {
+    endSection();
+    put(static_cast<std::uint32_t>(name.size()));
+    put<std::uint32_t>(0);
+    sectionStart = buffer.size();
+    put<std::uint64_t>(0);
+    append(name.data(), name.size());
+    pad();
+    ++sectionCount;
+}
+
+// The body length is only known once the section is complete
+void CheckpointWriter::endSection() {
+    if (sectionStart == 0) {
+        return;
+    }
+    const std::size_t nameLength = readAt<std::uint32_t>(buffer.data() + sectionStart - 2 * sizeof(std::uint32_t));
+    const std::size_t bodyStart = sectionStart + sizeof(std::uint64_t) + padded(nameLength);
+    const std::uint64_t bodyLength = buffer.size() - bodyStart;
+    std::memcpy(buffer.data() + sectionStart, &bodyLength, sizeof(bodyLength));
+    pad();
+    sectionStart = 0;
+}
+
+void CheckpointWriter::putBytes(const char* bytes, std::size_t length) {
+    put<std::uint64_t>(length);
+    append(bytes, length);
+}
+
+void CheckpointWriter::save(const std::string& path) {
+    endSection();
+    std::memcpy(buffer.data() + HEADER_SIZE - sizeof(std::uint64_t), &sectionCount, sizeof(sectionCount));
+
+    const std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Cannot create checkpoint " + temporary);
+    }
+    const bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    if (std::fclose(file) != 0 || !written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Cannot write checkpoint " + path);
+    }
+}
+
+const char* CheckpointReader::take(std::size_t count) {
+    if (count > length - position) {
+        fail();
+    }
+    const char* start = bytes + position;
+    position += count;
+    return start;
+}
+
+void CheckpointReader::fail() const {
+    throw std::runtime_error("Checkpoint section '" + name + "' ends before all of its state was read");
+}
+
+PacketView CheckpointReader::getBytes() {
+    const std::uint64_t count = get<std::uint64_t>();
+    if (count > length - position) {
+        fail();
+    }
+    return PacketView(take(static_cast<std::size_t>(count)), static_cast<std::size_t>(count));
+}
+
+std::string CheckpointReader::getString() {
+    const PacketView text = getBytes();
+    return std::string(text.data(), text.size());
+}
+
+// Every length is checked against the end of the file before it is followed
+CheckpointFile::CheckpointFile(const std::string& path) : path(path) {
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::runtime_error("Cannot open checkpoint " + path);
+    }
+    struct stat status;
+    if (::fstat(descriptor, &status) != 0 || static_cast<std::size_t>(status.st_size) < HEADER_SIZE) {
+        ::close(descriptor);
+        throw std::runtime_error("Checkpoint " + path + " is too short or unreadable");
+    }
+    size = static_cast<std::size_t>(status.st_size);
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map checkpoint " + path);
+    }
+    mapping = static_cast<char*>(mapped);
+
+    auto reject = [this](const std::string& reason) {
+        ::munmap(mapping, size);
+        throw std::runtime_error("Checkpoint " + this->path + " " + reason);
+    };
+    if (readAt<std::uint64_t>(mapping) != MAGIC) {
+        reject("is not a checkpoint, or was written on a machine of the other byte order");
+    }
+    if (readAt<std::uint32_t>(mapping + 8) != VERSION || readAt<std::uint32_t>(mapping + 12) != BYTE_ORDER_MARK) {
+        reject("was written by another version of the emulator");
+    }
+    const std::uint64_t count = readAt<std::uint64_t>(mapping + 16);
+    std::size_t offset = HEADER_SIZE;
+    for (std::uint64_t index = 0; index < count; ++index) {
+        if (size - offset < 16) {
+            reject("is cut off");
+        }
+        const std::size_t nameLength = readAt<std::uint32_t>(mapping + offset);
+        const std::uint64_t bodyLength = readAt<std::uint64_t>(mapping + offset + 8);
+        offset += 16;
+        if (padded(nameLength) > size - offset) {
+            reject("is cut off");
+        }
+        std::string name(mapping + offset, nameLength);
+        offset += padded(nameLength);
+        if (bodyLength > size - offset) {
+            reject("is cut off in section '" + name + "'");
+        }
+        sections[std::move(name)] = Section{offset, static_cast<std::size_t>(bodyLength)};
+        offset += static_cast<std::size_t>(bodyLength);
+        const std::size_t padding = padded(offset) - offset;
+        offset = padding > size - offset ? size : offset + padding;
+    }
+}
+
+CheckpointFile::~CheckpointFile() {
+    ::munmap(mapping, size);
+}
+
+CheckpointReader CheckpointFile::section(const std::string& name) const {
+    const auto found = sections.find(name);
+    if (found == sections.end()) {
+        throw std::runtime_error("Checkpoint " + path + " has no section '" + name + "'");
+    }
+    return CheckpointReader(name, mapping + found->second.offset, found->second.length);
+}
@@ -0,0 +1,166 @@
+#ifndef CHECKPOINT_H    // This will ensure no repeat definition of this header file.
+#define CHECKPOINT_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "PacketBuffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/*
+A checkpoint is the dynamic state of an emulation (frames queued and on the wire, pending
+events, random generators, node state) in one binary file, so that many runs can continue
+from one warmed-up state instead of each repeating the warm-up (see Topology::saveCheckpoint()).
+
+The file is a short header (magic, version, byte order) followed by named sections, one per
+component. A section is a length-prefixed name and a length-prefixed body, both padded to 8
+bytes, so a reader finds every section by hopping over the bodies, without parsing them.
+Values are stored as they are in memory: restoring a checkpoint is reading a mapping,
+with no parsing or conversion. It follows that a checkpoint is read on a machine with the
+byte order it was written on, which the header checks.
+*/
+
+/*
+CheckpointWriter builds a checkpoint in memory, section by section, and writes it out with
+save(). Only trivially copyable values can be put; anything else is put field by field.
+*/
+class CheckpointWriter{
+public:
+    CheckpointWriter();
+
+    // Starts the section 'name'; everything put from now on belongs to it.
+    void beginSection(const std::string& name);
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be put into a checkpoint");
+        append(&value, sizeof(T));
+    }
+
+    // A count followed by 'count' values.
+    template <typename T>
+    void putArray(const T* values, std::size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be put into a checkpoint");
+        put<std::uint64_t>(count);
+        append(values, count * sizeof(T));
+    }
+
+    // A length followed by the bytes, e.g. a frame.
+    void putBytes(const char* bytes, std::size_t length);
+    void putBytes(PacketView bytes) { putBytes(bytes.data(), bytes.size()); }
+    void putString(const std::string& text) { putBytes(text.data(), text.size()); }
+
+    // Bytes of the checkpoint so far.
+    std::size_t size() const { return buffer.size(); }
+
+    // Writes the checkpoint to 'path'. It goes to a temporary file first which is then renamed,
+    // so 'path' always holds a complete checkpoint. Throws std::runtime_error if writing fails.
+    void save(const std::string& path);
+
+private:
+    std::vector<char> buffer;
+    std::size_t sectionStart = 0;   // Offset of the open section's body length; 0 if none is open.
+    std::uint64_t sectionCount = 0;
+
+    void append(const void* bytes, std::size_t length);
+    void pad();
+    void endSection();
+};
+
+/*
+CheckpointReader reads the body of one section, front to back, in the order it was written.
+It reads straight from the CheckpointFile's mapping, which has to outlive it. Reading past
+the end of the section throws std::runtime_error, so a damaged file cannot be read out of bounds.
+*/
+class CheckpointReader{
+public:
+    CheckpointReader(const std::string& name, const char* bytes, std::size_t length)
+        : name(name), bytes(bytes), length(length) {}
+
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be read from a checkpoint");
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void get(T& value) { value = get<T>(); }
+
+    // Replaces the contents of 'values' with an array put by putArray().
+    template <typename T>
+    void getArray(std::vector<T>& values) {
+        const std::uint64_t count = get<std::uint64_t>();
+        if (count > (length - position) / sizeof(T)) {
+            fail();
+        }
+        const std::size_t byteCount = static_cast<std::size_t>(count) * sizeof(T);
+        values.resize(static_cast<std::size_t>(count));
+        const char* source = take(byteCount);
+        if (byteCount != 0) {
+            std::memcpy(values.data(), source, byteCount);
+        }
+    }
+
+    // Bytes put by putBytes(), as a view into the mapping; nothing is copied.
+    PacketView getBytes();
+    std::string getString();
+
+    // True once the whole section has been read.
+    bool atEnd() const { return position == length; }
+
+    const std::string& getName() const { return name; }
+
+private:
+    std::string name;
+    const char* bytes;
+    std::size_t length;
+    std::size_t position = 0;
+
+    const char* take(std::size_t count);
+    [[noreturn]] void fail() const;
+};
+
+/*
+CheckpointFile opens a checkpoint written by CheckpointWriter::save() through a read-only
+memory mapping: opening it reads only the header and the section names, and the kernel pages
+in the rest as it is restored. Any number of runs (or forked processes) can restore from the
+same file.
+*/
+class CheckpointFile{
+public:
+    // Maps the file and indexes its sections; throws std::runtime_error if it cannot be
+    // opened, was written by another version or on a machine of the other byte order, or is damaged.
+    explicit CheckpointFile(const std::string& path);
+    ~CheckpointFile();
+
+    CheckpointFile(const CheckpointFile&) = delete;
+    CheckpointFile& operator=(const CheckpointFile&) = delete;
+
+    bool hasSection(const std::string& name) const { return sections.count(name) != 0; }
+
+    // A reader for the section 'name'; throws std::runtime_error if there is none.
+    CheckpointReader section(const std::string& name) const;
+
+    std::size_t sectionCount() const { return sections.size(); }
+    std::size_t fileSize() const { return size; }
+
+private:
+    struct Section {
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    char* mapping = nullptr;
+    std::size_t size = 0;
+    std::string path;
+    std::unordered_map<std::string, Section> sections;
+};
+
+
+#endif  // End CHECKPOINT_H
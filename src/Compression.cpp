@@ -0,0 +1,157 @@
+#include "Compression.h"
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t MIN_MATCH = 4;
+constexpr std::size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 12;
+
+std::uint32_t load32(const char* bytes) {
+    std::uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+// Length of the common prefix of 'a' and 'b', at most 'limit' bytes, compared eight at a time
+std::size_t commonLength(const char* a, const char* b, std::size_t limit) {
+    std::size_t length = 0;
+    while (length + sizeof(std::uint64_t) <= limit) {
+        std::uint64_t left;
+        std::uint64_t right;
+        std::memcpy(&left, a + length, sizeof(left));
+        std::memcpy(&right, b + length, sizeof(right));
+        if (left != right) {
+            // The first differing byte is the lowest one on a little-endian machine
+            const int bit = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? __builtin_ctzll(left ^ right) : __builtin_clzll(left ^ right);
+            return length + static_cast<std::size_t>(bit) / 8;
+        }
+        length += sizeof(std::uint64_t);
+    }
+    while (length < limit && a[length] == b[length]) {
+        ++length;
+    }
+    return length;
+}
+
+std::uint32_t hashOf(std::uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Lengths of 15 and more continue in bytes of 255, ended by a smaller byte
+void putLength(std::vector<char>& out, std::size_t length) {
+    for (; length >= 255; length -= 255) {
+        out.push_back(static_cast<char>(255));
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+// One token: literal run length and match length in its two nibbles, then the literals and the match
+void putSequence(std::vector<char>& out, const char* literals, std::size_t literalLength, std::size_t offset, std::size_t matchLength) {
+    const std::size_t matchCode = matchLength >= MIN_MATCH ? matchLength - MIN_MATCH : 0;
+    const std::size_t token = (literalLength < 15 ? literalLength : 15) << 4 | (matchCode < 15 ? matchCode : 15);
+    out.push_back(static_cast<char>(token));
+    if (literalLength >= 15) {
+        putLength(out, literalLength - 15);
+    }
+    out.insert(out.end(), literals, literals + literalLength);
+    if (matchLength == 0) {
+        return;     // The last sequence has literals only
+    }
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15) {
+        putLength(out, matchCode - 15);
+    }
+}
+
+// Reads the continuation bytes of a length; false if the block ends first
+bool getLength(const unsigned char*& in, const unsigned char* end, std::size_t& length) {
+    for (;;) {
+        if (in == end) {
+            return false;
+        }
+        const unsigned char byte = *in++;
+        length += byte;
+        if (byte != 255) {
+            return true;
+        }
+    }
+}
+
+} // namespace
+
+// Greedy matching: take the first match the hash table offers and extend it as far as it goes
+void compressBlock(const char* data, std::size_t length, std::vector<char>& out) {
+    out.clear();
+    out.reserve(length + length / 255 + 16);
+    std::uint32_t table[std::size_t(1) << HASH_BITS] = {};
+    std::size_t anchor = 0;
+    std::size_t position = 0;
+    while (position + MIN_MATCH <= length) {
+        const std::uint32_t sequence = load32(data + position);
+        const std::uint32_t hash = hashOf(sequence);
+        const std::size_t candidate = table[hash];
+        table[hash] = static_cast<std::uint32_t>(position);
+        if (candidate < position && position - candidate <= MAX_OFFSET && load32(data + candidate) == sequence) {
+            const std::size_t matchLength = MIN_MATCH +
+                commonLength(data + candidate + MIN_MATCH, data + position + MIN_MATCH, length - position - MIN_MATCH);
+            putSequence(out, data + anchor, position - anchor, position - candidate, matchLength);
+            position += matchLength;
+            anchor = position;
+        } else {
+            position += 1 + ((position - anchor) >> 6);
+        }
+    }
+    putSequence(out, data + anchor, length - anchor, 0, 0);
+}
+
+// Every length and offset is checked against both ends, so a corrupt block cannot write out of bounds
+bool decompressBlock(const char* block, std::size_t blockLength, char* out, std::size_t originalLength) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(block);
+    const unsigned char* const end = in + blockLength;
+    std::size_t written = 0;
+    while (in != end) {
+        const unsigned char token = *in++;
+        std::size_t literalLength = token >> 4;
+        if (literalLength == 15 && !getLength(in, end, literalLength)) {
+            return false;
+        }
+        if (literalLength > static_cast<std::size_t>(end - in) || literalLength > originalLength - written) {
+            return false;
+        }
+        std::memcpy(out + written, in, literalLength);
+        in += literalLength;
+        written += literalLength;
+        if (in == end) {
+            break;      // The last sequence
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        const std::size_t offset = std::size_t(in[0]) | std::size_t(in[1]) << 8;
+        in += 2;
+        std::size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !getLength(in, end, matchLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > written || matchLength > originalLength - written) {
+            return false;
+        }
+        // A match may overlap the bytes it produces (a run), so it is copied byte by byte then
+        char* target = out + written;
+        const char* source = target - offset;
+        if (offset >= matchLength) {
+            std::memcpy(target, source, matchLength);
+        } else {
+            for (std::size_t index = 0; index < matchLength; ++index) {
+                target[index] = source[index];
+            }
+        }
+        written += matchLength;
+    }
+    return written == originalLength;
+}
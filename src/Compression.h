@@ -0,0 +1,29 @@
+#ifndef COMPRESSION_H    // This will ensure no repeat definition of this header file.
+#define COMPRESSION_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <cstddef>
+#include <vector>
+
+/*
+A small, fast LZ77 block compressor for batches of frames, in the format of an LZ4 block:
+a sequence of literal runs, each followed by a back reference of at least 4 bytes into the
+last 64 KiB. Matches are found through a hash table of 4-byte sequences, and the compressor
+skips ahead faster the longer it finds nothing, so incompressible data costs little time.
+
+Emulated traffic compresses well: headers repeat from frame to frame, and test payloads are
+often zeros or patterns. The point is to save time on the wire, not to compress tightly, so
+there is no entropy coding stage.
+*/
+
+// Replaces the contents of 'out' with the compressed form of the 'length' bytes at 'data'.
+// The result can be a little larger than the input if the data does not compress.
+void compressBlock(const char* data, std::size_t length, std::vector<char>& out);
+
+// Decompresses a block made by compressBlock() into 'out', which must have room for exactly
+// 'originalLength' bytes. Returns false if the block is malformed or does not decompress
+// to that length.
+bool decompressBlock(const char* block, std::size_t blockLength, char* out, std::size_t originalLength);
+
+
+#endif  // End COMPRESSION_H
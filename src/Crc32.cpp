@@ -0,0 +1,186 @@
+#include "Crc32.h"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace {
+
+// The inner functions work on the raw CRC register; crc32() adds the inversions
+using UpdateFunction = std::uint32_t (*)(std::uint32_t state, const unsigned char* bytes, std::size_t length);
+
+using Crc32Tables = std::array<std::array<std::uint32_t, 256>, 8>;
+
+// tables[0] is the classic byte-at-a-time table; tables[k] advances a byte through k more zero bytes
+constexpr Crc32Tables makeTables() {
+    Crc32Tables tables{};
+    for (std::uint32_t index = 0; index < 256; ++index) {
+        std::uint32_t value = index;
+        for (int bit = 0; bit < 8; ++bit) {
+            value = (value >> 1) ^ ((value & 1) ? 0xEDB88320u : 0);
+        }
+        tables[0][index] = value;
+    }
+    for (std::size_t slice = 1; slice < 8; ++slice) {
+        for (std::size_t index = 0; index < 256; ++index) {
+            const std::uint32_t previous = tables[slice - 1][index];
+            tables[slice][index] = (previous >> 8) ^ tables[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+constexpr Crc32Tables TABLES = makeTables();
+
+inline std::uint32_t loadLittleEndian32(const unsigned char* bytes) {
+    return static_cast<std::uint32_t>(bytes[0]) | (static_cast<std::uint32_t>(bytes[1]) << 8) |
+           (static_cast<std::uint32_t>(bytes[2]) << 16) | (static_cast<std::uint32_t>(bytes[3]) << 24);
+}
+
+// Slicing-by-8: eight table lookups handle eight bytes at once
+std::uint32_t updatePortable(std::uint32_t state, const unsigned char* bytes, std::size_t length) {
+    while (length >= 8) {
+        const std::uint32_t low = loadLittleEndian32(bytes) ^ state;
+        const std::uint32_t high = loadLittleEndian32(bytes + 4);
+        state = TABLES[7][low & 0xFF] ^ TABLES[6][(low >> 8) & 0xFF] ^
+                TABLES[5][(low >> 16) & 0xFF] ^ TABLES[4][low >> 24] ^
+                TABLES[3][high & 0xFF] ^ TABLES[2][(high >> 8) & 0xFF] ^
+                TABLES[1][(high >> 16) & 0xFF] ^ TABLES[0][high >> 24];
+        bytes += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        state = (state >> 8) ^ TABLES[0][(state ^ *bytes++) & 0xFF];
+    }
+    return state;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Folds 128 bits of remainder forward over the next 128 bits: low * k.low ^ high * k.high ^ next
+__attribute__((target("pclmul,sse4.1")))
+inline __m128i fold(__m128i remainder, __m128i constants, __m128i next) {
+    const __m128i low = _mm_clmulepi64_si128(remainder, constants, 0x00);
+    const __m128i high = _mm_clmulepi64_si128(remainder, constants, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(low, high), next);
+}
+
+inline __m128i load128(const unsigned char* bytes) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+}
+
+// Carry-less multiplication folding, after Intel's "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction". The constants are x^n mod P for the reflected polynomial.
+__attribute__((target("pclmul,sse4.1")))
+std::uint32_t updatePclmul(std::uint32_t state, const unsigned char* bytes, std::size_t length) {
+    if (length < 64) {
+        return updatePortable(state, bytes, length);
+    }
+    const std::size_t folded = length & ~static_cast<std::size_t>(15);
+    std::size_t left = folded - 64;
+
+    // Four independent 128-bit lanes keep the multipliers busy
+    __m128i lane1 = _mm_xor_si128(load128(bytes), _mm_cvtsi32_si128(static_cast<int>(state)));
+    __m128i lane2 = load128(bytes + 16);
+    __m128i lane3 = load128(bytes + 32);
+    __m128i lane4 = load128(bytes + 48);
+    bytes += 64;
+
+    const __m128i foldBy4 = _mm_set_epi64x(0x1C6E41596, 0x154442BD4);
+    while (left >= 64) {
+        lane1 = fold(lane1, foldBy4, load128(bytes));
+        lane2 = fold(lane2, foldBy4, load128(bytes + 16));
+        lane3 = fold(lane3, foldBy4, load128(bytes + 32));
+        lane4 = fold(lane4, foldBy4, load128(bytes + 48));
+        bytes += 64;
+        left -= 64;
+    }
+
+    // Merge the lanes, then eat the remaining 16-byte blocks one at a time
+    const __m128i foldBy1 = _mm_set_epi64x(0x0CCAA009E, 0x1751997D0);
+    __m128i value = fold(lane1, foldBy1, lane2);
+    value = fold(value, foldBy1, lane3);
+    value = fold(value, foldBy1, lane4);
+    while (left >= 16) {
+        value = fold(value, foldBy1, load128(bytes));
+        bytes += 16;
+        left -= 16;
+    }
+
+    // 128 bits down to 64, then to 32, and a Barrett reduction for the final remainder
+    const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+    value = _mm_xor_si128(_mm_srli_si128(value, 8), _mm_clmulepi64_si128(value, foldBy1, 0x10));
+    const __m128i fold32 = _mm_set_epi64x(0, 0x163CD6124);
+    value = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(value, mask32), fold32, 0x00), _mm_srli_si128(value, 4));
+    const __m128i barrett = _mm_set_epi64x(0x1F7011641, 0x1DB710641);    // mu and P
+    __m128i quotient = _mm_clmulepi64_si128(_mm_and_si128(value, mask32), barrett, 0x10);
+    quotient = _mm_clmulepi64_si128(_mm_and_si128(quotient, mask32), barrett, 0x00);
+    state = static_cast<std::uint32_t>(_mm_extract_epi32(_mm_xor_si128(value, quotient), 1));
+
+    return updatePortable(state, bytes, length - folded);
+}
+
+#elif defined(__aarch64__) && defined(__linux__)
+
+// ARMv8 computes this very CRC (unlike CRC-32C, which has its own crc32c* instructions)
+__attribute__((target("+crc")))
+std::uint32_t updateArm(std::uint32_t state, const unsigned char* bytes, std::size_t length) {
+    while (length >= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        state = __crc32d(state, word);
+        bytes += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        state = __crc32b(state, *bytes++);
+    }
+    return state;
+}
+
+#endif
+
+struct Implementation {
+    UpdateFunction update;
+    const char* name;
+};
+
+Implementation selectImplementation() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        return Implementation{updatePclmul, "pclmul"};
+    }
+#elif defined(__aarch64__) && defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        return Implementation{updateArm, "armv8-crc"};
+    }
+#endif
+    return Implementation{updatePortable, "slicing-by-8"};
+}
+
+// Chosen once, on first use
+const Implementation& implementation() {
+    static const Implementation selected = selectImplementation();
+    return selected;
+}
+
+} // namespace
+
+std::uint32_t crc32(const void* data, std::size_t length, std::uint32_t crc) {
+    return ~implementation().update(~crc, static_cast<const unsigned char*>(data), length);
+}
+
+std::uint32_t crc32Portable(const void* data, std::size_t length, std::uint32_t crc) {
+    return ~updatePortable(~crc, static_cast<const unsigned char*>(data), length);
+}
+
+const char* crc32Implementation() {
+    return implementation().name;
+}
@@ -0,0 +1,31 @@
+#ifndef CRC32_H    // This will ensure no repeat definition of this header file.
+#define CRC32_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <cstddef>
+#include <cstdint>
+
+/*
+CRC-32 as used by the Ethernet frame check sequence (IEEE 802.3, reflected polynomial
+0xEDB88320), with the same conventions as zlib's crc32(): start with 0, and pass the result
+of one call as 'crc' to the next to checksum data that arrives in pieces.
+
+The work is done by the fastest implementation the CPU supports, picked once at startup:
+
+* x86-64 with PCLMULQDQ: the data is folded 64 bytes at a time with carry-less
+  multiplications, then reduced to 32 bits with a Barrett reduction. (SSE4.2 also has a crc32
+  instruction, but it computes CRC-32C, a different polynomial, so it cannot be used here.)
+* ARMv8 with the CRC extension: the crc32x/crc32b instructions, 8 bytes per instruction.
+* Everything else: a portable table-driven version that handles 8 bytes per step
+  ("slicing-by-8").
+*/
+std::uint32_t crc32(const void* data, std::size_t length, std::uint32_t crc = 0);
+
+// The portable implementation, always available; useful to check the accelerated ones.
+std::uint32_t crc32Portable(const void* data, std::size_t length, std::uint32_t crc = 0);
+
+// Name of the implementation crc32() uses: "pclmul", "armv8-crc" or "slicing-by-8".
+const char* crc32Implementation();
+
+
+#endif  // End CRC32_H
@@ -0,0 +1,171 @@
+#include "EthernetFrame.h"
+#include "Crc32.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+std::uint16_t readBigEndian16(const char* bytes) {
+    return static_cast<std::uint16_t>((static_cast<std::uint8_t>(bytes[0]) << 8) | static_cast<std::uint8_t>(bytes[1]));
+}
+
+void writeBigEndian16(char* bytes, std::uint16_t value) {
+    bytes[0] = static_cast<char>(value >> 8);
+    bytes[1] = static_cast<char>(value & 0xFF);
+}
+
+int hexDigit(char digit) {
+    if (digit >= '0' && digit <= '9') {
+        return digit - '0';
+    }
+    if (digit >= 'a' && digit <= 'f') {
+        return digit - 'a' + 10;
+    }
+    if (digit >= 'A' && digit <= 'F') {
+        return digit - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace
+
+MacAddress MacAddress::fromValue(std::uint64_t value) {
+    MacAddress address;
+    for (std::size_t index = 0; index < 6; ++index) {
+        address.bytes[index] = static_cast<std::uint8_t>(value >> (8 * (5 - index)));
+    }
+    return address;
+}
+
+std::optional<MacAddress> MacAddress::parse(const std::string& text) {
+    if (text.size() != 17) {
+        return std::nullopt;
+    }
+    MacAddress address;
+    for (std::size_t index = 0; index < 6; ++index) {
+        const int high = hexDigit(text[index * 3]);
+        const int low = hexDigit(text[index * 3 + 1]);
+        if (high < 0 || low < 0) {
+            return std::nullopt;
+        }
+        if (index < 5 && text[index * 3 + 2] != ':' && text[index * 3 + 2] != '-') {
+            return std::nullopt;
+        }
+        address.bytes[index] = static_cast<std::uint8_t>(high * 16 + low);
+    }
+    return address;
+}
+
+std::uint64_t MacAddress::value() const {
+    std::uint64_t result = 0;
+    for (std::uint8_t byte : bytes) {
+        result = (result << 8) | byte;
+    }
+    return result;
+}
+
+std::string MacAddress::toString() const {
+    static const char DIGITS[] = "0123456789abcdef";
+    std::string text;
+    for (std::size_t index = 0; index < 6; ++index) {
+        if (index > 0) {
+            text += ':';
+        }
+        text += DIGITS[bytes[index] >> 4];
+        text += DIGITS[bytes[index] & 0x0F];
+    }
+    return text;
+}
+
+// Only the type field decides whether a VLAN tag is there; nothing else is read yet
+std::optional<EthernetFrame> EthernetFrame::parse(PacketView bytes) {
+    if (bytes.size() < HEADER_SIZE + FCS_SIZE) {
+        return std::nullopt;
+    }
+    const bool tagged = readBigEndian16(bytes.data() + 2 * ADDRESS_SIZE) == EtherType::VLAN;
+    if (tagged && bytes.size() < HEADER_SIZE + VLAN_TAG_SIZE + FCS_SIZE) {
+        return std::nullopt;
+    }
+    return EthernetFrame(bytes, tagged);
+}
+
+RawPacket EthernetFrame::build(const MacAddress& destination, const MacAddress& source, std::uint16_t etherType, PacketView payload) {
+    RawPacket packet = RawPacket::withHeadroom(HEADER_SIZE, payload.size());
+    if (!payload.empty()) {
+        std::memcpy(packet.data.data(), payload.data(), payload.size());
+    }
+    encapsulate(packet, destination, source, etherType);
+    return packet;
+}
+
+void EthernetFrame::encapsulate(RawPacket& packet, const MacAddress& destination, const MacAddress& source, std::uint16_t etherType) {
+    if (packet.data.size() < MIN_PAYLOAD_SIZE) {
+        packet.data.resize(MIN_PAYLOAD_SIZE, 0);
+    }
+    char* header = packet.data.prepend(HEADER_SIZE);
+    std::memcpy(header, destination.bytes.data(), ADDRESS_SIZE);
+    std::memcpy(header + ADDRESS_SIZE, source.bytes.data(), ADDRESS_SIZE);
+    writeBigEndian16(header + 2 * ADDRESS_SIZE, etherType);
+
+    const std::uint32_t checksum = crc32(packet.data.data(), packet.data.size());
+    char* trailer = packet.data.append(FCS_SIZE);
+    for (std::size_t index = 0; index < FCS_SIZE; ++index) {
+        trailer[index] = static_cast<char>(checksum >> (8 * index));
+    }
+}
+
+bool EthernetFrame::decapsulate(RawPacket& packet) {
+    const std::optional<EthernetFrame> frame = parse(packet.view());
+    if (!frame || !frame->hasValidFcs()) {
+        return false;
+    }
+    const PacketView body = frame->payload();
+    const std::size_t front = static_cast<std::size_t>(body.data() - packet.view().data());
+    packet.data.stripFront(front);
+    packet.data.trimBack(packet.data.size() - body.size());
+    return true;
+}
+
+MacAddress EthernetFrame::destination() const {
+    MacAddress address;
+    std::memcpy(address.bytes.data(), frame.data(), ADDRESS_SIZE);
+    return address;
+}
+
+MacAddress EthernetFrame::source() const {
+    MacAddress address;
+    std::memcpy(address.bytes.data(), frame.data() + ADDRESS_SIZE, ADDRESS_SIZE);
+    return address;
+}
+
+std::uint16_t EthernetFrame::vlanId() const {
+    return tagged ? readBigEndian16(frame.data() + HEADER_SIZE) & 0x0FFF : 0;
+}
+
+std::uint16_t EthernetFrame::etherType() const {
+    return readBigEndian16(frame.data() + typeOffset());
+}
+
+// Values up to 1500 are an 802.3 length, which tells the payload apart from the padding
+PacketView EthernetFrame::payload() const {
+    const std::size_t start = typeOffset() + 2;
+    std::size_t length = frame.size() - FCS_SIZE - start;
+    const std::uint16_t type = etherType();
+    if (type <= 1500) {
+        length = std::min<std::size_t>(length, type);
+    }
+    return frame.slice(start, length);
+}
+
+std::uint32_t EthernetFrame::fcs() const {
+    const char* trailer = frame.data() + frame.size() - FCS_SIZE;
+    std::uint32_t value = 0;
+    for (std::size_t index = 0; index < FCS_SIZE; ++index) {
+        value |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(trailer[index])) << (8 * index);
+    }
+    return value;
+}
+
+bool EthernetFrame::hasValidFcs() const {
+    return crc32(frame.data(), frame.size() - FCS_SIZE) == fcs();
+}
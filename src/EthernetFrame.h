@@ -0,0 +1,110 @@
+#ifndef ETHERNET_FRAME_H    // This will ensure no repeat definition of this header file.
+#define ETHERNET_FRAME_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "RawPacket.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/*
+MacAddress is a 48-bit hardware address, stored in transmission order.
+*/
+struct MacAddress {
+    std::array<std::uint8_t, 6> bytes{};
+
+    static constexpr MacAddress broadcast() { return MacAddress{{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}}; }
+
+    // Builds an address from its 48-bit value, e.g. 0x020000000001 for 02:00:00:00:00:01.
+    static MacAddress fromValue(std::uint64_t value);
+
+    // Parses "aa:bb:cc:dd:ee:ff" (or with '-'); returns std::nullopt if the text is not an address.
+    static std::optional<MacAddress> parse(const std::string& text);
+
+    // The address as a 48-bit number, handy as a hash table key.
+    std::uint64_t value() const;
+
+    bool isBroadcast() const { return *this == broadcast(); }
+    bool isMulticast() const { return (bytes[0] & 0x01) != 0; }    // Includes broadcast.
+
+    std::string toString() const;
+
+    bool operator==(const MacAddress& other) const = default;
+};
+
+// A few EtherType values.
+namespace EtherType {
+    constexpr std::uint16_t IPV4 = 0x0800;
+    constexpr std::uint16_t ARP = 0x0806;
+    constexpr std::uint16_t VLAN = 0x8100;     // IEEE 802.1Q tag.
+    constexpr std::uint16_t IPV6 = 0x86DD;
+}
+
+/*
+EthernetFrame reads an Ethernet II / IEEE 802.3 frame in place: it only remembers where the
+frame's bytes are and decodes the fields when they are asked for, so parsing a frame neither
+copies nor allocates anything. Its layout on the wire:
+
+    destination (6) | source (6) | [802.1Q tag (4)] | EtherType or length (2) | payload | FCS (4)
+
+The FCS is the CRC-32 of everything before it (see Crc32.h), stored least significant byte
+first. A frame made with build() or encapsulate() is padded to the 64-byte minimum.
+Like a PacketView, an EthernetFrame is only valid while the bytes it looks at are.
+*/
+class EthernetFrame{
+public:
+    static constexpr std::size_t ADDRESS_SIZE = 6;
+    static constexpr std::size_t HEADER_SIZE = 14;
+    static constexpr std::size_t VLAN_TAG_SIZE = 4;
+    static constexpr std::size_t FCS_SIZE = 4;
+    static constexpr std::size_t MIN_FRAME_SIZE = 64;      // Including the FCS.
+    static constexpr std::size_t MIN_PAYLOAD_SIZE = MIN_FRAME_SIZE - HEADER_SIZE - FCS_SIZE;
+
+    // Looks at 'bytes' as a frame that ends with an FCS. Returns std::nullopt if they are too
+    // short to be one. The FCS is not checked here; see hasValidFcs().
+    static std::optional<EthernetFrame> parse(PacketView bytes);
+
+    // Builds a complete frame, padding the payload and appending the FCS.
+    static RawPacket build(const MacAddress& destination, const MacAddress& source, std::uint16_t etherType, PacketView payload);
+
+    // Turns a packet holding a payload into a frame around it: the header goes into the
+    // packet's headroom and the padding and FCS into its tailroom, so the payload stays where
+    // it is. Create the packet with RawPacket::withHeadroom(HEADER_SIZE, ...) to avoid any copy.
+    static void encapsulate(RawPacket& packet, const MacAddress& destination, const MacAddress& source, std::uint16_t etherType);
+
+    // The reverse of encapsulate(): checks the FCS and strips header, padding (for 802.3
+    // length frames) and FCS in place, leaving only the payload. Returns false, leaving the
+    // packet untouched, if it is not a valid frame.
+    static bool decapsulate(RawPacket& packet);
+
+    MacAddress destination() const;
+    MacAddress source() const;
+
+    bool hasVlanTag() const { return tagged; }
+    std::uint16_t vlanId() const;       // 0 without a tag.
+
+    // The EtherType, or for an IEEE 802.3 frame the payload length (values up to 1500).
+    std::uint16_t etherType() const;
+
+    // The payload, including any padding unless the type field gives its length.
+    PacketView payload() const;
+
+    std::uint32_t fcs() const;
+    bool hasValidFcs() const;
+
+    // All bytes of the frame, FCS included.
+    PacketView bytes() const { return frame; }
+
+private:
+    explicit EthernetFrame(PacketView frame, bool tagged) : frame(frame), tagged(tagged) {}
+
+    PacketView frame;
+    bool tagged;
+
+    std::size_t typeOffset() const { return tagged ? HEADER_SIZE - 2 + VLAN_TAG_SIZE : HEADER_SIZE - 2; }
+};
+
+
+#endif  // End ETHERNET_FRAME_H
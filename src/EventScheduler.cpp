@@ -0,0 +1,193 @@
+#include "EventScheduler.h"
+#include "Checkpoint.h"
+#include "Trace.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+// An event as it is stored in a checkpoint, with its target replaced by an index
+struct SavedEvent {
+    SimTime time;
+    std::uint64_t sequence;
+    std::uint64_t target;
+    std::uint64_t cookie;
+};
+
+} // namespace
+
+EventScheduler::EventScheduler(SimTime slotWidth)
+    : slotWidth(slotWidth > 0 ? slotWidth : 1), slots(SLOT_COUNT), occupied(SLOT_COUNT / 64, 0) {}
+
+void EventScheduler::markOccupied(std::size_t slot) {
+    occupied[slot / 64] |= std::uint64_t(1) << (slot % 64);
+}
+
+void EventScheduler::markEmpty(std::size_t slot) {
+    occupied[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+}
+
+// Puts an event into its wheel slot, or into the overflow heap if it is beyond the horizon
+void EventScheduler::insert(const Event& event) {
+    // An event earlier than the cursor (possible after nextEventTime() peeked ahead)
+    // goes into the cursor's slot, where sorting by time still puts it first.
+    const std::uint64_t absoluteSlot = std::max<std::uint64_t>(event.time / slotWidth, cursor);
+    if (absoluteSlot - cursor >= SLOT_COUNT) {
+        overflow.push(event);
+        return;
+    }
+    const std::size_t slot = absoluteSlot & SLOT_MASK;
+    std::vector<Event>& events = slots[slot];
+    if (absoluteSlot == cursor && cursorSlotSorted) {
+        events.insert(std::upper_bound(events.begin(), events.end(), event, FiresLater()), event);
+    } else {
+        events.push_back(event);
+    }
+    markOccupied(slot);
+    ++wheelCount;
+}
+
+void EventScheduler::schedule(SimTime time, EventTarget* target, std::uint64_t cookie) {
+    insert(Event{std::max(time, currentTime), nextSequence++, target, cookie});
+    ++pendingCount;
+}
+
+void EventScheduler::pullFromOverflow() {
+    while (!overflow.empty() && overflow.top().time / slotWidth - cursor < SLOT_COUNT) {
+        Event event = overflow.top();
+        overflow.pop();
+        insert(event);
+    }
+}
+
+// Finds the next non-empty slot and makes sure it is sorted
+bool EventScheduler::advanceToNextEvent() {
+    if (wheelCount == 0) {
+        if (overflow.empty()) {
+            return false;
+        }
+        // Nothing inside the horizon: jump straight to the earliest far-away event
+        cursor = overflow.top().time / slotWidth;
+        cursorSlotSorted = false;
+        pullFromOverflow();
+    } else {
+        const std::size_t start = cursor & SLOT_MASK;
+        std::size_t word = start / 64;
+        std::uint64_t bits = occupied[word] & (~std::uint64_t(0) << (start % 64));
+        while (bits == 0) {
+            word = (word + 1) % occupied.size();
+            bits = occupied[word];
+        }
+        const std::size_t found = word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits));
+        const std::size_t distance = (found - start) & SLOT_MASK;
+        if (distance > 0) {
+            cursor += distance;
+            cursorSlotSorted = false;
+            pullFromOverflow();
+        }
+    }
+    if (!cursorSlotSorted) {
+        std::vector<Event>& events = slots[cursor & SLOT_MASK];
+        std::sort(events.begin(), events.end(), FiresLater());
+        cursorSlotSorted = true;
+    }
+    return true;
+}
+
+SimTime EventScheduler::nextEventTime() {
+    if (!advanceToNextEvent()) {
+        return currentTime;
+    }
+    return slots[cursor & SLOT_MASK].back().time;
+}
+
+// Takes the earliest event out of the wheel, moves the clock to it and fires it
+bool EventScheduler::step() {
+    NETEMU_TRACE_SCOPE(Scheduler, "EventScheduler::step");
+    if (!advanceToNextEvent()) {
+        return false;
+    }
+    const std::size_t slot = cursor & SLOT_MASK;
+    std::vector<Event>& events = slots[slot];
+    const Event event = events.back();
+    events.pop_back();
+    if (events.empty()) {
+        markEmpty(slot);
+    }
+    --wheelCount;
+    --pendingCount;
+
+    currentTime = event.time;
+    event.target->onEvent(currentTime, event.cookie);
+    return true;
+}
+
+void EventScheduler::run() {
+    while (step()) {
+    }
+}
+
+void EventScheduler::runUntil(SimTime endTime) {
+    while (!empty() && nextEventTime() <= endTime) {
+        step();
+    }
+    currentTime = std::max(currentTime, endTime);
+}
+// The overflow heap is read from a copy, since a priority queue cannot be walked
+void EventScheduler::saveState(CheckpointWriter& writer, const std::vector<EventTarget*>& targets) const {
+    std::unordered_map<const EventTarget*, std::uint64_t> indexOf;
+    for (std::size_t index = 0; index < targets.size(); ++index) {
+        if (targets[index] != nullptr) {
+            indexOf.emplace(targets[index], index);
+        }
+    }
+    std::vector<SavedEvent> events;
+    events.reserve(pendingCount);
+    auto save = [&](const Event& event) {
+        const auto found = indexOf.find(event.target);
+        if (found == indexOf.end()) {
+            throw std::runtime_error("A pending event belongs to something a checkpoint cannot name");
+        }
+        events.push_back(SavedEvent{event.time, event.sequence, found->second, event.cookie});
+    };
+    for (const std::vector<Event>& slot : slots) {
+        for (const Event& event : slot) {
+            save(event);
+        }
+    }
+    for (std::priority_queue<Event, std::vector<Event>, FiresLater> rest = overflow; !rest.empty(); rest.pop()) {
+        save(rest.top());
+    }
+    writer.put(currentTime);
+    writer.put(nextSequence);
+    writer.putArray(events.data(), events.size());
+}
+
+// Every event goes back through insert(), so the wheel may have another slot width than the saved one
+void EventScheduler::restoreState(CheckpointReader& reader, const std::vector<EventTarget*>& targets) {
+    const SimTime savedTime = reader.get<SimTime>();
+    const std::uint64_t savedSequence = reader.get<std::uint64_t>();
+    std::vector<SavedEvent> events;
+    reader.getArray(events);
+    for (const SavedEvent& event : events) {
+        if (event.target >= targets.size() || targets[event.target] == nullptr) {
+            throw std::runtime_error("A checkpointed event belongs to a target that does not exist");
+        }
+    }
+
+    for (std::vector<Event>& slot : slots) {
+        slot.clear();
+    }
+    std::fill(occupied.begin(), occupied.end(), 0);
+    overflow = std::priority_queue<Event, std::vector<Event>, FiresLater>();
+    wheelCount = 0;
+    currentTime = savedTime;
+    nextSequence = savedSequence;
+    cursor = currentTime / slotWidth;
+    cursorSlotSorted = false;
+    for (const SavedEvent& event : events) {
+        insert(Event{event.time, event.sequence, targets[event.target], event.cookie});
+    }
+    pendingCount = events.size();
+}
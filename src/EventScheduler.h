@@ -0,0 +1,131 @@
+#ifndef EVENT_SCHEDULER_H    // This will ensure no repeat definition of this header file.
+#define EVENT_SCHEDULER_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Virtual time of the emulation, in nanoseconds since the start of the run.
+using SimTime = std::uint64_t;
+
+constexpr SimTime NANOSECOND = 1;
+constexpr SimTime MICROSECOND = 1000 * NANOSECOND;
+constexpr SimTime MILLISECOND = 1000 * MICROSECOND;
+constexpr SimTime SECOND = 1000 * MILLISECOND;
+
+/*
+EventTarget is implemented by everything that wants to be called back by the EventScheduler.
+The 'cookie' is the value passed to schedule(); it tells the target which of its events fired
+(for example which in-flight frame is due), so no per-event object has to be allocated.
+*/
+class EventTarget{
+public:
+    virtual ~EventTarget() = default;
+    virtual void onEvent(SimTime now, std::uint64_t cookie) = 0;
+};
+
+/*
+EventScheduler is the discrete-event engine of the emulator. It keeps a virtual clock and a
+set of pending events; running the scheduler repeatedly jumps the clock to the earliest
+pending event and fires it. Nothing ever sleeps, so hours of virtual time pass as fast as
+the events can be processed.
+
+Events are kept in a timer wheel: a ring of SLOT_COUNT slots, each covering 'slotWidth'
+nanoseconds. Events within the wheel's horizon are dropped into their slot in O(1); events
+further in the future wait in an overflow heap and are moved into the wheel as the clock
+gets close to them. A bitmap of non-empty slots lets the scheduler skip idle stretches.
+
+Events with the same time fire in the order they were scheduled.
+*/
+class EventScheduler{
+public:
+    // Number of slots in the wheel (a power of two).
+    static constexpr std::size_t SLOT_COUNT = 4096;
+
+    // 'slotWidth' is the time covered by one wheel slot; pick it close to the typical
+    // spacing between events (the default of 1 microsecond suits per-frame events).
+    explicit EventScheduler(SimTime slotWidth = MICROSECOND);
+
+    // Current virtual time.
+    SimTime now() const { return currentTime; }
+
+    // Schedules target->onEvent(time, cookie). A time in the past is treated as "now".
+    void schedule(SimTime time, EventTarget* target, std::uint64_t cookie = 0);
+
+    // Schedules an event 'delay' nanoseconds from now.
+    void scheduleAfter(SimTime delay, EventTarget* target, std::uint64_t cookie = 0) {
+        schedule(currentTime + delay, target, cookie);
+    }
+
+    // Fires the earliest pending event. Returns false if there was none.
+    bool step();
+
+    // Fires events until none is left.
+    void run();
+
+    // Fires every event due at or before 'endTime', then sets the clock to 'endTime'.
+    void runUntil(SimTime endTime);
+
+    // True if no event is pending.
+    bool empty() const { return pendingCount == 0; }
+
+    // Number of pending events.
+    std::size_t pendingEvents() const { return pendingCount; }
+
+    // Time of the earliest pending event (only meaningful if !empty()).
+    SimTime nextEventTime();
+
+    // Writes the clock and every pending event to a checkpoint. A target is written as its
+    // index in 'targets'; throws std::runtime_error if an event's target is not in the list.
+    void saveState(CheckpointWriter& writer, const std::vector<EventTarget*>& targets) const;
+
+    // Replaces the clock and the pending events with those of a checkpoint written by
+    // saveState(), whose targets are looked up in 'targets' by index. Events keep their order
+    // of scheduling, so ties still fire as they would have in the saved run.
+    void restoreState(CheckpointReader& reader, const std::vector<EventTarget*>& targets);
+
+private:
+    struct Event {
+        SimTime time;
+        std::uint64_t sequence;     // Order of scheduling, breaks ties between equal times.
+        EventTarget* target;
+        std::uint64_t cookie;
+    };
+    // "Fires later than": used to keep slots sorted with the earliest event at the back,
+    // and as the comparison of the overflow min-heap.
+    struct FiresLater {
+        bool operator()(const Event& a, const Event& b) const {
+            return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+        }
+    };
+
+    static constexpr std::size_t SLOT_MASK = SLOT_COUNT - 1;
+
+    const SimTime slotWidth;
+    SimTime currentTime = 0;
+    std::uint64_t nextSequence = 0;
+    std::size_t pendingCount = 0;
+    std::size_t wheelCount = 0;             // Events stored in the wheel (not in the overflow heap).
+
+    std::uint64_t cursor = 0;               // Absolute slot number the wheel starts at.
+    bool cursorSlotSorted = false;          // The slot at 'cursor' is sorted, earliest event last.
+    std::vector<std::vector<Event>> slots;
+    std::vector<std::uint64_t> occupied;    // One bit per slot: the slot holds events.
+    std::priority_queue<Event, std::vector<Event>, FiresLater> overflow;
+
+    void insert(const Event& event);
+    void markOccupied(std::size_t slot);
+    void markEmpty(std::size_t slot);
+    // Moves the cursor to the next slot holding an event (wheel or overflow); false if there is none.
+    bool advanceToNextEvent();
+    // Moves overflow events that now fall within the wheel's horizon into the wheel.
+    void pullFromOverflow();
+};
+
+
+#endif  // End EVENT_SCHEDULER_H
\ No newline at end of file
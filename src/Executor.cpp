@@ -0,0 +1,42 @@
+#include "Executor.h"
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+    for (std::size_t index = 0; index < (threadCount == 0 ? 1 : threadCount); ++index) {
+        workers.emplace_back([this]() { work(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        runQueue.push_back(handle);
+    }
+    wakeUp.notify_one();
+}
+
+// Resumes posted coroutines until the pool is destroyed and nothing is left to run
+void ThreadPool::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wakeUp.wait(lock, [this]() { return stopping || !runQueue.empty(); });
+        if (runQueue.empty()) {
+            return;
+        }
+        std::coroutine_handle<> handle = runQueue.front();
+        runQueue.pop_front();
+        lock.unlock();
+        handle.resume();
+        lock.lock();
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef EXECUTOR_H    // This will ensure no repeat definition of this header file.
+#define EXECUTOR_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+An Executor decides where a suspended coroutine continues. When a medium has a packet for a
+coroutine that is waiting in 'co_await medium.receive(executor)', it hands the coroutine to
+that executor instead of resuming it on the sending thread.
+*/
+class Executor{
+public:
+    virtual ~Executor() = default;
+
+    // Arranges for 'handle' to be resumed. May be called from any thread.
+    virtual void post(std::coroutine_handle<> handle) = 0;
+};
+
+/*
+InlineExecutor resumes the coroutine right away, on the thread that posts it. That is the
+right choice when everything runs on one thread anyway, e.g. nodes driven by an EventScheduler:
+the coroutine continues from inside the event that delivered its packet.
+*/
+class InlineExecutor : public Executor{
+public:
+    void post(std::coroutine_handle<> handle) override { handle.resume(); }
+
+    // A shared instance, used when no executor is given.
+    static InlineExecutor& instance() {
+        static InlineExecutor executor;
+        return executor;
+    }
+};
+
+/*
+ThreadPool runs coroutines on a fixed number of worker threads, so thousands of node state
+machines can share a few cores. Posted coroutines are resumed in FIFO order; a worker only
+sleeps when the run queue is empty.
+*/
+class ThreadPool : public Executor{
+public:
+    explicit ThreadPool(std::size_t threadCount);
+
+    // Stops the workers once the run queue is empty; coroutines still suspended elsewhere
+    // (e.g. waiting for a packet) are not resumed any more.
+    ~ThreadPool();
+
+    void post(std::coroutine_handle<> handle) override;
+
+    // 'co_await pool.schedule()' moves the calling coroutine onto one of the pool's threads.
+    auto schedule() {
+        struct ScheduleAwaiter {
+            ThreadPool& pool;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { pool.post(handle); }
+            void await_resume() const noexcept {}
+        };
+        return ScheduleAwaiter{*this};
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::deque<std::coroutine_handle<>> runQueue;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void work();
+};
+
+/*
+Task is the return type of a fire-and-forget coroutine, such as the main loop of a node:
+
+    Task receiveLoop(NetworkMedium& medium, ThreadPool& pool) {
+        co_await pool.schedule();
+        for (;;) {
+            RawPacket packet = co_await medium.receive(pool);
+            ...
+        }
+    }
+
+The coroutine starts running as soon as it is called and frees itself when it returns.
+*/
+class Task{
+public:
+    struct promise_type {
+        Task get_return_object() noexcept { return Task(); }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+
+#endif  // End EXECUTOR_H
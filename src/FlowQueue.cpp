@@ -0,0 +1,401 @@
+#include "FlowQueue.h"
+#include "Checkpoint.h"
+#include "EthernetFrame.h"
+#include "Random.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr std::size_t KEY_WORDS = 5;
+constexpr std::uint8_t PROTOCOL_TCP = 6;
+constexpr std::uint8_t PROTOCOL_UDP = 17;
+
+// Odd multipliers, one per lane of the hash
+constexpr std::uint64_t LANE_MULTIPLIERS[KEY_WORDS] = {
+    0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull, 0xFF51AFD7ED558CCDull,
+};
+
+std::uint8_t byteAt(PacketView frame, std::size_t offset) {
+    return static_cast<std::uint8_t>(frame[offset]);
+}
+
+std::uint64_t readBigEndian(PacketView frame, std::size_t offset, std::size_t count) {
+    std::uint64_t value = 0;
+    for (std::size_t index = 0; index < count; ++index) {
+        value = (value << 8) | byteAt(frame, offset + index);
+    }
+    return value;
+}
+
+// Offset of the network header and the EtherType, looking through one 802.1Q tag
+std::uint16_t networkType(PacketView frame, std::size_t& offset) {
+    offset = EthernetFrame::HEADER_SIZE;
+    std::uint16_t type = static_cast<std::uint16_t>(readBigEndian(frame, offset - 2, 2));
+    if (type == EtherType::VLAN && frame.size() >= offset + EthernetFrame::VLAN_TAG_SIZE) {
+        offset += EthernetFrame::VLAN_TAG_SIZE;
+        type = static_cast<std::uint16_t>(readBigEndian(frame, offset - 2, 2));
+    }
+    return type;
+}
+
+// The key is always five words, zero where the frame has no such field, so hashing it never branches
+void readKey(PacketView frame, FlowKey key, std::uint64_t (&words)[KEY_WORDS]) {
+    if (frame.size() < EthernetFrame::HEADER_SIZE) {
+        return;
+    }
+    if (key == FlowKey::FiveTuple) {
+        std::size_t offset;
+        const std::uint16_t type = networkType(frame, offset);
+        if (type == EtherType::IPV4 && frame.size() >= offset + 20) {
+            const std::size_t headerLength = static_cast<std::size_t>(byteAt(frame, offset) & 0x0F) * 4;
+            const std::uint8_t protocol = byteAt(frame, offset + 9);
+            const bool firstFragment = (readBigEndian(frame, offset + 6, 2) & 0x1FFF) == 0;
+            std::memcpy(&words[0], frame.data() + offset + 12, 8);
+            words[4] = protocol | (std::uint64_t{4} << 8);
+            if ((protocol == PROTOCOL_TCP || protocol == PROTOCOL_UDP) && firstFragment &&
+                headerLength >= 20 && frame.size() >= offset + headerLength + 4) {
+                words[4] |= readBigEndian(frame, offset + headerLength, 4) << 16;
+            }
+            return;
+        }
+        if (type == EtherType::IPV6 && frame.size() >= offset + 40) {
+            const std::uint8_t protocol = byteAt(frame, offset + 6);
+            std::memcpy(&words[0], frame.data() + offset + 8, 32);
+            words[4] = protocol | (std::uint64_t{6} << 8);
+            if ((protocol == PROTOCOL_TCP || protocol == PROTOCOL_UDP) && frame.size() >= offset + 44) {
+                words[4] |= readBigEndian(frame, offset + 40, 4) << 16;
+            }
+            return;
+        }
+    }
+    words[0] = readBigEndian(frame, 0, EthernetFrame::ADDRESS_SIZE);
+    words[1] = readBigEndian(frame, EthernetFrame::ADDRESS_SIZE, EthernetFrame::ADDRESS_SIZE);
+}
+
+// The lanes are independent multiply-fold steps, so they run side by side; only the final mix is serial
+std::uint64_t hashKey(const std::uint64_t (&words)[KEY_WORDS], std::uint64_t seed) {
+    std::uint64_t lanes[KEY_WORDS];
+    for (std::size_t lane = 0; lane < KEY_WORDS; ++lane) {
+        const std::uint64_t value = (words[lane] ^ seed) * LANE_MULTIPLIERS[lane];
+        lanes[lane] = value ^ (value >> 29);
+    }
+    std::uint64_t hash = lanes[0] ^ std::rotl(lanes[1], 13) ^ std::rotl(lanes[2], 27) ^
+                         std::rotl(lanes[3], 41) ^ std::rotl(lanes[4], 53);
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+} // namespace
+
+FlowQueue::FlowQueue(const FlowQueueConfig& config) : config(config) {
+    if (config.flowQueues == 0 || config.flowQueues > (std::size_t{1} << 31)) {
+        throw std::invalid_argument("A flow queue needs between 1 and 2^31 flow queues");
+    }
+    if (config.quantum == 0) {
+        throw std::invalid_argument("The quantum of a flow queue must not be zero");
+    }
+    if (config.priorityClasses == 0 || config.priorityClasses > 64) {
+        throw std::invalid_argument("A flow queue has between 1 and 64 priority classes");
+    }
+    std::uint64_t seedState = config.seed;
+    hashSeed = splitMix64(seedState);
+    const std::size_t queues = config.policy == FlowPolicy::StrictPriority ? config.priorityClasses
+                                                                            : std::bit_ceil(config.flowQueues);
+    mask = static_cast<std::uint32_t>(std::bit_ceil(config.flowQueues) - 1);
+    flows.resize(queues);
+}
+
+// 802.1Q PCP if the frame is tagged, otherwise the IP precedence; a higher value is served first
+std::uint32_t FlowQueue::priorityOf(PacketView frame) const {
+    std::uint32_t priority = 0;
+    if (frame.size() >= EthernetFrame::HEADER_SIZE) {
+        const std::uint16_t outerType = static_cast<std::uint16_t>(readBigEndian(frame, EthernetFrame::HEADER_SIZE - 2, 2));
+        std::size_t offset;
+        const std::uint16_t type = networkType(frame, offset);
+        if (outerType == EtherType::VLAN && offset > EthernetFrame::HEADER_SIZE) {
+            priority = byteAt(frame, EthernetFrame::HEADER_SIZE) >> 5;
+        } else if (type == EtherType::IPV4 && frame.size() > offset + 1) {
+            priority = byteAt(frame, offset + 1) >> 5;
+        } else if (type == EtherType::IPV6 && frame.size() > offset + 1) {
+            priority = (byteAt(frame, offset) & 0x0F) >> 1;
+        }
+    }
+    return static_cast<std::uint32_t>((7 - priority) * config.priorityClasses / 8);
+}
+
+std::uint32_t FlowQueue::classify(PacketView frame) const {
+    if (config.policy == FlowPolicy::StrictPriority) {
+        return priorityOf(frame);
+    }
+    std::uint64_t words[KEY_WORDS] = {};
+    readKey(frame, config.key, words);
+    return static_cast<std::uint32_t>(hashKey(words, hashSeed)) & mask;
+}
+
+std::uint32_t FlowQueue::allocateEntry() {
+    if (freeEntries != NONE) {
+        const std::uint32_t index = freeEntries;
+        freeEntries = entries[index].next;
+        entries[index].next = NONE;
+        return index;
+    }
+    entries.emplace_back();
+    return static_cast<std::uint32_t>(entries.size() - 1);
+}
+
+void FlowQueue::freeEntry(std::uint32_t index) {
+    entries[index].packet = RawPacket();    // Gives the block back now, not when the entry is reused
+    entries[index].next = freeEntries;
+    freeEntries = index;
+}
+
+void FlowQueue::pushFrame(std::uint32_t queue, RawPacket& packet, SimTime readyTime) {
+    const std::uint32_t index = allocateEntry();
+    Entry& entry = entries[index];
+    const std::size_t bytes = packet.data.size();
+    entry.packet.data = std::move(packet.data);
+    entry.readyTime = readyTime;
+
+    Flow& flow = flows[queue];
+    if (flow.tail != NONE) {
+        entries[flow.tail].next = index;
+    } else {
+        flow.head = index;
+        ++counters.activeFlows;
+    }
+    flow.tail = index;
+    ++flow.frames;
+    flow.bytes += bytes;
+    ++counters.frames;
+    counters.bytes += bytes;
+}
+
+std::uint32_t FlowQueue::popFrame(std::uint32_t queue) {
+    Flow& flow = flows[queue];
+    const std::uint32_t index = flow.head;
+    flow.head = entries[index].next;
+    if (flow.head == NONE) {
+        flow.tail = NONE;
+        --counters.activeFlows;
+    }
+    entries[index].next = NONE;
+    const std::size_t bytes = entries[index].packet.data.size();
+    --flow.frames;
+    flow.bytes -= bytes;
+    --counters.frames;
+    counters.bytes -= bytes;
+    return index;
+}
+
+void FlowQueue::dropFront(std::uint32_t queue) {
+    freeEntry(popFrame(queue));
+    if (config.policy == FlowPolicy::StrictPriority && flows[queue].frames == 0) {
+        busyClasses &= ~(std::uint64_t{1} << queue);
+    }
+}
+
+void FlowQueue::append(ActiveList& list, std::uint32_t queue) {
+    flows[queue].nextActive = NONE;
+    if (list.tail != NONE) {
+        flows[list.tail].nextActive = queue;
+    } else {
+        list.head = queue;
+    }
+    list.tail = queue;
+}
+
+std::uint32_t FlowQueue::popFront(ActiveList& list) {
+    const std::uint32_t queue = list.head;
+    list.head = flows[queue].nextActive;
+    if (list.head == NONE) {
+        list.tail = NONE;
+    }
+    flows[queue].nextActive = NONE;
+    return queue;
+}
+
+// A queue that was idle joins the new flows with a full quantum (RFC 8290, section 4.1.1)
+std::size_t FlowQueue::enqueue(RawPacket& packet, SimTime readyTime) {
+    const std::uint32_t queue = classify(packet.view());
+    Flow& flow = flows[queue];
+    if (config.policy == FlowPolicy::StrictPriority) {
+        busyClasses |= std::uint64_t{1} << queue;
+    } else if (flow.list == List::None) {
+        const bool fq = config.policy == FlowPolicy::FqCodel;
+        append(fq ? newFlows : oldFlows, queue);
+        flow.list = fq ? List::New : List::Old;
+        flow.deficit = static_cast<std::int64_t>(config.quantum);
+        ++counters.newFlows;
+    }
+    pushFrame(queue, packet, readyTime);
+    ++counters.enqueued;
+    counters.highWaterFrames = std::max(counters.highWaterFrames, counters.frames);
+
+    if (config.maxFrames == 0 || counters.frames <= config.maxFrames) {
+        return 0;
+    }
+    // StrictPriority drops from the lowest class that holds frames; the others from the
+    // queue holding the most bytes, which is the only walk over all queues
+    std::uint32_t victim = 0;
+    if (config.policy == FlowPolicy::StrictPriority) {
+        victim = static_cast<std::uint32_t>(63 - std::countl_zero(busyClasses));
+    } else {
+        for (std::uint32_t index = 1; index < flows.size(); ++index) {
+            if (flows[index].bytes > flows[victim].bytes) {
+                victim = index;
+            }
+        }
+    }
+    dropFront(victim);
+    ++counters.overflowDrops;
+    return 1;
+}
+
+bool FlowQueue::dequeue(RawPacket& out, SimTime& readyTime, SimTime now, std::size_t& dropped) {
+    const bool found = config.policy == FlowPolicy::StrictPriority ? dequeuePriority(out, readyTime)
+                                                                   : dequeueRoundRobin(out, readyTime, now, dropped);
+    if (found) {
+        ++counters.dequeued;
+    }
+    return found;
+}
+
+// New flows go before old ones; a queue that used up its deficit goes to the back of the old
+// flows with a fresh quantum, and an emptied queue leaves the lists (RFC 8290, section 4.2)
+bool FlowQueue::dequeueRoundRobin(RawPacket& out, SimTime& readyTime, SimTime now, std::size_t& dropped) {
+    const bool codel = config.policy == FlowPolicy::FqCodel;
+    for (;;) {
+        const bool fromNew = newFlows.head != NONE;
+        ActiveList& list = fromNew ? newFlows : oldFlows;
+        if (list.head == NONE) {
+            return false;
+        }
+        const std::uint32_t queue = list.head;
+        Flow& flow = flows[queue];
+        if (flow.deficit <= 0) {
+            flow.deficit += static_cast<std::int64_t>(config.quantum);
+            append(oldFlows, popFront(list));
+            flow.list = List::Old;
+            continue;
+        }
+
+        // CoDel looks at the front frame of this flow only, so a slow flow never makes a fast one drop
+        while (flow.head != NONE && codel) {
+            const SimTime frameReadyTime = entries[flow.head].readyTime;
+            const SimTime sojourn = now > frameReadyTime ? now - frameReadyTime : 0;
+            if (!flow.codel.shouldDrop(sojourn, now, flow.frames > 1, config.codelTarget, config.codelInterval)) {
+                break;
+            }
+            freeEntry(popFrame(queue));
+            ++counters.codelDrops;
+            ++dropped;
+        }
+        if (flow.head == NONE) {
+            // Moving an emptied new flow behind the old ones stops a flow that sends one frame
+            // at a time from always counting as new
+            popFront(list);
+            if (fromNew && oldFlows.head != NONE) {
+                append(oldFlows, queue);
+                flow.list = List::Old;
+            } else {
+                flow.list = List::None;
+            }
+            continue;
+        }
+
+        const std::uint32_t index = popFrame(queue);
+        Entry& entry = entries[index];
+        flow.deficit -= static_cast<std::int64_t>(entry.packet.data.size());
+        out.data = std::move(entry.packet.data);
+        readyTime = entry.readyTime;
+        freeEntry(index);
+        return true;
+    }
+}
+
+// The lowest set bit is the highest class with frames
+bool FlowQueue::dequeuePriority(RawPacket& out, SimTime& readyTime) {
+    if (busyClasses == 0) {
+        return false;
+    }
+    const std::uint32_t queue = static_cast<std::uint32_t>(std::countr_zero(busyClasses));
+    const std::uint32_t index = popFrame(queue);
+    if (flows[queue].frames == 0) {
+        busyClasses &= ~(std::uint64_t{1} << queue);
+    }
+    out.data = std::move(entries[index].packet.data);
+    readyTime = entries[index].readyTime;
+    freeEntry(index);
+    return true;
+}
+
+// The queues keep their CoDel state and the counters their totals
+void FlowQueue::clear() {
+    for (Flow& flow : flows) {
+        flow.head = NONE;
+        flow.tail = NONE;
+        flow.frames = 0;
+        flow.bytes = 0;
+        flow.nextActive = NONE;
+        flow.list = List::None;
+    }
+    entries.clear();
+    freeEntries = NONE;
+    newFlows = ActiveList();
+    oldFlows = ActiveList();
+    busyClasses = 0;
+    counters.frames = 0;
+    counters.bytes = 0;
+    counters.activeFlows = 0;
+}
+
+// Layout: the queues (their links into the lists are queue numbers, which stay valid), the
+// frames of each queue in order, the lists and the counters. Entry numbers are not saved;
+// restoring builds a fresh pool.
+void FlowQueue::saveState(CheckpointWriter& writer) const {
+    writer.putArray(flows.data(), flows.size());
+    for (const Flow& flow : flows) {
+        for (std::uint32_t index = flow.head; index != NONE; index = entries[index].next) {
+            writer.put(entries[index].readyTime);
+            writer.putBytes(entries[index].packet.view());
+        }
+    }
+    writer.put(newFlows);
+    writer.put(oldFlows);
+    writer.put(busyClasses);
+    writer.put(counters);
+}
+
+void FlowQueue::restoreState(CheckpointReader& reader) {
+    clear();
+    const std::size_t queues = flows.size();
+    reader.getArray(flows);
+    if (flows.size() != queues) {
+        throw std::runtime_error("Checkpoint section '" + reader.getName() + "' was saved from a flow queue with " +
+                                 std::to_string(flows.size()) + " queues, not " + std::to_string(queues));
+    }
+    for (std::uint32_t queue = 0; queue < queues; ++queue) {
+        Flow& flow = flows[queue];
+        const std::uint32_t frames = flow.frames;
+        flow.head = NONE;
+        flow.tail = NONE;
+        flow.frames = 0;
+        flow.bytes = 0;
+        for (std::uint32_t frame = 0; frame < frames; ++frame) {
+            const SimTime frameReadyTime = reader.get<SimTime>();
+            const PacketView bytes = reader.getBytes();
+            RawPacket packet(bytes.data(), bytes.size());
+            pushFrame(queue, packet, frameReadyTime);
+        }
+    }
+    reader.get(newFlows);
+    reader.get(oldFlows);
+    reader.get(busyClasses);
+    reader.get(counters);
+}
@@ -0,0 +1,169 @@
+#ifndef FLOW_QUEUE_H    // This will ensure no repeat definition of this header file.
+#define FLOW_QUEUE_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "QueueLimit.h"
+#include "RawPacket.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// How a FlowQueue picks the next frame to hand to the receiver.
+enum class FlowPolicy {
+    Drr,            // Deficit round robin: every busy flow sends 'quantum' bytes per round.
+    FqCodel,        // FQ-CoDel (RFC 8290): DRR that serves new flows first, with CoDel in every flow.
+    StrictPriority, // Priority classes from the 802.1Q PCP or the IP precedence; FIFO within a class.
+};
+
+// Which header fields make up a flow.
+enum class FlowKey {
+    Addresses,      // The Ethernet source and destination address.
+    FiveTuple,      // IP addresses, protocol and TCP/UDP ports; the Ethernet addresses for non-IP frames.
+};
+
+/*
+FlowQueueConfig sets up the scheduler stage of a medium (see NetworkMedium::setFlowQueue()).
+Flows are hashed into 'flowQueues' queues, the way fq_codel does: memory depends on the
+number of queues, never on the number of flows, and flows whose hashes collide share a queue.
+*/
+struct FlowQueueConfig {
+    FlowPolicy policy = FlowPolicy::FqCodel;
+    FlowKey key = FlowKey::FiveTuple;
+    std::size_t flowQueues = 1024;      // Rounded up to a power of two.
+    std::size_t quantum = 1514;         // Bytes a flow may send per round (DRR and FQ-CoDel).
+    std::size_t maxFrames = 10240;      // Frames held at most, over all flows; 0 means no limit.
+    std::size_t priorityClasses = 8;    // StrictPriority: number of classes (1 to 64); class 0 goes first.
+
+    // FQ-CoDel: the CoDel target and interval of every flow.
+    SimTime codelTarget = 5 * MILLISECOND;
+    SimTime codelInterval = 100 * MILLISECOND;
+
+    std::uint64_t seed = 1;             // Perturbs the flow hash, so collisions differ between runs.
+};
+
+// What the flow queue has done so far, and how full it is.
+struct FlowCounters {
+    std::uint64_t enqueued = 0;
+    std::uint64_t dequeued = 0;
+    std::uint64_t overflowDrops = 0;    // Dropped from the longest queue because 'maxFrames' was reached.
+    std::uint64_t codelDrops = 0;       // Dropped by a flow's CoDel because they waited too long.
+    std::uint64_t newFlows = 0;         // Times an idle queue became busy.
+    std::size_t frames = 0;             // Frames held now,
+    std::size_t bytes = 0;              // and their bytes.
+    std::size_t activeFlows = 0;        // Queues holding frames now.
+    std::size_t highWaterFrames = 0;
+};
+
+/*
+FlowQueue is a scheduler stage between the wire and the receiver of a medium: arriving frames
+are classified into flows and the next frame to be received is chosen among the flows, so one
+heavy flow can no longer hold up everybody else the way it does in a single FIFO.
+
+Classifying a frame reads the header fields of the key into a fixed block of five 64-bit
+words and hashes them in independent lanes (multiply and fold, no loop-carried dependency, so
+the compiler can vectorize it). The hash picks one of the flow queues.
+
+Frames are kept in one pool of entries linked by index, shared by all queues, so enqueueing
+and dequeueing are O(1) and allocate nothing once the pool has reached the working size. Busy
+queues are linked into the round robin lists (DRR, FQ-CoDel), or marked in a bitmap of classes
+(StrictPriority), so finding the next one never scans idle queues. When 'maxFrames' is reached
+the front frame of the longest queue (by bytes, as fq_codel does) is dropped, which is the one
+case that walks over all queues; StrictPriority drops from the lowest class holding frames.
+
+Single-threaded, like the Queue backend it serves.
+*/
+class FlowQueue{
+public:
+    // Throws std::invalid_argument if there are no flow queues or more than 2^31, the quantum
+    // is zero or the number of priority classes is not between 1 and 64.
+    explicit FlowQueue(const FlowQueueConfig& config);
+
+    // The flow queue 'frame' belongs to (for StrictPriority, its class).
+    // A higher PCP or IP precedence maps to a lower class, which is served first.
+    std::uint32_t classify(PacketView frame) const;
+
+    // Adds a frame that would have arrived at 'readyTime' over an idle wire. Returns the number
+    // of frames dropped to make room (see 'maxFrames'), which may include this one.
+    std::size_t enqueue(RawPacket& packet, SimTime readyTime);
+
+    // Moves the next frame to send into 'out', as of time 'now', and returns true, or returns
+    // false if no frame is left. 'dropped' is increased by the frames CoDel dropped on the way.
+    bool dequeue(RawPacket& out, SimTime& readyTime, SimTime now, std::size_t& dropped);
+
+    // Drops every frame.
+    void clear();
+
+    bool empty() const { return counters.frames == 0; }
+    std::size_t size() const { return counters.frames; }
+    std::size_t queueCount() const { return flows.size(); }
+
+    // Frames waiting in one flow queue.
+    std::size_t queueLength(std::uint32_t queue) const { return flows[queue].frames; }
+
+    const FlowQueueConfig& getConfig() const { return config; }
+    const FlowCounters& getCounters() const { return counters; }
+
+    // Writes the frames, in queue order, and the scheduling state to a checkpoint, and reads
+    // them back into a flow queue made from the same config.
+    void saveState(CheckpointWriter& writer) const;
+    void restoreState(CheckpointReader& reader);
+
+private:
+    static constexpr std::uint32_t NONE = ~static_cast<std::uint32_t>(0);
+
+    // Which round robin list a flow queue is linked into.
+    enum class List : std::uint8_t { None, New, Old };
+
+    struct Entry {
+        RawPacket packet;
+        SimTime readyTime = 0;
+        std::uint32_t next = NONE;      // Next frame of the same queue, or of the free list.
+    };
+    struct Flow {
+        std::uint32_t head = NONE;
+        std::uint32_t tail = NONE;
+        std::uint32_t frames = 0;
+        std::uint32_t nextActive = NONE; // Next queue of the same round robin list.
+        std::uint64_t bytes = 0;
+        std::int64_t deficit = 0;
+        List list = List::None;
+        CodelState codel;
+    };
+    struct ActiveList {
+        std::uint32_t head = NONE;
+        std::uint32_t tail = NONE;
+    };
+
+    FlowQueueConfig config;
+    FlowCounters counters;
+    std::uint64_t hashSeed;
+    std::uint32_t mask;
+
+    std::vector<Entry> entries;
+    std::uint32_t freeEntries = NONE;
+    std::vector<Flow> flows;
+    ActiveList newFlows;
+    ActiveList oldFlows;
+    std::uint64_t busyClasses = 0;      // StrictPriority: one bit per class holding frames.
+
+    std::uint32_t allocateEntry();
+    void pushFrame(std::uint32_t queue, RawPacket& packet, SimTime readyTime);
+    // Unlinks the front frame of a queue and returns its entry, which the caller frees.
+    std::uint32_t popFrame(std::uint32_t queue);
+    void freeEntry(std::uint32_t index);
+    void dropFront(std::uint32_t queue);
+
+    void append(ActiveList& list, std::uint32_t queue);
+    std::uint32_t popFront(ActiveList& list);
+
+    std::uint32_t priorityOf(PacketView frame) const;
+    bool dequeueRoundRobin(RawPacket& out, SimTime& readyTime, SimTime now, std::size_t& dropped);
+    bool dequeuePriority(RawPacket& out, SimTime& readyTime);
+};
+
+
+#endif  // End FLOW_QUEUE_H
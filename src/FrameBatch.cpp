@@ -0,0 +1,128 @@
+#include "FrameBatch.h"
+#include "EthernetFrame.h"
+
+namespace {
+
+// Reads a 48-bit address stored in transmission order
+std::uint64_t readAddress(const char* bytes) {
+    std::uint64_t value = 0;
+    for (std::size_t index = 0; index < EthernetFrame::ADDRESS_SIZE; ++index) {
+        value = (value << 8) | static_cast<std::uint8_t>(bytes[index]);
+    }
+    return value;
+}
+
+// The finalizer of MurmurHash3: every input bit affects every output bit
+std::uint64_t mix(std::uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+} // namespace
+
+FrameBatch::FrameBatch(std::size_t capacity) {
+    packets.reserve(capacity);
+    lengthColumn.reserve(capacity);
+    timestampColumn.reserve(capacity);
+    sourceColumn.reserve(capacity);
+    destinationColumn.reserve(capacity);
+    flowHashColumn.reserve(capacity);
+    dropColumn.reserve(capacity);
+}
+
+// The packets give their buffers back to the pool; the columns keep their memory
+void FrameBatch::clear() {
+    packets.clear();
+    lengthColumn.clear();
+    timestampColumn.clear();
+    sourceColumn.clear();
+    destinationColumn.clear();
+    flowHashColumn.clear();
+    dropColumn.clear();
+}
+
+void FrameBatch::push(RawPacket&& packet, SimTime timestamp) {
+    lengthColumn.push_back(static_cast<std::uint32_t>(packet.data.size()));
+    timestampColumn.push_back(timestamp);
+    sourceColumn.push_back(0);
+    destinationColumn.push_back(0);
+    flowHashColumn.push_back(0);
+    dropColumn.push_back(0);
+    packets.push_back(std::move(packet));
+}
+
+void FrameBatch::resize(std::size_t count) {
+    packets.resize(count);
+    lengthColumn.resize(count);
+    timestampColumn.resize(count);
+    sourceColumn.resize(count);
+    destinationColumn.resize(count);
+    flowHashColumn.resize(count);
+    dropColumn.resize(count);
+}
+
+// The lengths are checked from their column first, so short frames are never read
+void FrameBatch::parseAddresses() {
+    for (std::size_t index = 0; index < packets.size(); ++index) {
+        if (lengthColumn[index] < EthernetFrame::HEADER_SIZE) {
+            dropColumn[index] = 1;
+            continue;
+        }
+        const char* header = packets[index].view().data();
+        destinationColumn[index] = readAddress(header);
+        sourceColumn[index] = readAddress(header + EthernetFrame::ADDRESS_SIZE);
+    }
+}
+
+// Ordering the pair makes the hash the same in both directions
+void FrameBatch::computeFlowHashes() {
+    const std::size_t count = packets.size();
+    for (std::size_t index = 0; index < count; ++index) {
+        const std::uint64_t low = sourceColumn[index] < destinationColumn[index] ? sourceColumn[index] : destinationColumn[index];
+        const std::uint64_t high = sourceColumn[index] ^ destinationColumn[index] ^ low;
+        flowHashColumn[index] = static_cast<std::uint32_t>(mix(low * 0x9E3779B97F4A7C15ull ^ high));
+    }
+}
+
+std::uint64_t FrameBatch::totalBytes() const {
+    std::uint64_t total = 0;
+    for (std::uint32_t length : lengthColumn) {
+        total += length;
+    }
+    return total;
+}
+
+std::size_t FrameBatch::countMarked() const {
+    std::size_t marked = 0;
+    for (std::uint8_t mark : dropColumn) {
+        marked += mark != 0;
+    }
+    return marked;
+}
+
+// One pass that moves every kept frame down to the next free index
+std::size_t FrameBatch::compact() {
+    std::size_t kept = 0;
+    for (std::size_t index = 0; index < packets.size(); ++index) {
+        if (dropColumn[index] != 0) {
+            continue;
+        }
+        if (kept != index) {
+            packets[kept] = std::move(packets[index]);
+            lengthColumn[kept] = lengthColumn[index];
+            timestampColumn[kept] = timestampColumn[index];
+            sourceColumn[kept] = sourceColumn[index];
+            destinationColumn[kept] = destinationColumn[index];
+            flowHashColumn[kept] = flowHashColumn[index];
+            dropColumn[kept] = 0;
+        }
+        ++kept;
+    }
+    const std::size_t removed = packets.size() - kept;
+    resize(kept);
+    return removed;
+}
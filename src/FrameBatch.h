@@ -0,0 +1,92 @@
+#ifndef FRAME_BATCH_H    // This will ensure no repeat definition of this header file.
+#define FRAME_BATCH_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "LinkImpairment.h"
+#include "RawPacket.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+FrameBatch is a burst of frames with their metadata stored as columns: one array per field
+(length, timestamp, addresses, flow hash, drop mark), indexed like the packets. Code that
+decides something for every frame of a burst (classification, stats, impairment) then runs
+one loop over one or two contiguous arrays, which the compiler can vectorize, instead of
+hopping from packet object to packet object. The payload bytes are only touched by the steps
+that really read them, such as parseAddresses().
+
+A batch is meant to be reused: clear() keeps the memory of every column, so a batch that has
+reached its working size allocates nothing more. The frames, and every column, stay in the
+order they were added.
+*/
+class FrameBatch{
+public:
+    // The burst size that amortizes well on the media (see NetworkMedium::sendBatch()).
+    static constexpr std::size_t DEFAULT_CAPACITY = 64;
+
+    explicit FrameBatch(std::size_t capacity = DEFAULT_CAPACITY);
+
+    std::size_t size() const { return packets.size(); }
+    bool empty() const { return packets.empty(); }
+
+    // Removes every frame, keeping the memory.
+    void clear();
+
+    // Appends a frame. Its length is filled in; the other columns start at zero.
+    void push(RawPacket&& packet, SimTime timestamp = 0);
+
+    RawPacket& packet(std::size_t index) { return packets[index]; }
+    const RawPacket& packet(std::size_t index) const { return packets[index]; }
+    std::span<RawPacket> frames() { return packets; }
+
+    // The columns; each has size() entries.
+    std::uint32_t* lengths() { return lengthColumn.data(); }
+    const std::uint32_t* lengths() const { return lengthColumn.data(); }
+    SimTime* timestamps() { return timestampColumn.data(); }                 // Set by push(), or the ready time on receiving.
+    std::uint64_t* sources() { return sourceColumn.data(); }                 // 48-bit addresses, see parseAddresses().
+    std::uint64_t* destinations() { return destinationColumn.data(); }
+    std::uint32_t* flowHashes() { return flowHashColumn.data(); }            // See computeFlowHashes().
+    std::uint8_t* dropMarks() { return dropColumn.data(); }                  // Nonzero for frames to be removed by compact().
+    const std::uint8_t* dropMarks() const { return dropColumn.data(); }
+
+    // Verdict columns of the impairment stage, filled by NetworkMedium::sendBatch().
+    ImpairmentVerdicts verdicts;
+
+    // Reads the destination and source address of every frame from its Ethernet header, the
+    // only payload bytes it touches. Frames too short for a header are marked to be dropped.
+    void parseAddresses();
+
+    // Hashes the address columns into the flow hash column, without touching the payload.
+    // Frames between the same pair of addresses get the same hash, whatever the direction.
+    void computeFlowHashes();
+
+    // Sum of the length column.
+    std::uint64_t totalBytes() const;
+
+    // Number of frames marked to be dropped.
+    std::size_t countMarked() const;
+
+    // Removes the frames marked to be dropped, keeping the others (and their columns) in
+    // order; returns how many were removed.
+    std::size_t compact();
+
+private:
+    std::vector<RawPacket> packets;
+    std::vector<std::uint32_t> lengthColumn;
+    std::vector<SimTime> timestampColumn;
+    std::vector<std::uint64_t> sourceColumn;
+    std::vector<std::uint64_t> destinationColumn;
+    std::vector<std::uint32_t> flowHashColumn;
+    std::vector<std::uint8_t> dropColumn;
+
+    friend class NetworkMedium;
+
+    // Grows every column to 'count' frames, for a medium that fills them in place.
+    void resize(std::size_t count);
+};
+
+
+#endif  // End FRAME_BATCH_H
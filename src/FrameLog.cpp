@@ -0,0 +1,134 @@
+#include "FrameLog.h"
+#include "Checkpoint.h"
+
+// Adds a receiver whose cursor starts after the newest frame
+ReceiverId FrameLog::attach() {
+    ReceiverId receiver;
+    if (!freeIds.empty()) {
+        receiver = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        receiver = cursors.size();
+        cursors.emplace_back();
+    }
+    cursors[receiver].nextSequence = firstSequence + entries.size();
+    cursors[receiver].attached = true;
+    ++attachedCount;
+    return receiver;
+}
+
+// Removes a receiver and gives up its claim on the frames it has not read
+void FrameLog::detach(ReceiverId receiver) {
+    if (receiver >= cursors.size() || !cursors[receiver].attached) {
+        return;
+    }
+    Cursor& cursor = cursors[receiver];
+    for (std::size_t index = unreadFrom(cursor) - firstSequence; index < entries.size(); ++index) {
+        if (entries[index].origin != receiver) {
+            --entries[index].remaining;
+        }
+    }
+    cursor.attached = false;
+    --attachedCount;
+    freeIds.push_back(receiver);
+    trimFront();
+}
+
+// Stores the frame once for every receiver that should hear it
+bool FrameLog::append(RawPacket&& packet, ReceiverId origin) {
+    std::size_t readers = attachedCount;
+    if (origin < cursors.size() && cursors[origin].attached) {
+        --readers;
+    }
+    if (readers == 0) {
+        return false;
+    }
+    // The packet object itself is allocated from the PacketBufferPool, like its bytes
+    SharedPacket shared = std::allocate_shared<const RawPacket>(PoolAllocator<RawPacket>(), std::move(packet));
+    entries.push_back(Entry{std::move(shared), origin, readers});
+    return true;
+}
+
+// Hands out the receiver's next frame, skipping frames the receiver sent itself
+bool FrameLog::next(ReceiverId receiver, SharedPacket& out) {
+    if (receiver >= cursors.size() || !cursors[receiver].attached) {
+        return false;
+    }
+    Cursor& cursor = cursors[receiver];
+    cursor.nextSequence = unreadFrom(cursor);
+    while (cursor.nextSequence < firstSequence + entries.size()) {
+        Entry& entry = entries[cursor.nextSequence - firstSequence];
+        ++cursor.nextSequence;
+        if (entry.origin == receiver) {
+            continue;
+        }
+        out = entry.packet;
+        release(entry);
+        return true;
+    }
+    return false;
+}
+
+bool FrameLog::hasUnread(ReceiverId receiver) const {
+    if (receiver >= cursors.size() || !cursors[receiver].attached) {
+        return false;
+    }
+    const Cursor& cursor = cursors[receiver];
+    for (std::uint64_t sequence = unreadFrom(cursor); sequence < firstSequence + entries.size(); ++sequence) {
+        if (entries[sequence - firstSequence].origin != receiver) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FrameLog::release(Entry& entry) {
+    if (--entry.remaining == 0) {
+        entry.packet.reset();
+        trimFront();
+    }
+}
+
+// Removes the oldest frames once every receiver has read them
+void FrameLog::trimFront() {
+    while (!entries.empty() && entries.front().remaining == 0) {
+        entries.pop_front();
+        ++firstSequence;
+    }
+}
+
+// A frame every receiver has read, but that sits behind an unread one, is written without bytes
+void FrameLog::saveState(CheckpointWriter& writer) const {
+    writer.put(firstSequence);
+    writer.put<std::uint64_t>(entries.size());
+    for (const Entry& entry : entries) {
+        writer.put<std::uint64_t>(entry.origin);
+        writer.put<std::uint64_t>(entry.remaining);
+        writer.put(entry.packet != nullptr);
+        if (entry.packet != nullptr) {
+            writer.putBytes(entry.packet->view());
+        }
+    }
+    writer.putArray(cursors.data(), cursors.size());
+    writer.putArray(freeIds.data(), freeIds.size());
+}
+
+void FrameLog::restoreState(CheckpointReader& reader) {
+    reader.get(firstSequence);
+    const std::uint64_t entryCount = reader.get<std::uint64_t>();
+    entries.clear();
+    for (std::uint64_t index = 0; index < entryCount; ++index) {
+        Entry entry{nullptr, static_cast<ReceiverId>(reader.get<std::uint64_t>()), static_cast<std::size_t>(reader.get<std::uint64_t>())};
+        if (reader.get<bool>()) {
+            const PacketView bytes = reader.getBytes();
+            entry.packet = std::allocate_shared<const RawPacket>(PoolAllocator<RawPacket>(), bytes.data(), bytes.size());
+        }
+        entries.push_back(std::move(entry));
+    }
+    reader.getArray(cursors);
+    reader.getArray(freeIds);
+    attachedCount = 0;
+    for (const Cursor& cursor : cursors) {
+        attachedCount += cursor.attached;
+    }
+}
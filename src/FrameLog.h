@@ -0,0 +1,90 @@
+#ifndef FRAME_LOG_H    // This will ensure no repeat definition of this header file.
+#define FRAME_LOG_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "RawPacket.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Identifies one receiver attached to a broadcast medium.
+using ReceiverId = std::size_t;
+
+// Used where no receiver is meant, e.g. for frames that were not sent by an attached receiver.
+constexpr ReceiverId NO_RECEIVER = static_cast<ReceiverId>(-1);
+
+/*
+FrameLog gives a broadcast medium its bus semantics: every frame sent is seen by every
+attached receiver, not just by the first one that asks.
+
+Each frame is stored once, as a reference-counted SharedPacket, and every receiver keeps its
+own read cursor into the log. A frame also remembers how many receivers still have to read
+it; when that count reaches zero for the oldest frames (the slowest cursor has passed them),
+they are removed from the log. A receiver that still holds a SharedPacket keeps only that one
+frame alive.
+*/
+class FrameLog{
+public:
+    // Adds a receiver. It will see every frame sent from now on.
+    ReceiverId attach();
+
+    // Removes a receiver; frames only it still had to read are released.
+    void detach(ReceiverId receiver);
+
+    // Number of receivers currently attached.
+    std::size_t receiverCount() const { return attachedCount; }
+
+    // Adds a frame for all attached receivers except 'origin' (the sender does not hear
+    // itself). A frame nobody would read is dropped right away; returns false in that case.
+    bool append(RawPacket&& packet, ReceiverId origin = NO_RECEIVER);
+
+    // Moves the receiver's cursor to its next frame and hands it out. Returns false if the
+    // receiver has read everything, or is not attached (NO_RECEIVER included).
+    bool next(ReceiverId receiver, SharedPacket& out);
+
+    // True if 'receiver' is attached and has frames it has not read yet.
+    bool hasUnread(ReceiverId receiver) const;
+
+    // Number of frames still held by the log.
+    std::size_t size() const { return entries.size(); }
+
+    // Writes the unread frames and every receiver's cursor to a checkpoint, and reads them back,
+    // replacing the log's contents. The receivers keep their ids, so a restored bus goes on
+    // with the receivers that were attached to it when it was saved.
+    void saveState(CheckpointWriter& writer) const;
+    void restoreState(CheckpointReader& reader);
+
+private:
+    struct Entry {
+        SharedPacket packet;
+        ReceiverId origin;          // Receiver that sent the frame, it skips it.
+        std::size_t remaining;      // Receivers that have not read the frame yet.
+    };
+    struct Cursor {
+        std::uint64_t nextSequence = 0;     // Sequence number of the next frame to read.
+        bool attached = false;
+    };
+
+    std::deque<Entry> entries;
+    std::uint64_t firstSequence = 0;        // Sequence number of entries.front().
+    std::vector<Cursor> cursors;            // Indexed by ReceiverId.
+    std::vector<ReceiverId> freeIds;        // Ids of detached receivers, reused by attach().
+    std::size_t attachedCount = 0;
+
+    // Where the receiver's unread frames start. A cursor may lag behind the front of the log:
+    // frames a receiver sent itself do not wait for it, so they can be trimmed before it passes them.
+    std::uint64_t unreadFrom(const Cursor& cursor) const {
+        return cursor.nextSequence > firstSequence ? cursor.nextSequence : firstSequence;
+    }
+
+    // Marks the entry as read by one more receiver and drops fully read frames from the front.
+    void release(Entry& entry);
+    void trimFront();
+};
+
+
+#endif  // End FRAME_LOG_H
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "IoUring.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int ioUringSetup(unsigned entries, io_uring_params& params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned waitFor, unsigned flags, const void* argument, std::size_t argumentSize) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, waitFor, flags, argument, argumentSize));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void* argument, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, argument, count));
+}
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+std::uint32_t* field(void* mapping, std::uint32_t offset) {
+    return reinterpret_cast<std::uint32_t*>(static_cast<char*>(mapping) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+    fd = ioUringSetup(entries, params);
+    if (fd < 0) {
+        throw systemError("Cannot set up an io_uring");
+    }
+    if ((params.features & IORING_FEAT_EXT_ARG) == 0) {
+        ::close(fd);
+        throw std::runtime_error("The kernel's io_uring cannot wait with a timeout (Linux 5.11 or later is needed)");
+    }
+
+    // Map the rings; newer kernels put both rings into one mapping
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+    const std::size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMapping && cqSize > sqRingSize) {
+        sqRingSize = cqSize;
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        const std::runtime_error error = systemError("Cannot map the io_uring submission ring");
+        unmap();
+        throw error;
+    }
+    cqRing = sqRing;
+    if (!singleMapping) {
+        cqRingSize = cqSize;
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            const std::runtime_error error = systemError("Cannot map the io_uring completion ring");
+            unmap();
+            throw error;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* entriesMapping = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (entriesMapping == MAP_FAILED) {
+        const std::runtime_error error = systemError("Cannot map the io_uring submission entries");
+        unmap();
+        throw error;
+    }
+    sqes = static_cast<io_uring_sqe*>(entriesMapping);
+
+    sqHead = field(sqRing, params.sq_off.head);
+    sqTail = field(sqRing, params.sq_off.tail);
+    sqMask = *field(sqRing, params.sq_off.ring_mask);
+    sqEntries = *field(sqRing, params.sq_off.ring_entries);
+    sqeTail = *sqTail;
+    cqHead = field(cqRing, params.cq_off.head);
+    cqTail = field(cqRing, params.cq_off.tail);
+    cqMask = *field(cqRing, params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(cqRing) + params.cq_off.cqes);
+
+    // Submission slot i always points at entry i, so entries are used in ring order
+    std::uint32_t* slots = field(sqRing, params.sq_off.array);
+    for (std::uint32_t index = 0; index < sqEntries; ++index) {
+        slots[index] = index;
+    }
+    probe();
+}
+
+IoUring::~IoUring() {
+    unmap();
+}
+
+void IoUring::unmap() {
+    if (sqes != nullptr) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing != nullptr && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != nullptr) {
+        munmap(sqRing, sqRingSize);
+    }
+    sqes = nullptr;
+    sqRing = cqRing = nullptr;
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+// Asks the kernel once which requests it implements; a kernel without the probe supports none of the newer ones
+void IoUring::probe() {
+    constexpr unsigned OPS = 256;
+    alignas(io_uring_probe) char storage[sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op)];
+    std::memset(storage, 0, sizeof(storage));
+    io_uring_probe* result = reinterpret_cast<io_uring_probe*>(storage);
+    if (ioUringRegister(fd, IORING_REGISTER_PROBE, result, OPS) < 0) {
+        return;
+    }
+    for (unsigned index = 0; index < result->ops_len && index < OPS; ++index) {
+        if (result->ops[index].flags & IO_URING_OP_SUPPORTED) {
+            const std::uint8_t opcode = result->ops[index].op;
+            supportedOps[opcode / 64] |= std::uint64_t(1) << (opcode % 64);
+        }
+    }
+}
+
+bool IoUring::supports(std::uint8_t opcode) const {
+    return (supportedOps[opcode / 64] >> (opcode % 64)) & 1;
+}
+
+io_uring_sqe* IoUring::getSqe() {
+    if (sqeSpace() == 0) {
+        return nullptr;
+    }
+    io_uring_sqe* sqe = &sqes[sqeTail & sqMask];
+    ++sqeTail;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+unsigned IoUring::sqeSpace() const {
+    return sqEntries - (sqeTail - std::atomic_ref<std::uint32_t>(*sqHead).load(std::memory_order_acquire));
+}
+
+// Publishes the new tail, then enters the kernel once for submitting and waiting together
+unsigned IoUring::submitAndWait(unsigned waitFor, std::chrono::nanoseconds timeout) {
+    std::atomic_ref<std::uint32_t>(*sqTail).store(sqeTail, std::memory_order_release);
+    const unsigned toSubmit = sqeTail - std::atomic_ref<std::uint32_t>(*sqHead).load(std::memory_order_acquire);
+    if (toSubmit == 0 && waitFor == 0) {
+        return 0;
+    }
+    unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+    __kernel_timespec wait{};
+    io_uring_getevents_arg argument{};
+    const void* argumentPointer = nullptr;
+    std::size_t argumentSize = 0;
+    if (waitFor > 0) {
+        wait.tv_sec = timeout.count() / 1000000000;
+        wait.tv_nsec = timeout.count() % 1000000000;
+        argument.sigmask_sz = _NSIG / 8;
+        argument.ts = reinterpret_cast<std::uint64_t>(&wait);
+        flags |= IORING_ENTER_EXT_ARG;
+        argumentPointer = &argument;
+        argumentSize = sizeof(argument);
+    }
+    const int result = ioUringEnter(fd, toSubmit, waitFor, flags, argumentPointer, argumentSize);
+    if (result < 0) {
+        // A timeout, a signal or a full completion ring is not an error; the caller just looks again
+        if (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+            return 0;
+        }
+        throw systemError("io_uring_enter failed");
+    }
+    return static_cast<unsigned>(result);
+}
+
+IoUringBufferRing::IoUringBufferRing(IoUring& ring, std::uint16_t group, unsigned entries)
+    : ring(ring), group(group), entries(entries) {
+    if (entries == 0 || entries > 32768 || (entries & (entries - 1)) != 0) {
+        throw std::invalid_argument("A provided buffer ring needs a power of two of at most 32768 entries");
+    }
+    size = entries * sizeof(io_uring_buf);
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw systemError("Cannot allocate a provided buffer ring");
+    }
+    buffers = static_cast<io_uring_buf*>(mapping);
+    io_uring_buf_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<std::uint64_t>(buffers);
+    registration.ring_entries = entries;
+    registration.bgid = group;
+    if (ioUringRegister(ring.fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        const std::runtime_error error = systemError("Cannot register a provided buffer ring");
+        munmap(buffers, size);
+        throw error;
+    }
+}
+
+IoUringBufferRing::~IoUringBufferRing() {
+    io_uring_buf_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+    registration.bgid = group;
+    ioUringRegister(ring.fd, IORING_UNREGISTER_PBUF_RING, &registration, 1);
+    munmap(buffers, size);
+}
+
+void IoUringBufferRing::add(void* address, unsigned length, std::uint16_t id) {
+    io_uring_buf& buffer = buffers[tail & (entries - 1)];
+    buffer.addr = reinterpret_cast<std::uint64_t>(address);
+    buffer.len = length;
+    buffer.bid = id;
+    ++tail;
+}
+
+// The kernel reads the tail to find new buffers, so it is written last. io_uring_buf_ring is not
+// used for this: compiled as C++, its flexible array member does not start at offset 0.
+void IoUringBufferRing::publish() {
+    std::atomic_ref<std::uint16_t>(buffers[0].resv).store(tail, std::memory_order_release);
+}
@@ -0,0 +1,126 @@
+#ifndef IO_URING_H    // This will ensure no repeat definition of this header file.
+#define IO_URING_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <linux/io_uring.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Linux 6.7 added multishot reads; older uapi headers do not name the opcode yet.
+constexpr std::uint8_t IORING_OP_READ_MULTISHOT_CODE = 49;
+
+/*
+IoUring is a small wrapper around a Linux io_uring instance, written against the raw system
+calls so the emulator does not need liburing. The submission and completion rings are shared
+with the kernel: requests are queued by filling submission entries in memory, and one
+io_uring_enter() call submits all of them and waits for completions, so a batch of reads or
+writes costs one system call instead of one per frame.
+
+The instance is meant for a single thread; it is not safe to use from several at once.
+*/
+class IoUring{
+public:
+    // Sets up a ring with room for 'entries' submissions (rounded up to a power of two by the
+    // kernel). Throws std::runtime_error if io_uring is missing, older than Linux 5.11 or
+    // forbidden, as it is in many containers.
+    explicit IoUring(unsigned entries);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // True if the kernel implements the given IORING_OP_* request.
+    bool supports(std::uint8_t opcode) const;
+
+    // A cleared submission entry, or nullptr if every entry is already queued.
+    io_uring_sqe* getSqe();
+
+    // Free submission entries.
+    unsigned sqeSpace() const;
+
+    // Submits what was queued with getSqe() and waits until at least 'waitFor' completions are
+    // there or 'timeout' has passed. Returns the number of entries submitted.
+    unsigned submitAndWait(unsigned waitFor, std::chrono::nanoseconds timeout);
+    unsigned submit() { return submitAndWait(0, std::chrono::nanoseconds(0)); }
+
+    // Calls 'handle(cqe)' for every completion that has arrived, oldest first, and returns
+    // how many there were.
+    template <typename Handle>
+    unsigned forEachCompletion(Handle&& handle) {
+        std::uint32_t head = *cqHead;
+        const std::uint32_t tail = std::atomic_ref<std::uint32_t>(*cqTail).load(std::memory_order_acquire);
+        const unsigned count = tail - head;
+        for (; head != tail; ++head) {
+            handle(cqes[head & cqMask]);
+        }
+        std::atomic_ref<std::uint32_t>(*cqHead).store(head, std::memory_order_release);
+        return count;
+    }
+
+    int getFd() const { return fd; }
+
+private:
+    friend class IoUringBufferRing;
+
+    int fd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    std::size_t sqRingSize = 0;
+    std::size_t cqRingSize = 0;             // 0 if both rings share one mapping.
+    io_uring_sqe* sqes = nullptr;
+    std::size_t sqesSize = 0;
+
+    std::uint32_t* sqHead = nullptr;        // Written by the kernel.
+    std::uint32_t* sqTail = nullptr;        // Written by us.
+    std::uint32_t sqMask = 0;
+    std::uint32_t sqEntries = 0;
+    std::uint32_t sqeTail = 0;              // Entries handed out by getSqe(), not yet published.
+    std::uint32_t* cqHead = nullptr;        // Written by us.
+    std::uint32_t* cqTail = nullptr;        // Written by the kernel.
+    std::uint32_t cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    std::uint64_t supportedOps[4] = {0, 0, 0, 0};   // One bit per opcode, from the probe.
+
+    void probe();
+    void unmap();
+};
+
+/*
+IoUringBufferRing is a ring of buffers handed to the kernel in advance (a "provided buffer
+ring"). A read that is submitted with IOSQE_BUFFER_SELECT and the ring's group id takes the
+next buffer when data arrives rather than having one assigned up front, and its completion
+says which buffer it filled. That is what multishot reads need: one request keeps filling
+buffers frame after frame. Buffers are returned with add() and made visible with publish().
+*/
+class IoUringBufferRing{
+public:
+    // Registers a ring of 'entries' buffers (a power of two, at most 32768) as group 'group'.
+    // Throws std::runtime_error if the kernel cannot (provided buffer rings need Linux 5.19).
+    IoUringBufferRing(IoUring& ring, std::uint16_t group, unsigned entries);
+    ~IoUringBufferRing();
+
+    IoUringBufferRing(const IoUringBufferRing&) = delete;
+    IoUringBufferRing& operator=(const IoUringBufferRing&) = delete;
+
+    // Queues a buffer for the kernel; it becomes usable with the next publish().
+    void add(void* address, unsigned length, std::uint16_t id);
+
+    // Hands every buffer queued with add() to the kernel.
+    void publish();
+
+    std::uint16_t getGroup() const { return group; }
+
+private:
+    IoUring& ring;
+    const std::uint16_t group;
+    const unsigned entries;
+    io_uring_buf* buffers = nullptr;       // The ring; its tail overlays the 'resv' field of the first entry.
+    std::size_t size = 0;
+    std::uint16_t tail = 0;                 // Includes buffers added but not yet published.
+};
+
+
+#endif  // End IO_URING_H
@@ -0,0 +1,183 @@
+#include "LearningSwitch.h"
+#include "Checkpoint.h"
+#include "EthernetFrame.h"
+#include "Trace.h"
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// The two kinds of events a switch schedules for itself
+constexpr std::uint64_t POLL = 0;
+constexpr std::uint64_t SWEEP = 1;
+
+} // namespace
+
+LearningSwitch::LearningSwitch(std::string name, std::vector<Port> ports, const LearningSwitchConfig& config)
+    : Node(std::move(name)), ports(std::move(ports)), config(config), macTable(config.maxEntries, config.agingTime) {
+    if (config.batchSize == 0 || config.pollInterval == 0) {
+        throw std::invalid_argument("A switch needs a batch size and a poll interval greater than zero");
+    }
+    packets.reserve(config.batchSize);
+    sharedPackets.reserve(config.batchSize);
+    pending.reserve(config.batchSize);
+    outgoing.resize(this->ports.size());
+}
+
+void LearningSwitch::start(EventScheduler& eventScheduler) {
+    scheduler = &eventScheduler;
+    scheduler->scheduleAfter(config.pollInterval, this, POLL);
+    if (config.agingTime != 0) {
+        scheduler->scheduleAfter(config.agingTime / 2, this, SWEEP);
+    }
+}
+
+void LearningSwitch::onEvent(SimTime now, std::uint64_t cookie) {
+    if (cookie == SWEEP) {
+        macTable.removeExpired(now);
+        scheduler->scheduleAfter(config.agingTime / 2, this, SWEEP);
+        return;
+    }
+    poll(now);
+    scheduler->scheduleAfter(config.pollInterval, this, POLL);
+}
+
+void LearningSwitch::saveState(CheckpointWriter& writer) const {
+    macTable.saveState(writer);
+    writer.put(counters);
+}
+
+void LearningSwitch::restoreState(CheckpointReader& reader, EventScheduler& eventScheduler) {
+    scheduler = &eventScheduler;
+    macTable.restoreState(reader);
+    reader.get(counters);
+}
+
+std::size_t LearningSwitch::poll(SimTime now) {
+    NETEMU_TRACE_SCOPE(Switch, "LearningSwitch::poll");
+    std::size_t total = 0;
+    for (PortId port = 0; port < ports.size(); ++port) {
+        total += pollPort(port, now);
+    }
+    sendCollected();
+    return total;
+}
+
+// Pass one parses the batch and prefetches its table slots, pass two learns and forwards
+std::size_t LearningSwitch::pollPort(PortId ingress, SimTime now) {
+    NETEMU_TRACE_SCOPE(Switch, "LearningSwitch::pollPort");
+    const Port& port = ports[ingress];
+    const bool shared = port.segment != NO_SEGMENT;
+    packets.clear();
+    sharedPackets.clear();
+    pending.clear();
+    if (shared) {
+        port.rx->receiveBatch(port.receiver, sharedPackets, config.batchSize);
+        for (const SharedPacket& packet : sharedPackets) {
+            pending.push_back(Pending{packet.get(), 0, 0, false});
+        }
+    } else {
+        port.rx->receiveBatch(packets, config.batchSize);
+        for (const RawPacket& packet : packets) {
+            pending.push_back(Pending{&packet, 0, 0, false});
+        }
+    }
+
+    for (Pending& frame : pending) {
+        const std::optional<EthernetFrame> parsed = EthernetFrame::parse(frame.packet->view());
+        if (!parsed) {
+            ++counters.malformed;
+            continue;
+        }
+        if (config.checkFcs && !parsed->hasValidFcs()) {
+            ++counters.fcsErrors;
+            continue;
+        }
+        frame.destination = parsed->destination().value();
+        frame.source = parsed->source().value();
+        frame.valid = true;
+        macTable.prefetch(frame.source);
+        macTable.prefetch(frame.destination);
+    }
+
+    for (std::size_t index = 0; index < pending.size(); ++index) {
+        if (pending[index].valid) {
+            forward(ingress, pending[index], shared ? nullptr : &packets[index], now);
+        }
+    }
+    counters.received += pending.size();
+    return pending.size();
+}
+
+void LearningSwitch::forward(PortId ingress, const Pending& frame, RawPacket* owned, SimTime now) {
+    // A multicast source address is invalid and never learned
+    if ((frame.source >> 40 & 0x01) == 0) {
+        switch (macTable.learn(frame.source, ingress, now)) {
+        case Learned::Added:
+            ++counters.learned;
+            break;
+        case Learned::Moved:
+            ++counters.moved;
+            break;
+        case Learned::TableFull:
+            ++counters.tableFull;
+            break;
+        case Learned::Refreshed:
+            break;
+        }
+    }
+
+    const bool multicast = (frame.destination >> 40 & 0x01) != 0;
+    const PortId egress = multicast ? NO_PORT : macTable.lookup(frame.destination, now);
+    if (egress == NO_PORT) {
+        flood(ingress, *frame.packet, owned);
+        return;
+    }
+    if (egress == ingress) {
+        ++counters.filtered;
+        return;
+    }
+    ++counters.forwarded;
+    sendOut(egress, owned != nullptr ? std::move(*owned) : RawPacket(*frame.packet));
+}
+
+// Every port but the ingress gets a copy, except the last one, which gets the frame itself if it may be moved
+void LearningSwitch::flood(PortId ingress, const RawPacket& packet, RawPacket* owned) {
+    ++counters.flooded;
+    PortId last = NO_PORT;
+    for (PortId port = 0; port < ports.size(); ++port) {
+        if (port == ingress) {
+            continue;
+        }
+        if (last != NO_PORT) {
+            sendOut(last, RawPacket(packet));
+        }
+        last = port;
+    }
+    if (last != NO_PORT) {
+        sendOut(last, owned != nullptr ? std::move(*owned) : RawPacket(packet));
+    }
+}
+
+// A segment gets the frame at once; a point-to-point port collects it for its burst
+void LearningSwitch::sendOut(PortId port, RawPacket&& packet) {
+    const Port& out = ports[port];
+    if (out.segment == NO_SEGMENT) {
+        outgoing[port].push_back(std::move(packet));
+    } else if (!out.tx->sendPacketFrom(out.receiver, std::move(packet))) {
+        ++counters.txDrops;
+    }
+}
+
+// Frames a medium does not accept are dropped, as a full output queue would
+void LearningSwitch::sendCollected() {
+    NETEMU_TRACE_SCOPE(Switch, "LearningSwitch::sendCollected");
+    for (PortId port = 0; port < ports.size(); ++port) {
+        std::vector<RawPacket>& frames = outgoing[port];
+        if (frames.empty()) {
+            continue;
+        }
+        counters.txDrops += frames.size() - ports[port].tx->sendBatch(frames);
+        frames.clear();
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef LEARNING_SWITCH_H    // This will ensure no repeat definition of this header file.
+#define LEARNING_SWITCH_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "MacTable.h"
+#include "Node.h"
+#include "RawPacket.h"
+#include "Topology.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct LearningSwitchConfig {
+    std::size_t maxEntries = 8192;      // Size of the MAC table; up to millions for a large fabric.
+    SimTime agingTime = MacTable::DEFAULT_AGING_TIME;
+    std::size_t batchSize = 32;         // Frames taken from a port per poll.
+    SimTime pollInterval = MICROSECOND; // How often the switch polls its ports once start()ed.
+    bool checkFcs = true;               // Drop frames with a bad FCS, like a store-and-forward switch.
+};
+
+// What the switch has done so far.
+struct SwitchCounters {
+    std::uint64_t received = 0;
+    std::uint64_t forwarded = 0;        // Sent out of the one port the destination is known on.
+    std::uint64_t flooded = 0;          // Sent out of every other port (broadcast, multicast or unknown).
+    std::uint64_t filtered = 0;         // Dropped because the destination is on the port it came from.
+    std::uint64_t malformed = 0;        // Too short to be an Ethernet frame.
+    std::uint64_t fcsErrors = 0;
+    std::uint64_t txDrops = 0;          // Copies an outgoing medium did not accept.
+    std::uint64_t learned = 0;          // New addresses in the MAC table,
+    std::uint64_t moved = 0;            // addresses that showed up on another port,
+    std::uint64_t tableFull = 0;        // and addresses that did not fit.
+};
+
+/*
+LearningSwitch is a transparent Ethernet bridge (IEEE 802.1D without spanning tree). It learns
+on which port every source address lives, sends a frame only out of the port its destination
+was learned on, and floods frames for broadcast, multicast and unknown destinations out of
+every other port. Its ports are the node's Topology ports, so it can sit between point-to-point
+links and LAN segments alike.
+
+Frames are handled a batch per port at a time: the switch drains up to 'batchSize' frames with
+the medium's receiveBatch(), prefetches the MAC table slots of all their addresses, and only
+then learns and looks them up, so the cache misses of a large table overlap instead of being
+paid one after the other. A frame that goes out of a single port is moved on, not copied.
+Frames leaving through a point-to-point port are collected per port and sent as one burst
+with sendBatch() once every port has been polled.
+*/
+class LearningSwitch : public Node{
+public:
+    LearningSwitch(std::string name, std::vector<Port> ports, const LearningSwitchConfig& config = LearningSwitchConfig());
+
+    // Polls the ports every 'pollInterval' of virtual time, and removes aged MAC table
+    // entries every half aging time.
+    void start(EventScheduler& scheduler) override;
+    void onEvent(SimTime now, std::uint64_t cookie) override;
+
+    // The MAC table and the counters.
+    void saveState(CheckpointWriter& writer) const override;
+    void restoreState(CheckpointReader& reader, EventScheduler& scheduler) override;
+
+    // Takes up to 'batchSize' frames from every port and forwards them, as of time 'now'.
+    // Returns the number of frames taken. Can also be called directly instead of start()ing
+    // the switch, for example from a thread that owns it.
+    std::size_t poll(SimTime now);
+
+    const MacTable& getMacTable() const { return macTable; }
+    MacTable& getMacTable() { return macTable; }
+    const SwitchCounters& getCounters() const { return counters; }
+    const std::vector<Port>& getPorts() const { return ports; }
+
+private:
+    // What pass one of a batch found out about a frame.
+    struct Pending {
+        const RawPacket* packet;
+        std::uint64_t destination;
+        std::uint64_t source;
+        bool valid;
+    };
+
+    std::vector<Port> ports;
+    LearningSwitchConfig config;
+    MacTable macTable;
+    SwitchCounters counters;
+    EventScheduler* scheduler = nullptr;
+
+    // Reused for every batch so that forwarding does not allocate.
+    std::vector<RawPacket> packets;
+    std::vector<SharedPacket> sharedPackets;
+    std::vector<Pending> pending;
+    std::vector<std::vector<RawPacket>> outgoing;   // Frames for each point-to-point port, sent once per poll().
+
+    std::size_t pollPort(PortId ingress, SimTime now);
+    // 'owned' is the frame itself when it may be moved on, nullptr when it is shared and has to be copied.
+    void forward(PortId ingress, const Pending& frame, RawPacket* owned, SimTime now);
+    void flood(PortId ingress, const RawPacket& packet, RawPacket* owned);
+    void sendOut(PortId port, RawPacket&& packet);
+    void sendCollected();
+};
+
+
+#endif  // End LEARNING_SWITCH_H
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include "LinkImpairment.h"
+#include "Checkpoint.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+
+LinkImpairment::LinkImpairment(const ImpairmentConfig& config)
+    : config(config),
+      random(config.seed),
+      lossThreshold(RandomBatch::probabilityThreshold(config.lossProbability)),
+      goodToBadThreshold(RandomBatch::probabilityThreshold(config.goodToBad)),
+      badToGoodThreshold(RandomBatch::probabilityThreshold(config.badToGood)),
+      lossInGoodThreshold(RandomBatch::probabilityThreshold(config.lossInGood)),
+      lossInBadThreshold(RandomBatch::probabilityThreshold(config.lossInBad)),
+      duplicateThreshold(RandomBatch::probabilityThreshold(config.duplicateProbability)),
+      corruptThreshold(RandomBatch::probabilityThreshold(config.corruptProbability)),
+      reorderThreshold(RandomBatch::probabilityThreshold(config.reorderProbability)),
+      tokens(static_cast<double>(config.burstBytes)) {}
+
+ImpairmentVerdict LinkImpairment::judge(std::size_t frameBytes, SimTime now) {
+    NETEMU_TRACE_SCOPE(Impairment, "LinkImpairment::judge");
+    ImpairmentVerdict verdict;
+    ++counters.frames;
+
+    if (isLost()) {
+        verdict.drop = true;
+        ++counters.dropped;
+        return verdict;
+    }
+    if (random.chance(duplicateThreshold)) {
+        verdict.duplicate = true;
+        ++counters.duplicated;
+    }
+    if (frameBytes > 0 && random.chance(corruptThreshold)) {
+        verdict.corruptBit = static_cast<std::int64_t>(random.nextU64() % (frameBytes * 8));
+        ++counters.corrupted;
+    }
+
+    // The bandwidth cap delays every frame, including the ones sent ahead by reordering
+    verdict.delay = shapingDelay(frameBytes, now);
+
+    if (random.chance(reorderThreshold)) {
+        verdict.keepOrder = false;
+        ++counters.reordered;
+    } else {
+        verdict.delay += latencyDelay();
+    }
+    return verdict;
+}
+
+void ImpairmentVerdicts::resize(std::size_t count) {
+    drop.resize(count);
+    duplicate.resize(count);
+    keepOrder.resize(count);
+    corruptBit.resize(count);
+    delay.resize(count);
+}
+
+void ImpairmentVerdicts::set(std::size_t index, const ImpairmentVerdict& verdict) {
+    drop[index] = verdict.drop;
+    duplicate[index] = verdict.duplicate;
+    keepOrder[index] = verdict.keepOrder;
+    corruptBit[index] = verdict.corruptBit;
+    delay[index] = verdict.delay;
+}
+
+// Every frame takes one random value per enabled effect, in frame order, so the verdicts and the
+// state after the first k frames do not depend on how many frames follow. The values are then
+// compared a column at a time; a dropped frame takes none of the other effects.
+void LinkImpairment::judgeBatch(const std::uint32_t* frameBytes, std::size_t count, SimTime now, ImpairmentVerdicts& out) {
+    NETEMU_TRACE_SCOPE_FRAMES(Impairment, "LinkImpairment::judgeBatch", count);
+    out.resize(count);
+    const bool independent = config.lossModel != LossModel::GilbertElliott && config.jitter == 0 &&
+                             config.rateBitsPerSecond == 0 && reorderThreshold == 0;
+    if (!independent) {
+        for (std::size_t index = 0; index < count; ++index) {
+            out.set(index, judge(frameBytes[index], now));
+        }
+        return;
+    }
+
+    const std::uint64_t dropThreshold = config.lossModel == LossModel::Bernoulli ? lossThreshold : 0;
+    const std::size_t stride = (dropThreshold != 0) + (duplicateThreshold != 0) + (corruptThreshold != 0);
+    draws.resize(stride * count);
+    random.fill(draws.data(), draws.size());
+    std::size_t column = 0;
+    auto chances = [&](std::uint64_t threshold, std::uint8_t* marks) -> const std::uint64_t* {
+        if (threshold == 0) {
+            std::fill(marks, marks + count, 0);
+            return nullptr;
+        }
+        const std::uint64_t* values = draws.data() + column++;
+        for (std::size_t index = 0; index < count; ++index) {
+            marks[index] = values[index * stride] < threshold;
+        }
+        return values;
+    };
+    chances(dropThreshold, out.drop.data());
+    chances(duplicateThreshold, out.duplicate.data());
+    corruptMarks.resize(count);
+    const std::uint64_t* corruptValues = chances(corruptThreshold, corruptMarks.data());
+    std::uint64_t dropped = 0;
+    std::uint64_t duplicated = 0;
+    for (std::size_t index = 0; index < count; ++index) {
+        const std::uint8_t kept = out.drop[index] ^ 1;
+        out.duplicate[index] &= kept;
+        corruptMarks[index] &= kept;
+        out.keepOrder[index] = 1;
+        out.delay[index] = config.latency;
+        out.corruptBit[index] = -1;
+        dropped += out.drop[index];
+        duplicated += out.duplicate[index];
+    }
+    // Few frames are corrupted, so only they pay for the bit position, which is mixed out of
+    // the value that picked the frame
+    if (corruptValues != nullptr) {
+        for (std::size_t index = 0; index < count; ++index) {
+            if (corruptMarks[index] != 0 && frameBytes[index] > 0) {
+                std::uint64_t state = corruptValues[index * stride];
+                out.corruptBit[index] = static_cast<std::int64_t>(splitMix64(state) % (std::uint64_t(frameBytes[index]) * 8));
+                ++counters.corrupted;
+            }
+        }
+    }
+    counters.frames += count;
+    counters.dropped += dropped;
+    counters.duplicated += duplicated;
+}
+
+// Bernoulli or Gilbert-Elliott loss: one or two random numbers per frame
+bool LinkImpairment::isLost() {
+    switch (config.lossModel) {
+    case LossModel::Bernoulli:
+        return random.chance(lossThreshold);
+    case LossModel::GilbertElliott:
+        if (inBadState) {
+            inBadState = !random.chance(badToGoodThreshold);
+        } else {
+            inBadState = random.chance(goodToBadThreshold);
+        }
+        return random.chance(inBadState ? lossInBadThreshold : lossInGoodThreshold);
+    case LossModel::None:
+        break;
+    }
+    return false;
+}
+
+// Fixed latency plus its random variation; the result never goes below zero
+SimTime LinkImpairment::latencyDelay() {
+    if (config.jitter == 0) {
+        return config.latency;
+    }
+    double offset = 0.0;
+    switch (config.jitterDistribution) {
+    case JitterDistribution::Uniform:
+        offset = (random.nextUnit() * 2.0 - 1.0) * static_cast<double>(config.jitter);
+        break;
+    case JitterDistribution::Normal:
+        if (haveSpareNormal) {
+            offset = spareNormal;
+            haveSpareNormal = false;
+        } else {
+            // Box-Muller transform: two uniform numbers give two independent normal ones
+            const double radius = std::sqrt(-2.0 * std::log(1.0 - random.nextUnit()));
+            const double angle = 6.283185307179586 * random.nextUnit();
+            offset = radius * std::cos(angle);
+            spareNormal = radius * std::sin(angle);
+            haveSpareNormal = true;
+        }
+        offset *= static_cast<double>(config.jitter);
+        break;
+    case JitterDistribution::None:
+        break;
+    }
+    const double total = static_cast<double>(config.latency) + offset;
+    return total <= 0.0 ? 0 : static_cast<SimTime>(std::llround(total));
+}
+
+// Token bucket: refill for the time passed, take the frame's bytes, wait out any debt
+SimTime LinkImpairment::shapingDelay(std::size_t frameBytes, SimTime now) {
+    if (config.rateBitsPerSecond == 0) {
+        return 0;
+    }
+    const double bytesPerNanosecond = static_cast<double>(config.rateBitsPerSecond) / 8.0 / static_cast<double>(SECOND);
+    if (now > tokensUpdatedAt) {
+        tokens += static_cast<double>(now - tokensUpdatedAt) * bytesPerNanosecond;
+        if (tokens > static_cast<double>(config.burstBytes)) {
+            tokens = static_cast<double>(config.burstBytes);
+        }
+        tokensUpdatedAt = now;
+    }
+    tokens -= static_cast<double>(frameBytes);
+    if (tokens >= 0.0) {
+        return 0;
+    }
+    ++counters.shaped;
+    return static_cast<SimTime>(std::ceil(-tokens / bytesPerNanosecond));
+}
+
+void LinkImpairment::saveState(CheckpointWriter& writer) const {
+    writer.put(counters);
+    writer.put(random);
+    writer.put(inBadState);
+    writer.put(tokens);
+    writer.put(tokensUpdatedAt);
+    writer.put(haveSpareNormal);
+    writer.put(spareNormal);
+}
+
+void LinkImpairment::restoreState(CheckpointReader& reader) {
+    reader.get(counters);
+    reader.get(random);
+    reader.get(inBadState);
+    reader.get(tokens);
+    reader.get(tokensUpdatedAt);
+    reader.get(haveSpareNormal);
+    reader.get(spareNormal);
+}
@@ -0,0 +1,165 @@
+#ifndef LINK_IMPAIRMENT_H    // This will ensure no repeat definition of this header file.
+#define LINK_IMPAIRMENT_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "Random.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Shape of the random variation added to the fixed latency.
+enum class JitterDistribution {
+    None,
+    Uniform,    // Evenly spread over [-jitter, +jitter].
+    Normal,     // Normal distribution with a standard deviation of 'jitter'.
+};
+
+// How frames are chosen to be lost.
+enum class LossModel {
+    None,
+    Bernoulli,      // Every frame is lost independently with 'lossProbability'.
+    GilbertElliott, // Two-state Markov chain producing bursts of loss (see ImpairmentConfig).
+};
+
+/*
+ImpairmentConfig describes how a medium deviates from a perfectly reliable wire.
+All probabilities are in [0, 1]; zero disables the effect. Delays, jitter, reordering and the
+bandwidth cap act in virtual time and need the medium to be attached to an EventScheduler;
+loss, duplication and corruption work with or without one.
+*/
+struct ImpairmentConfig {
+    // Delay added on top of the wire's propagation delay.
+    SimTime latency = 0;
+    SimTime jitter = 0;
+    JitterDistribution jitterDistribution = JitterDistribution::None;
+
+    // Token bucket bandwidth cap; frames beyond the rate wait until enough tokens have
+    // accumulated. 0 means no cap. 'burstBytes' is the bucket size.
+    std::uint64_t rateBitsPerSecond = 0;
+    std::uint64_t burstBytes = 1518;
+
+    LossModel lossModel = LossModel::None;
+    double lossProbability = 0.0;       // Bernoulli loss.
+    double goodToBad = 0.0;             // Gilbert-Elliott: chance per frame of entering the bad state,
+    double badToGood = 0.0;             // chance per frame of returning to the good state,
+    double lossInGood = 0.0;            // loss probability in the good state,
+    double lossInBad = 1.0;             // and in the bad state.
+
+    double duplicateProbability = 0.0;  // Frame is delivered twice.
+    double corruptProbability = 0.0;    // One random bit of the frame is flipped.
+
+    // Frames picked for reordering skip the latency and jitter and may overtake earlier frames.
+    // All other frames keep their sending order even when jitter would swap them.
+    double reorderProbability = 0.0;
+
+    std::uint64_t seed = 1;             // Seed of the random numbers, for repeatable runs.
+};
+
+// What should happen to one frame.
+struct ImpairmentVerdict {
+    bool drop = false;
+    bool duplicate = false;
+    bool keepOrder = true;              // Arrival must not be earlier than the previous frame's.
+    SimTime delay = 0;                  // Extra delay (latency + jitter + shaping).
+    std::int64_t corruptBit = -1;       // Index of the bit to flip, or -1.
+};
+
+// What should happen to each frame of a burst, one column per effect (see judgeBatch()).
+struct ImpairmentVerdicts {
+    std::vector<std::uint8_t> drop;
+    std::vector<std::uint8_t> duplicate;
+    std::vector<std::uint8_t> keepOrder;
+    std::vector<std::int64_t> corruptBit;
+    std::vector<SimTime> delay;
+
+    void resize(std::size_t count);
+    ImpairmentVerdict at(std::size_t index) const {
+        return ImpairmentVerdict{drop[index] != 0, duplicate[index] != 0, keepOrder[index] != 0, delay[index], corruptBit[index]};
+    }
+    void set(std::size_t index, const ImpairmentVerdict& verdict);
+};
+
+// Number of frames each effect has hit so far.
+struct ImpairmentCounters {
+    std::uint64_t frames = 0;
+    std::uint64_t dropped = 0;
+    std::uint64_t duplicated = 0;
+    std::uint64_t corrupted = 0;
+    std::uint64_t reordered = 0;
+    std::uint64_t shaped = 0;           // Frames delayed by the bandwidth cap.
+};
+
+/*
+LinkImpairment applies an ImpairmentConfig to a stream of frames. Deciding a frame's fate
+takes constant time: probabilities are turned into integer thresholds when the config is
+set, random numbers come from a pre-filled RandomBatch, and no memory is allocated.
+*/
+class LinkImpairment{
+public:
+    explicit LinkImpairment(const ImpairmentConfig& config);
+
+    // Decides what happens to a frame of 'frameBytes' bytes sent at 'now'.
+    ImpairmentVerdict judge(std::size_t frameBytes, SimTime now);
+
+    // Decides what happens to a burst of 'count' frames, of the lengths at 'frameBytes', all
+    // sent at 'now'. When the effects do not depend on the frames before (no Gilbert-Elliott
+    // loss, jitter, reordering or bandwidth cap) each effect is decided for the whole burst in
+    // one loop over a column; otherwise the frames are judged one by one. The columnar way draws
+    // its random numbers in another order than judge() would, so a burst does not lose the
+    // same frames as those frames sent one at a time (runs are still repeatable).
+    // Either way the verdicts of the first k frames, and the state judging them leaves behind,
+    // do not depend on the frames after them: a burst that was cut short after k frames can be
+    // judged again as a burst of k frames, from a copy of the impairment taken before, and
+    // comes out the same. NetworkMedium::sendBatch(FrameBatch&) does that when a frame is
+    // refused, with k the frames the medium took, so the refused frame and the ones behind it
+    // are judged only once they are really sent.
+    void judgeBatch(const std::uint32_t* frameBytes, std::size_t count, SimTime now, ImpairmentVerdicts& out);
+
+    const ImpairmentConfig& getConfig() const { return config; }
+    const ImpairmentCounters& getCounters() const { return counters; }
+
+    // Writes the state that evolves as frames are judged (random numbers, counters, the
+    // Gilbert-Elliott state and the token bucket) to a checkpoint, and reads it back into an
+    // impairment made from the same config.
+    void saveState(CheckpointWriter& writer) const;
+    void restoreState(CheckpointReader& reader);
+
+private:
+    ImpairmentConfig config;
+    ImpairmentCounters counters;
+    RandomBatch random;
+
+    // Probabilities converted for RandomBatch::chance().
+    std::uint64_t lossThreshold;
+    std::uint64_t goodToBadThreshold;
+    std::uint64_t badToGoodThreshold;
+    std::uint64_t lossInGoodThreshold;
+    std::uint64_t lossInBadThreshold;
+    std::uint64_t duplicateThreshold;
+    std::uint64_t corruptThreshold;
+    std::uint64_t reorderThreshold;
+
+    bool inBadState = false;            // Gilbert-Elliott state.
+
+    // Token bucket, in bytes. It may go negative: that debt is what later frames wait for.
+    double tokens;
+    SimTime tokensUpdatedAt = 0;
+
+    // Normal jitter is generated in pairs; the second value of a pair waits here.
+    bool haveSpareNormal = false;
+    double spareNormal = 0.0;
+
+    std::vector<std::uint64_t> draws;           // Scratch columns of judgeBatch(): random values,
+    std::vector<std::uint8_t> corruptMarks;     // and the frames picked for corruption.
+
+    bool isLost();
+    SimTime latencyDelay();
+    SimTime shapingDelay(std::size_t frameBytes, SimTime now);
+};
+
+
+#endif  // End LINK_IMPAIRMENT_H
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "MacTable.h"
+#include "Checkpoint.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+MacTable::MacTable(std::size_t maxEntries, SimTime agingTime)
+    : maxEntries(maxEntries), agingTime(agingTime), agingTicks(0) {
+    if (maxEntries == 0) {
+        throw std::invalid_argument("A MAC table needs room for at least one entry");
+    }
+    if (agingTime != 0) {
+        agingTicks = static_cast<std::uint32_t>(std::max<SimTime>(1, ticks(agingTime)));
+    }
+    // Smallest power of two that keeps the load factor at or below 3/4
+    std::size_t size = 4;
+    unsigned bits = 2;
+    while (size / 4 * 3 < maxEntries) {
+        size *= 2;
+        ++bits;
+    }
+    slots.resize(size);
+    mask = size - 1;
+    shift = 64 - bits;
+}
+
+// An expired entry on the probe path is reused, but only once the address is known not to be further along
+Learned MacTable::learn(std::uint64_t mac, PortId port, SimTime now) {
+    const std::uint32_t stamp = ticks(now);
+    std::size_t reusable = slots.size();
+    for (std::size_t index = indexOf(mac);; index = (index + 1) & mask) {
+        Slot& slot = slots[index];
+        if (slot.mac == mac) {
+            const bool expired = isExpired(slot, stamp);
+            if (slot.port == port) {
+                slot.lastSeen = stamp;
+                return expired ? Learned::Added : Learned::Refreshed;
+            }
+            slot.port = port;
+            slot.lastSeen = stamp;
+            return expired ? Learned::Added : Learned::Moved;
+        }
+        if (slot.mac == EMPTY) {
+            if (reusable == slots.size()) {
+                if (count == maxEntries) {
+                    return Learned::TableFull;
+                }
+                reusable = index;
+                ++count;
+            }
+            slots[reusable] = Slot{mac, port, stamp};
+            return Learned::Added;
+        }
+        if (reusable == slots.size() && isExpired(slot, stamp)) {
+            reusable = index;
+        }
+    }
+}
+
+PortId MacTable::lookup(std::uint64_t mac, SimTime now) const {
+    for (std::size_t index = indexOf(mac);; index = (index + 1) & mask) {
+        const Slot& slot = slots[index];
+        if (slot.mac == mac) {
+            return isExpired(slot, ticks(now)) ? NO_PORT : slot.port;
+        }
+        if (slot.mac == EMPTY) {
+            return NO_PORT;
+        }
+    }
+}
+
+// Backward-shift deletion: an entry moves into the hole if its home slot is not between the hole and itself
+void MacTable::erase(std::size_t index) {
+    std::size_t hole = index;
+    for (std::size_t next = (hole + 1) & mask; slots[next].mac != EMPTY; next = (next + 1) & mask) {
+        const std::size_t home = indexOf(slots[next].mac);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            slots[hole] = slots[next];
+            hole = next;
+        }
+    }
+    slots[hole] = Slot();
+    --count;
+}
+
+// An entry shifted into the slot just checked is checked again before moving on
+std::size_t MacTable::removeExpired(SimTime now) {
+    const std::uint32_t stamp = ticks(now);
+    std::size_t removed = 0;
+    for (std::size_t index = 0; index < slots.size();) {
+        if (slots[index].mac != EMPTY && isExpired(slots[index], stamp)) {
+            erase(index);
+            ++removed;
+        } else {
+            ++index;
+        }
+    }
+    return removed;
+}
+
+std::size_t MacTable::removePort(PortId port) {
+    std::size_t removed = 0;
+    for (std::size_t index = 0; index < slots.size();) {
+        if (slots[index].mac != EMPTY && slots[index].port == port) {
+            erase(index);
+            ++removed;
+        } else {
+            ++index;
+        }
+    }
+    return removed;
+}
+
+void MacTable::clear() {
+    slots.assign(slots.size(), Slot());
+    count = 0;
+}
+
+// The slots are written as they are, so restoring needs no hashing and keeps every probe chain
+void MacTable::saveState(CheckpointWriter& writer) const {
+    writer.put<std::uint64_t>(count);
+    writer.putArray(slots.data(), slots.size());
+}
+
+void MacTable::restoreState(CheckpointReader& reader) {
+    const std::uint64_t savedCount = reader.get<std::uint64_t>();
+    std::vector<Slot> savedSlots;
+    reader.getArray(savedSlots);
+    if (savedSlots.size() != slots.size()) {
+        throw std::runtime_error("The checkpointed MAC table has " + std::to_string(savedSlots.size()) +
+                                 " slots, this one " + std::to_string(slots.size()));
+    }
+    slots = std::move(savedSlots);
+    count = static_cast<std::size_t>(savedCount);
+}
@@ -0,0 +1,99 @@
+#ifndef MAC_TABLE_H    // This will ensure no repeat definition of this header file.
+#define MAC_TABLE_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "Topology.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// What MacTable::learn() did with an address.
+enum class Learned {
+    Refreshed,  // Already known on this port; only its age was reset.
+    Added,      // A new entry.
+    Moved,      // Known on another port before (the station moved, or a loop).
+    TableFull,  // Not stored: the table holds 'maxEntries' live addresses already.
+};
+
+/*
+MacTable maps 48-bit MAC addresses to ports, the way the filtering database of an Ethernet
+switch does. It is an open-addressing hash table with linear probing: the entries are 16-byte
+slots in one flat array (four per cache line), so a lookup is one hash and, almost always,
+one cache line, and no pointer is ever followed.
+
+Entries age: an address that has not been seen for the aging time is treated as unknown, and
+its slot is reused by the next address that probes past it. removeExpired() frees such slots
+for good. The table never grows; it is sized once for 'maxEntries' addresses at a load factor
+of at most 3/4.
+*/
+class MacTable{
+public:
+    // IEEE 802.1D's default aging time.
+    static constexpr SimTime DEFAULT_AGING_TIME = 300 * SECOND;
+
+    // 'agingTime' 0 means that entries never age. Ages are kept with millisecond resolution.
+    explicit MacTable(std::size_t maxEntries, SimTime agingTime = DEFAULT_AGING_TIME);
+
+    // Records that 'mac' was seen as a source address on 'port' at time 'now'.
+    Learned learn(std::uint64_t mac, PortId port, SimTime now);
+
+    // The port 'mac' was last seen on, or NO_PORT if it is unknown or has aged out.
+    PortId lookup(std::uint64_t mac, SimTime now) const;
+
+    // Starts loading the slot of 'mac' into the cache. Issuing this for a whole batch of
+    // frames before looking any of them up overlaps the cache misses of a large table.
+    void prefetch(std::uint64_t mac) const { __builtin_prefetch(&slots[indexOf(mac)]); }
+
+    // Forgets the entries that have aged out and returns how many there were.
+    std::size_t removeExpired(SimTime now);
+
+    // Forgets everything, or only the addresses learned on 'port' (e.g. when its link went down).
+    void clear();
+    std::size_t removePort(PortId port);
+
+    // Number of entries stored, including ones that have aged out but were not removed yet.
+    std::size_t size() const { return count; }
+    std::size_t getMaxEntries() const { return maxEntries; }
+    std::size_t slotCount() const { return slots.size(); }
+    SimTime getAgingTime() const { return agingTime; }
+
+    // Writes every slot to a checkpoint, and reads them back into a table of the same size.
+    // Throws std::runtime_error if the saved table had another number of slots.
+    void saveState(CheckpointWriter& writer) const;
+    void restoreState(CheckpointReader& reader);
+
+private:
+    static constexpr std::uint64_t EMPTY = ~static_cast<std::uint64_t>(0);    // Not a 48-bit address.
+
+    struct Slot {
+        std::uint64_t mac = EMPTY;
+        PortId port = NO_PORT;
+        std::uint32_t lastSeen = 0;     // In milliseconds, wrapping around.
+    };
+
+    std::vector<Slot> slots;
+    std::size_t mask;
+    unsigned shift;
+    std::size_t maxEntries;
+    std::size_t count = 0;
+    SimTime agingTime;
+    std::uint32_t agingTicks;
+
+    // Fibonacci hashing: consecutive addresses, common in emulated networks, spread out evenly.
+    std::size_t indexOf(std::uint64_t mac) const {
+        return static_cast<std::size_t>((mac * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    static std::uint32_t ticks(SimTime time) { return static_cast<std::uint32_t>(time / MILLISECOND); }
+    bool isExpired(const Slot& slot, std::uint32_t now) const { return agingTicks != 0 && now - slot.lastSeen >= agingTicks; }
+
+    // Empties a slot and moves later entries of its probe chain back, so that no chain is broken.
+    void erase(std::size_t index);
+};
+
+
+#endif  // End MAC_TABLE_H
\ No newline at end of file
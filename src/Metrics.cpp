@@ -0,0 +1,92 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Threads take the shards in turn, so up to METRIC_SHARDS senders never share one
+std::size_t assignMetricShard() {
+    static std::atomic<std::size_t> nextShard{0};
+    return nextShard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+}
+
+// The buckets are read while the writer keeps going, so the count is taken from the buckets themselves
+HistogramSnapshot Histogram::snapshot() const {
+    HistogramSnapshot copy;
+    copy.buckets.resize(BUCKET_COUNT);
+    if (count.load(std::memory_order_acquire) == 0) {
+        return copy;
+    }
+    for (std::size_t index = 0; index < BUCKET_COUNT; ++index) {
+        copy.buckets[index] = buckets[index].load(std::memory_order_relaxed);
+        copy.count += copy.buckets[index];
+    }
+    copy.sum = sum.load(std::memory_order_relaxed);
+    copy.min = min.load(std::memory_order_relaxed);
+    copy.max = max.load(std::memory_order_relaxed);
+    return copy;
+}
+
+// Walks the buckets up to the one holding the wanted rank and reports its highest value
+std::uint64_t HistogramSnapshot::percentile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    const double clamped = std::clamp(quantile, 0.0, 1.0);
+    const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(clamped * static_cast<double>(count))));
+    std::uint64_t seen = 0;
+    for (std::size_t index = 0; index < buckets.size(); ++index) {
+        seen += buckets[index];
+        if (seen >= rank) {
+            const std::uint64_t highest = index + 1 < Histogram::BUCKET_COUNT ? Histogram::bucketLowerBound(index + 1) - 1 : max;
+            return std::clamp(highest, min, max);
+        }
+    }
+    return max;
+}
+
+// A bucket straddling 'value' is left out, so the count is exact at bucket bounds
+std::uint64_t HistogramSnapshot::countBelow(std::uint64_t value) const {
+    std::uint64_t total = 0;
+    for (std::size_t index = 0; index + 1 < buckets.size(); ++index) {
+        if (Histogram::bucketLowerBound(index + 1) > value) {
+            break;
+        }
+        total += buckets[index];
+    }
+    return total;
+}
+
+MediumMetrics::MediumMetrics(bool concurrentSenders, std::uint32_t histogramSampleEvery)
+    : concurrentSenders(concurrentSenders), histogramSampleEvery(histogramSampleEvery),
+      senders(new SenderShard[concurrentSenders ? METRIC_SHARDS : 1]) {
+    if (histogramSampleEvery == 0) {
+        throw std::invalid_argument("Histograms need a sampling ratio greater than zero");
+    }
+}
+
+void MediumMetrics::setHistogramSampleEvery(std::uint32_t every) {
+    if (every == 0) {
+        throw std::invalid_argument("Histograms need a sampling ratio greater than zero");
+    }
+    histogramSampleEvery = every;
+    receiver.untilSample = std::min(receiver.untilSample, every);
+}
+
+// Sums the sender shards; every value is read once, without stopping the medium
+MediumStats MediumMetrics::snapshot() const {
+    MediumStats stats;
+    const std::size_t shards = concurrentSenders ? METRIC_SHARDS : 1;
+    for (std::size_t index = 0; index < shards; ++index) {
+        const SenderShard& shard = senders[index];
+        stats.framesSent += shard.framesSent.load(std::memory_order_relaxed);
+        stats.bytesSent += shard.bytesSent.load(std::memory_order_relaxed);
+        stats.framesRefused += shard.framesRefused.load(std::memory_order_relaxed);
+        stats.framesDropped += shard.framesDropped.load(std::memory_order_relaxed);
+        stats.framesDelivered += shard.framesDelivered.load(std::memory_order_relaxed);
+    }
+    stats.framesReceived = receiver.framesReceived.load(std::memory_order_relaxed);
+    stats.bytesReceived = receiver.bytesReceived.load(std::memory_order_relaxed);
+    stats.occupancy = receiver.occupancy.snapshot();
+    stats.sojourn = receiver.sojourn.snapshot();
+    return stats;
+}
@@ -0,0 +1,214 @@
+#ifndef METRICS_H    // This will ensure no repeat definition of this header file.
+#define METRICS_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "PacketRing.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Number of shards of a counter that many threads update at once.
+constexpr std::size_t METRIC_SHARDS = 16;
+
+// Hands out shard numbers to threads round robin; see metricShard().
+std::size_t assignMetricShard();
+
+// The calling thread's shard, fixed for the life of the thread.
+inline std::size_t metricShard() {
+    static thread_local std::size_t shard = METRIC_SHARDS;
+    if (shard == METRIC_SHARDS) {
+        shard = assignMetricShard();
+    }
+    return shard;
+}
+
+// Adds to a counter that only one thread ever writes: a plain load and store, no locked instruction.
+inline void addExclusive(std::atomic<std::uint64_t>& counter, std::uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// A copy of a Histogram's contents, taken by Histogram::snapshot().
+struct HistogramSnapshot {
+    std::vector<std::uint64_t> buckets;     // Counts per bucket, see Histogram::bucketLowerBound().
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t min = 0;                  // 0 while empty.
+    std::uint64_t max = 0;
+
+    double mean() const { return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count); }
+
+    // The value below which the fraction 'quantile' (0 to 1) of the recorded values lie,
+    // accurate to the bucket width; 0 while empty.
+    std::uint64_t percentile(double quantile) const;
+
+    // Number of recorded values below 'value'; exact when 'value' is where a bucket begins,
+    // as every power of two does.
+    std::uint64_t countBelow(std::uint64_t value) const;
+};
+
+/*
+Histogram counts 64-bit values (nanoseconds, queue depths) in log-linear buckets, like an
+HdrHistogram: every power of two is split into 16 equal buckets, so a value is recorded with a
+relative error of at most 1/16 whatever its size, and values below 32 exactly. 720 buckets cover
+everything below 2^48; larger values land in the last one. Recording is a bit scan and an add,
+with no allocation and no branch on the value's size.
+
+A histogram has a single writer (only one thread may call record()), but snapshot() may run
+on any thread at any time.
+*/
+class Histogram{
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 4;
+    static constexpr std::size_t SUB_BUCKETS = std::size_t(1) << SUB_BUCKET_BITS;
+    static constexpr unsigned MAX_BITS = 48;
+    static constexpr std::size_t BUCKET_COUNT = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void record(std::uint64_t value) {
+        addExclusive(buckets[bucketOf(value)], 1);
+        addExclusive(sum, value);
+        const std::uint64_t recorded = count.load(std::memory_order_relaxed);
+        if (recorded == 0 || value < min.load(std::memory_order_relaxed)) {
+            min.store(value, std::memory_order_relaxed);
+        }
+        if (value > max.load(std::memory_order_relaxed)) {
+            max.store(value, std::memory_order_relaxed);
+        }
+        count.store(recorded + 1, std::memory_order_release);
+    }
+
+    HistogramSnapshot snapshot() const;
+
+    static std::size_t bucketOf(std::uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<std::size_t>(value);
+        }
+        unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value));
+        if (exponent >= MAX_BITS) {
+            return BUCKET_COUNT - 1;
+        }
+        const std::size_t sub = static_cast<std::size_t>(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    // The smallest value recorded in bucket 'index'; the bucket ends where the next one begins.
+    static std::uint64_t bucketLowerBound(std::size_t index) {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+        const unsigned exponent = static_cast<unsigned>(index / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+        return (SUB_BUCKETS + index % SUB_BUCKETS) << (exponent - SUB_BUCKET_BITS);
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<std::uint64_t> min{0};
+    std::atomic<std::uint64_t> max{0};
+};
+
+// A point-in-time copy of a medium's metrics (see NetworkMedium::getMetrics()).
+struct MediumStats {
+    std::uint64_t framesSent = 0;       // Frames handed to the medium by senders (including refused ones),
+    std::uint64_t bytesSent = 0;        // and their bytes.
+    std::uint64_t framesRefused = 0;    // Handed back: the send call returned false and the sender kept the frame.
+    std::uint64_t framesDropped = 0;    // Lost on the medium: impairment loss, queue drops, a full ring on arrival.
+    std::uint64_t framesDelivered = 0;  // Reached the receiving end and were stored for the receivers.
+    std::uint64_t framesReceived = 0;   // Taken off by receivers (by each receiver on a Broadcast medium),
+    std::uint64_t bytesReceived = 0;    // and their bytes.
+    HistogramSnapshot occupancy;        // Frames waiting on the medium as a frame is received, that frame included.
+    HistogramSnapshot sojourn;          // Nanoseconds a frame waited to be received, see MediumMetrics.
+};
+
+/*
+MediumMetrics are the counters and histograms of one NetworkMedium, kept once metrics were
+enabled on it. The medium updates them on its send and receive paths for a few nanoseconds per
+frame; nothing is locked and nothing is aggregated until somebody reads them.
+
+Every counter has a single writer wherever possible: the sender-side counters live on their own
+cache lines, apart from the receiver-side counters and histograms, so a sending and a receiving
+thread never write the same line. On an MpscRing or SharedMemory medium, which many threads
+send into, every sending thread gets a shard of its own among METRIC_SHARDS (atomically added,
+as two threads may share one); snapshot() sums the shards. The metrics of a SharedMemory medium
+count what this process sent and received, not what the other processes on the segment did.
+
+The sojourn time of a frame runs from the moment it would have arrived over an idle wire until
+a receiver took it: all the time it spent queued behind other frames, at either end of the wire.
+*/
+class MediumMetrics{
+public:
+    // 'concurrentSenders' for media that several threads send into. Histograms record one
+    // received frame in 'histogramSampleEvery'; the counters always count every frame.
+    MediumMetrics(bool concurrentSenders, std::uint32_t histogramSampleEvery);
+
+    // Changes the sampling ratio of the histograms from the next sampled frame on. Throws
+    // std::invalid_argument for 0. Not to be called while a receiver is taking frames.
+    void setHistogramSampleEvery(std::uint32_t every);
+
+    // 'frames' frames of 'bytes' bytes in all; a burst is counted with one update.
+    void countSent(std::size_t bytes, std::uint64_t frames = 1) {
+        SenderShard& shard = senderShard();
+        add(shard.framesSent, frames);
+        add(shard.bytesSent, bytes);
+    }
+    void countRefused(std::uint64_t frames = 1) { add(senderShard().framesRefused, frames); }
+    void countDropped(std::uint64_t frames = 1) { add(senderShard().framesDropped, frames); }
+    void countDelivered(std::uint64_t frames = 1) { add(senderShard().framesDelivered, frames); }
+
+    void countReceived(std::size_t bytes, std::uint64_t frames = 1) {
+        addExclusive(receiver.framesReceived, frames);
+        addExclusive(receiver.bytesReceived, bytes);
+    }
+
+    // True if the frame just received should go into the histograms.
+    bool sampleHistograms() {
+        if (receiver.untilSample > 1) {
+            --receiver.untilSample;
+            return false;
+        }
+        receiver.untilSample = histogramSampleEvery;
+        return true;
+    }
+
+    void recordOccupancy(std::size_t frames) { receiver.occupancy.record(frames); }
+    void recordSojourn(std::uint64_t nanoseconds) { receiver.sojourn.record(nanoseconds); }
+
+    MediumStats snapshot() const;
+
+private:
+    struct alignas(CACHE_LINE_SIZE) SenderShard {
+        std::atomic<std::uint64_t> framesSent{0};
+        std::atomic<std::uint64_t> bytesSent{0};
+        std::atomic<std::uint64_t> framesRefused{0};
+        std::atomic<std::uint64_t> framesDropped{0};
+        std::atomic<std::uint64_t> framesDelivered{0};
+    };
+    struct alignas(CACHE_LINE_SIZE) ReceiverSide {
+        std::atomic<std::uint64_t> framesReceived{0};
+        std::atomic<std::uint64_t> bytesReceived{0};
+        std::uint32_t untilSample = 1;
+        Histogram occupancy;
+        Histogram sojourn;
+    };
+
+    const bool concurrentSenders;
+    std::uint32_t histogramSampleEvery;
+    std::unique_ptr<SenderShard[]> senders;     // METRIC_SHARDS shards with concurrent senders, otherwise one.
+    ReceiverSide receiver;
+
+    SenderShard& senderShard() { return concurrentSenders ? senders[metricShard()] : senders[0]; }
+
+    void add(std::atomic<std::uint64_t>& counter, std::uint64_t amount) {
+        if (concurrentSenders) {
+            counter.fetch_add(amount, std::memory_order_relaxed);
+        } else {
+            addExclusive(counter, amount);
+        }
+    }
+};
+
+
+#endif  // End METRICS_H
\ No newline at end of file
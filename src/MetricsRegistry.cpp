@@ -0,0 +1,240 @@
+#include "MetricsRegistry.h"
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+
+// Upper bounds of the exported histogram buckets: 1 ns to 4^17 ns (about 17 s), and 1 to 65536 frames
+constexpr std::size_t SOJOURN_BUCKETS = 18;
+constexpr std::size_t OCCUPANCY_BUCKETS = 17;
+
+// Both formats escape backslashes, quotes and newlines the same way
+std::string escape(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (const char character : text) {
+        if (character == '\\' || character == '"') {
+            escaped += '\\';
+            escaped += character;
+        } else if (character == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += character;
+        }
+    }
+    return escaped;
+}
+
+std::string formatDouble(double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", value);
+    return text;
+}
+
+// '{name="value",...}', with an optional extra label at the end (for 'le')
+std::string prometheusLabels(const MetricLabels& labels, const char* extraName = nullptr, const std::string& extraValue = "") {
+    std::string text = "{";
+    for (const auto& [name, value] : labels) {
+        if (text.size() > 1) {
+            text += ',';
+        }
+        text += name + "=\"" + escape(value) + '"';
+    }
+    if (extraName != nullptr) {
+        if (text.size() > 1) {
+            text += ',';
+        }
+        text += std::string(extraName) + "=\"" + extraValue + '"';
+    }
+    return text + "}";
+}
+
+void prometheusHeader(std::string& out, const std::string& metric, const char* type, const std::string& help) {
+    out += "# HELP " + metric + ' ' + help + '\n';
+    out += "# TYPE " + metric + ' ' + type + '\n';
+}
+
+// Cumulative buckets with bounds at the powers of 'base' (in recorded units), reported multiplied by
+// 'scale'. A bucket counts the values below its bound, which the log-linear buckets give exactly.
+void prometheusHistogram(std::string& out, const std::string& metric, const MetricLabels& labels,
+                         const HistogramSnapshot& histogram, std::size_t bucketCount, std::uint64_t base, double scale) {
+    std::uint64_t bound = 1;
+    for (std::size_t index = 0; index < bucketCount; ++index, bound *= base) {
+        out += metric + "_bucket" + prometheusLabels(labels, "le", formatDouble(static_cast<double>(bound) * scale)) + ' ' +
+               std::to_string(histogram.countBelow(bound)) + '\n';
+    }
+    out += metric + "_bucket" + prometheusLabels(labels, "le", "+Inf") + ' ' + std::to_string(histogram.count) + '\n';
+    out += metric + "_sum" + prometheusLabels(labels) + ' ' + formatDouble(static_cast<double>(histogram.sum) * scale) + '\n';
+    out += metric + "_count" + prometheusLabels(labels) + ' ' + std::to_string(histogram.count) + '\n';
+}
+
+std::string jsonLabels(const MetricLabels& labels) {
+    std::string text = "{";
+    for (const auto& [name, value] : labels) {
+        if (text.size() > 1) {
+            text += ',';
+        }
+        text += '"' + escape(name) + "\":\"" + escape(value) + '"';
+    }
+    return text + "}";
+}
+
+std::string jsonHistogram(const HistogramSnapshot& histogram) {
+    return "{\"count\":" + std::to_string(histogram.count) + ",\"mean\":" + formatDouble(histogram.mean()) +
+           ",\"min\":" + std::to_string(histogram.min) + ",\"p50\":" + std::to_string(histogram.percentile(0.5)) +
+           ",\"p90\":" + std::to_string(histogram.percentile(0.9)) + ",\"p99\":" + std::to_string(histogram.percentile(0.99)) +
+           ",\"p999\":" + std::to_string(histogram.percentile(0.999)) + ",\"max\":" + std::to_string(histogram.max) + "}";
+}
+
+bool isMetricName(const std::string& name) {
+    if (name.empty()) {
+        return false;
+    }
+    for (std::size_t index = 0; index < name.size(); ++index) {
+        const char character = name[index];
+        const bool letter = (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') ||
+                            character == '_' || character == ':';
+        if (!letter && !(index > 0 && character >= '0' && character <= '9')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The medium counters in the order they are exported
+struct MediumCounter {
+    const char* metric;
+    const char* json;
+    const char* help;
+    std::uint64_t MediumStats::*field;
+};
+constexpr MediumCounter MEDIUM_COUNTERS[] = {
+    {"netemu_medium_frames_sent_total", "framesSent", "Frames handed to the medium by senders.", &MediumStats::framesSent},
+    {"netemu_medium_bytes_sent_total", "bytesSent", "Bytes handed to the medium by senders.", &MediumStats::bytesSent},
+    {"netemu_medium_frames_refused_total", "framesRefused", "Frames handed back to their senders.", &MediumStats::framesRefused},
+    {"netemu_medium_frames_dropped_total", "framesDropped", "Frames lost on the medium.", &MediumStats::framesDropped},
+    {"netemu_medium_frames_delivered_total", "framesDelivered", "Frames that reached the receiving end.", &MediumStats::framesDelivered},
+    {"netemu_medium_frames_received_total", "framesReceived", "Frames taken off the medium by receivers.", &MediumStats::framesReceived},
+    {"netemu_medium_bytes_received_total", "bytesReceived", "Bytes taken off the medium by receivers.", &MediumStats::bytesReceived},
+};
+
+} // namespace
+
+void MetricsRegistry::addMedium(const std::string& name, NetworkMedium& medium, const MetricLabels& labels) {
+    if (medium.getMetrics() == nullptr) {
+        medium.enableMetrics();
+    }
+    MediumEntry entry{&medium, {{"medium", name}}};
+    entry.labels.insert(entry.labels.end(), labels.begin(), labels.end());
+    media.push_back(std::move(entry));
+}
+
+// A segment's medium is shared by its members' ports, so it is registered once, through its first member
+void MetricsRegistry::addTopology(Topology& topology) {
+    std::vector<bool> segmentAdded(topology.segmentCount(), false);
+    for (NodeId node = 0; node < topology.nodeCount(); ++node) {
+        const std::vector<Port>& ports = topology.getPorts(node);
+        for (PortId port = 0; port < ports.size(); ++port) {
+            const Port& entry = ports[port];
+            if (entry.segment != NO_SEGMENT) {
+                if (!segmentAdded[entry.segment]) {
+                    segmentAdded[entry.segment] = true;
+                    const std::string& segment = topology.getSegmentName(entry.segment);
+                    addMedium(segment, *entry.tx, {{"segment", segment}});
+                }
+                continue;
+            }
+            addMedium(topology.getMediumName(node, port), *entry.tx,
+                      {{"node", topology.getName(node)}, {"port", std::to_string(port)}, {"peer", topology.getName(entry.peer)}});
+        }
+    }
+}
+
+void MetricsRegistry::addCounter(const std::string& metric, const std::string& help, const MetricLabels& labels,
+                                 std::function<std::uint64_t()> read) {
+    if (!isMetricName(metric)) {
+        throw std::invalid_argument("'" + metric + "' is not a valid metric name");
+    }
+    counters.push_back(CounterEntry{metric, help, labels, std::move(read)});
+}
+
+// Series of one metric have to stay together, so the output is grouped by metric rather than by medium
+std::string MetricsRegistry::toPrometheus() const {
+    std::vector<MediumStats> stats;
+    stats.reserve(media.size());
+    for (const MediumEntry& entry : media) {
+        stats.push_back(entry.medium->getMetrics()->snapshot());
+    }
+
+    std::string out;
+    if (!media.empty()) {
+        for (const MediumCounter& counter : MEDIUM_COUNTERS) {
+            prometheusHeader(out, counter.metric, "counter", counter.help);
+            for (std::size_t index = 0; index < media.size(); ++index) {
+                out += counter.metric + prometheusLabels(media[index].labels) + ' ' + std::to_string(stats[index].*counter.field) + '\n';
+            }
+        }
+        prometheusHeader(out, "netemu_medium_occupancy_frames", "histogram", "Frames waiting on the medium as a frame is received.");
+        for (std::size_t index = 0; index < media.size(); ++index) {
+            prometheusHistogram(out, "netemu_medium_occupancy_frames", media[index].labels, stats[index].occupancy,
+                                OCCUPANCY_BUCKETS, 2, 1.0);
+        }
+        prometheusHeader(out, "netemu_medium_sojourn_seconds", "histogram", "Time frames waited on the medium to be received.");
+        for (std::size_t index = 0; index < media.size(); ++index) {
+            prometheusHistogram(out, "netemu_medium_sojourn_seconds", media[index].labels, stats[index].sojourn,
+                                SOJOURN_BUCKETS, 4, 1e-9);
+        }
+    }
+
+    std::vector<bool> written(counters.size(), false);
+    for (std::size_t first = 0; first < counters.size(); ++first) {
+        if (written[first]) {
+            continue;
+        }
+        prometheusHeader(out, counters[first].metric, "counter", counters[first].help);
+        for (std::size_t index = first; index < counters.size(); ++index) {
+            if (!written[index] && counters[index].metric == counters[first].metric) {
+                written[index] = true;
+                out += counters[index].metric + prometheusLabels(counters[index].labels) + ' ' +
+                       std::to_string(counters[index].read()) + '\n';
+            }
+        }
+    }
+    return out;
+}
+
+std::string MetricsRegistry::toJson() const {
+    std::string out = "{\"media\":[";
+    for (std::size_t index = 0; index < media.size(); ++index) {
+        const MediumStats stats = media[index].medium->getMetrics()->snapshot();
+        const MetricLabels labels(media[index].labels.begin() + 1, media[index].labels.end());
+        out += index == 0 ? "" : ",";
+        out += "{\"name\":\"" + escape(media[index].labels.front().second) + "\",\"labels\":" + jsonLabels(labels);
+        for (const MediumCounter& counter : MEDIUM_COUNTERS) {
+            out += ",\"" + std::string(counter.json) + "\":" + std::to_string(stats.*counter.field);
+        }
+        out += ",\"occupancyFrames\":" + jsonHistogram(stats.occupancy);
+        out += ",\"sojournNanoseconds\":" + jsonHistogram(stats.sojourn) + "}";
+    }
+    out += "],\"counters\":[";
+    for (std::size_t index = 0; index < counters.size(); ++index) {
+        out += index == 0 ? "" : ",";
+        out += "{\"metric\":\"" + counters[index].metric + "\",\"labels\":" + jsonLabels(counters[index].labels) +
+               ",\"value\":" + std::to_string(counters[index].read()) + "}";
+    }
+    return out + "]}";
+}
+
+void MetricsRegistry::writePrometheusFile(const std::string& path) const {
+    const std::string text = toPrometheus();
+    const std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Cannot create metrics file " + temporary);
+    }
+    const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (std::fclose(file) != 0 || !written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Cannot write metrics file " + path);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef METRICS_REGISTRY_H    // This will ensure no repeat definition of this header file.
+#define METRICS_REGISTRY_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "Metrics.h"
+#include "NetworkMedium.h"
+#include "Topology.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Label names and values attached to a metric, e.g. {{"node", "r1"}, {"port", "0"}}.
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+/*
+MetricsRegistry collects the media (and any other counters, such as a node's) of a simulation
+under names and labels, and writes what they have counted as Prometheus text exposition
+format or as JSON. Nothing is aggregated until an export is asked for; exporting takes a
+snapshot of every medium, which is safe while the media are in use on other threads.
+
+Media are exported as netemu_medium_* series labelled medium="<name>" plus their own labels.
+The histograms are cut down to fixed Prometheus buckets: powers of four nanoseconds for the
+sojourn time (exported in seconds) and powers of two frames for the occupancy.
+
+Media and counters are registered before exporting starts; the registry does not lock.
+*/
+class MetricsRegistry{
+public:
+    // Registers a medium under the label medium="<name>", enabling its metrics if they are not
+    // yet. The medium must outlive the registry.
+    void addMedium(const std::string& name, NetworkMedium& medium, const MetricLabels& labels = MetricLabels());
+
+    // Registers every medium of the topology: the medium a node sends into over a
+    // point-to-point link as "<node>-><peer>" (labels node, port and peer), and the medium of
+    // a LAN segment as "<segment>" (label segment).
+    void addTopology(Topology& topology);
+
+    // Registers a counter that 'read' returns the current value of, such as a field of a
+    // node's counters. 'read' is called on the exporting thread. Throws std::invalid_argument
+    // if 'metric' is not a valid Prometheus metric name.
+    void addCounter(const std::string& metric, const std::string& help, const MetricLabels& labels,
+                    std::function<std::uint64_t()> read);
+
+    // Every metric in Prometheus text exposition format (version 0.0.4).
+    std::string toPrometheus() const;
+
+    // Every metric as one JSON object, with percentiles instead of histogram buckets.
+    std::string toJson() const;
+
+    // Writes toPrometheus() to 'path' through a temporary file that is then renamed, so the
+    // node exporter's textfile collector never reads half a file. Throws std::runtime_error
+    // if the file cannot be written.
+    void writePrometheusFile(const std::string& path) const;
+
+    std::size_t mediumCount() const { return media.size(); }
+
+private:
+    struct MediumEntry {
+        NetworkMedium* medium;
+        MetricLabels labels;    // medium="<name>" first.
+    };
+    struct CounterEntry {
+        std::string metric;
+        std::string help;
+        MetricLabels labels;
+        std::function<std::uint64_t()> read;
+    };
+
+    std::vector<MediumEntry> media;
+    std::vector<CounterEntry> counters;
+};
+
+
+#endif  // End METRICS_REGISTRY_H
@@ -1,26 +1,1141 @@
 #include "NetworkMedium.h"
+#include "Checkpoint.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
 
-// Definition of the static constant member
-const RawPacket NetworkMedium::EMPTY_PACKET;
+// Bounds of the adaptive spin phase of waitReceive(), in polls of the medium
+constexpr std::uint32_t MIN_SPIN_ROUNDS = 16;
+constexpr std::uint32_t MAX_SPIN_ROUNDS = 4096;
 
-// Puts a packet onto the medium
-void NetworkMedium::sendPacket(const RawPacket& packet) {
-    packetQueue.push(packet);
+// Spinning only helps when the sender can run at the same time; asked once, as it is a system call
+static std::uint32_t initialSpinRounds() {
+    static const std::uint32_t rounds = std::thread::hardware_concurrency() > 1 ? 256 : 0;
+    return rounds;
+}
+
+// Flips the bit a corrupting impairment picked
+static void flipBit(RawPacket& packet, std::int64_t bit) {
+    packet.data[static_cast<std::size_t>(bit / 8)] ^= static_cast<char>(1 << (bit % 8));
+}
+
+// Creates the storage of the selected backend
+NetworkMedium::NetworkMedium(MediumBackend backend, std::size_t ringCapacity)
+    : backend(backend), spinRounds(initialSpinRounds()) {
+    if (backend == MediumBackend::SpscRing) {
+        spscRing = std::make_unique<SpscRing<QueuedFrame>>(ringCapacity);
+    } else if (backend == MediumBackend::MpscRing) {
+        mpscRing = std::make_unique<MpscRing<QueuedFrame>>(ringCapacity);
+    } else if (backend == MediumBackend::Broadcast) {
+        frameLog = std::make_unique<FrameLog>();
+    } else if (backend == MediumBackend::SharedMemory) {
+        throw std::invalid_argument("A SharedMemory medium is created from the name of its segment");
+    }
+}
+
+// Maps the segment another process (or this one) created
+NetworkMedium::NetworkMedium(const std::string& segmentName)
+    : backend(MediumBackend::SharedMemory), sharedRing(std::make_unique<SharedFrameRing>(segmentName)),
+      spinRounds(initialSpinRounds()) {
+}
+
+// Hands the packet to whichever backend this medium uses
+bool NetworkMedium::push(RawPacket& packet, SimTime readyTime) {
+    if (backend == MediumBackend::Broadcast) {
+        return frameLog->append(std::move(packet), NO_RECEIVER);
+    }
+    if (backend == MediumBackend::SharedMemory) {
+        // The bytes are copied into the segment; the sender's buffer goes back to the pool
+        if (!sharedRing->tryPush(packet.view().data(), packet.data.size(), readyTime)) {
+            return false;
+        }
+        packet.data = PacketBuffer();
+        return true;
+    }
+    // The frame is written straight into its slot; a full ring leaves the packet with the caller
+    auto fill = [&packet, readyTime](QueuedFrame& slot) {
+        slot.packet.data = std::move(packet.data);
+        slot.readyTime = readyTime;
+    };
+    if (backend == MediumBackend::Queue) {
+        if (flowQueue) {
+            const std::size_t dropped = flowQueue->enqueue(packet, readyTime);
+            if (metrics && dropped > 0) {
+                metrics->countDropped(dropped);
+            }
+            return true;
+        }
+        fill(packetQueue.pushBack());
+        return true;
+    }
+    return backend == MediumBackend::SpscRing ? spscRing->tryPushWith(fill) : mpscRing->tryPushWith(fill);
+}
+
+// Takes the next packet from the Queue or ring backend
+bool NetworkMedium::pop(RawPacket& out, SimTime& readyTime) {
+    if (backend == MediumBackend::Queue) {
+        if (queueLimit) {
+            return popLimited(out, readyTime);
+        }
+        if (flowQueue) {
+            return popFlow(out, readyTime);
+        }
+        if (packetQueue.empty()) {
+            return false;
+        }
+        // The caller gets the frame, and the caller's old buffer returns to the pool
+        out.data = std::move(packetQueue.front().packet.data);
+        readyTime = packetQueue.front().readyTime;
+        packetQueue.pop_front();
+        return true;
+    }
+    if (backend == MediumBackend::SharedMemory) {
+        // Copied into the caller's own buffer, which is reused if it is big enough
+        return sharedRing->tryPopWith([&out, &readyTime](const char* bytes, std::size_t length, SimTime frameReadyTime) {
+            out.data.assign(bytes, bytes + length);
+            readyTime = frameReadyTime;
+        });
+    }
+    auto take = [&out, &readyTime](QueuedFrame& slot) {
+        out.data = std::move(slot.packet.data);
+        readyTime = slot.readyTime;
+    };
+    return backend == MediumBackend::SpscRing ? spscRing->tryPopWith(take) : mpscRing->tryPopWith(take);
+}
+
+// Frames are written straight into their slots, like push() does
+std::size_t NetworkMedium::pushBatch(std::span<RawPacket> packets, SimTime readyTime) {
+    if (backend == MediumBackend::Queue) {
+        for (RawPacket& packet : packets) {
+            QueuedFrame& slot = packetQueue.pushBack();
+            slot.packet.data = std::move(packet.data);
+            slot.readyTime = readyTime;
+        }
+        return packets.size();
+    }
+    // A ring that is busy with other senders may take a burst in several parts
+    std::size_t pushed = 0;
+    while (pushed < packets.size()) {
+        const std::span<RawPacket> rest = packets.subspan(pushed);
+        auto fill = [rest, readyTime](QueuedFrame& slot, std::size_t index) {
+            slot.packet.data = std::move(rest[index].data);
+            slot.readyTime = readyTime;
+        };
+        const std::size_t part = backend == MediumBackend::SpscRing ? spscRing->tryPushBatchWith(rest.size(), fill)
+                                                                    : mpscRing->tryPushBatchWith(rest.size(), fill);
+        if (part == 0) {
+            break;
+        }
+        pushed += part;
+    }
+    return pushed;
+}
+
+// Takes a burst from the Queue backend (without a queue limit) or a ring
+std::size_t NetworkMedium::popBatch(RawPacket* out, SimTime* readyTimes, std::size_t maxCount) {
+    auto take = [out, readyTimes](QueuedFrame& slot, std::size_t index) {
+        out[index].data = std::move(slot.packet.data);
+        if (readyTimes != nullptr) {
+            readyTimes[index] = slot.readyTime;
+        }
+    };
+    if (backend == MediumBackend::Queue) {
+        const std::size_t count = std::min(maxCount, packetQueue.size());
+        for (std::size_t index = 0; index < count; ++index) {
+            take(packetQueue.front(), index);
+            packetQueue.pop_front();
+        }
+        return count;
+    }
+    return backend == MediumBackend::SpscRing ? spscRing->tryPopBatchWith(maxCount, take)
+                                              : mpscRing->tryPopBatchWith(maxCount, take);
+}
+
+// Hands the packet to the backend, telling a broadcast bus who sent it
+bool NetworkMedium::deliver(RawPacket& packet, ReceiverId origin, SimTime readyTime, bool wake) {
+    if (backend == MediumBackend::Broadcast) {
+        const bool appended = frameLog->append(std::move(packet), origin);
+        if (metrics && appended) {
+            metrics->countDelivered();
+        }
+        return appended;
+    }
+    if (!push(packet, readyTime)) {
+        return false;
+    }
+    if (metrics) {
+        metrics->countDelivered();
+    }
+    if (wake) {
+        wakeReceivers();
+    }
+    return true;
+}
+
+// A frame the sender still holds was refused; one a Broadcast medium had no receiver for is gone
+void NetworkMedium::countUndelivered(bool senderKeepsIt) {
+    if (!metrics) {
+        return;
+    }
+    if (senderKeepsIt && backend != MediumBackend::Broadcast) {
+        metrics->countRefused();
+    } else {
+        metrics->countDropped();
+    }
+}
+
+// Only sampled frames pay for the clock and the occupancy snapshot
+void NetworkMedium::countReceived(std::size_t bytes, SimTime readyTime, bool knowsReadyTime) {
+    metrics->countReceived(bytes);
+    if (!metrics->sampleHistograms()) {
+        return;
+    }
+    metrics->recordOccupancy(packetCount() + 1);
+    if (knowsReadyTime) {
+        const SimTime now = currentTime();
+        metrics->recordSojourn(now > readyTime ? now - readyTime : 0);
+    }
+}
+
+// Counters are updated once for the burst; the histograms still sample every frame on its own
+void NetworkMedium::countReceivedBatch(const RawPacket* packets, std::size_t count) {
+    std::size_t bytes = 0;
+    for (std::size_t index = 0; index < count; ++index) {
+        bytes += packets[index].data.size();
+    }
+    metrics->countReceived(bytes, count);
+    const std::size_t waiting = packetCount();
+    SimTime now = 0;
+    bool haveNow = false;
+    for (std::size_t index = 0; index < count; ++index) {
+        if (!metrics->sampleHistograms()) {
+            continue;
+        }
+        metrics->recordOccupancy(waiting + count - index);
+        if (!haveNow) {
+            now = currentTime();
+            haveNow = true;
+        }
+        const SimTime readyTime = batchReadyTimes[index];
+        metrics->recordSojourn(now > readyTime ? now - readyTime : 0);
+    }
+}
+
+// Only pays for a fence and a load unless a receiver is actually waiting
+void NetworkMedium::wakeReceivers() {
+    // Pairs with the fence in park() and waitReceive(): either the sender sees the waiter,
+    // or the waiter sees the packet. The Queue backend has no second thread to fence against.
+    if (backend == MediumBackend::SharedMemory) {
+        sharedRing->notify();   // Fences itself, for receivers in other processes
+    } else if (backend != MediumBackend::Queue) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    if (waiters.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    ReceiveAwaiter* ready = nullptr;
+    ReceiveAwaiter* readyLast = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        // Taking the packets under the lock keeps the ring's single receiver single. After a
+        // burst there may be a packet for several parked coroutines.
+        while (parkedFirst != nullptr && tryReceive(parkedFirst->packet)) {
+            ReceiveAwaiter* awaiter = parkedFirst;
+            parkedFirst = awaiter->next;
+            if (parkedFirst == nullptr) {
+                parkedLast = nullptr;
+            }
+            awaiter->next = nullptr;
+            if (readyLast != nullptr) {
+                readyLast->next = awaiter;
+            } else {
+                ready = awaiter;
+            }
+            readyLast = awaiter;
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    packetArrived.notify_all();
+    while (ready != nullptr) {
+        ReceiveAwaiter* next = ready->next;    // The resumed coroutine may destroy the awaiter
+        ready->executor.post(ready->handle);
+        ready = next;
+    }
+}
+
+bool NetworkMedium::park(ReceiveAwaiter& awaiter) {
+    std::lock_guard<std::mutex> lock(waitMutex);
+    waiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // A packet sent before the waiter was counted would not wake anybody; look once more
+    if (parkedFirst == nullptr && tryReceive(awaiter.packet)) {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (parkedLast != nullptr) {
+        parkedLast->next = &awaiter;
+    } else {
+        parkedFirst = &awaiter;
+    }
+    parkedLast = &awaiter;
+    return true;
+}
+
+bool ReceiveAwaiter::await_ready() {
+    return medium.tryReceive(packet);
+}
+
+bool ReceiveAwaiter::await_suspend(std::coroutine_handle<> suspended) {
+    handle = suspended;
+    return medium.park(*this);
+}
+
+// Spin first, since a packet is often only a moment away, then sleep on the condition variable
+bool NetworkMedium::waitReceive(RawPacket& out, std::chrono::nanoseconds timeout) {
+    for (std::uint32_t round = 0; round < spinRounds; ++round) {
+        if (tryReceive(out)) {
+            spinRounds = std::min(spinRounds * 2, MAX_SPIN_ROUNDS);
+            return true;
+        }
+        cpuRelax();
+    }
+    if (tryReceive(out)) {
+        return true;
+    }
+    if (spinRounds > 0) {
+        spinRounds = std::max(spinRounds / 2, MIN_SPIN_ROUNDS);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    if (backend == MediumBackend::SharedMemory) {
+        // The sender may be in another process, which cannot signal the condition variable
+        for (;;) {
+            const auto left = deadline - std::chrono::steady_clock::now();
+            if (left <= std::chrono::nanoseconds(0) || !sharedRing->wait(left)) {
+                return tryReceive(out);
+            }
+            if (tryReceive(out)) {
+                return true;
+            }
+        }
+    }
+    std::unique_lock<std::mutex> lock(waitMutex);
+    waiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool received = tryReceive(out);
+    while (!received) {
+        if (packetArrived.wait_until(lock, deadline) == std::cv_status::timeout) {
+            received = tryReceive(out);
+            break;
+        }
+        received = tryReceive(out);
+    }
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+    return received;
+}
+
+// Lets the impairment stage decide the frame's fate before it goes on the wire
+bool NetworkMedium::transmit(RawPacket& packet, ReceiverId origin, Burst* burst) {
+    if (capture != nullptr && capture->sample()) {
+        capture->record(packet.view(), burst != nullptr ? burst->now : currentTime());
+    }
+    if (metrics) {
+        metrics->countSent(packet.data.size());
+    }
+    if (!impairment) {
+        return putOnWire(packet, origin, 0, true, burst);
+    }
+    return applyVerdict(packet, origin, impairment->judge(packet.data.size(), scheduler ? scheduler->now() : 0), burst);
+}
+
+// A lost frame still counts as sent; a duplicate travels the wire as a frame of its own. Only a
+// frame the medium takes is acted on: a refused one goes back to its sender as it was, with no
+// duplicate sent. Corruption is done on a copy for that reason (and because a frame borrowed
+// from a trace file is read-only).
+bool NetworkMedium::applyVerdict(RawPacket& packet, ReceiverId origin, const ImpairmentVerdict& verdict, Burst* burst) {
+    if (verdict.drop) {
+        countUndelivered(false);
+        return true;    // The sender cannot tell that the wire lost the frame
+    }
+    RawPacket duplicate;
+    if (verdict.duplicate) {
+        duplicate = packet;
+    }
+    if (verdict.corruptBit >= 0) {
+        RawPacket corrupted(packet);
+        flipBit(corrupted, verdict.corruptBit);
+        if (!putOnWire(corrupted, origin, verdict.delay, verdict.keepOrder, burst)) {
+            return false;
+        }
+        packet = RawPacket();   // Taken by the medium, as an uncorrupted frame would have been
+    } else if (!putOnWire(packet, origin, verdict.delay, verdict.keepOrder, burst)) {
+        return false;
+    }
+    if (verdict.duplicate) {
+        if (verdict.corruptBit >= 0) {
+            flipBit(duplicate, verdict.corruptBit);
+        }
+        putOnWire(duplicate, origin, verdict.delay, verdict.keepOrder, burst, false);
+    }
+    return true;
+}
+
+// Without a scheduler the packet arrives at once; otherwise it travels the wire in virtual time
+bool NetworkMedium::putOnWire(RawPacket& packet, ReceiverId origin, SimTime extraDelay, bool keepOrder, Burst* burst,
+                              bool fromSender) {
+    if (queueLimit) {
+        const Admission admission = admitFrame(packet.data.size());
+        if (admission != Admission::Accept) {
+            countUndelivered(fromSender && admission == Admission::Refuse);
+            return admission == Admission::Drop;    // A dropped frame looks sent; a refused one stays with the sender
+        }
+    }
+    if (scheduler == nullptr) {
+        if (burst == nullptr && deliver(packet, origin, currentTime())) {
+            return true;
+        }
+        if (burst != nullptr && deliver(packet, origin, burst->now, false)) {
+            burst->delivered = true;
+            return true;
+        }
+        countUndelivered(fromSender);
+        return false;
+    }
+    // The frame waits until the previous one has been serialized, then takes its own serialization time
+    const SimTime start = std::max(scheduler->now(), wireFreeAt);
+    wireFreeAt = start + serializationDelay(packet.data.size());
+    SimTime arrival = wireFreeAt + timing.propagationDelay + extraDelay;
+    if (keepOrder) {
+        arrival = std::max(arrival, lastArrival);
+        lastArrival = arrival;
+    }
+
+    std::size_t index;
+    if (!freeInFlight.empty()) {
+        index = freeInFlight.back();
+        freeInFlight.pop_back();
+    } else {
+        index = inFlight.size();
+        inFlight.emplace_back();
+    }
+    inFlight[index].packet = std::move(packet);
+    inFlight[index].origin = origin;
+    inFlight[index].readyTime = scheduler->now() + serializationDelay(inFlight[index].packet.data.size()) +
+                                timing.propagationDelay + extraDelay;
+    inFlight[index].next = NO_FRAME;
+    ++inFlightCount;
+    // Events of equal time fire in the order they were scheduled, so chaining the frame to the
+    // previous one of its burst changes nothing but the number of events
+    if (burst != nullptr && burst->last != NO_FRAME && burst->arrival == arrival) {
+        inFlight[burst->last].next = index;
+    } else {
+        scheduler->schedule(arrival, this, index);
+    }
+    if (burst != nullptr) {
+        burst->arrival = arrival;
+        burst->last = index;
+    }
+    return true;
+}
+
+// A frame, and any frames of its burst that arrive together with it, reached the far end of the wire
+void NetworkMedium::onEvent(SimTime, std::uint64_t cookie) {
+    bool delivered = false;
+    for (std::size_t index = cookie; index != NO_FRAME;) {
+        InFlightFrame& frame = inFlight[index];
+        if (deliver(frame.packet, frame.origin, frame.readyTime, false)) {
+            delivered = true;
+        } else {
+            countUndelivered(false);
+        }
+        const std::size_t next = frame.next;
+        frame.packet = RawPacket();
+        frame.next = NO_FRAME;
+        freeInFlight.push_back(index);
+        --inFlightCount;
+        index = next;
+    }
+    if (delivered && backend != MediumBackend::Broadcast) {
+        wakeReceivers();
+    }
+}
+
+void NetworkMedium::attachScheduler(EventScheduler& eventScheduler, const LinkTiming& linkTiming) {
+    scheduler = &eventScheduler;
+    timing = linkTiming;
+    wireFreeAt = eventScheduler.now();
+    lastArrival = eventScheduler.now();
+}
+
+// Starts counting the packets that are already on the medium against the new limit
+void NetworkMedium::setQueueLimit(const QueueLimitConfig& config) {
+    if (backend != MediumBackend::Queue) {
+        throw std::invalid_argument("Queue limits need the Queue backend; ring backends are bounded by their capacity");
+    }
+    if (flowQueue) {
+        throw std::invalid_argument("A medium cannot have both a queue limit and a flow queue; the flow queue has a limit of its own");
+    }
+    if (!queueLimit && !metrics) {
+        stampQueuedFrames();
+    }
+    queueLimit = std::make_unique<QueueLimit>(config);
+    queueLimit->countWaitingFrames(packetQueue.size() + inFlightCount);
+}
+
+void NetworkMedium::clearQueueLimit() {
+    queueLimit.reset();
+}
+
+// emplacePacket() leaves out the ready time while neither a queue limit nor metrics need it
+void NetworkMedium::stampQueuedFrames() {
+    const SimTime now = currentTime();
+    for (std::size_t index = 0; index < packetQueue.size(); ++index) {
+        packetQueue[index].readyTime = now;
+    }
+}
+
+// Enabling them again keeps what was counted so far
+void NetworkMedium::enableMetrics(std::uint32_t histogramSampleEvery) {
+    if (metrics) {
+        metrics->setHistogramSampleEvery(histogramSampleEvery);
+        return;
+    }
+    if (!queueLimit) {
+        stampQueuedFrames();
+    }
+    const bool manySenders = backend == MediumBackend::MpscRing || backend == MediumBackend::SharedMemory;
+    metrics = std::make_unique<MediumMetrics>(manySenders, histogramSampleEvery);
+}
+
+// Head drop may need several of the oldest frames to go before the new one fits
+Admission NetworkMedium::admitFrame(std::size_t bytes) {
+    for (;;) {
+        const Admission admission = queueLimit->admit(bytes, !packetQueue.empty());
+        if (admission != Admission::DropOldest) {
+            return admission;
+        }
+        dropOldest();
+    }
+}
+
+void NetworkMedium::dropOldest() {
+    queueLimit->remove(packetQueue.front().packet.data.size());
+    packetQueue.front().packet = RawPacket();   // Gives the block back now, not when the slot is reused
+    packetQueue.pop_front();
+    if (metrics) {
+        metrics->countDropped();
+    }
+}
+
+// Takes the front packet, unless CoDel decides it has waited too long
+bool NetworkMedium::popLimited(RawPacket& out, SimTime& readyTime) {
+    const bool codel = queueLimit->getConfig().policy == OverflowPolicy::CoDel;
+    while (!packetQueue.empty()) {
+        QueuedFrame& front = packetQueue.front();
+        if (codel) {
+            const SimTime now = currentTime();
+            if (queueLimit->codelDrop(now > front.readyTime ? now - front.readyTime : 0, now)) {
+                dropOldest();
+                continue;
+            }
+        }
+        queueLimit->remove(front.packet.data.size());
+        out.data = std::move(front.packet.data);
+        readyTime = front.readyTime;
+        packetQueue.pop_front();
+        return true;
+    }
+    return false;
+}
+
+// Only CoDel needs the clock
+bool NetworkMedium::popFlow(RawPacket& out, SimTime& readyTime) {
+    const SimTime now = flowQueue->getConfig().policy == FlowPolicy::FqCodel ? currentTime() : 0;
+    std::size_t dropped = 0;
+    const bool found = flowQueue->dequeue(out, readyTime, now, dropped);
+    if (metrics && dropped > 0) {
+        metrics->countDropped(dropped);
+    }
+    return found;
+}
+
+// Frames already waiting enter in arrival order, as if they had just arrived
+void NetworkMedium::setFlowQueue(const FlowQueueConfig& config) {
+    if (backend != MediumBackend::Queue) {
+        throw std::invalid_argument("Flow queues need the Queue backend");
+    }
+    if (queueLimit) {
+        throw std::invalid_argument("A medium cannot have both a queue limit and a flow queue; the flow queue has a limit of its own");
+    }
+    auto replacement = std::make_unique<FlowQueue>(config);
+    if (!metrics) {
+        stampQueuedFrames();
+    }
+    RawPacket packet;
+    SimTime readyTime;
+    while (pop(packet, readyTime)) {
+        replacement->enqueue(packet, readyTime);
+    }
+    flowQueue = std::move(replacement);
+}
+
+// Zero as the time keeps CoDel from dropping on the way out
+void NetworkMedium::clearFlowQueue() {
+    if (!flowQueue) {
+        return;
+    }
+    std::unique_ptr<FlowQueue> previous = std::move(flowQueue);
+    RawPacket packet;
+    SimTime readyTime;
+    std::size_t dropped = 0;
+    while (previous->dequeue(packet, readyTime, 0, dropped)) {
+        QueuedFrame& slot = packetQueue.pushBack();
+        slot.packet.data = std::move(packet.data);
+        slot.readyTime = readyTime;
+    }
+}
+
+SimTime NetworkMedium::currentTime() const {
+    if (scheduler != nullptr) {
+        return scheduler->now();
+    }
+    const auto sinceEpoch = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<SimTime>(std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count());
+}
+
+void NetworkMedium::attachCapture(CaptureTap& tap, const std::string& name) {
+    capture = &tap.addInterface(name);
+}
+
+void NetworkMedium::setImpairment(const ImpairmentConfig& config) {
+    impairment = std::make_unique<LinkImpairment>(config);
+}
+
+void NetworkMedium::clearImpairment() {
+    impairment.reset();
+}
+
+SimTime NetworkMedium::serializationDelay(std::size_t bytes) const {
+    if (timing.bitsPerSecond == 0) {
+        return 0;
+    }
+    const std::uint64_t bits = static_cast<std::uint64_t>(bytes) * 8;
+    return (bits * SECOND + timing.bitsPerSecond - 1) / timing.bitsPerSecond;
+}
+
+// Puts a copy of the packet onto the medium (the copy's buffer comes from the PacketBufferPool)
+bool NetworkMedium::sendPacket(const RawPacket& packet) {
+    NETEMU_TRACE_SCOPE(Medium, "NetworkMedium::sendPacket");
+    RawPacket copy(packet);
+    return transmit(copy, NO_RECEIVER);
+}
+
+// Moves a packet onto the medium; only the vector's internal pointer changes hands
+bool NetworkMedium::sendPacket(RawPacket&& packet) {
+    NETEMU_TRACE_SCOPE(Medium, "NetworkMedium::sendPacket");
+    return transmit(packet, NO_RECEIVER);
+}
+
+// Queue and ring media with nothing between sender and storage take the burst in one piece;
+// everything else sends frame by frame, but still reads the clock and wakes receivers once
+std::size_t NetworkMedium::sendBatch(std::span<RawPacket> packets) {
+    NETEMU_TRACE_SCOPE_FRAMES(Medium, "NetworkMedium::sendBatch", packets.size());
+    if (packets.empty()) {
+        return 0;
+    }
+    Burst burst;
+    burst.now = currentTime();
+    std::size_t sent = 0;
+    const bool plainStorage = backend == MediumBackend::Queue || backend == MediumBackend::SpscRing ||
+                              backend == MediumBackend::MpscRing;
+    if (plainStorage && scheduler == nullptr && !impairment && !queueLimit && !flowQueue && capture == nullptr) {
+        std::size_t bytes = 0;
+        if (metrics) {
+            for (const RawPacket& packet : packets) {
+                bytes += packet.data.size();
+            }
+        }
+        sent = pushBatch(packets, burst.now);
+        if (metrics) {
+            metrics->countSent(bytes, packets.size());
+            metrics->countDelivered(sent);
+            metrics->countRefused(packets.size() - sent);
+        }
+        burst.delivered = sent > 0;
+    } else {
+        while (sent < packets.size() && transmit(packets[sent], NO_RECEIVER, &burst)) {
+            ++sent;
+        }
+        if (sent < packets.size()) {
+            countUnoffered(packets.subspan(sent + 1));
+        }
+    }
+    if (burst.delivered && backend != MediumBackend::Broadcast) {
+        wakeReceivers();
+    }
+    return sent;
+}
+
+// The impairment verdicts are decided for the burst first, then carried out frame by frame.
+// A refused frame's verdict is not acted on (see applyVerdict()). The impairment then goes back
+// to where it was before the burst and judges again only the frames the medium took, which
+// gives them the same verdicts (see LinkImpairment::judgeBatch()). The refused frame and the
+// ones behind it have drawn no random numbers, and are judged once, when they are retried.
+std::size_t NetworkMedium::sendBatch(FrameBatch& batch) {
+    NETEMU_TRACE_SCOPE_FRAMES(Medium, "NetworkMedium::sendBatch", batch.size());
+    if (!impairment || batch.empty()) {
+        return sendBatch(batch.frames());
+    }
+    Burst burst;
+    burst.now = currentTime();
+    const std::size_t count = batch.size();
+    const SimTime judgedAt = scheduler ? scheduler->now() : 0;
+    // Only a queue limit, or a full ring or frame log without a wire, refuses a frame
+    const bool mayRefuse = queueLimit || (scheduler == nullptr && backend != MediumBackend::Queue);
+    if (mayRefuse) {
+        if (impairmentBeforeBurst) {
+            *impairmentBeforeBurst = *impairment;
+        } else {
+            impairmentBeforeBurst = std::make_unique<LinkImpairment>(*impairment);
+        }
+    }
+    impairment->judgeBatch(batch.lengths(), count, judgedAt, batch.verdicts);
+    if (metrics) {
+        metrics->countSent(batch.totalBytes(), count);
+    }
+    std::size_t sent = 0;
+    for (; sent < count; ++sent) {
+        RawPacket& packet = batch.packet(sent);
+        if (capture != nullptr && capture->sample()) {
+            capture->record(packet.view(), burst.now);
+        }
+        if (!applyVerdict(packet, NO_RECEIVER, batch.verdicts.at(sent), &burst)) {
+            break;
+        }
+    }
+    if (mayRefuse && sent < count) {
+        *impairment = *impairmentBeforeBurst;
+        impairment->judgeBatch(batch.lengths(), sent, judgedAt, batch.verdicts);
+    }
+    if (metrics && sent + 1 < count) {
+        metrics->countRefused(count - sent - 1);
+    }
+    if (burst.delivered && backend != MediumBackend::Broadcast) {
+        wakeReceivers();
+    }
+    return sent;
+}
+
+// The packets after the refused one count as sent and refused, as if each had been offered
+void NetworkMedium::countUnoffered(std::span<const RawPacket> packets) {
+    if (!metrics || packets.empty()) {
+        return;
+    }
+    std::size_t bytes = 0;
+    for (const RawPacket& packet : packets) {
+        bytes += packet.data.size();
+    }
+    metrics->countSent(bytes, packets.size());
+    metrics->countRefused(packets.size());
+}
+
+// Delivers a packet that has already travelled its link
+bool NetworkMedium::injectPacket(RawPacket&& packet) {
+    NETEMU_TRACE_SCOPE(Medium, "NetworkMedium::injectPacket");
+    if (capture != nullptr && capture->sample()) {
+        capture->record(packet.view(), currentTime());
+    }
+    if (metrics) {
+        metrics->countSent(packet.data.size());
+    }
+    if (queueLimit) {
+        const Admission admission = admitFrame(packet.data.size());
+        if (admission != Admission::Accept) {
+            countUndelivered(admission == Admission::Refuse);
+            return admission == Admission::Drop;
+        }
+    }
+    if (deliver(packet, NO_RECEIVER, currentTime())) {
+        return true;
+    }
+    countUndelivered(true);
+    return false;
 }
 
 // Takes a packet off the medium and returns it
 RawPacket NetworkMedium::receivePacket() {
-    if (!packetQueue.empty()) {
-        RawPacket packet = packetQueue.front();
-        packetQueue.pop();
-        return packet;
+    // Move the front packet out, so the payload is handed over instead of copied.
+    // An empty packet is returned if no packet is available.
+    RawPacket packet;
+    tryReceive(packet);
+    return packet;
+}
+
+// Takes a packet off the medium into the caller's packet, if there is one
+bool NetworkMedium::tryReceive(RawPacket& out) {
+    NETEMU_TRACE_SCOPE(Medium, "NetworkMedium::tryReceive");
+    if (backend == MediumBackend::Broadcast) {
+        return false;   // Broadcast receivers read through their own cursor
+    }
+    SimTime readyTime;
+    if (!pop(out, readyTime)) {
+        return false;
+    }
+    if (metrics) {
+        countReceived(out.data.size(), readyTime, true);
+    }
+    return true;
+}
+
+// Takes a packet off the medium, or returns nothing if the medium is empty
+std::optional<RawPacket> NetworkMedium::tryReceive() {
+    RawPacket packet;
+    if (!tryReceive(packet)) {
+        return std::nullopt;
     }
-    // Return the empty packet if no packet is available
-    return EMPTY_PACKET;
+    return std::optional<RawPacket>(std::move(packet));
+}
+
+// Moves up to maxCount packets into the caller's vector
+std::size_t NetworkMedium::receiveBatch(std::vector<RawPacket>& out, std::size_t maxCount) {
+    NETEMU_TRACE_SCOPE(Medium, "NetworkMedium::receiveBatch");
+    const bool wholeBurst = backend == MediumBackend::SpscRing || backend == MediumBackend::MpscRing ||
+                            (backend == MediumBackend::Queue && !queueLimit && !flowQueue);
+    if (wholeBurst) {
+        // Room for the whole burst first; what the ring did not fill is cut off again
+        maxCount = std::min(maxCount, packetCount());
+        const std::size_t first = out.size();
+        out.resize(first + maxCount);
+        if (metrics && batchReadyTimes.size() < maxCount) {
+            batchReadyTimes.resize(maxCount);
+        }
+        const std::size_t count = popBatch(out.data() + first, metrics ? batchReadyTimes.data() : nullptr, maxCount);
+        out.resize(first + count);
+        if (metrics && count > 0) {
+            countReceivedBatch(out.data() + first, count);
+        }
+        return count;
+    }
+    std::size_t count = 0;
+    while (count < maxCount) {
+        out.emplace_back();
+        if (!tryReceive(out.back())) {
+            out.pop_back();
+            break;
+        }
+        ++count;
+    }
+    return count;
+}
+
+// The packets go into the batch's own vector, then their lengths are filled in from it
+std::size_t NetworkMedium::receiveBatch(FrameBatch& out, std::size_t maxCount) {
+    NETEMU_TRACE_SCOPE(Medium, "NetworkMedium::receiveBatch");
+    if (backend == MediumBackend::Broadcast) {
+        return 0;
+    }
+    const bool wholeBurst = backend == MediumBackend::SpscRing || backend == MediumBackend::MpscRing ||
+                            (backend == MediumBackend::Queue && !queueLimit && !flowQueue);
+    const std::size_t first = out.size();
+    std::size_t count = 0;
+    if (wholeBurst) {
+        maxCount = std::min(maxCount, packetCount());
+        out.resize(first + maxCount);
+        count = popBatch(out.packets.data() + first, out.timestamps() + first, maxCount);
+        out.resize(first + count);
+        for (std::size_t index = first; index < first + count; ++index) {
+            out.lengths()[index] = static_cast<std::uint32_t>(out.packets[index].data.size());
+        }
+    } else {
+        RawPacket packet;
+        SimTime readyTime;
+        while (count < maxCount && pop(packet, readyTime)) {
+            out.push(std::move(packet), readyTime);
+            ++count;
+        }
+    }
+    if (metrics && count > 0) {
+        if (batchReadyTimes.size() < count) {
+            batchReadyTimes.resize(count);
+        }
+        std::copy(out.timestamps() + first, out.timestamps() + first + count, batchReadyTimes.begin());
+        countReceivedBatch(out.packets.data() + first, count);
+    }
+    return count;
 }
 
 // Checks if there are any packets waiting on the medium
 bool NetworkMedium::hasPackets() const {
-    return !packetQueue.empty();
-}
\ No newline at end of file
+    switch (backend) {
+    case MediumBackend::SpscRing:
+        return !spscRing->empty();
+    case MediumBackend::MpscRing:
+        return !mpscRing->empty();
+    case MediumBackend::Broadcast:
+        return frameLog->size() > 0;
+    case MediumBackend::SharedMemory:
+        return !sharedRing->empty();
+    case MediumBackend::Queue:
+        break;
+    }
+    return flowQueue ? !flowQueue->empty() : !packetQueue.empty();
+}
+
+// Counts the packets waiting on the medium
+std::size_t NetworkMedium::packetCount() const {
+    switch (backend) {
+    case MediumBackend::SpscRing:
+        return spscRing->size();
+    case MediumBackend::MpscRing:
+        return mpscRing->size();
+    case MediumBackend::Broadcast:
+        return frameLog->size();
+    case MediumBackend::SharedMemory:
+        return sharedRing->size();
+    case MediumBackend::Queue:
+        break;
+    }
+    return flowQueue ? flowQueue->size() : packetQueue.size();
+}
+
+// Attaches a receiver to the broadcast bus
+ReceiverId NetworkMedium::attachReceiver() {
+    return frameLog ? frameLog->attach() : NO_RECEIVER;
+}
+
+// Detaches a receiver from the broadcast bus
+void NetworkMedium::detachReceiver(ReceiverId receiver) {
+    if (frameLog) {
+        frameLog->detach(receiver);
+    }
+}
+
+// Broadcasts a frame to everyone on the bus except its sender
+bool NetworkMedium::sendPacketFrom(ReceiverId sender, RawPacket&& packet) {
+    NETEMU_TRACE_SCOPE(Medium, "NetworkMedium::sendPacketFrom");
+    return transmit(packet, sender);
+}
+
+// Hands a receiver its next frame from the frame log
+bool NetworkMedium::tryReceive(ReceiverId receiver, SharedPacket& out) {
+    if (!frameLog || !frameLog->next(receiver, out)) {
+        return false;
+    }
+    if (metrics) {
+        countReceived(out->data.size(), 0, false);     // The frame log keeps no arrival times
+    }
+    return true;
+}
+
+// Hands a receiver a burst of frames from the frame log
+std::size_t NetworkMedium::receiveBatch(ReceiverId receiver, std::vector<SharedPacket>& out, std::size_t maxCount) {
+    NETEMU_TRACE_SCOPE(Medium, "NetworkMedium::receiveBatch");
+    std::size_t count = 0;
+    SharedPacket packet;
+    while (count < maxCount && tryReceive(receiver, packet)) {
+        out.push_back(std::move(packet));
+        ++count;
+    }
+    return count;
+}
+
+// Checks if a receiver has unread frames
+bool NetworkMedium::hasPackets(ReceiverId receiver) const {
+    return frameLog && frameLog->hasUnread(receiver);
+}
+
+// Layout: backend, waiting frames, wire, impairment, queue limit, flow queue
+void NetworkMedium::saveState(CheckpointWriter& writer) const {
+    if (backend == MediumBackend::SharedMemory) {
+        throw std::runtime_error("A SharedMemory medium cannot be checkpointed: its frames are shared with other processes");
+    }
+    if (parkedFirst != nullptr || waiters.load(std::memory_order_acquire) != 0) {
+        throw std::runtime_error("A medium cannot be checkpointed while receivers are waiting on it");
+    }
+    writer.put(static_cast<std::uint32_t>(backend));
+
+    auto saveFrame = [&writer](const QueuedFrame& frame) {
+        writer.put(frame.readyTime);
+        writer.putBytes(frame.packet.view());
+    };
+    if (backend == MediumBackend::Broadcast) {
+        frameLog->saveState(writer);
+    } else {
+        writer.put<std::uint64_t>(backend == MediumBackend::Queue ? packetQueue.size() : packetCount());
+        if (backend == MediumBackend::Queue) {
+            for (std::size_t index = 0; index < packetQueue.size(); ++index) {
+                saveFrame(packetQueue[index]);
+            }
+        } else if (backend == MediumBackend::SpscRing) {
+            spscRing->forEach(saveFrame);
+        } else {
+            mpscRing->forEach(saveFrame);
+        }
+    }
+
+    // Free entries are written too, so the event cookies, which are indices, stay valid
+    writer.put(wireFreeAt);
+    writer.put(lastArrival);
+    writer.put<std::uint64_t>(inFlightCount);
+    writer.put<std::uint64_t>(inFlight.size());
+    for (const InFlightFrame& frame : inFlight) {
+        writer.put<std::uint64_t>(frame.origin);
+        writer.put(frame.readyTime);
+        writer.put<std::uint64_t>(frame.next);
+        writer.putBytes(frame.packet.view());
+    }
+    writer.putArray(freeInFlight.data(), freeInFlight.size());
+
+    writer.put(impairment != nullptr);
+    if (impairment) {
+        writer.put(impairment->getConfig());
+        impairment->saveState(writer);
+    }
+    writer.put(queueLimit != nullptr);
+    if (queueLimit) {
+        writer.put(queueLimit->getConfig());
+        queueLimit->saveState(writer);
+    }
+    writer.put(flowQueue != nullptr);
+    if (flowQueue) {
+        writer.put(flowQueue->getConfig());
+        flowQueue->saveState(writer);
+    }
+}
+
+// Whatever the medium held before is dropped. The whole section is read and checked first, so
+// a checkpoint that does not fit this medium leaves it as it was.
+void NetworkMedium::restoreState(CheckpointReader& reader) {
+    if (reader.get<std::uint32_t>() != static_cast<std::uint32_t>(backend)) {
+        throw std::runtime_error("Checkpoint section '" + reader.getName() + "' was saved from a medium of another backend");
+    }
+
+    std::unique_ptr<FrameLog> restoredLog;
+    std::vector<std::pair<SimTime, PacketView>> queued;    // The bytes stay in the reader
+    if (backend == MediumBackend::Broadcast) {
+        restoredLog = std::make_unique<FrameLog>();
+        restoredLog->restoreState(reader);
+    } else {
+        const std::uint64_t count = reader.get<std::uint64_t>();
+        if (backend != MediumBackend::Queue && count > (backend == MediumBackend::SpscRing ? spscRing->capacity() : mpscRing->capacity())) {
+            throw std::runtime_error("Checkpoint section '" + reader.getName() + "' holds more frames than the ring has room for");
+        }
+        for (std::uint64_t index = 0; index < count; ++index) {
+            const SimTime frameReadyTime = reader.get<SimTime>();
+            queued.emplace_back(frameReadyTime, reader.getBytes());
+        }
+    }
+
+    const SimTime restoredWireFreeAt = reader.get<SimTime>();
+    const SimTime restoredLastArrival = reader.get<SimTime>();
+    const std::uint64_t liveCount = reader.get<std::uint64_t>();
+    const std::uint64_t slotCount = reader.get<std::uint64_t>();
+    std::vector<InFlightFrame> restoredInFlight;
+    for (std::uint64_t index = 0; index < slotCount; ++index) {
+        InFlightFrame& frame = restoredInFlight.emplace_back();
+        frame.origin = static_cast<ReceiverId>(reader.get<std::uint64_t>());
+        reader.get(frame.readyTime);
+        frame.next = static_cast<std::size_t>(reader.get<std::uint64_t>());
+        const PacketView bytes = reader.getBytes();
+        frame.packet = RawPacket(bytes.data(), bytes.size());
+    }
+    std::vector<std::size_t> restoredFree;
+    reader.getArray(restoredFree);
+    checkInFlight(reader, restoredInFlight, restoredFree, liveCount);
+    if (liveCount > 0 && scheduler == nullptr) {
+        throw std::runtime_error("Checkpoint section '" + reader.getName() + "' has frames on the wire, but the medium has no scheduler");
+    }
+
+    std::unique_ptr<LinkImpairment> restoredImpairment;
+    if (reader.get<bool>()) {
+        restoredImpairment = std::make_unique<LinkImpairment>(reader.get<ImpairmentConfig>());
+        restoredImpairment->restoreState(reader);
+    }
+    std::unique_ptr<QueueLimit> restoredQueueLimit;
+    if (reader.get<bool>()) {
+        restoredQueueLimit = std::make_unique<QueueLimit>(reader.get<QueueLimitConfig>());
+        restoredQueueLimit->restoreState(reader);
+    }
+    std::unique_ptr<FlowQueue> restoredFlowQueue;
+    if (reader.get<bool>()) {
+        restoredFlowQueue = std::make_unique<FlowQueue>(reader.get<FlowQueueConfig>());
+        restoredFlowQueue->restoreState(reader);
+    }
+
+    // Nothing below can fail
+    flowQueue.reset();
+    queueLimit.reset();
+    if (backend == MediumBackend::Broadcast) {
+        frameLog = std::move(restoredLog);
+    } else {
+        if (backend == MediumBackend::Queue) {
+            while (!packetQueue.empty()) {
+                packetQueue.front().packet = RawPacket();
+                packetQueue.pop_front();
+            }
+        } else {
+            RawPacket discarded;
+            SimTime readyTime;
+            while (pop(discarded, readyTime)) {
+            }
+        }
+        for (const auto& [frameReadyTime, bytes] : queued) {
+            RawPacket packet(bytes.data(), bytes.size());
+            push(packet, frameReadyTime);
+        }
+    }
+    wireFreeAt = restoredWireFreeAt;
+    lastArrival = restoredLastArrival;
+    inFlightCount = static_cast<std::size_t>(liveCount);
+    inFlight = std::move(restoredInFlight);
+    freeInFlight = std::move(restoredFree);
+    impairment = std::move(restoredImpairment);
+    queueLimit = std::move(restoredQueueLimit);
+    flowQueue = std::move(restoredFlowQueue);
+}
+
+// The free list and the burst chains must index entries of 'frames', every entry must be either
+// free or on the wire, and every burst chain must start at a frame no other one points to, so
+// that onEvent() neither reads past the table nor follows a chain round in a circle.
+void NetworkMedium::checkInFlight(const CheckpointReader& reader, const std::vector<InFlightFrame>& frames,
+                                  const std::vector<std::size_t>& free, std::uint64_t liveCount) {
+    auto damaged = [&reader]() {
+        return std::runtime_error("Checkpoint section '" + reader.getName() + "' has a damaged table of frames on the wire");
+    };
+    std::vector<std::uint8_t> isFree(frames.size(), 0);
+    for (const std::size_t index : free) {
+        if (index >= frames.size() || isFree[index]) {
+            throw damaged();
+        }
+        isFree[index] = 1;
+    }
+    if (liveCount != frames.size() - free.size()) {
+        throw damaged();
+    }
+    std::vector<std::uint8_t> pointedTo(frames.size(), 0);
+    for (std::size_t index = 0; index < frames.size(); ++index) {
+        const std::size_t next = frames[index].next;
+        if (next == NO_FRAME) {
+            continue;
+        }
+        if (isFree[index] || next >= frames.size() || isFree[next] || pointedTo[next]) {
+            throw damaged();
+        }
+        pointedTo[next] = 1;
+    }
+    std::uint64_t reached = 0;
+    for (std::size_t index = 0; index < frames.size(); ++index) {
+        if (isFree[index] || pointedTo[index]) {
+            continue;
+        }
+        for (std::size_t frame = index; frame != NO_FRAME; frame = frames[frame].next) {
+            ++reached;
+        }
+    }
+    if (reached != liveCount) {
+        throw damaged();    // The frames not reached form a circle
+    }
+}
@@ -2,37 +2,470 @@
 #define NETWORK_MEDIUM_H    // If the header file is not defined then only define it for use.
 
 // Including the necessary header files
+#include "RawPacket.h"
+#include "FrameLog.h"
+#include "PacketRing.h"
+#include "EventScheduler.h"
+#include "LinkImpairment.h"
+#include "QueueLimit.h"
+#include "FlowQueue.h"
+#include "Executor.h"
+#include "PacketCapture.h"
+#include "Metrics.h"
+#include "SharedFrameRing.h"
+#include "FrameBatch.h"
 #include <vector>
-#include <queue>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+
+// How a NetworkMedium stores the packets that are in transit.
+enum class MediumBackend {
+    Queue,      // UnboundedRing, unbounded unless a queue limit is set; single-threaded use only (the original behaviour).
+    SpscRing,   // Bounded lock-free ring for one sending and one receiving thread (point-to-point links).
+    MpscRing,   // Bounded lock-free ring for many sending threads and one receiving thread (the shared bus).
+    Broadcast,  // Unbounded frame log, every attached receiver gets every frame; single-threaded use only.
+    SharedMemory,   // SharedFrameRing in a named segment, for senders and receivers in any threads and processes.
+};
+
+// Timing of the wire, used once a medium is attached to an EventScheduler.
+struct LinkTiming {
+    std::uint64_t bitsPerSecond = 0;    // Line rate; 0 means frames take no time to put on the wire.
+    SimTime propagationDelay = 0;       // Time a bit needs to travel from sender to receiver.
+};
+
+class NetworkMedium;
+class CheckpointWriter;
+class CheckpointReader;
 
 /*
-RawPacket is a simple container for raw bytes.
-It is the basic unit of data that the NetworkMedium can transport.
+ReceiveAwaiter is what 'co_await medium.receive(executor)' waits on. If a packet is waiting
+the coroutine does not suspend at all; otherwise it is parked on the medium, and the sender
+whose packet arrives next hands the packet and the coroutine to the executor.
 */
-class RawPacket{
+class ReceiveAwaiter{
 public:
-    std::vector<char> data; //Sequence of data that will travel on the network medium.
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> handle);
+    RawPacket await_resume() { return std::move(packet); }
+
+private:
+    friend class NetworkMedium;
+
+    ReceiveAwaiter(NetworkMedium& medium, Executor& executor) : medium(medium), executor(executor) {}
+
+    NetworkMedium& medium;
+    Executor& executor;
+    std::coroutine_handle<> handle;
+    RawPacket packet;
+    ReceiveAwaiter* next = nullptr;     // Next parked coroutine on the same medium.
 };
 
 /*
 The NetworkMedium class simulates a shared physical communication channel where all nodes can send and receive RawPackets.
-*/
+The backend is chosen per medium when it is created; all backends deliver packets in FIFO order.
 
-// Used by receivePacket() to signal that no packet was available.
+With the Queue and ring backends each packet is delivered once, to whoever receives it first.
+The Broadcast backend behaves like a real bus instead: receivers attach to the medium and
+every frame sent is delivered to each of them, as a SharedPacket that is stored only once.
 
-class NetworkMedium{
+By default a sent packet can be received immediately. After attachScheduler() the medium
+works in virtual time instead: a frame only becomes visible to receivers once the scheduler's
+clock reaches send time + serialization delay + propagation delay.
+*/
+class NetworkMedium : private EventTarget{
 private:
-    std::queue<RawPacket> packetQueue;  // Packets are added to the back and removed from the front.
+    // A packet waiting for its receiver, with the time it would have arrived over an idle wire
+    // (for CoDel and the sojourn histogram).
+    struct QueuedFrame {
+        RawPacket packet;
+        SimTime readyTime = 0;
+    };
+
+    MediumBackend backend;
+    UnboundedRing<QueuedFrame> packetQueue;    // Packets are added to the back and removed from the front (Queue backend).
+    std::unique_ptr<SpscRing<QueuedFrame>> spscRing;    // Used by the SpscRing backend.
+    std::unique_ptr<MpscRing<QueuedFrame>> mpscRing;    // Used by the MpscRing backend.
+    std::unique_ptr<FrameLog> frameLog;             // Used by the Broadcast backend.
+    std::unique_ptr<SharedFrameRing> sharedRing;    // Used by the SharedMemory backend.
+
+    // Virtual time support (see attachScheduler()).
+    static constexpr std::size_t NO_FRAME = static_cast<std::size_t>(-1);
+    struct InFlightFrame {
+        RawPacket packet;
+        ReceiverId origin = NO_RECEIVER;
+        SimTime readyTime = 0;          // When it would have arrived over an idle wire (for CoDel).
+        std::size_t next = NO_FRAME;    // Next frame of a burst that arrives with the same event.
+    };
+    EventScheduler* scheduler = nullptr;
+    LinkTiming timing;
+    SimTime wireFreeAt = 0;                 // When the sender side of the wire is idle again.
+    SimTime lastArrival = 0;                // Arrival time of the latest in-order frame.
+    std::vector<InFlightFrame> inFlight;    // Frames on the wire; the event cookie is the index.
+    std::vector<std::size_t> freeInFlight;  // Unused entries of 'inFlight'.
+    std::size_t inFlightCount = 0;
+
+    // Moves 'packet' into the backend; on failure (full ring) the packet stays with the caller.
+    bool push(RawPacket& packet, SimTime readyTime);
+
+    // Moves as many of 'packets' as fit into the Queue or ring backend, in order, and returns how many did.
+    std::size_t pushBatch(std::span<RawPacket> packets, SimTime readyTime);
+
+    // Moves up to 'maxCount' packets from the Queue or ring backend to 'out' (ready times
+    // to 'readyTimes' when it is not null) and returns how many were moved.
+    std::size_t popBatch(RawPacket* out, SimTime* readyTimes, std::size_t maxCount);
+
+    // What a sendBatch() call has done so far, so that its fixed costs are paid once per burst.
+    struct Burst {
+        SimTime now = 0;                // The clock, read once for the whole burst.
+        SimTime arrival = 0;            // Arrival time of the burst's latest frame in virtual time,
+        std::size_t last = NO_FRAME;    // and its entry in 'inFlight'.
+        bool delivered = false;         // A frame was stored at once; receivers still need waking.
+    };
+
+    // Takes the next packet off the Queue or ring backend, with its ready time.
+    bool pop(RawPacket& out, SimTime& readyTime);
+
+    // Hands a packet to the backend, as sent by 'origin' (Broadcast backend only). 'readyTime'
+    // is when it would have arrived had it not been queued anywhere.
+    // Receivers are not woken without 'wake'; the caller does that once it has delivered a burst.
+    bool deliver(RawPacket& packet, ReceiverId origin, SimTime readyTime, bool wake = true);
+
+    // Optional bound on the packets buffered by the Queue backend (see setQueueLimit()).
+    std::unique_ptr<QueueLimit> queueLimit;
+
+    // Asks the queue limit whether a frame of 'bytes' bytes may enter, dropping the oldest
+    // waiting frames if the policy says so. Never returns Admission::DropOldest.
+    Admission admitFrame(std::size_t bytes);
+
+    // Removes the packet at the front of a limited queue without delivering it.
+    void dropOldest();
+
+    // Takes the next packet off a limited queue, letting CoDel drop the ones that waited too long.
+    bool popLimited(RawPacket& out, SimTime& readyTime);
+
+    // Optional scheduler stage that the Queue backend's frames wait in (see setFlowQueue()).
+    std::unique_ptr<FlowQueue> flowQueue;
+
+    // Takes the next packet the flow queue picks, counting the frames its CoDel dropped.
+    bool popFlow(RawPacket& out, SimTime& readyTime);
+
+    // Gives the packets already queued a ready time, once something starts reading them.
+    void stampQueuedFrames();
+
+    // The scheduler's time, or the steady clock in nanoseconds without a scheduler.
+    SimTime currentTime() const;
+
+    // Blocking and asynchronous receivers (see waitReceive() and receive()). Senders only
+    // take the mutex when 'waiters' says that somebody is actually waiting.
+    friend class ReceiveAwaiter;
+    std::atomic<std::size_t> waiters{0};
+    std::mutex waitMutex;
+    std::condition_variable packetArrived;
+    ReceiveAwaiter* parkedFirst = nullptr;  // Coroutines waiting for a packet, oldest first.
+    ReceiveAwaiter* parkedLast = nullptr;
+    std::uint32_t spinRounds;               // Adapted by waitReceive() to how long waits usually take.
+
+    // Called after a packet was stored: wakes waiting threads and hands the packet to the
+    // oldest parked coroutine, if any.
+    void wakeReceivers();
+
+    // Parks a coroutine unless a packet arrived in the meantime; returns false in that case.
+    bool park(ReceiveAwaiter& awaiter);
+
+    // Optional impairment stage between sending and delivery (see setImpairment()).
+    std::unique_ptr<LinkImpairment> impairment;
+    // A copy of it taken before a burst that may be refused part way (see sendBatch(FrameBatch&)).
+    std::unique_ptr<LinkImpairment> impairmentBeforeBurst;
+
+    // Optional capture point that records every frame sent or injected (see attachCapture()).
+    CaptureInterface* capture = nullptr;
+
+    // Optional counters and histograms (see enableMetrics()).
+    std::unique_ptr<MediumMetrics> metrics;
+
+    // Counts a frame the backend did not take: lost if it was on the wire, refused if its sender still has it.
+    void countUndelivered(bool senderKeepsIt);
+
+    // Counts a received frame and, when sampled, its wait and the frames still waiting.
+    void countReceived(std::size_t bytes, SimTime readyTime, bool knowsReadyTime);
+
+    // The same for a burst received by receiveBatch(), whose ready times are in 'batchReadyTimes'.
+    void countReceivedBatch(const RawPacket* packets, std::size_t count);
+    std::vector<SimTime> batchReadyTimes;
+
+    // Runs a sent packet through the impairment stage (if any) and puts it on the wire, as part
+    // of 'burst' if it is not null.
+    bool transmit(RawPacket& packet, ReceiverId origin, Burst* burst = nullptr);
+
+    // Carries out the impairment stage's verdict on a sent packet.
+    bool applyVerdict(RawPacket& packet, ReceiverId origin, const ImpairmentVerdict& verdict, Burst* burst);
+
+    // Counts the packets of a burst after the refused one, which were never offered.
+    void countUnoffered(std::span<const RawPacket> packets);
+
+    // Delivers a packet now, or schedules its arrival in virtual time 'extraDelay' later than
+    // the wire alone would. With 'keepOrder' it never arrives before an earlier in-order frame.
+    // A frame of a burst that arrives at the same time as the one before it shares its event.
+    // A frame not 'fromSender' (a duplicate the impairment made) counts as dropped if refused.
+    bool putOnWire(RawPacket& packet, ReceiverId origin, SimTime extraDelay, bool keepOrder, Burst* burst,
+                   bool fromSender = true);
+
+    // Called by the scheduler when an in-flight frame arrives.
+    void onEvent(SimTime now, std::uint64_t cookie) override;
+
+    // Throws std::runtime_error unless a restored table of frames on the wire is consistent.
+    static void checkInFlight(const CheckpointReader& reader, const std::vector<InFlightFrame>& frames,
+                              const std::vector<std::size_t>& free, std::uint64_t liveCount);
 
 public:
-    // Puts a packet onto the medium (adds to the queue).
-    void sendPacket(const RawPacket& packet);
+    // Number of packets a ring backend holds when no capacity is given.
+    static constexpr std::size_t DEFAULT_RING_CAPACITY = 4096;
+
+    // Creates a medium using the given backend. 'ringCapacity' is rounded up to a power of two
+    // and is ignored by the unbounded Queue backend. Throws std::invalid_argument for the
+    // SharedMemory backend, which needs a segment name.
+    explicit NetworkMedium(MediumBackend backend = MediumBackend::Queue,
+                           std::size_t ringCapacity = DEFAULT_RING_CAPACITY);
+
+    // Creates a SharedMemory medium on the existing segment 'segmentName' (see
+    // SharedFrameRing::create()). Every process that opens a medium on the same segment sends
+    // into and receives from the same ring. Frames are copied into the segment and out of it,
+    // and frames longer than its slots are refused. Throws std::runtime_error if the segment
+    // cannot be mapped.
+    explicit NetworkMedium(const std::string& segmentName);
+
+    MediumBackend getBackend() const { return backend; }
+
+    // Makes the medium run in the scheduler's virtual time with the given wire timing.
+    // Frames sent from now on are held on the wire and delivered by scheduler events, which
+    // make them receivable at send time + serialization delay + propagation delay. A new
+    // frame starts serializing only when the previous one has left the sender.
+    // The scheduler must outlive the medium (or the frames it still carries).
+    void attachScheduler(EventScheduler& eventScheduler, const LinkTiming& linkTiming);
+
+    // Time needed to put 'bytes' bytes on the wire at the configured line rate.
+    SimTime serializationDelay(std::size_t bytes) const;
+
+    // Makes the medium imperfect: every frame sent from now on is subject to the configured
+    // latency, jitter, bandwidth cap, loss, duplication, reordering and corruption.
+    // Time-based effects need attachScheduler(); without it they are ignored.
+    void setImpairment(const ImpairmentConfig& config);
+
+    // Turns the medium back into a perfectly reliable wire.
+    void clearImpairment();
+
+    // The impairment stage, or nullptr if none is set (e.g. to read its counters).
+    const LinkImpairment* getImpairment() const { return impairment.get(); }
+
+    // Number of frames sent but not yet arrived (always 0 without a scheduler).
+    std::size_t framesInFlight() const { return inFlightCount; }
+
+    // Bounds the buffer of the medium to a number of frames and/or bytes, with the given
+    // overflow policy. Every frame the medium holds counts against the limit from the moment
+    // it is sent until it is received, including the time it spends on the wire in virtual
+    // time. With OverflowPolicy::Backpressure a frame that does not fit is refused and the
+    // send functions return false, leaving the frame with the caller.
+    // Only the Queue backend supports this (the rings are bounded by their ring capacity);
+    // throws std::invalid_argument for other backends or while a flow queue is set.
+    void setQueueLimit(const QueueLimitConfig& config);
+
+    // Makes the Queue backend unbounded again.
+    void clearQueueLimit();
+
+    // The queue limit, or nullptr if none is set (e.g. to read its drop counters and high-water marks).
+    const QueueLimit* getQueueLimit() const { return queueLimit.get(); }
+
+    // Makes the frames waiting to be received wait per flow, and be received in the order the
+    // flow queue's policy picks (fair queueing, FQ-CoDel or strict priority) rather than in
+    // arrival order, so a heavy flow no longer delays every other flow behind it. Frames already
+    // waiting move into the flow queue. The flow queue bounds the buffer itself ('maxFrames'),
+    // so it cannot be combined with a queue limit. receiveBatch() then takes frame by frame.
+    // Only the Queue backend supports this; throws std::invalid_argument for other backends
+    // or while a queue limit is set.
+    void setFlowQueue(const FlowQueueConfig& config);
+
+    // Goes back to a single FIFO; the waiting frames keep the order the flow queue would have
+    // given them.
+    void clearFlowQueue();
+
+    // The flow queue, or nullptr if none is set (e.g. to read its counters).
+    const FlowQueue* getFlowQueue() const { return flowQueue.get(); }
+
+    // Records every frame sent into (or injected into) the medium from now on in the tap's
+    // capture file, as the interface 'name', with the medium's current time (virtual time
+    // once a scheduler is attached). Frames are recorded as the sender hands them over,
+    // before any impairment. The tap must outlive the medium or detachCapture().
+    void attachCapture(CaptureTap& tap, const std::string& name);
+
+    // Stops recording frames.
+    void detachCapture() { capture = nullptr; }
+
+    // The capture point, or nullptr if the medium is not captured.
+    const CaptureInterface* getCapture() const { return capture; }
+
+    // Starts counting the frames and bytes sent, refused, dropped, delivered and received, and
+    // recording a histogram of the frames waiting and one of the sojourn time (see
+    // MediumMetrics), for one received frame in 'histogramSampleEvery'. Costs a few nanoseconds
+    // per frame; a medium without metrics only checks a pointer. Frames already queued count
+    // as arriving now. Call before the medium is used from several threads. On a medium that
+    // has metrics already, only changes the sampling ratio: the counts and histograms stay.
+    void enableMetrics(std::uint32_t histogramSampleEvery = 1);
+
+    // Stops counting; the counts so far are lost.
+    void disableMetrics() { metrics.reset(); }
+
+    // The metrics, or nullptr if they are not enabled.
+    const MediumMetrics* getMetrics() const { return metrics.get(); }
+
+    // Puts a packet onto the medium (adds to the queue). The packet's bytes are copied.
+    // Returns false if a ring backend is full, or a queue limit with OverflowPolicy::Backpressure
+    // is reached, and the packet was not accepted. (In virtual time the wire always accepts a
+    // frame; it is lost if the ring is full when it arrives.)
+    bool sendPacket(const RawPacket& packet);
+
+    // Puts a packet onto the medium by moving it in. The caller's packet is left empty,
+    // and the payload buffer itself travels through the medium without being copied.
+    // Returns false if a ring backend is full; the packet is then left untouched.
+    // With the Broadcast backend, returns false if no receiver is attached (the frame is lost).
+    bool sendPacket(RawPacket&& packet);
+
+    // Sends a burst of packets in order, as sendPacket(RawPacket&&) would one by one, and returns
+    // how many the medium accepted. Sending stops at the first packet that is refused: that packet
+    // and the ones after it stay with the caller, and count as refused in the metrics. The fixed
+    // costs of a send are paid once per burst rather than once per frame: the clock is read once,
+    // a ring claims the slots of the whole burst with one atomic update, receivers are woken once,
+    // the metrics are updated once, and in virtual time the frames that arrive at the same time
+    // share one scheduler event. Bursts of 32 to 256 frames amortize well.
+    std::size_t sendBatch(std::span<RawPacket> packets);
+
+    // Like sendBatch(span), for the frames of a FrameBatch. The impairment stage judges the
+    // whole burst at once from the length column, into the batch's verdict columns (see
+    // LinkImpairment::judgeBatch()), and the metrics take their byte count from the length
+    // column. Drop marks are not looked at; compact() the batch first to leave frames out.
+    // If a frame is refused, the impairment ends up as if the burst had ended just before that
+    // frame, and the verdict columns are cut down to the frames taken: the refused frame and
+    // the ones after it have not been judged, so retrying them judges each exactly once.
+    std::size_t sendBatch(FrameBatch& batch);
+
+    // Hands a packet straight to the receivers, as if it had just arrived at the far end of
+    // the wire: no serialization, propagation delay or impairment is applied. Used by links
+    // that model the journey themselves (for example a CrossShardLink).
+    bool injectPacket(RawPacket&& packet);
+
+    // Builds a packet from the given constructor arguments (for example a PacketBuffer&&,
+    // or a pointer and a length) directly inside the medium. With a ring backend the packet
+    // is built first and then moved into its slot, which still never copies the payload.
+    // Returns false if a ring backend is full.
+    template <typename... Args>
+    bool emplacePacket(Args&&... args) {
+        if (backend == MediumBackend::Queue && scheduler == nullptr && !impairment && !queueLimit && !flowQueue &&
+            capture == nullptr && !metrics) {
+            packetQueue.push_back(QueuedFrame{RawPacket(std::forward<Args>(args)...), 0});
+            wakeReceivers();
+            return true;
+        }
+        RawPacket packet(std::forward<Args>(args)...);
+        return transmit(packet, NO_RECEIVER);
+    }
 
     // Takes a packet off the medium (removes from the queue) and returns it.
+    // The packet is moved out of the queue, so its bytes are never copied.
+    // Returns an empty packet if nothing was waiting; prefer tryReceive() when
+    // "no packet" has to be told apart from "a packet with an empty payload".
     RawPacket receivePacket();
 
+    // Takes the next packet off the medium into 'out' and returns true, or returns false
+    // (leaving 'out' untouched) if the medium is empty. The old buffer of 'out' goes back
+    // to the PacketBufferPool and is reused for later sends, so polling in a loop does not allocate.
+    bool tryReceive(RawPacket& out);
+
+    // Same as tryReceive(RawPacket&), but returns the packet or std::nullopt.
+    std::optional<RawPacket> tryReceive();
+
+    // Moves up to 'maxCount' waiting packets to the back of 'out' and returns how many were moved.
+    // Draining a burst in one call avoids paying the per-call cost for every frame: a ring
+    // updates its index once for the whole burst and the metrics are updated once.
+    std::size_t receiveBatch(std::vector<RawPacket>& out, std::size_t maxCount);
+
+    // Appends up to 'maxCount' waiting packets to 'out', with their lengths, and ready times as
+    // timestamps (when the medium keeps them, see enableMetrics()), and returns how many were added.
+    std::size_t receiveBatch(FrameBatch& out, std::size_t maxCount);
+
     // Checks if there are any packets waiting on the medium.
     bool hasPackets() const;
+
+    // Like tryReceive(), but waits up to 'timeout' for a packet to arrive. The receiver first
+    // spins on the medium for a short while (a round count adapted to how long recent waits
+    // took, none on a single-core machine), then sleeps until a sender wakes it up, so an
+    // idle receiver does not burn a core. Returns false if the time ran out.
+    // Meant for the ring backends, whose senders run on other threads. On a SharedMemory
+    // medium the receiver sleeps on the segment's doorbell, so senders in other processes wake it.
+    bool waitReceive(RawPacket& out, std::chrono::nanoseconds timeout);
+
+    // 'RawPacket packet = co_await medium.receive(executor);' receives without blocking a
+    // thread: a coroutine that finds the medium empty is suspended and continues on 'executor'
+    // once a packet has arrived for it. Waiting coroutines get packets in the order they
+    // started waiting. Queue and ring backends only; a ring has a single receiver, so only
+    // one coroutine or thread may receive from it at a time. On a SharedMemory medium only
+    // senders in the same process hand packets to parked coroutines; use waitReceive() to
+    // wait for other processes.
+    ReceiveAwaiter receive(Executor& executor = InlineExecutor::instance()) { return ReceiveAwaiter(*this, executor); }
+
+    // --- Broadcast backend ---
+    // The receive functions above return nothing on a Broadcast medium; receivers use the
+    // functions below with the id they got from attachReceiver().
+
+    // Attaches a new receiver to the bus. It receives every frame sent from now on.
+    ReceiverId attachReceiver();
+
+    // Detaches a receiver; frames it had not read yet no longer wait for it.
+    void detachReceiver(ReceiverId receiver);
+
+    // Broadcasts a frame sent by the attached receiver 'sender', which does not receive it back.
+    // Returns false if no other receiver is attached.
+    bool sendPacketFrom(ReceiverId sender, RawPacket&& packet);
+
+    // Hands 'receiver' its next frame. The frame is shared with all other receivers, not copied.
+    bool tryReceive(ReceiverId receiver, SharedPacket& out);
+
+    // Appends up to 'maxCount' unread frames of 'receiver' to 'out' and returns how many were added.
+    std::size_t receiveBatch(ReceiverId receiver, std::vector<SharedPacket>& out, std::size_t maxCount);
+
+    // Checks if 'receiver' has frames it has not read yet.
+    bool hasPackets(ReceiverId receiver) const;
+
+    // Number of packets waiting on the medium (a snapshot for the ring backends). For the
+    // Broadcast backend this is the number of frames not yet read by every receiver.
+    std::size_t packetCount() const;
+
+    // --- Checkpoints ---
+
+    // Writes the frames waiting on the medium and on its wire, the wire's timing state, and the
+    // impairment and queue limit with their state to a checkpoint. Metrics and capture are not
+    // part of it. The medium must be quiescent: no thread sends or receives while it is saved.
+    // Throws std::runtime_error for a SharedMemory medium, whose frames other processes share,
+    // and while a receiver is parked on the medium.
+    void saveState(CheckpointWriter& writer) const;
+
+    // Replaces the frames, wire state, impairment and queue limit with those of a checkpoint
+    // written by saveState() for a medium of the same backend, attached to a scheduler if frames
+    // were on the wire. The frames' bytes are copied out of the checkpoint. The scheduler events
+    // of the frames on the wire come back with the scheduler (see EventScheduler::restoreState()).
+    // Throws std::runtime_error, leaving the medium as it was, if the section does not fit this
+    // medium or its table of frames on the wire is inconsistent.
+    void restoreState(CheckpointReader& reader);
+
+    // The target of the medium's scheduler events, for code that has to name them in a checkpoint.
+    EventTarget* eventTarget() { return this; }
 };
 
 
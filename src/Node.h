@@ -0,0 +1,45 @@
+#ifndef NODE_H    // This will ensure no repeat definition of this header file.
+#define NODE_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include <string>
+#include <utility>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+/*
+Node is the base class of every device connected to the emulated network (see DESIGN.md,
+section 4). A concrete node sends and receives through the NetworkMedium objects it was
+given, and reacts to time through the EventScheduler: it schedules events for itself and
+is called back through onEvent().
+*/
+class Node : public EventTarget{
+public:
+    explicit Node(std::string name) : name(std::move(name)) {}
+
+    const std::string& getName() const { return name; }
+
+    // Called once before the emulation starts running, on the thread that will run the node.
+    // This is where a node schedules its first events.
+    virtual void start(EventScheduler& scheduler) { (void)scheduler; }
+
+    // Called for every event the node scheduled for itself.
+    void onEvent(SimTime now, std::uint64_t cookie) override { (void)now; (void)cookie; }
+
+    // Writes the node's state to a checkpoint (see Topology::saveCheckpoint()). A node whose
+    // behaviour depends on more than its configuration overrides this and restoreState().
+    virtual void saveState(CheckpointWriter& writer) const { (void)writer; }
+
+    // Reads back what saveState() wrote, on a node built with the same configuration. It is
+    // called instead of start(): the node's pending events come back with the scheduler, so it
+    // must not schedule any, only remember the scheduler it runs on.
+    virtual void restoreState(CheckpointReader& reader, EventScheduler& scheduler) { (void)reader; (void)scheduler; }
+
+private:
+    std::string name;
+};
+
+
+#endif  // End NODE_H
\ No newline at end of file
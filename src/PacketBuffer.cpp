@@ -0,0 +1,221 @@
+#include "PacketBuffer.h"
+#include "PacketBufferPool.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+PacketBuffer::PacketBuffer(std::size_t length, char fill) {
+    resize(length, fill);
+}
+
+PacketBuffer::PacketBuffer(const char* first, const char* last) {
+    assign(first, last);
+}
+
+PacketBuffer PacketBuffer::withHeadroom(std::size_t headroom, std::size_t length) {
+    PacketBuffer buffer;
+    buffer.reallocate(headroom, length);
+    buffer.resize(length);
+    return buffer;
+}
+
+PacketBuffer PacketBuffer::borrow(char* bytes, std::size_t length) {
+    PacketBuffer buffer;
+    buffer.block = bytes;
+    buffer.blockSize = static_cast<std::uint32_t>(length);
+    buffer.length = static_cast<std::uint32_t>(length);
+    buffer.borrowed = true;
+    return buffer;
+}
+
+PacketBuffer::PacketBuffer(const PacketBuffer& other) {
+    if (other.length > 0 || other.head > 0) {
+        reallocate(other.head, other.length);
+        std::memcpy(block + head, other.data(), other.length);
+        length = other.length;
+    }
+}
+
+PacketBuffer& PacketBuffer::operator=(const PacketBuffer& other) {
+    if (this != &other) {
+        // Reuse the current block when it is big enough (and ours), otherwise start over
+        if (other.length > capacity() || borrowed) {
+            releaseBlock();
+            reallocate(other.head, other.length);
+        }
+        std::memcpy(block + head, other.data(), other.length);
+        length = other.length;
+    }
+    return *this;
+}
+
+PacketBuffer::PacketBuffer(PacketBuffer&& other) noexcept {
+    takeFrom(other);
+}
+
+PacketBuffer& PacketBuffer::operator=(PacketBuffer&& other) noexcept {
+    if (this != &other) {
+        releaseBlock();
+        takeFrom(other);
+    }
+    return *this;
+}
+
+// A block is handed over by pointer; inline bytes have to be copied. The whole array goes, which
+// compiles to a few vector moves and is cheaper than calling memcpy for the exact length.
+void PacketBuffer::takeFrom(PacketBuffer& other) noexcept {
+    if (other.isInline()) {
+        block = inlineBytes;
+        std::memcpy(inlineBytes, other.inlineBytes, INLINE_CAPACITY);
+    } else {
+        block = other.block;
+    }
+    blockSize = other.blockSize;
+    head = other.head;
+    length = other.length;
+    borrowed = other.borrowed;
+    other.block = nullptr;
+    other.blockSize = other.head = other.length = 0;
+    other.borrowed = false;
+}
+
+PacketBuffer::~PacketBuffer() {
+    releaseBlock();
+}
+
+void PacketBuffer::releaseBlock() {
+    if (block != nullptr && !borrowed && !isInline()) {
+        PacketBufferPool::instance().release(block, blockSize);
+    }
+    block = nullptr;
+    blockSize = head = length = 0;
+    borrowed = false;
+}
+
+// Two pooled blocks just trade places; inline bytes go through a third buffer
+void PacketBuffer::swap(PacketBuffer& other) noexcept {
+    if (!isInline() && !other.isInline()) {
+        std::swap(block, other.block);
+        std::swap(blockSize, other.blockSize);
+        std::swap(head, other.head);
+        std::swap(length, other.length);
+        std::swap(borrowed, other.borrowed);
+        return;
+    }
+    PacketBuffer held;
+    held.takeFrom(other);
+    other.takeFrom(*this);
+    takeFrom(held);
+}
+
+// Moves the current bytes to their new place in the inline array, or in a new block from the pool
+void PacketBuffer::reallocate(std::size_t newHeadroom, std::size_t dataCapacity) {
+    const std::size_t wanted = newHeadroom + std::max<std::size_t>(dataCapacity, length);
+    if (wanted <= INLINE_CAPACITY) {
+        if (isInline()) {
+            std::memmove(inlineBytes + newHeadroom, block + head, length);
+        } else {
+            if (length > 0) {
+                std::memcpy(inlineBytes + newHeadroom, block + head, length);
+            }
+            const std::uint32_t keptLength = length;
+            releaseBlock();
+            length = keptLength;
+            block = inlineBytes;
+        }
+        blockSize = static_cast<std::uint32_t>(INLINE_CAPACITY);
+        head = static_cast<std::uint32_t>(newHeadroom);
+        return;
+    }
+    const std::size_t newBlockSize = PacketBufferPool::usableSize(wanted);
+    char* newBlock = static_cast<char*>(PacketBufferPool::instance().acquire(newBlockSize));
+    if (length > 0) {
+        std::memcpy(newBlock + newHeadroom, block + head, length);
+    }
+    const std::uint32_t keptLength = length;
+    releaseBlock();
+    block = newBlock;
+    blockSize = static_cast<std::uint32_t>(newBlockSize);
+    head = static_cast<std::uint32_t>(newHeadroom);
+    length = keptLength;
+}
+
+// The copy keeps the headroom regained by stripFront(), so a header can go back in place
+void PacketBuffer::copyBorrowed() {
+    PacketBuffer copy(std::as_const(*this));
+    *this = std::move(copy);
+}
+
+void PacketBuffer::reserve(std::size_t newCapacity) {
+    if (newCapacity > capacity()) {
+        reallocate(head, newCapacity);
+    }
+}
+
+void PacketBuffer::resize(std::size_t newLength, char fill) {
+    makeWritable();
+    if (newLength > capacity()) {
+        // Grow geometrically so that byte-by-byte filling stays cheap
+        reallocate(head, std::max(newLength, capacity() * 2));
+    }
+    if (newLength > length) {
+        std::memset(data() + length, fill, newLength - length);
+    }
+    length = static_cast<std::uint32_t>(newLength);
+}
+
+void PacketBuffer::push_back(char value) {
+    makeWritable();
+    if (length == capacity()) {
+        reallocate(head, std::max<std::size_t>(16, capacity() * 2));
+    }
+    block[head + length++] = value;
+}
+
+void PacketBuffer::assign(const char* first, const char* last) {
+    const std::size_t count = static_cast<std::size_t>(last - first);
+    if (borrowed) {
+        releaseBlock();
+    }
+    length = 0;
+    reserve(count);
+    if (count > 0) {
+        std::memcpy(data(), first, count);
+    }
+    length = static_cast<std::uint32_t>(count);
+}
+
+// A small packet stays inline as long as the header fits, with as much of the reserve as there is room for
+char* PacketBuffer::prepend(std::size_t count) {
+    makeWritable();
+    if (count > head) {
+        if (count + length <= INLINE_CAPACITY) {
+            reallocate(std::min(count + PREPEND_RESERVE, INLINE_CAPACITY - length), length);
+        } else {
+            reallocate(count + PREPEND_RESERVE, length + tailroom());
+        }
+    }
+    head -= static_cast<std::uint32_t>(count);
+    length += static_cast<std::uint32_t>(count);
+    return data();
+}
+
+void PacketBuffer::stripFront(std::size_t count) {
+    count = std::min<std::size_t>(count, length);
+    head += static_cast<std::uint32_t>(count);
+    length -= static_cast<std::uint32_t>(count);
+}
+
+char* PacketBuffer::append(std::size_t count) {
+    const std::size_t oldLength = length;
+    resize(oldLength + count);
+    return data() + oldLength;
+}
+
+void PacketBuffer::trimBack(std::size_t count) {
+    length -= static_cast<std::uint32_t>(std::min<std::size_t>(count, length));
+}
+
+bool PacketBuffer::operator==(const PacketBuffer& other) const {
+    return length == other.length && (length == 0 || std::memcmp(data(), other.data(), length) == 0);
+}
\ No newline at end of file
@@ -0,0 +1,202 @@
+#ifndef PACKET_BUFFER_H    // This will ensure no repeat definition of this header file.
+#define PACKET_BUFFER_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+/*
+PacketView is a read-only window onto bytes owned by someone else (usually a RawPacket).
+Making a view or a slice of a view never copies anything; the view is only valid while the
+bytes it points to are alive and unchanged.
+*/
+class PacketView{
+public:
+    PacketView() = default;
+    PacketView(const char* bytes, std::size_t length) : bytes(bytes), length(length) {}
+
+    const char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    char operator[](std::size_t index) const { return bytes[index]; }
+    const char* begin() const { return bytes; }
+    const char* end() const { return bytes + length; }
+
+    // The 'count' bytes starting at 'offset' (clamped to the end of the view).
+    PacketView slice(std::size_t offset, std::size_t count) const {
+        if (offset > length) {
+            offset = length;
+        }
+        return PacketView(bytes + offset, count < length - offset ? count : length - offset);
+    }
+
+    // Everything after the first 'count' bytes, e.g. the payload behind a header.
+    PacketView skip(std::size_t count) const { return slice(count, length); }
+
+    // The first 'count' bytes, e.g. a header.
+    PacketView first(std::size_t count) const { return slice(0, count); }
+
+private:
+    const char* bytes = nullptr;
+    std::size_t length = 0;
+};
+
+/*
+PacketBuffer holds the bytes of a RawPacket. It behaves like a std::vector<char> (size(),
+data(), operator[], resize(), push_back(), ...), but the bytes do not have to start at the
+beginning of the underlying block: like a Linux sk_buff or a BSD mbuf it keeps free
+"headroom" in front of the data and "tailroom" behind it.
+
+That makes encapsulation cheap. Adding a header with prepend() only moves the start of the
+data back into the headroom, and stripping one with stripFront() moves it forward; no byte
+of the payload is moved or copied.
+
+Small packets (ACKs, control frames) live inside the PacketBuffer itself: up to
+INLINE_CAPACITY bytes of headroom and data fit into an array that makes the whole object
+three cache lines, so building, queueing and receiving one needs no block at all and a ring
+slot holds its bytes directly. Larger packets get a block from the PacketBufferPool. Moving
+a small packet copies its bytes (at most INLINE_CAPACITY), so pointers and views into a
+packet are not valid after it was moved.
+*/
+class PacketBuffer{
+public:
+    using value_type = char;
+    using iterator = char*;
+    using const_iterator = const char*;
+
+    // Headroom reserved when prepend() finds too little of it and has to reallocate.
+    static constexpr std::size_t PREPEND_RESERVE = 64;
+
+    // Bytes of headroom plus data stored inside the buffer, without a pooled block.
+    static constexpr std::size_t INLINE_CAPACITY = 168;
+
+    PacketBuffer() noexcept = default;
+    PacketBuffer(std::size_t length, char fill);
+    PacketBuffer(const char* first, const char* last);
+
+    // Copies any range of chars (e.g. from a std::vector<char> or a std::string).
+    template <std::input_iterator Iterator>
+    PacketBuffer(Iterator first, Iterator last) {
+        assign(first, last);
+    }
+
+    // A buffer of 'length' zero bytes with at least 'headroom' free bytes in front, for
+    // packets that will get headers prepended later.
+    static PacketBuffer withHeadroom(std::size_t headroom, std::size_t length);
+
+    // A buffer that uses the 'length' bytes at 'bytes' in place instead of a pooled block, for
+    // example a frame inside a memory-mapped trace file. Nothing is copied, and the bytes are
+    // not freed with the buffer, so they have to outlive it (and every buffer it is moved
+    // into). The bytes are never written to, so they may be read-only: every way of
+    // modifying the buffer (the non-const data(), operator[] and begin(), resize(), append(),
+    // push_back() and prepend()) first moves the data into a block of its own (inline or
+    // pooled) with makeWritable(). Read borrowed bytes through view() or a const buffer to
+    // keep them in place.
+    static PacketBuffer borrow(char* bytes, std::size_t length);
+
+    // True if the bytes are borrowed (see borrow()) rather than in a pooled block.
+    bool isBorrowed() const { return borrowed; }
+
+    // Copies borrowed bytes into a block of the buffer's own, so that writes no longer reach
+    // the borrowed memory. Does nothing otherwise.
+    void makeWritable() {
+        if (borrowed) {
+            copyBorrowed();
+        }
+    }
+
+    // True if the bytes are stored inside the buffer (see INLINE_CAPACITY).
+    bool isInline() const { return block == inlineBytes; }
+
+    // Copies keep the original's headroom, so they can still grow at the front cheaply.
+    PacketBuffer(const PacketBuffer& other);
+    PacketBuffer& operator=(const PacketBuffer& other);
+    PacketBuffer(PacketBuffer&& other) noexcept;
+    PacketBuffer& operator=(PacketBuffer&& other) noexcept;
+    ~PacketBuffer();
+
+    // --- std::vector-like access ---
+    char* data() { makeWritable(); return block + head; }
+    const char* data() const { return block + head; }
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    std::size_t capacity() const { return blockSize - head; }   // Size plus tailroom.
+    char& operator[](std::size_t index) { makeWritable(); return block[head + index]; }
+    char operator[](std::size_t index) const { return block[head + index]; }
+    iterator begin() { return data(); }
+    iterator end() { return data() + length; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + length; }
+
+    void resize(std::size_t newLength, char fill = 0);
+    void reserve(std::size_t newCapacity);
+    void push_back(char value);
+    void clear() { length = 0; }
+    void swap(PacketBuffer& other) noexcept;
+
+    void assign(const char* first, const char* last);
+    template <std::input_iterator Iterator>
+    void assign(Iterator first, Iterator last) {
+        if constexpr (std::contiguous_iterator<Iterator> && std::is_same_v<std::iter_value_t<Iterator>, char>) {
+            const char* bytes = std::to_address(first);
+            assign(bytes, bytes + (last - first));
+            return;
+        }
+        clear();
+        if constexpr (std::forward_iterator<Iterator>) {
+            reserve(static_cast<std::size_t>(std::distance(first, last)));
+        }
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+
+    // --- Headroom and tailroom ---
+    std::size_t headroom() const { return head; }
+    std::size_t tailroom() const { return blockSize - head - length; }
+
+    // Grows the data by 'count' bytes at the front and returns a pointer to them (the new
+    // start of the data), ready for a header to be written. Only reallocates if the
+    // headroom is too small.
+    char* prepend(std::size_t count);
+
+    // Removes 'count' bytes from the front (e.g. a header that has been parsed).
+    void stripFront(std::size_t count);
+
+    // Grows the data by 'count' bytes at the back and returns a pointer to them.
+    char* append(std::size_t count);
+
+    // Removes 'count' bytes from the back (e.g. a trailer such as a checksum).
+    void trimBack(std::size_t count);
+
+    // A read-only view of all bytes, or of a part of them.
+    PacketView view() const { return PacketView(data(), length); }
+    PacketView slice(std::size_t offset, std::size_t count) const { return view().slice(offset, count); }
+
+    // Compares the bytes only, not the headroom or capacity.
+    bool operator==(const PacketBuffer& other) const;
+
+private:
+    // Block sizes and offsets are 32 bits wide so the inline array can be as large as
+    // possible within three cache lines; no frame comes anywhere near 4 GB.
+    char* block = nullptr;
+    std::uint32_t blockSize = 0;
+    std::uint32_t head = 0;         // Offset of the first data byte inside the block.
+    std::uint32_t length = 0;
+    bool borrowed = false;          // The block belongs to someone else and is not released.
+    char inlineBytes[INLINE_CAPACITY];  // The block of small packets; 'block' then points here.
+
+    // Moves the data into a new block with the given headroom and room for 'dataCapacity' bytes.
+    void reallocate(std::size_t newHeadroom, std::size_t dataCapacity);
+    void releaseBlock();
+    void copyBorrowed();
+
+    // Takes over the bytes of 'other', which is left empty; this buffer must be empty too.
+    void takeFrom(PacketBuffer& other) noexcept;
+};
+
+
+#endif  // End PACKET_BUFFER_H
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "PacketBufferPool.h"
+
+// Set once the calling thread's cache has been destroyed (during thread or program exit);
+// from then on that thread talks to the shared lists directly.
+static thread_local bool threadCacheGone = false;
+
+/*
+The free blocks and unflushed counters of one thread. The hot path (acquire/release with a
+non-empty, non-full cache) only touches this object.
+*/
+class PoolThreadCache{
+public:
+    struct ClassCache {
+        void* blocks[PacketBufferPool::THREAD_CACHE_BLOCKS];
+        std::size_t count = 0;
+        std::uint64_t hits = 0;     // Not yet added to the shared counters.
+        std::uint64_t misses = 0;
+    };
+
+    PacketBufferPool& pool;
+    ClassCache classes[PacketBufferPool::CLASS_COUNT];
+
+    PoolThreadCache() : pool(PacketBufferPool::instance()) {}
+
+    // Returns all cached blocks to the shared lists when the thread exits.
+    ~PoolThreadCache() {
+        for (std::size_t index = 0; index < PacketBufferPool::CLASS_COUNT; ++index) {
+            ClassCache& cache = classes[index];
+            pool.giveShared(index, cache.blocks, cache.count);
+            cache.count = 0;
+            flushCounters(index);
+        }
+        threadCacheGone = true;
+    }
+
+    void flushCounters(std::size_t index) {
+        ClassCache& cache = classes[index];
+        pool.shared[index].hits.fetch_add(cache.hits, std::memory_order_relaxed);
+        pool.shared[index].misses.fetch_add(cache.misses, std::memory_order_relaxed);
+        cache.hits = 0;
+        cache.misses = 0;
+    }
+};
+
+static PoolThreadCache& threadCache() {
+    thread_local PoolThreadCache cache;
+    return cache;
+}
+
+// The pool is never destroyed: packets living in static objects may still give their
+// buffers back while the program shuts down.
+PacketBufferPool& PacketBufferPool::instance() {
+    static PacketBufferPool* pool = new PacketBufferPool();
+    return *pool;
+}
+
+std::size_t PacketBufferPool::classIndex(std::size_t size) {
+    for (std::size_t index = 0; index < CLASS_COUNT; ++index) {
+        if (size <= CLASS_SIZES[index]) {
+            return index;
+        }
+    }
+    return CLASS_COUNT;
+}
+
+std::size_t PacketBufferPool::takeShared(std::size_t index, void** out, std::size_t count) {
+    SharedClass& sharedClass = shared[index];
+    std::lock_guard<std::mutex> guard(sharedClass.lock);
+    std::size_t moved = 0;
+    while (moved < count && !sharedClass.freeBlocks.empty()) {
+        out[moved++] = sharedClass.freeBlocks.back();
+        sharedClass.freeBlocks.pop_back();
+    }
+    return moved;
+}
+
+void PacketBufferPool::giveShared(std::size_t index, void* const* blocks, std::size_t count) {
+    SharedClass& sharedClass = shared[index];
+    std::lock_guard<std::mutex> guard(sharedClass.lock);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (sharedClass.freeBlocks.size() < MAX_SHARED_BLOCKS) {
+            sharedClass.freeBlocks.push_back(blocks[i]);
+        } else {
+            ::operator delete(blocks[i]);
+        }
+    }
+}
+
+// Serves a block from the thread cache, refilling it from the shared list when it is empty
+void* PacketBufferPool::acquire(std::size_t size) {
+    std::size_t index = classIndex(size);
+    if (index == CLASS_COUNT) {
+        oversize.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+    if (threadCacheGone) {
+        void* block = nullptr;
+        if (takeShared(index, &block, 1) == 1) {
+            shared[index].hits.fetch_add(1, std::memory_order_relaxed);
+            return block;
+        }
+        shared[index].misses.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(CLASS_SIZES[index]);
+    }
+
+    PoolThreadCache& cache = threadCache();
+    PoolThreadCache::ClassCache& classCache = cache.classes[index];
+    if (classCache.count == 0) {
+        classCache.count = takeShared(index, classCache.blocks, TRANSFER_BATCH);
+        cache.flushCounters(index);
+        if (classCache.count == 0) {
+            ++classCache.misses;
+            return ::operator new(CLASS_SIZES[index]);
+        }
+    }
+    ++classCache.hits;
+    return classCache.blocks[--classCache.count];
+}
+
+// Puts a block back into the thread cache, spilling half of it to the shared list when it is full
+void PacketBufferPool::release(void* block, std::size_t size) {
+    std::size_t index = classIndex(size);
+    if (index == CLASS_COUNT) {
+        ::operator delete(block);
+        return;
+    }
+    if (threadCacheGone) {
+        giveShared(index, &block, 1);
+        return;
+    }
+
+    PoolThreadCache& cache = threadCache();
+    PoolThreadCache::ClassCache& classCache = cache.classes[index];
+    if (classCache.count == THREAD_CACHE_BLOCKS) {
+        classCache.count -= TRANSFER_BATCH;
+        giveShared(index, classCache.blocks + classCache.count, TRANSFER_BATCH);
+        cache.flushCounters(index);
+    }
+    classCache.blocks[classCache.count++] = block;
+}
+
+PoolStats PacketBufferPool::stats() {
+    // Fold in this thread's own counts so a single-threaded caller always sees exact numbers
+    PoolStats result;
+    for (std::size_t index = 0; index < CLASS_COUNT; ++index) {
+        if (!threadCacheGone) {
+            threadCache().flushCounters(index);
+        }
+        PoolClassStats classStats;
+        classStats.blockSize = CLASS_SIZES[index];
+        classStats.hits = shared[index].hits.load(std::memory_order_relaxed);
+        classStats.misses = shared[index].misses.load(std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> guard(shared[index].lock);
+            classStats.pooledBlocks = shared[index].freeBlocks.size();
+        }
+        result.classes.push_back(classStats);
+    }
+    result.oversizeAllocations = oversize.load(std::memory_order_relaxed);
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef PACKET_BUFFER_POOL_H    // This will ensure no repeat definition of this header file.
+#define PACKET_BUFFER_POOL_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/*
+PacketBufferPool hands out payload buffers in a few fixed size classes and takes them back
+when a packet is destroyed, so steady-state traffic reuses the same blocks instead of going
+through malloc/free for every frame.
+
+Every thread keeps a small cache of free blocks per size class. Allocating and releasing
+only touch that cache; the shared, mutex protected free lists are used when a thread cache
+runs empty or overflows, and then a whole batch of blocks is moved at once. Requests larger
+than the biggest class go straight to the global allocator.
+*/
+
+// Hit/miss counters of one size class.
+struct PoolClassStats {
+    std::size_t blockSize = 0;  // Size of every block in this class, in bytes.
+    std::uint64_t hits = 0;     // Allocations served from a free block.
+    std::uint64_t misses = 0;   // Allocations that had to ask the global allocator for a new block.
+    std::size_t pooledBlocks = 0;   // Free blocks currently held by the shared free list.
+};
+
+// Counters of the whole pool, one entry per size class.
+struct PoolStats {
+    std::vector<PoolClassStats> classes;
+    std::uint64_t oversizeAllocations = 0;  // Requests bigger than the largest size class.
+};
+
+class PacketBufferPool{
+public:
+    // Block sizes of the size classes: minimum frame, small frame, Ethernet frame, jumbo frame.
+    static constexpr std::array<std::size_t, 4> CLASS_SIZES = {64, 256, 1518, 9000};
+    static constexpr std::size_t CLASS_COUNT = CLASS_SIZES.size();
+
+    // Number of free blocks a thread keeps per size class, and how many move at once
+    // between a thread cache and the shared free list.
+    static constexpr std::size_t THREAD_CACHE_BLOCKS = 64;
+    static constexpr std::size_t TRANSFER_BATCH = THREAD_CACHE_BLOCKS / 2;
+
+    // Upper bound of free blocks kept in the shared list per class; beyond it blocks are freed.
+    static constexpr std::size_t MAX_SHARED_BLOCKS = 16384;
+
+    // The process-wide pool.
+    static PacketBufferPool& instance();
+
+    // Returns a block of at least 'size' bytes.
+    void* acquire(std::size_t size);
+
+    // Gives back a block obtained from acquire() with the same 'size'.
+    void release(void* block, std::size_t size);
+
+    // Index of the size class serving 'size' bytes, or CLASS_COUNT if it is too large.
+    static std::size_t classIndex(std::size_t size);
+
+    // Number of bytes a block acquired for 'size' bytes really has: the size of its class
+    // (or 'size' itself above the largest class). Callers may use all of it.
+    static std::size_t usableSize(std::size_t size) {
+        const std::size_t index = classIndex(size);
+        return index == CLASS_COUNT ? size : CLASS_SIZES[index];
+    }
+
+    // Current counters. Counts made by other threads are included once their cache
+    // has traded blocks with the shared list (or the thread has exited).
+    PoolStats stats();
+
+    PacketBufferPool(const PacketBufferPool&) = delete;
+    PacketBufferPool& operator=(const PacketBufferPool&) = delete;
+
+private:
+    PacketBufferPool() = default;
+
+    // The shared free list and counters of one size class, each on its own cache line.
+    struct alignas(64) SharedClass {
+        std::mutex lock;
+        std::vector<void*> freeBlocks;
+        std::atomic<std::uint64_t> hits{0};
+        std::atomic<std::uint64_t> misses{0};
+    };
+    std::array<SharedClass, CLASS_COUNT> shared;
+    std::atomic<std::uint64_t> oversize{0};
+
+    // Per-thread cache; defined in the .cpp file.
+    friend class PoolThreadCache;
+
+    // Moves up to 'count' free blocks of class 'index' into 'out'; returns how many were moved.
+    std::size_t takeShared(std::size_t index, void** out, std::size_t count);
+    // Puts 'count' free blocks of class 'index' back on the shared list.
+    void giveShared(std::size_t index, void* const* blocks, std::size_t count);
+};
+
+/*
+PoolAllocator lets standard containers and std::allocate_shared draw their storage from
+the PacketBufferPool. It is stateless, so any two instances are interchangeable.
+*/
+template <typename T>
+class PoolAllocator{
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t count) {
+        return static_cast<T*>(PacketBufferPool::instance().acquire(count * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t count) noexcept {
+        PacketBufferPool::instance().release(pointer, count * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+};
+
+
+#endif  // End PACKET_BUFFER_POOL_H
\ No newline at end of file
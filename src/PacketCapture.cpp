@@ -0,0 +1,258 @@
+#include "PacketCapture.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// pcapng block types and option codes
+constexpr std::uint32_t SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+constexpr std::uint32_t INTERFACE_DESCRIPTION_BLOCK = 0x00000001;
+constexpr std::uint32_t ENHANCED_PACKET_BLOCK = 0x00000006;
+constexpr std::uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+constexpr std::uint16_t LINKTYPE_ETHERNET = 1;
+constexpr std::uint16_t OPTION_END = 0;
+constexpr std::uint16_t OPTION_IF_NAME = 2;
+constexpr std::uint16_t OPTION_IF_TSRESOL = 9;
+constexpr std::uint16_t OPTION_IF_FCSLEN = 13;
+
+// Blocks are written in little-endian order, which the byte order magic tells readers
+void put16(std::vector<char>& out, std::uint16_t value) {
+    out.push_back(static_cast<char>(value));
+    out.push_back(static_cast<char>(value >> 8));
+}
+
+void put32(std::vector<char>& out, std::uint32_t value) {
+    put16(out, static_cast<std::uint16_t>(value));
+    put16(out, static_cast<std::uint16_t>(value >> 16));
+}
+
+// Everything in a block is padded to 32 bits
+void padTo32Bits(std::vector<char>& out) {
+    while (out.size() % 4 != 0) {
+        out.push_back(0);
+    }
+}
+
+void putOption(std::vector<char>& out, std::uint16_t code, const char* value, std::size_t length) {
+    put16(out, code);
+    put16(out, static_cast<std::uint16_t>(length));
+    out.insert(out.end(), value, value + length);
+    padTo32Bits(out);
+}
+
+// Blocks begin and end with their total length; the first copy is patched once it is known
+std::size_t beginBlock(std::vector<char>& out, std::uint32_t type) {
+    const std::size_t start = out.size();
+    put32(out, type);
+    put32(out, 0);
+    return start;
+}
+
+void endBlock(std::vector<char>& out, std::size_t start) {
+    const std::uint32_t length = static_cast<std::uint32_t>(out.size() - start + 4);
+    put32(out, length);
+    for (std::size_t index = 0; index < 4; ++index) {
+        out[start + 4 + index] = static_cast<char>(length >> (8 * index));
+    }
+}
+
+} // namespace
+
+// Copies the start of the frame and stages it; a full ring drops the frame instead of waiting
+void CaptureInterface::record(PacketView bytes, SimTime time) {
+    if (!tap.open.load(std::memory_order_acquire)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const std::size_t kept = std::min(bytes.size(), tap.config.snapLength);
+    CaptureTap::Record entry;
+    entry.time = time;
+    entry.interface = id;
+    entry.originalLength = static_cast<std::uint32_t>(bytes.size());
+    entry.bytes = PacketBuffer(bytes.data(), bytes.data() + kept);
+    if (!tap.staging.tryPush(entry)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    captured.fetch_add(1, std::memory_order_release);
+    if (kept < bytes.size()) {
+        truncated.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+CaptureTap::CaptureTap(const CaptureConfig& config) : config(config), staging(config.bufferFrames) {
+    if (config.snapLength == 0 || config.sampleEvery == 0 || config.bufferFrames == 0) {
+        throw std::invalid_argument("A capture needs a snap length, sampling ratio and buffer size greater than zero");
+    }
+    file = std::fopen(config.path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Cannot create capture file " + config.path);
+    }
+    // The tap buffers on its own; large writes go straight to the file
+    std::setvbuf(file, nullptr, _IONBF, 0);
+    output.reserve(config.writeSize + 65536);
+
+    const std::size_t start = beginBlock(output, SECTION_HEADER_BLOCK);
+    put32(output, BYTE_ORDER_MAGIC);
+    put16(output, 1);
+    put16(output, 0);
+    put32(output, 0xFFFFFFFF);      // Section length unknown
+    put32(output, 0xFFFFFFFF);
+    endBlock(output, start);
+
+    writer = std::thread([this] { writerLoop(); });
+}
+
+CaptureTap::~CaptureTap() {
+    close();
+}
+
+CaptureInterface& CaptureTap::addInterface(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::uint32_t id = static_cast<std::uint32_t>(interfaces.size());
+    interfaces.push_back(std::unique_ptr<CaptureInterface>(new CaptureInterface(*this, id, name, config.sampleEvery)));
+    return *interfaces.back();
+}
+
+void CaptureTap::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (stopping) {
+        return;
+    }
+    std::uint64_t target = 0;
+    for (const std::unique_ptr<CaptureInterface>& interface : interfaces) {
+        target += interface->captured.load(std::memory_order_acquire);
+    }
+    ++flushRequests;
+    wakeWriter.notify_one();
+    fileUpdated.wait(lock, [&] { return written.load(std::memory_order_acquire) >= target || stopping; });
+}
+
+void CaptureTap::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    open.store(false, std::memory_order_release);
+    wakeWriter.notify_one();
+    writer.join();
+    std::fclose(file);
+    file = nullptr;
+}
+
+CaptureCounters CaptureTap::getCounters() const {
+    CaptureCounters counters;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::unique_ptr<CaptureInterface>& interface : interfaces) {
+        counters.captured += interface->captured.load(std::memory_order_relaxed);
+        counters.skipped += interface->skipped.load(std::memory_order_relaxed);
+        counters.dropped += interface->dropped.load(std::memory_order_relaxed);
+        counters.truncated += interface->truncated.load(std::memory_order_relaxed);
+    }
+    counters.written = written.load(std::memory_order_relaxed);
+    counters.bytesWritten = bytesWritten.load(std::memory_order_relaxed);
+    counters.writeErrors = writeErrors.load(std::memory_order_relaxed);
+    return counters;
+}
+
+// Drains the ring into 'output' and writes it when it is big enough, on request, or when it has waited too long
+void CaptureTap::writerLoop() {
+    Record record;
+    auto oldestPending = std::chrono::steady_clock::now();
+    std::uint64_t flushesServed = 0;
+    for (;;) {
+        while (staging.tryPop(record)) {
+            if (outputFrames == 0) {
+                oldestPending = std::chrono::steady_clock::now();
+            }
+            appendPacket(record);
+            record.bytes = PacketBuffer();  // Back to the pool right away
+            if (output.size() >= config.writeSize) {
+                writeOutput();
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        const bool flushRequested = flushRequests != flushesServed;
+        const bool stop = stopping;
+        const bool stale = outputFrames > 0 && std::chrono::steady_clock::now() - oldestPending >= config.flushInterval;
+        if (flushRequested || stop || stale) {
+            flushesServed = flushRequests;
+            lock.unlock();
+            // Frames staged while the lock was taken are picked up before writing
+            while (staging.tryPop(record)) {
+                appendPacket(record);
+                record.bytes = PacketBuffer();
+            }
+            writeOutput();
+            lock.lock();
+            fileUpdated.notify_all();
+            if (stop) {
+                return;
+            }
+            continue;
+        }
+        // Nothing to do: poll the ring again in a millisecond, or sooner when woken
+        wakeWriter.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+void CaptureTap::appendInterfaceDescription(const std::string& name) {
+    const std::size_t start = beginBlock(output, INTERFACE_DESCRIPTION_BLOCK);
+    put16(output, LINKTYPE_ETHERNET);
+    put16(output, 0);
+    put32(output, static_cast<std::uint32_t>(std::min<std::size_t>(config.snapLength, 0xFFFFFFFF)));
+    putOption(output, OPTION_IF_NAME, name.data(), name.size());
+    const char nanoseconds = 9;     // Timestamps are in units of 10^-9 seconds
+    putOption(output, OPTION_IF_TSRESOL, &nanoseconds, 1);
+    if (config.fcsLength != 0) {
+        const char fcsLength = static_cast<char>(config.fcsLength);
+        putOption(output, OPTION_IF_FCSLEN, &fcsLength, 1);
+    }
+    put16(output, OPTION_END);
+    put16(output, 0);
+    endBlock(output, start);
+}
+
+void CaptureTap::appendPacket(const Record& record) {
+    // An interface is described in the file before its first frame
+    if (record.interface >= describedInterfaces) {
+        std::vector<std::string> names;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (std::size_t index = describedInterfaces; index <= record.interface; ++index) {
+                names.push_back(interfaces[index]->getName());
+            }
+        }
+        for (const std::string& name : names) {
+            appendInterfaceDescription(name);
+        }
+        describedInterfaces = record.interface + 1;
+    }
+    const std::size_t start = beginBlock(output, ENHANCED_PACKET_BLOCK);
+    put32(output, record.interface);
+    put32(output, static_cast<std::uint32_t>(record.time >> 32));
+    put32(output, static_cast<std::uint32_t>(record.time));
+    put32(output, static_cast<std::uint32_t>(record.bytes.size()));
+    put32(output, record.originalLength);
+    output.insert(output.end(), record.bytes.data(), record.bytes.data() + record.bytes.size());
+    padTo32Bits(output);
+    endBlock(output, start);
+    ++outputFrames;
+}
+
+void CaptureTap::writeOutput() {
+    if (!output.empty()) {
+        if (std::fwrite(output.data(), 1, output.size(), file) == output.size()) {
+            bytesWritten.fetch_add(output.size(), std::memory_order_relaxed);
+        } else {
+            writeErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    written.fetch_add(outputFrames, std::memory_order_release);
+    output.clear();
+    outputFrames = 0;
+}
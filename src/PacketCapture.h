@@ -0,0 +1,164 @@
+#ifndef PACKET_CAPTURE_H    // This will ensure no repeat definition of this header file.
+#define PACKET_CAPTURE_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "PacketBuffer.h"
+#include "PacketRing.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct CaptureConfig {
+    std::string path;                       // The pcapng file to write; replaced if it exists.
+    std::size_t snapLength = 262144;        // Bytes kept of every frame; the rest is cut off.
+    std::uint32_t sampleEvery = 1;          // Record one frame in this many (per interface).
+    std::size_t bufferFrames = 65536;       // Frames staged for the writer; more are dropped.
+    std::size_t writeSize = 1 << 20;        // The writer collects this many bytes per write.
+    std::chrono::milliseconds flushInterval{100};   // Longest time a frame waits in a partial write.
+    std::uint8_t fcsLength = 4;             // FCS bytes at the end of each frame, for Wireshark (0 if none).
+};
+
+// What a capture has done so far.
+struct CaptureCounters {
+    std::uint64_t captured = 0;     // Frames staged for the file.
+    std::uint64_t skipped = 0;      // Left out by sampling.
+    std::uint64_t dropped = 0;      // Lost because the writer was behind and the staging ring was full.
+    std::uint64_t truncated = 0;    // Captured frames longer than the snap length.
+    std::uint64_t written = 0;      // Frames in the file.
+    std::uint64_t bytesWritten = 0;
+    std::uint64_t writeErrors = 0;  // Failed writes; their frames are lost.
+};
+
+class CaptureTap;
+
+/*
+A CaptureInterface is one capture point of a CaptureTap, normally one NetworkMedium. It is an
+interface of its own in the pcapng file, so Wireshark can tell the media apart.
+*/
+class CaptureInterface{
+public:
+    // Decides whether the next frame is recorded, one in 'sampleEvery'. Cheap enough to call
+    // for every frame before anything (the timestamp, say) is computed for record().
+    bool sample() {
+        if (sampleEvery <= 1 || seen.fetch_add(1, std::memory_order_relaxed) % sampleEvery == 0) {
+            return true;
+        }
+        skipped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Records a frame seen at 'time', whether sample() chose it or not. Safe to call from
+    // several threads; never blocks.
+    void record(PacketView bytes, SimTime time);
+
+    std::uint32_t getId() const { return id; }
+    const std::string& getName() const { return name; }
+
+private:
+    friend class CaptureTap;
+
+    CaptureInterface(CaptureTap& tap, std::uint32_t id, std::string name, std::uint32_t sampleEvery)
+        : tap(tap), id(id), sampleEvery(sampleEvery), name(std::move(name)) {}
+
+    CaptureTap& tap;
+    const std::uint32_t id;
+    const std::uint32_t sampleEvery;
+    const std::string name;
+    std::atomic<std::uint64_t> seen{0};
+    std::atomic<std::uint64_t> captured{0};
+    std::atomic<std::uint64_t> skipped{0};
+    std::atomic<std::uint64_t> dropped{0};
+    std::atomic<std::uint64_t> truncated{0};
+};
+
+/*
+CaptureTap writes the frames crossing one or more media into a pcapng file that Wireshark can
+open, with the media's (virtual) timestamps in nanoseconds.
+
+Recording a frame never touches the file: the sending thread copies up to 'snapLength' bytes
+into a pooled buffer and pushes it into a lock-free multi-producer ring. A background thread
+drains the ring, formats the pcapng blocks into a buffer of 'writeSize' bytes and writes it in
+one go, so the file sees a few large sequential writes instead of one small write per frame.
+If the writer falls behind and the ring is full, frames are dropped and counted rather than
+making the sender wait. Sampling ('sampleEvery') bounds the cost further on busy media.
+*/
+class CaptureTap{
+public:
+    // Creates the file and starts the writer thread; throws std::runtime_error if the file
+    // cannot be created, and std::invalid_argument for an unusable configuration.
+    explicit CaptureTap(const CaptureConfig& config);
+
+    // Writes whatever is still staged and closes the file.
+    ~CaptureTap();
+
+    CaptureTap(const CaptureTap&) = delete;
+    CaptureTap& operator=(const CaptureTap&) = delete;
+
+    // Adds a capture point, described in the file as interface 'name'. The interface lives as
+    // long as the tap. NetworkMedium::attachCapture() calls this.
+    CaptureInterface& addInterface(const std::string& name);
+
+    // Blocks until every frame captured so far is in the file.
+    void flush();
+
+    // Stops the writer after it wrote everything staged, and closes the file. Frames
+    // recorded afterwards are counted as dropped.
+    void close();
+
+    // The counters of all interfaces together, and the writer's.
+    CaptureCounters getCounters() const;
+
+    const CaptureConfig& getConfig() const { return config; }
+
+private:
+    friend class CaptureInterface;
+
+    // One frame on its way from a sender to the writer thread.
+    struct Record {
+        SimTime time = 0;
+        std::uint32_t interface = 0;
+        std::uint32_t originalLength = 0;
+        PacketBuffer bytes;
+    };
+
+    const CaptureConfig config;
+    std::FILE* file = nullptr;
+    MpscRing<Record> staging;
+    std::atomic<bool> open{true};
+
+    // Interfaces, in the order of their ids; guarded by 'mutex'. The writer adds an
+    // interface description block to the file before the first frame that refers to it.
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<CaptureInterface>> interfaces;
+
+    // Writer thread state. 'flushRequests' and 'stopping' are guarded by 'mutex' and wake the
+    // writer through 'wakeWriter'; flush() waits on 'fileUpdated' for 'written' to catch up.
+    std::condition_variable wakeWriter;
+    std::condition_variable fileUpdated;
+    std::uint64_t flushRequests = 0;
+    bool stopping = false;
+    std::vector<char> output;               // Formatted blocks not yet written.
+    std::uint64_t outputFrames = 0;         // Frames in 'output'.
+    std::size_t describedInterfaces = 0;    // Interface description blocks in the file so far.
+    std::atomic<std::uint64_t> written{0};
+    std::atomic<std::uint64_t> bytesWritten{0};
+    std::atomic<std::uint64_t> writeErrors{0};
+    std::thread writer;
+
+    void writerLoop();
+    void appendInterfaceDescription(const std::string& name);
+    void appendPacket(const Record& record);
+    void writeOutput();
+};
+
+
+#endif  // End PACKET_CAPTURE_H
\ No newline at end of file
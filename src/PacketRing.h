@@ -0,0 +1,417 @@
+#ifndef PACKET_RING_H    // This will ensure no repeat definition of this header file.
+#define PACKET_RING_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Size of a cache line; indices written by different threads are kept this far apart
+// so that a producer and a consumer never fight over the same line.
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// Rounds 'value' up to the next power of two (at least 2), so ring indices can be masked instead of divided.
+constexpr std::size_t roundUpToPowerOfTwo(std::size_t value) {
+    std::size_t result = 2;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Tells the CPU that the thread is spinning, which saves power and lets a sibling
+// hyper-thread run while a waiting receiver polls a ring.
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// True for the fixed capacities the rings take: 0 (chosen at run time) or a power of two.
+constexpr bool isRingCapacity(std::size_t capacity) {
+    return capacity == 0 || (capacity >= 2 && (capacity & (capacity - 1)) == 0);
+}
+
+/*
+SpscRing is a bounded, lock-free ring buffer for exactly one sending thread and one
+receiving thread, which is what a point-to-point link needs.
+
+The producer only writes 'tail' and the consumer only writes 'head'. Each side also keeps a
+private copy of the other side's index and only reloads it when the ring looks full (or
+empty), so in the common case neither side touches the other side's cache line at all.
+Packets are moved in and out of the slots, so a payload is never copied.
+
+With a FixedCapacity (a power of two) the capacity is a compile-time constant and the
+constructor argument is ignored, so indices are masked with an immediate value.
+*/
+template <typename Packet, std::size_t FixedCapacity = 0>
+class SpscRing{
+    static_assert(isRingCapacity(FixedCapacity), "A fixed ring capacity must be a power of two");
+
+public:
+    explicit SpscRing(std::size_t capacity = FixedCapacity)
+        : mask(FixedCapacity != 0 ? FixedCapacity - 1 : roundUpToPowerOfTwo(capacity) - 1), slots(new Packet[ringMask() + 1]) {}
+
+    // Moves 'packet' into the ring and returns true, or returns false (leaving 'packet' alone) if it is full.
+    bool tryPush(Packet& packet) {
+        return tryPushWith([&packet](Packet& slot) { slot = std::move(packet); });
+    }
+
+    // Like tryPush(), but 'fill' writes the packet straight into its slot, which saves moving a
+    // whole packet (inline bytes and all) when it is assembled from parts.
+    template <typename Fill>
+    bool tryPushWith(Fill&& fill) {
+        const std::size_t tail = producer.tail.load(std::memory_order_relaxed);
+        if (tail - producer.cachedHead > ringMask()) {
+            producer.cachedHead = consumer.head.load(std::memory_order_acquire);
+            if (tail - producer.cachedHead > ringMask()) {
+                return false;
+            }
+        }
+        fill(slots[tail & ringMask()]);
+        producer.tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Like tryPushWith() for a burst of up to 'count' packets: 'fill(slot, index)' writes packet
+    // 'index' of the burst. Returns how many fitted; the consumer sees them all with one index update.
+    template <typename Fill>
+    std::size_t tryPushBatchWith(std::size_t count, Fill&& fill) {
+        const std::size_t tail = producer.tail.load(std::memory_order_relaxed);
+        std::size_t space = ringMask() + 1 - (tail - producer.cachedHead);
+        if (space < count) {
+            producer.cachedHead = consumer.head.load(std::memory_order_acquire);
+            space = ringMask() + 1 - (tail - producer.cachedHead);
+        }
+        const std::size_t pushed = count < space ? count : space;
+        for (std::size_t index = 0; index < pushed; ++index) {
+            fill(slots[(tail + index) & ringMask()], index);
+        }
+        if (pushed > 0) {
+            producer.tail.store(tail + pushed, std::memory_order_release);
+        }
+        return pushed;
+    }
+
+    // Moves the oldest packet into 'out' and returns true, or returns false if the ring is empty.
+    bool tryPop(Packet& out) {
+        return tryPopWith([&out](Packet& slot) { out = std::move(slot); });
+    }
+
+    // Like tryPop(), but 'take' moves what it needs out of the oldest slot itself.
+    template <typename Take>
+    bool tryPopWith(Take&& take) {
+        const std::size_t head = consumer.head.load(std::memory_order_relaxed);
+        if (head == consumer.cachedTail) {
+            consumer.cachedTail = producer.tail.load(std::memory_order_acquire);
+            if (head == consumer.cachedTail) {
+                return false;
+            }
+        }
+        take(slots[head & ringMask()]);
+        consumer.head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Like tryPopWith() for up to 'maxCount' packets: 'take(slot, index)' empties the slot of packet
+    // 'index' of the burst. Returns how many were taken.
+    template <typename Take>
+    std::size_t tryPopBatchWith(std::size_t maxCount, Take&& take) {
+        const std::size_t head = consumer.head.load(std::memory_order_relaxed);
+        std::size_t ready = consumer.cachedTail - head;
+        if (ready < maxCount) {
+            consumer.cachedTail = producer.tail.load(std::memory_order_acquire);
+            ready = consumer.cachedTail - head;
+        }
+        const std::size_t popped = maxCount < ready ? maxCount : ready;
+        for (std::size_t index = 0; index < popped; ++index) {
+            take(slots[(head + index) & ringMask()], index);
+        }
+        if (popped > 0) {
+            consumer.head.store(head + popped, std::memory_order_release);
+        }
+        return popped;
+    }
+
+    // True if no packet is waiting. Exact when called from the consumer thread.
+    bool empty() const {
+        return consumer.head.load(std::memory_order_acquire) == producer.tail.load(std::memory_order_acquire);
+    }
+
+    // Number of waiting packets (a snapshot while the other side keeps running).
+    std::size_t size() const {
+        return producer.tail.load(std::memory_order_acquire) - consumer.head.load(std::memory_order_acquire);
+    }
+
+    // Calls visit(packet) for every waiting packet, oldest first, leaving them in the ring. Only
+    // meaningful while neither side is using the ring (e.g. while it is checkpointed).
+    template <typename Visit>
+    void forEach(Visit&& visit) const {
+        const std::size_t tail = producer.tail.load(std::memory_order_acquire);
+        for (std::size_t index = consumer.head.load(std::memory_order_acquire); index != tail; ++index) {
+            visit(static_cast<const Packet&>(slots[index & ringMask()]));
+        }
+    }
+
+    std::size_t capacity() const { return ringMask() + 1; }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) ProducerSide {
+        std::atomic<std::size_t> tail{0};
+        std::size_t cachedHead = 0;     // Last head value seen by the producer.
+    };
+    struct alignas(CACHE_LINE_SIZE) ConsumerSide {
+        std::atomic<std::size_t> head{0};
+        std::size_t cachedTail = 0;     // Last tail value seen by the consumer.
+    };
+
+    const std::size_t mask;
+    std::unique_ptr<Packet[]> slots;
+    ProducerSide producer;
+    ConsumerSide consumer;
+
+    constexpr std::size_t ringMask() const { return FixedCapacity != 0 ? FixedCapacity - 1 : mask; }
+};
+
+/*
+MpscRing is a bounded, lock-free ring buffer for any number of sending threads and a
+single receiving thread, which is what the shared bus needs.
+
+Every slot carries a sequence number that tells whether it is free for the producer that
+claimed it or filled for the consumer (the scheme of Dmitry Vyukov's bounded queue).
+Producers claim a slot with one compare-and-swap on 'tail'; the consumer needs no atomic
+read-modify-write at all. Slots are padded to a cache line so neighbouring producers do not
+disturb each other. FixedCapacity works as for SpscRing.
+*/
+template <typename Packet, std::size_t FixedCapacity = 0>
+class MpscRing{
+    static_assert(isRingCapacity(FixedCapacity), "A fixed ring capacity must be a power of two");
+
+public:
+    explicit MpscRing(std::size_t capacity = FixedCapacity)
+        : mask(FixedCapacity != 0 ? FixedCapacity - 1 : roundUpToPowerOfTwo(capacity) - 1), slots(new Slot[ringMask() + 1]) {
+        for (std::size_t i = 0; i <= ringMask(); ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Moves 'packet' into the ring and returns true, or returns false (leaving 'packet' alone) if it is full.
+    bool tryPush(Packet& packet) {
+        return tryPushWith([&packet](Packet& slot) { slot = std::move(packet); });
+    }
+
+    // Like tryPush(), but 'fill' writes the packet straight into its slot (see SpscRing).
+    template <typename Fill>
+    bool tryPushWith(Fill&& fill) {
+        std::size_t tail = producers.tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[tail & ringMask()];
+            const std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence - tail);
+            if (difference == 0) {
+                // The slot is free: try to claim it
+                if (producers.tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                    fill(slot.packet);
+                    slot.sequence.store(tail + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                // The slot still holds a packet from one lap earlier: the ring is full
+                return false;
+            } else {
+                // Another producer claimed this slot first
+                tail = producers.tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Like tryPushWith() for a burst of up to 'count' packets (see SpscRing). The slots of a burst
+    // are claimed with a single compare-and-swap as far as they are free. Fewer packets than
+    // would fit may be pushed while other producers are busy; calling again pushes more.
+    template <typename Fill>
+    std::size_t tryPushBatchWith(std::size_t count, Fill&& fill) {
+        std::size_t tail = producers.tail.load(std::memory_order_relaxed);
+        std::size_t wanted = count;
+        while (wanted > 0) {
+            // The consumer's index may lag behind its slots, which only makes the estimate smaller
+            const std::size_t head = consumer.head.load(std::memory_order_relaxed);
+            const std::size_t used = static_cast<std::ptrdiff_t>(tail - head) > 0 ? tail - head : 0;
+            const std::size_t space = used < ringMask() + 1 ? ringMask() + 1 - used : 0;
+            std::size_t claim = wanted < space ? wanted : space;
+            if (claim == 0) {
+                claim = 1;      // Let the slot itself tell whether the ring is full
+            }
+            // Once the last slot of the run has been emptied, so have the ones before it
+            const Slot& last = slots[(tail + claim - 1) & ringMask()];
+            const std::ptrdiff_t difference =
+                static_cast<std::ptrdiff_t>(last.sequence.load(std::memory_order_acquire) - (tail + claim - 1));
+            if (difference == 0) {
+                if (producers.tail.compare_exchange_weak(tail, tail + claim, std::memory_order_relaxed)) {
+                    for (std::size_t index = 0; index < claim; ++index) {
+                        Slot& slot = slots[(tail + index) & ringMask()];
+                        fill(slot.packet, index);
+                        slot.sequence.store(tail + index + 1, std::memory_order_release);
+                    }
+                    return claim;
+                }
+            } else if (difference < 0) {
+                if (claim == 1) {
+                    return 0;   // The ring is full
+                }
+                wanted = claim / 2;
+            } else {
+                tail = producers.tail.load(std::memory_order_relaxed);
+            }
+        }
+        return 0;
+    }
+
+    // Moves the oldest packet into 'out' and returns true, or returns false if the ring is empty.
+    // Must only be called from the single consumer thread.
+    bool tryPop(Packet& out) {
+        return tryPopWith([&out](Packet& slot) { out = std::move(slot); });
+    }
+
+    // Like tryPop(), but 'take' moves what it needs out of the oldest slot itself.
+    template <typename Take>
+    bool tryPopWith(Take&& take) {
+        const std::size_t head = consumer.head.load(std::memory_order_relaxed);
+        Slot& slot = slots[head & ringMask()];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+            return false;
+        }
+        take(slot.packet);
+        slot.sequence.store(head + ringMask() + 1, std::memory_order_release);
+        consumer.head.store(head + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Like tryPopWith() for up to 'maxCount' packets (see SpscRing). Consumer thread only.
+    template <typename Take>
+    std::size_t tryPopBatchWith(std::size_t maxCount, Take&& take) {
+        const std::size_t head = consumer.head.load(std::memory_order_relaxed);
+        std::size_t popped = 0;
+        while (popped < maxCount) {
+            Slot& slot = slots[(head + popped) & ringMask()];
+            if (slot.sequence.load(std::memory_order_acquire) != head + popped + 1) {
+                break;
+            }
+            take(slot.packet, popped);
+            slot.sequence.store(head + popped + ringMask() + 1, std::memory_order_release);
+            ++popped;
+        }
+        if (popped > 0) {
+            consumer.head.store(head + popped, std::memory_order_relaxed);
+        }
+        return popped;
+    }
+
+    // True if no packet is ready for the consumer. Exact when called from the consumer thread.
+    bool empty() const {
+        const std::size_t head = consumer.head.load(std::memory_order_relaxed);
+        return slots[head & ringMask()].sequence.load(std::memory_order_acquire) != head + 1;
+    }
+
+    // Number of claimed slots (a snapshot while producers keep running).
+    std::size_t size() const {
+        const std::size_t tail = producers.tail.load(std::memory_order_acquire);
+        const std::size_t head = consumer.head.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    // Calls visit(packet) for every waiting packet, oldest first, leaving them in the ring. Only
+    // meaningful while no thread is using the ring (e.g. while it is checkpointed).
+    template <typename Visit>
+    void forEach(Visit&& visit) const {
+        const std::size_t tail = producers.tail.load(std::memory_order_acquire);
+        for (std::size_t index = consumer.head.load(std::memory_order_acquire); index < tail; ++index) {
+            visit(static_cast<const Packet&>(slots[index & ringMask()].packet));
+        }
+    }
+
+    std::size_t capacity() const { return ringMask() + 1; }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<std::size_t> sequence{0};
+        Packet packet;
+    };
+    struct alignas(CACHE_LINE_SIZE) ProducerSide {
+        std::atomic<std::size_t> tail{0};
+    };
+    struct alignas(CACHE_LINE_SIZE) ConsumerSide {
+        std::atomic<std::size_t> head{0};
+    };
+
+    const std::size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    ProducerSide producers;
+    ConsumerSide consumer;
+
+    constexpr std::size_t ringMask() const { return FixedCapacity != 0 ? FixedCapacity - 1 : mask; }
+};
+
+/*
+UnboundedRing is the single-threaded queue of the Queue backend: a ring buffer that doubles
+its slot array when it runs full and never gives it back. Unlike a std::deque, which frees
+and allocates a chunk every few hundred bytes of traffic, a queue that has reached its
+working size allocates nothing more, and packets with inline bytes sit directly in the
+slots. pop_front() leaves the slot as it is: the caller is expected to have moved the packet
+out (or to reset it, if the packet is dropped), so no pooled block stays behind in the ring.
+*/
+template <typename Packet>
+class UnboundedRing{
+public:
+    bool empty() const { return count == 0; }
+    std::size_t size() const { return count; }
+
+    // The oldest packet, and the packet 'index' places behind it.
+    Packet& front() { return slots[head]; }
+    Packet& operator[](std::size_t index) { return slots[(head + index) & mask]; }
+    const Packet& operator[](std::size_t index) const { return slots[(head + index) & mask]; }
+
+    void push_back(Packet&& packet) {
+        pushBack() = std::move(packet);
+    }
+
+    // Appends a slot and returns it for the caller to fill in place, saving a move of the packet.
+    Packet& pushBack() {
+        if (count == capacity) {
+            grow();
+        }
+        return slots[(head + count++) & mask];
+    }
+
+    void pop_front() {
+        head = (head + 1) & mask;
+        --count;
+    }
+
+private:
+    static constexpr std::size_t INITIAL_CAPACITY = 16;
+
+    std::unique_ptr<Packet[]> slots;
+    std::size_t capacity = 0;
+    std::size_t mask = 0;
+    std::size_t head = 0;
+    std::size_t count = 0;
+
+    // Moves the packets, oldest first, to the front of an array twice the size
+    void grow() {
+        const std::size_t newCapacity = capacity == 0 ? INITIAL_CAPACITY : capacity * 2;
+        std::unique_ptr<Packet[]> newSlots(new Packet[newCapacity]);
+        for (std::size_t index = 0; index < count; ++index) {
+            newSlots[index] = std::move(slots[(head + index) & mask]);
+        }
+        slots = std::move(newSlots);
+        capacity = newCapacity;
+        mask = newCapacity - 1;
+        head = 0;
+    }
+};
+
+
+#endif  // End PACKET_RING_H
\ No newline at end of file
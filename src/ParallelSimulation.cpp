@@ -0,0 +1,238 @@
+#include "ParallelSimulation.h"
+#include <algorithm>
+#include <barrier>
+#include <stdexcept>
+#include <thread>
+
+Shard::Shard(ParallelSimulation& simulation, std::size_t index, std::size_t shardCount)
+    : simulation(simulation), index(index), outboxes(shardCount) {}
+
+NetworkMedium& Shard::addMedium(MediumBackend backend, const LinkTiming& timing) {
+    media.push_back(std::make_unique<NetworkMedium>(backend));
+    media.back()->attachScheduler(scheduler, timing);
+    return *media.back();
+}
+
+Node& Shard::addNode(std::unique_ptr<Node> node) {
+    nodes.push_back(std::move(node));
+    return *nodes.back();
+}
+
+// Empties every other shard's outbox for this shard. Frames due at the same time are scheduled
+// by link and then in sending order (one link's frames all come from one outbox, in that order),
+// so the order does not depend on which shard sent them.
+void Shard::collectMail() {
+    incoming.clear();
+    for (std::size_t source = 0; source < simulation.shards.size(); ++source) {
+        for (Mail& mail : simulation.shards[source]->outboxes[index]) {
+            incoming.push_back(&mail);
+        }
+    }
+    std::stable_sort(incoming.begin(), incoming.end(), [](const Mail* a, const Mail* b) {
+        return a->arrival != b->arrival ? a->arrival < b->arrival : a->link->id < b->link->id;
+    });
+    for (Mail* mail : incoming) {
+        mail->link->accept(*mail);
+    }
+    for (std::size_t source = 0; source < simulation.shards.size(); ++source) {
+        simulation.shards[source]->outboxes[index].clear();
+    }
+    nextEventTime = scheduler.empty() ? NEVER : scheduler.nextEventTime();
+}
+
+CrossShardLink::CrossShardLink(Shard& from, Shard& to, NetworkMedium& destination, SimTime latency, std::size_t id)
+    : from(from), to(to), destination(destination), latency(latency), id(id) {}
+
+// Posts the frame to the destination shard's mailbox; it is picked up at the next barrier
+void CrossShardLink::send(RawPacket&& packet) {
+    from.outboxes[to.index].push_back(Shard::Mail{from.scheduler.now() + latency, this, std::move(packet)});
+}
+
+// Keeps the frame until its arrival time, on the destination shard's clock
+void CrossShardLink::accept(Shard::Mail& mail) {
+    std::size_t slot;
+    if (!freeArrived.empty()) {
+        slot = freeArrived.back();
+        freeArrived.pop_back();
+    } else {
+        slot = arrived.size();
+        arrived.emplace_back();
+    }
+    arrived[slot] = std::move(mail.packet);
+    to.scheduler.schedule(mail.arrival, this, slot);
+}
+
+void CrossShardLink::onEvent(SimTime, std::uint64_t cookie) {
+    destination.injectPacket(std::move(arrived[cookie]));
+    arrived[cookie] = RawPacket();
+    freeArrived.push_back(cookie);
+}
+
+ParallelSimulation::ParallelSimulation(std::size_t shardCount, std::uint64_t seed) : streams(seed) {
+    const std::size_t count = std::max<std::size_t>(shardCount, 1);
+    for (std::size_t index = 0; index < count; ++index) {
+        shards.push_back(std::unique_ptr<Shard>(new Shard(*this, index, count)));
+    }
+}
+
+ParallelSimulation::~ParallelSimulation() = default;
+
+CrossShardLink& ParallelSimulation::connect(Shard& from, Shard& to, NetworkMedium& destination, SimTime latency) {
+    if (latency == 0) {
+        throw std::invalid_argument("CrossShardLink latency must be greater than zero");
+    }
+    links.push_back(std::unique_ptr<CrossShardLink>(new CrossShardLink(from, to, destination, latency, links.size())));
+    lookahead = std::min(lookahead, latency);
+    return *links.back();
+}
+
+RemotePeer& ParallelSimulation::addPeer(int socket) {
+    peers.push_back(std::unique_ptr<RemotePeer>(new RemotePeer(socket)));
+    return *peers.back();
+}
+
+RemoteLink& ParallelSimulation::connectRemote(Shard& from, RemotePeer& peer, std::uint32_t linkId, SimTime latency,
+                                              const RemoteLinkConfig& config) {
+    if (latency == 0) {
+        throw std::invalid_argument("RemoteLink latency must be greater than zero");
+    }
+    remoteLinks.push_back(std::unique_ptr<RemoteLink>(new RemoteLink(from, peer, linkId, latency, config)));
+    lookahead = std::min(lookahead, latency);
+    return *remoteLinks.back();
+}
+
+// The frames arrive through a CrossShardLink that only ever delivers, on the destination shard's clock
+void ParallelSimulation::acceptRemote(std::uint32_t linkId, Shard& to, NetworkMedium& destination) {
+    if (remoteInputById.count(linkId) != 0) {
+        throw std::invalid_argument("Remote link " + std::to_string(linkId) + " already has a destination");
+    }
+    remoteInputs.push_back(std::unique_ptr<CrossShardLink>(new CrossShardLink(to, to, destination, 0, linkId)));
+    remoteInputById[linkId] = remoteInputs.back().get();
+}
+
+// The hosts must cut the same windows, so they take the smallest lookahead of them all
+void ParallelSimulation::greetPeers(SimTime endTime) {
+    windowLength = lookahead;
+    for (std::unique_ptr<RemotePeer>& peer : peers) {
+        peer->sendHello(lookahead, endTime);
+    }
+    for (std::unique_ptr<RemotePeer>& peer : peers) {
+        const RemotePeer::Hello hello = peer->awaitHello();
+        if (hello.endTime != endTime) {
+            throw std::runtime_error("The hosts of a distributed run were given different end times");
+        }
+        windowLength = std::min(windowLength, hello.lookahead);
+    }
+}
+
+// Frames sent during the window count towards the earliest time, since they are events on another host
+SimTime ParallelSimulation::exchangeWithPeers(SimTime localEarliest) {
+    for (std::unique_ptr<RemoteLink>& link : remoteLinks) {
+        localEarliest = std::min(localEarliest, link->takeEarliestArrival());
+        link->flush();
+    }
+    for (std::unique_ptr<RemotePeer>& peer : peers) {
+        peer->sendWindowEnd(localEarliest);
+    }
+    SimTime earliest = localEarliest;
+    remoteIncoming.clear();
+    for (std::unique_ptr<RemotePeer>& peer : peers) {
+        earliest = std::min(earliest, peer->awaitWindowEnd(remoteIncoming));
+    }
+    // Same order as collectMail(): by arrival time, then by link, then in sending order
+    std::stable_sort(remoteIncoming.begin(), remoteIncoming.end(),
+                     [](const RemotePeer::IncomingFrame& a, const RemotePeer::IncomingFrame& b) {
+                         return a.arrival != b.arrival ? a.arrival < b.arrival : a.linkId < b.linkId;
+                     });
+    for (RemotePeer::IncomingFrame& frame : remoteIncoming) {
+        const auto input = remoteInputById.find(frame.linkId);
+        if (input == remoteInputById.end()) {
+            throw std::runtime_error("A peer sent frames on remote link " + std::to_string(frame.linkId) +
+                                     ", which has no destination here");
+        }
+        Shard::Mail mail{frame.arrival, input->second, std::move(frame.packet)};
+        input->second->accept(mail);
+    }
+    return earliest;
+}
+
+// The window starts at the earliest pending event anywhere and lasts one lookahead
+void ParallelSimulation::planWindow(SimTime endTime) {
+    SimTime earliest = NEVER;
+    for (const std::unique_ptr<Shard>& shard : shards) {
+        earliest = std::min(earliest, shard->nextEventTime);
+    }
+    if (!peers.empty()) {
+        // The completion step must not throw; a failed exchange ends the run on every host
+        try {
+            earliest = exchangeWithPeers(earliest);
+        } catch (const std::exception& error) {
+            failure = error.what();
+            for (std::unique_ptr<RemotePeer>& peer : peers) {
+                peer->abort();
+            }
+            finished = true;
+            return;
+        }
+    }
+    if (earliest == NEVER || earliest > endTime) {
+        finished = true;
+        return;
+    }
+    // windowEnd is exclusive; guard against running past 'endTime' or overflowing
+    const SimTime limit = endTime == NEVER ? NEVER : endTime + 1;
+    windowEnd = (windowLength >= limit - earliest) ? limit : earliest + windowLength;
+    ++windows;
+}
+
+template <typename Barrier>
+void ParallelSimulation::runShard(Shard& shard, Barrier& barrier) {
+    for (std::unique_ptr<Node>& node : shard.nodes) {
+        node->start(shard.scheduler);
+    }
+    barrier.arrive_and_wait();     // Every shard has started and posted its first frames
+    for (;;) {
+        shard.collectMail();
+        barrier.arrive_and_wait();     // Completion step: planWindow()
+        if (finished) {
+            return;
+        }
+        // Run the window without moving the clock past the last event it contained
+        while (!shard.scheduler.empty() && shard.scheduler.nextEventTime() < windowEnd) {
+            shard.scheduler.step();
+        }
+        barrier.arrive_and_wait();     // Everyone finished the window; mail can be collected
+    }
+}
+
+void ParallelSimulation::run(SimTime endTime) {
+    finished = false;
+    windows = 0;
+    failure.clear();
+    windowLength = lookahead;
+    if (!peers.empty()) {
+        greetPeers(endTime);
+    }
+    // The completion step runs on one thread while all others wait, so it can freely
+    // read every shard's published time and write the shared window fields.
+    bool planning = false;
+    auto completion = [this, endTime, &planning]() noexcept {
+        if (planning) {
+            planWindow(endTime);
+        }
+        planning = !planning;
+    };
+    std::barrier barrier(static_cast<std::ptrdiff_t>(shards.size()), completion);
+
+    std::vector<std::thread> workers;
+    for (std::size_t index = 1; index < shards.size(); ++index) {
+        workers.emplace_back([this, index, &barrier]() { runShard(*shards[index], barrier); });
+    }
+    runShard(*shards[0], barrier);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (!failure.empty()) {
+        throw std::runtime_error("Distributed run stopped: " + failure);
+    }
+}
\ No newline at end of file
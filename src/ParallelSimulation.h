@@ -0,0 +1,215 @@
+#ifndef PARALLEL_SIMULATION_H    // This will ensure no repeat definition of this header file.
+#define PARALLEL_SIMULATION_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "NetworkMedium.h"
+#include "Node.h"
+#include "Random.h"
+#include "RemoteLink.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ParallelSimulation;
+class CrossShardLink;
+
+// A time later than any event; used for "no event pending" and "no limit".
+constexpr SimTime NEVER = std::numeric_limits<SimTime>::max();
+
+/*
+A Shard is one partition of the topology: a group of Nodes and media together with the
+EventScheduler that drives them. A shard is run by exactly one worker thread, so everything
+inside it stays single-threaded; shards only talk to each other through CrossShardLinks.
+*/
+class Shard{
+public:
+    std::size_t getIndex() const { return index; }
+    EventScheduler& getScheduler() { return scheduler; }
+
+    // Creates a medium owned by this shard and puts it on the shard's virtual clock.
+    NetworkMedium& addMedium(MediumBackend backend = MediumBackend::Queue, const LinkTiming& timing = LinkTiming());
+
+    // Adds a node to this shard; the shard takes ownership of it.
+    Node& addNode(std::unique_ptr<Node> node);
+
+private:
+    friend class ParallelSimulation;
+    friend class CrossShardLink;
+
+    // A frame travelling to another shard.
+    struct Mail {
+        SimTime arrival;
+        CrossShardLink* link;
+        RawPacket packet;
+    };
+
+    Shard(ParallelSimulation& simulation, std::size_t index, std::size_t shardCount);
+
+    ParallelSimulation& simulation;
+    const std::size_t index;
+    EventScheduler scheduler;
+    std::vector<std::unique_ptr<NetworkMedium>> media;
+    std::vector<std::unique_ptr<Node>> nodes;
+
+    // outboxes[d] holds frames for shard d. Only this shard's thread writes it while running a
+    // window, and only shard d's thread reads and empties it between the two barriers.
+    std::vector<std::vector<Mail>> outboxes;
+
+    SimTime nextEventTime = NEVER;      // Published at the barrier; NEVER if no event is pending.
+
+    std::vector<Mail*> incoming;        // Scratch space of collectMail().
+
+    // Takes the frames other shards sent here and schedules their arrival.
+    void collectMail();
+};
+
+/*
+CrossShardLink is a one-way link from a node in one shard to a medium in another shard.
+Its latency is what makes the parallel run possible: a frame sent at time t cannot arrive
+before t + latency, so shards may run that far ahead of each other without waiting.
+The receiving end of a RemoteLink is a CrossShardLink too, one that only delivers.
+*/
+class CrossShardLink : public EventTarget{
+public:
+    SimTime getLatency() const { return latency; }
+
+    // Sends a frame to the destination medium; it arrives 'latency' after the sender's
+    // current time. Must be called from the sending shard's thread.
+    void send(RawPacket&& packet);
+
+    // Delivers an arrived frame into the destination medium.
+    void onEvent(SimTime now, std::uint64_t cookie) override;
+
+private:
+    friend class ParallelSimulation;
+    friend class Shard;
+
+    CrossShardLink(Shard& from, Shard& to, NetworkMedium& destination, SimTime latency, std::size_t id);
+
+    Shard& from;
+    Shard& to;
+    NetworkMedium& destination;
+    const SimTime latency;
+    const std::size_t id;               // Position in the order the links were created.
+
+    // Frames that reached the destination shard and wait for their arrival event.
+    std::vector<RawPacket> arrived;
+    std::vector<std::size_t> freeArrived;
+
+    void accept(Shard::Mail& mail);
+};
+
+/*
+ParallelSimulation runs a partitioned topology on several cores. Every shard gets its own
+worker thread; the threads advance in windows with conservative synchronization:
+
+1. All shards agree on the earliest pending event time T over the whole simulation.
+2. Every shard runs its own events with times in [T, T + lookahead), where lookahead is the
+   smallest CrossShardLink latency. No frame from another shard can arrive inside the
+   window, so the shards do not need to talk while they run it.
+3. At a barrier the shards swap the frames they sent each other, then go back to step 1.
+
+Frames are handed over through per-pair outboxes that have a single writer and a single
+reader separated by the barrier, so no locks are involved.
+
+Every run with the same seed produces the same result, no matter how the threads are
+scheduled. Within a shard, events at the same time fire in the order they were scheduled.
+Frames from other shards are scheduled at the barrier in one fixed order: by arrival time,
+then by link (in the order the links were created), then in the order they were sent.
+Random numbers come from RandomStreams derived from the run seed, one stream per component,
+so no generator is shared between threads.
+
+A topology too big for one machine runs on several hosts, each with a ParallelSimulation of
+its own, connected to each other with addPeer(). RemoteLinks carry frames between hosts, and
+the window plan includes the peers: once per window every host sends its peers the batches
+of frames for them and its earliest event time, and the next window starts at the earliest
+time of all hosts. Frames from peers are scheduled in the same fixed order as local ones, so
+a distributed run is as reproducible as a local one.
+*/
+class ParallelSimulation{
+public:
+    explicit ParallelSimulation(std::size_t shardCount, std::uint64_t seed = 1);
+    ~ParallelSimulation();
+
+    std::size_t shardCount() const { return shards.size(); }
+
+    // The streams of the run seed, for seeding the impairments, queue limits and nodes of
+    // every shard (e.g. seedFor("<medium name>")).
+    const RandomStreams& getRandomStreams() const { return streams; }
+    Shard& getShard(std::size_t index) { return *shards[index]; }
+
+    // Creates a link from shard 'from' to 'destination', a medium owned by shard 'to'.
+    // 'latency' must be greater than zero.
+    CrossShardLink& connect(Shard& from, Shard& to, NetworkMedium& destination, SimTime latency);
+
+    // The window length: the smallest latency of all cross-shard links.
+    SimTime getLookahead() const { return lookahead; }
+
+    // Adds the host at the other end of the connected TCP socket 'socket' (see
+    // RemotePeer::acceptConnection() and openConnection()), which runs another part of the
+    // topology. The simulation takes over the socket. Every host must be a peer of every other.
+    RemotePeer& addPeer(int socket);
+
+    // Creates a link from shard 'from' to the medium the host 'peer' routes 'linkId' to (see
+    // acceptRemote()). Ids identify links across all hosts, so each must be used only once.
+    // 'latency' must be greater than zero.
+    RemoteLink& connectRemote(Shard& from, RemotePeer& peer, std::uint32_t linkId, SimTime latency,
+                              const RemoteLinkConfig& config = RemoteLinkConfig());
+
+    // Delivers the frames that peers send on the link 'linkId' into 'destination', a medium
+    // owned by the shard 'to'.
+    void acceptRemote(std::uint32_t linkId, Shard& to, NetworkMedium& destination);
+
+    // Starts all nodes and runs every shard until no event is left or the next event is
+    // later than 'endTime'. Shard 0 runs on the calling thread, the others on new threads.
+    // With peers, every host must call run() with the same 'endTime', and the runs end
+    // together. Throws std::runtime_error if a peer fails or disagrees about 'endTime'.
+    void run(SimTime endTime = NEVER);
+
+    // Number of synchronization windows the last run() needed.
+    std::uint64_t windowCount() const { return windows; }
+
+private:
+    friend class Shard;
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<std::unique_ptr<CrossShardLink>> links;
+    SimTime lookahead = NEVER;
+    RandomStreams streams;
+
+    // Other hosts, the links to them, and the local ends of their links to us (by link id)
+    std::vector<std::unique_ptr<RemotePeer>> peers;
+    std::vector<std::unique_ptr<RemoteLink>> remoteLinks;
+    std::vector<std::unique_ptr<CrossShardLink>> remoteInputs;
+    std::unordered_map<std::uint32_t, CrossShardLink*> remoteInputById;
+    std::vector<RemotePeer::IncomingFrame> remoteIncoming;      // Scratch space of exchangeWithPeers().
+
+    // Shared between the threads; only changed by the barrier's completion step.
+    SimTime windowEnd = 0;
+    SimTime windowLength = NEVER;   // The lookahead of this run, over all hosts.
+    bool finished = false;
+    std::uint64_t windows = 0;
+    std::string failure;            // Why the peers could not go on; empty while all is well.
+
+    // Runs on every shard's thread: start the nodes, then loop over the windows.
+    template <typename Barrier>
+    void runShard(Shard& shard, Barrier& barrier);
+
+    // Picks the next window from the published event times; runs between two barrier phases.
+    void planWindow(SimTime endTime);
+
+    // Agrees with every peer on the run's lookahead and end time.
+    void greetPeers(SimTime endTime);
+
+    // Ships the window's batches and 'localEarliest' to the peers, schedules the frames they
+    // sent, and returns the earliest event time over all hosts.
+    SimTime exchangeWithPeers(SimTime localEarliest);
+};
+
+
+#endif  // End PARALLEL_SIMULATION_H
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "QueueLimit.h"
+#include "Checkpoint.h"
+#include <algorithm>
+#include <cmath>
+
+QueueLimit::QueueLimit(const QueueLimitConfig& config) : config(config), random(config.seed) {}
+
+bool QueueLimit::fits(std::size_t bytes) const {
+    if (config.maxFrames != 0 && counters.frames + 1 > config.maxFrames) {
+        return false;
+    }
+    return config.maxBytes == 0 || counters.bytes + bytes <= config.maxBytes;
+}
+
+Admission QueueLimit::admit(std::size_t bytes, bool canDropOldest) {
+    if (config.policy == OverflowPolicy::Red && redDrop()) {
+        ++counters.earlyDrops;
+        return Admission::Drop;
+    }
+    if (!fits(bytes)) {
+        if (config.policy == OverflowPolicy::HeadDrop && canDropOldest) {
+            ++counters.headDrops;
+            return Admission::DropOldest;
+        }
+        if (config.policy == OverflowPolicy::Backpressure) {
+            ++counters.refused;
+            return Admission::Refuse;
+        }
+        ++counters.tailDrops;
+        return Admission::Drop;
+    }
+    ++counters.accepted;
+    ++counters.frames;
+    counters.bytes += bytes;
+    counters.highWaterFrames = std::max(counters.highWaterFrames, counters.frames);
+    counters.highWaterBytes = std::max(counters.highWaterBytes, counters.bytes);
+    return Admission::Accept;
+}
+
+void QueueLimit::remove(std::size_t bytes) {
+    counters.frames -= std::min<std::size_t>(counters.frames, 1);
+    counters.bytes -= std::min(counters.bytes, bytes);
+}
+
+void QueueLimit::countWaitingFrames(std::size_t frames) {
+    counters.frames += frames;
+    counters.highWaterFrames = std::max(counters.highWaterFrames, counters.frames);
+}
+
+// The drop probability rises linearly between the two thresholds of the average depth
+bool QueueLimit::redDrop() {
+    const bool inFrames = config.maxFrames != 0;
+    const double capacity = static_cast<double>(inFrames ? config.maxFrames : config.maxBytes);
+    if (capacity == 0) {
+        return false;
+    }
+    const double depth = static_cast<double>(inFrames ? counters.frames : counters.bytes);
+    averageDepth += config.redWeight * (depth - averageDepth);
+
+    const double fill = averageDepth / capacity;
+    if (fill < config.redMinThreshold) {
+        return false;
+    }
+    if (fill >= config.redMaxThreshold) {
+        return true;
+    }
+    const double probability = config.redMaxProbability * (fill - config.redMinThreshold) /
+                               (config.redMaxThreshold - config.redMinThreshold);
+    return random.nextUnit() < probability;
+}
+
+// A single waiting frame is never a standing queue, however long it has waited
+bool QueueLimit::codelDrop(SimTime sojourn, SimTime now) {
+    if (!codel.shouldDrop(sojourn, now, counters.frames > 1, config.codelTarget, config.codelInterval)) {
+        return false;
+    }
+    ++counters.codelDrops;
+    return true;
+}
+
+// Drops get closer together the longer the delay stays above the target (RFC 8289)
+bool CodelState::shouldDrop(SimTime sojourn, SimTime now, bool standingQueue, SimTime target, SimTime interval) {
+    auto controlLaw = [this, interval](SimTime time) {
+        return time + static_cast<SimTime>(interval / std::sqrt(static_cast<double>(dropCount)));
+    };
+    bool okToDrop = false;
+    if (sojourn < target || !standingQueue) {
+        firstAboveTime = 0;
+    } else if (firstAboveTime == 0) {
+        firstAboveTime = now + interval;
+    } else if (now >= firstAboveTime) {
+        okToDrop = true;
+    }
+
+    if (dropping) {
+        if (!okToDrop) {
+            dropping = false;
+            return false;
+        }
+        if (now < dropNext) {
+            return false;
+        }
+        ++dropCount;
+        dropNext = controlLaw(dropNext);
+        return true;
+    }
+    if (!okToDrop) {
+        return false;
+    }
+    // Entering the dropping state; resume the old drop rate if it was left only recently
+    dropping = true;
+    const std::uint32_t delta = dropCount - lastDropCount;
+    const bool recently = now < dropNext || now - dropNext < 16 * interval;
+    dropCount = (delta > 1 && recently) ? delta : 1;
+    lastDropCount = dropCount;
+    dropNext = controlLaw(now);
+    return true;
+}
+
+void QueueLimit::saveState(CheckpointWriter& writer) const {
+    writer.put(counters);
+    writer.put(random);
+    writer.put(averageDepth);
+    writer.put(codel);
+}
+
+void QueueLimit::restoreState(CheckpointReader& reader) {
+    reader.get(counters);
+    reader.get(random);
+    reader.get(averageDepth);
+    reader.get(codel);
+}
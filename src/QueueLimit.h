@@ -0,0 +1,139 @@
+#ifndef QUEUE_LIMIT_H    // This will ensure no repeat definition of this header file.
+#define QUEUE_LIMIT_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "Random.h"
+#include <cstddef>
+#include <cstdint>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// What a full medium does with a frame that does not fit.
+enum class OverflowPolicy {
+    TailDrop,       // The new frame is dropped.
+    HeadDrop,       // The oldest waiting frames are dropped to make room for the new one.
+    Red,            // Random Early Detection: frames are dropped at random before the buffer
+                    // is full, more often the longer the average queue gets.
+    CoDel,          // Controlled Delay: frames are dropped at the receiving end while they
+                    // have been waiting longer than a target delay for too long.
+    Backpressure,   // Nothing is dropped; the medium refuses the frame and the sender keeps it.
+};
+
+/*
+QueueLimitConfig bounds the buffer of a medium. A limit of 0 means "no limit" for that unit;
+when both are set a frame has to fit into both. Whatever the policy, a frame that does not
+fit is never queued: RED and CoDel drop early, in addition to dropping at the tail when full.
+*/
+struct QueueLimitConfig {
+    std::size_t maxFrames = 0;
+    std::size_t maxBytes = 0;
+    OverflowPolicy policy = OverflowPolicy::TailDrop;
+
+    // RED: thresholds are fractions of the capacity (in frames if 'maxFrames' is set,
+    // otherwise in bytes), compared with an exponentially weighted average of the depth.
+    double redMinThreshold = 0.25;      // Below this nothing is dropped early,
+    double redMaxThreshold = 0.75;      // above this every frame is dropped,
+    double redMaxProbability = 0.1;     // and in between up to this share of frames.
+    double redWeight = 0.002;           // Weight of the current depth in the average.
+
+    // CoDel (RFC 8289): the acceptable standing queue delay, and how long it may be
+    // exceeded before frames are dropped.
+    SimTime codelTarget = 5 * MILLISECOND;
+    SimTime codelInterval = 100 * MILLISECOND;
+
+    std::uint64_t seed = 1;             // Seed of RED's random numbers, for repeatable runs.
+};
+
+// What the buffer has done so far, and how full it is.
+struct QueueCounters {
+    std::uint64_t accepted = 0;
+    std::uint64_t tailDrops = 0;        // Dropped because the buffer was full.
+    std::uint64_t headDrops = 0;        // Dropped from the front to make room.
+    std::uint64_t earlyDrops = 0;       // Dropped by RED before the buffer was full.
+    std::uint64_t codelDrops = 0;       // Dropped by CoDel because they waited too long.
+    std::uint64_t refused = 0;          // Handed back to the sender (Backpressure).
+    std::size_t frames = 0;             // Frames in the buffer now,
+    std::size_t bytes = 0;              // and their bytes.
+    std::size_t highWaterFrames = 0;    // The most frames and bytes ever held at once.
+    std::size_t highWaterBytes = 0;
+};
+
+// The decision QueueLimit::admit() makes for an arriving frame.
+enum class Admission {
+    Accept,
+    Drop,
+    DropOldest,     // Drop the oldest waiting frame, then ask again.
+    Refuse,
+};
+
+/*
+CodelState is the control loop of CoDel (RFC 8289) for one queue. It is asked about the frame
+at the front of the queue before it leaves, and answers whether to drop it instead: once the
+frames have been waiting longer than 'target' for at least 'interval', frames are dropped at
+a rate that grows with the square root of the drops so far, until the delay falls back below
+the target. QueueLimit runs one for the whole buffer, FlowQueue one per flow.
+*/
+class CodelState{
+public:
+    // 'sojourn' is how long the front frame has waited at time 'now'. Without a 'standingQueue'
+    // (a single waiting frame, say) nothing is dropped, however long it has waited.
+    bool shouldDrop(SimTime sojourn, SimTime now, bool standingQueue, SimTime target, SimTime interval);
+
+    bool isDropping() const { return dropping; }
+
+private:
+    SimTime firstAboveTime = 0;         // When the delay may start causing drops; 0 if below target.
+    SimTime dropNext = 0;               // Time of the next drop while dropping.
+    std::uint32_t dropCount = 0;        // Drops since entering the dropping state.
+    std::uint32_t lastDropCount = 0;
+    bool dropping = false;
+};
+
+/*
+QueueLimit keeps the books of a bounded buffer and makes the policy decisions; the medium
+that owns the buffer carries them out. It does not touch any frame itself.
+*/
+class QueueLimit{
+public:
+    explicit QueueLimit(const QueueLimitConfig& config);
+
+    // Decides about a frame of 'bytes' bytes that wants to enter the buffer. 'canDropOldest'
+    // tells whether there is a waiting frame that HeadDrop could remove. On Accept the frame
+    // is counted as part of the buffer.
+    Admission admit(std::size_t bytes, bool canDropOldest);
+
+    // A frame of 'bytes' bytes has left the buffer: received, or dropped by the medium
+    // following DropOldest or codelDrop().
+    void remove(std::size_t bytes);
+
+    // CoDel: asked for the frame at the front of the buffer before it is received. It has
+    // been waiting 'sojourn' at time 'now'; returns true if it should be dropped instead.
+    bool codelDrop(SimTime sojourn, SimTime now);
+
+    const QueueLimitConfig& getConfig() const { return config; }
+    const QueueCounters& getCounters() const { return counters; }
+
+    // Counts frames that were already waiting when the limit was set (their bytes are unknown).
+    void countWaitingFrames(std::size_t frames);
+
+    // Writes the books (counters, RED's average and random numbers, CoDel's state) to a
+    // checkpoint, and reads them back into a limit made from the same config.
+    void saveState(CheckpointWriter& writer) const;
+    void restoreState(CheckpointReader& reader);
+
+private:
+    QueueLimitConfig config;
+    QueueCounters counters;
+    RandomBatch random;
+
+    double averageDepth = 0.0;          // RED's weighted average, in frames or bytes.
+    CodelState codel;
+
+    bool fits(std::size_t bytes) const;
+    bool redDrop();
+};
+
+
+#endif  // End QUEUE_LIMIT_H
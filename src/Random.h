@@ -0,0 +1,188 @@
+#ifndef RANDOM_H    // This will ensure no repeat definition of this header file.
+#define RANDOM_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// SplitMix64 step: turns any 64-bit value into a well mixed one. Used to expand seeds.
+inline std::uint64_t splitMix64(std::uint64_t& state) {
+    std::uint64_t value = (state += 0x9E3779B97F4A7C15ull);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+/*
+Xoshiro256 is the xoshiro256** generator by Blackman and Vigna: small (32 bytes of state),
+fast, and statistically far better than std::rand. It is deterministic for a given seed.
+*/
+class Xoshiro256{
+public:
+    explicit Xoshiro256(std::uint64_t seed = 0) {
+        std::uint64_t state = seed;
+        for (std::uint64_t& word : s) {
+            word = splitMix64(state);
+        }
+    }
+
+    std::uint64_t next() {
+        const std::uint64_t result = rotateLeft(s[1] * 5, 7) * 9;
+        const std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotateLeft(s[3], 45);
+        return result;
+    }
+
+    // Advances the generator by 2^128 values, as if next() had been called that often. A
+    // generator copied and jumped k times yields the k-th of 2^128 sequences that can never
+    // overlap, for code that wants several streams out of one seed.
+    void jump() {
+        static constexpr std::uint64_t JUMP[4] = {0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull,
+                                                  0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull};
+        std::uint64_t jumped[4] = {0, 0, 0, 0};
+        for (const std::uint64_t word : JUMP) {
+            for (int bit = 0; bit < 64; ++bit) {
+                if (word & (std::uint64_t(1) << bit)) {
+                    for (int index = 0; index < 4; ++index) {
+                        jumped[index] ^= s[index];
+                    }
+                }
+                next();
+            }
+        }
+        for (int index = 0; index < 4; ++index) {
+            s[index] = jumped[index];
+        }
+    }
+
+private:
+    std::uint64_t s[4];
+
+    static std::uint64_t rotateLeft(std::uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+};
+
+// FNV-1a hash of a name, so random streams can be keyed by the names of media and nodes.
+inline std::uint64_t streamKey(std::string_view name) {
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    for (const char character : name) {
+        hash = (hash ^ static_cast<unsigned char>(character)) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/*
+RandomStreams turns the one seed of a run into the seeds of every random number generator in
+it: each impairment, queue limit and traffic source asks for the seed of its own stream, named
+by a key (usually its medium's or node's name) and an index. A stream's seed is a function of
+the run seed, the key and the index alone, computed the way a counter-based generator
+(Philox, say) computes its output, by mixing them through SplitMix64. It therefore does not
+depend on the order in which streams are created, on which thread creates them, or on how a
+parallel run is split into shards, and no two components share a generator or a lock.
+
+Runs with the same seed and the same input replay bit for bit; changing the run seed changes
+every stream at once.
+*/
+class RandomStreams{
+public:
+    explicit RandomStreams(std::uint64_t runSeed = 1) : runSeed(runSeed) {}
+
+    std::uint64_t getRunSeed() const { return runSeed; }
+
+    // The seed of stream 'index' of 'key', e.g. for ImpairmentConfig::seed.
+    std::uint64_t seedFor(std::uint64_t key, std::uint64_t index = 0) const {
+        std::uint64_t state = runSeed;
+        state = splitMix64(state) ^ key;
+        state = splitMix64(state) ^ index;
+        return splitMix64(state);
+    }
+
+    std::uint64_t seedFor(std::string_view name, std::uint64_t index = 0) const {
+        return seedFor(streamKey(name), index);
+    }
+
+private:
+    std::uint64_t runSeed;
+};
+
+/*
+RandomBatch draws random numbers from a Xoshiro256 BATCH_SIZE values at a time. The refill
+is one tight loop, and handing out a value is an array read, so code that needs a few random
+numbers per frame pays almost nothing for them.
+*/
+class RandomBatch{
+public:
+    static constexpr std::size_t BATCH_SIZE = 256;
+
+    explicit RandomBatch(std::uint64_t seed = 0) : generator(seed) {}
+
+    // A uniformly distributed 64-bit value.
+    std::uint64_t nextU64() {
+        if (index == BATCH_SIZE) {
+            refill();
+        }
+        return values[index++];
+    }
+
+    // A uniformly distributed double in [0, 1).
+    double nextUnit() {
+        return static_cast<double>(nextU64() >> 11) * 0x1.0p-53;
+    }
+
+    // True with the given probability, expressed as a threshold from probabilityThreshold().
+    bool chance(std::uint64_t threshold) {
+        return threshold != 0 && nextU64() < threshold;
+    }
+
+    // The next 'count' values of nextU64(), copied out of the buffer a run at a time.
+    void fill(std::uint64_t* out, std::size_t count) {
+        while (count > 0) {
+            if (index == BATCH_SIZE) {
+                refill();
+            }
+            const std::size_t take = count < BATCH_SIZE - index ? count : BATCH_SIZE - index;
+            const std::uint64_t* source = values.data() + index;
+            for (std::size_t position = 0; position < take; ++position) {
+                out[position] = source[position];
+            }
+            index += take;
+            out += take;
+            count -= take;
+        }
+    }
+
+    // Converts a probability in [0, 1] into an integer threshold for chance(); comparing two
+    // integers is cheaper than converting every random value to a double.
+    static std::uint64_t probabilityThreshold(double probability) {
+        if (probability <= 0.0) {
+            return 0;
+        }
+        if (probability >= 1.0) {
+            return ~std::uint64_t(0);
+        }
+        return static_cast<std::uint64_t>(probability * 18446744073709551616.0);
+    }
+
+private:
+    Xoshiro256 generator;
+    std::array<std::uint64_t, BATCH_SIZE> values{};
+    std::size_t index = BATCH_SIZE;
+
+    void refill() {
+        for (std::uint64_t& value : values) {
+            value = generator.next();
+        }
+        index = 0;
+    }
+};
+
+
+#endif  // End RANDOM_H
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef RAW_PACKET_H    // This will ensure no repeat definition of this header file.
+#define RAW_PACKET_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "PacketBuffer.h"
+#include "PacketBufferPool.h"
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+RawPacket is a simple container for raw bytes.
+It is the basic unit of data that the NetworkMedium can transport.
+Its bytes live in a PacketBuffer drawn from the PacketBufferPool, which gets the buffer back
+as soon as the packet is destroyed. The buffer can keep free room in front of the bytes, so
+a protocol layer can add or strip its header without moving the rest of the packet.
+*/
+class RawPacket{
+public:
+    PacketBuffer data; //Sequence of data that will travel on the network medium.
+
+    RawPacket() = default;
+
+    // Takes over an existing byte buffer without copying it.
+    explicit RawPacket(PacketBuffer&& bytes) : data(std::move(bytes)) {}
+
+    // Copies the bytes of an ordinary vector into a pooled buffer.
+    explicit RawPacket(const std::vector<char>& bytes) : data(bytes.begin(), bytes.end()) {}
+
+    // Copies 'length' bytes starting at 'bytes' into the packet.
+    RawPacket(const char* bytes, std::size_t length) : data(bytes, bytes + length) {}
+
+    // Creates a packet of 'length' bytes, all set to 'fill'.
+    RawPacket(std::size_t length, char fill) : data(length, fill) {}
+
+    // Creates a packet of 'length' zero bytes with 'headroom' free bytes in front of them,
+    // for packets whose headers will be prepended layer by layer.
+    static RawPacket withHeadroom(std::size_t headroom, std::size_t length) {
+        return RawPacket(PacketBuffer::withHeadroom(headroom, length));
+    }
+
+    // Read-only views of the bytes; nothing is copied.
+    PacketView view() const { return data.view(); }
+    PacketView slice(std::size_t offset, std::size_t count) const { return data.slice(offset, count); }
+};
+
+// A read-only packet shared by several receivers (see FrameLog). The packet and its
+// bytes stay alive until the last receiver lets go of it.
+using SharedPacket = std::shared_ptr<const RawPacket>;
+
+
+#endif  // End RAW_PACKET_H
\ No newline at end of file
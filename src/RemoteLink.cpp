@@ -0,0 +1,387 @@
+#include "RemoteLink.h"
+#include "Compression.h"
+#include "ParallelSimulation.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// Starts every message; also tells a peer of the other byte order apart
+constexpr std::uint32_t WIRE_MAGIC = 0x4E45524C;     // "NERL"
+constexpr std::uint32_t WIRE_VERSION = 1;
+
+// A batch is shipped at this size whatever the configuration says, and a message larger than
+// MAX_MESSAGE_BYTES is taken for a broken stream rather than allocated
+constexpr std::size_t MAX_BATCH_BYTES = 64u << 20;
+constexpr std::uint32_t MAX_MESSAGE_BYTES = 256u << 20;
+
+enum WireType : std::uint32_t {
+    HELLO = 1,          // Start of a run: the sender's lookahead and end time.
+    BATCH = 2,          // Frames of one link.
+    WINDOW_END = 3,     // The sender finished a window; 'time' is its earliest event time.
+};
+
+constexpr std::uint32_t FLAG_COMPRESSED = 1;
+
+struct WireHeader {
+    std::uint32_t magic;
+    std::uint32_t type;
+    std::uint32_t linkId;
+    std::uint32_t frameCount;
+    std::uint32_t flags;
+    std::uint32_t rawBytes;         // Payload size before compression.
+    std::uint32_t storedBytes;      // Payload bytes following the header.
+    std::uint32_t version;
+    std::uint64_t time;
+    std::uint64_t endTime;
+};
+
+// Every frame in a batch starts with its arrival time and length
+constexpr std::size_t FRAME_RECORD_BYTES = sizeof(std::uint64_t) + sizeof(std::uint32_t);
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// Waits out partial reads; false at the end of the stream or on an error
+bool readExactly(int socket, void* target, std::size_t length) {
+    char* bytes = static_cast<char*>(target);
+    while (length > 0) {
+        const ssize_t count = ::recv(socket, bytes, length, 0);
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += count;
+        length -= static_cast<std::size_t>(count);
+    }
+    return true;
+}
+
+// Batches are large, so Nagle's algorithm only ever delays the small window messages
+void tuneSocket(int socket) {
+    const int enable = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+} // namespace
+
+int RemotePeer::acceptConnection(std::uint16_t port) {
+    const int listener = ::socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        throw systemError("Cannot create a socket");
+    }
+    const int enable = 1;
+    const int disable = 0;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof(disable));   // IPv4 peers too
+    sockaddr_in6 address{};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(port);
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 1) != 0) {
+        const std::runtime_error error = systemError("Cannot listen on port " + std::to_string(port));
+        ::close(listener);
+        throw error;
+    }
+    int connection;
+    do {
+        connection = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    } while (connection < 0 && errno == EINTR);
+    const int acceptError = errno;
+    ::close(listener);
+    if (connection < 0) {
+        errno = acceptError;
+        throw systemError("Cannot accept a peer on port " + std::to_string(port));
+    }
+    tuneSocket(connection);
+    return connection;
+}
+
+// Tries every address the name resolves to, again and again until the peer listens or time runs out
+int RemotePeer::openConnection(const std::string& host, std::uint16_t port, std::chrono::milliseconds timeout) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    const int resolved = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+    if (resolved != 0) {
+        throw std::runtime_error("Cannot resolve " + host + ": " + gai_strerror(resolved));
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+        for (addrinfo* address = addresses; address != nullptr; address = address->ai_next) {
+            const int connection = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+            if (connection < 0) {
+                continue;
+            }
+            if (::connect(connection, address->ai_addr, address->ai_addrlen) == 0) {
+                freeaddrinfo(addresses);
+                tuneSocket(connection);
+                return connection;
+            }
+            ::close(connection);
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    freeaddrinfo(addresses);
+    throw systemError("Cannot connect to " + host + ":" + std::to_string(port));
+}
+
+RemotePeer::RemotePeer(int socket) : socket(socket) {
+    reader = std::thread([this]() { readLoop(); });
+}
+
+RemotePeer::~RemotePeer() {
+    abort();
+    reader.join();
+    ::close(socket);
+}
+
+RemotePeerCounters RemotePeer::getCounters() const {
+    RemotePeerCounters counters;
+    counters.batchesOut = batchesOut.load(std::memory_order_relaxed);
+    counters.framesOut = framesOut.load(std::memory_order_relaxed);
+    counters.bytesOut = bytesOut.load(std::memory_order_relaxed);
+    counters.wireBytesOut = wireBytesOut.load(std::memory_order_relaxed);
+    counters.batchesIn = batchesIn.load(std::memory_order_relaxed);
+    counters.framesIn = framesIn.load(std::memory_order_relaxed);
+    counters.bytesIn = bytesIn.load(std::memory_order_relaxed);
+    counters.wireBytesIn = wireBytesIn.load(std::memory_order_relaxed);
+    counters.windows = windowCount.load(std::memory_order_relaxed);
+    return counters;
+}
+
+void RemotePeer::abort() {
+    ::shutdown(socket, SHUT_RDWR);
+}
+
+void RemotePeer::markFailed(const std::string& what) {
+    std::lock_guard<std::mutex> lock(receiveMutex);
+    if (!failed) {
+        failed = true;
+        failure = what;
+    }
+    receiveSignal.notify_all();
+}
+
+// Reads messages until the connection ends; the frames of a window are unpacked as their batches arrive
+void RemotePeer::readLoop() {
+    WireHeader header;
+    std::vector<char> stored;
+    std::vector<char> raw;
+    while (readExactly(socket, &header, sizeof(header))) {
+        if (header.magic != WIRE_MAGIC || header.version != WIRE_VERSION) {
+            markFailed("The peer does not speak this protocol (or has another byte order)");
+            return;
+        }
+        if (header.storedBytes > MAX_MESSAGE_BYTES || header.rawBytes > MAX_MESSAGE_BYTES) {
+            markFailed("The peer sent a message of " + std::to_string(header.storedBytes) + " bytes");
+            return;
+        }
+        stored.resize(header.storedBytes);
+        if (!readExactly(socket, stored.data(), stored.size())) {
+            break;
+        }
+        wireBytesIn.fetch_add(sizeof(header) + stored.size(), std::memory_order_relaxed);
+
+        if (header.type == HELLO) {
+            std::lock_guard<std::mutex> lock(receiveMutex);
+            hellos.push_back(Hello{SimTime(header.time), SimTime(header.endTime)});
+            receiveSignal.notify_all();
+        } else if (header.type == WINDOW_END) {
+            std::lock_guard<std::mutex> lock(receiveMutex);
+            windows.push_back(Window{SimTime(header.time), std::move(current)});
+            current.clear();
+            receiveSignal.notify_all();
+        } else if (header.type == BATCH) {
+            const char* payload = stored.data();
+            if (header.flags & FLAG_COMPRESSED) {
+                raw.resize(header.rawBytes);
+                if (!decompressBlock(stored.data(), stored.size(), raw.data(), raw.size())) {
+                    markFailed("The peer sent a corrupt batch");
+                    return;
+                }
+                payload = raw.data();
+            } else if (header.rawBytes != header.storedBytes) {
+                markFailed("The peer sent a corrupt batch");
+                return;
+            }
+            const char* const end = payload + header.rawBytes;
+            for (std::uint32_t frame = 0; frame < header.frameCount; ++frame) {
+                std::uint64_t arrival;
+                std::uint32_t length;
+                if (static_cast<std::size_t>(end - payload) < FRAME_RECORD_BYTES) {
+                    markFailed("The peer sent a truncated batch");
+                    return;
+                }
+                std::memcpy(&arrival, payload, sizeof(arrival));
+                std::memcpy(&length, payload + sizeof(arrival), sizeof(length));
+                payload += FRAME_RECORD_BYTES;
+                if (static_cast<std::size_t>(end - payload) < length) {
+                    markFailed("The peer sent a truncated batch");
+                    return;
+                }
+                current.push_back(IncomingFrame{SimTime(arrival), header.linkId, RawPacket(payload, length)});
+                payload += length;
+            }
+            batchesIn.fetch_add(1, std::memory_order_relaxed);
+            framesIn.fetch_add(header.frameCount, std::memory_order_relaxed);
+            bytesIn.fetch_add(header.rawBytes - std::uint64_t(header.frameCount) * FRAME_RECORD_BYTES, std::memory_order_relaxed);
+        }
+    }
+    markFailed("The connection to the peer was closed");
+}
+
+// Header and payload leave in one call; MSG_NOSIGNAL turns a closed connection into an error instead of SIGPIPE
+void RemotePeer::sendMessage(std::uint32_t type, std::uint32_t linkId, std::uint32_t frameCount, bool compressed,
+                             std::uint32_t rawBytes, SimTime time, SimTime endTime, const char* payload, std::size_t length) {
+    WireHeader header{};
+    header.magic = WIRE_MAGIC;
+    header.type = type;
+    header.linkId = linkId;
+    header.frameCount = frameCount;
+    header.flags = compressed ? FLAG_COMPRESSED : 0;
+    header.rawBytes = rawBytes;
+    header.storedBytes = static_cast<std::uint32_t>(length);
+    header.version = WIRE_VERSION;
+    header.time = time;
+    header.endTime = endTime;
+
+    iovec parts[2];
+    parts[0].iov_base = &header;
+    parts[0].iov_len = sizeof(header);
+    parts[1].iov_base = const_cast<char*>(payload);
+    parts[1].iov_len = length;
+    msghdr message{};
+    message.msg_iov = parts;
+    message.msg_iovlen = length > 0 ? 2 : 1;
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+    std::size_t left = sizeof(header) + length;
+    wireBytesOut.fetch_add(left, std::memory_order_relaxed);
+    while (left > 0) {
+        const ssize_t count = ::sendmsg(socket, &message, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            markFailed(std::string("Cannot send to the peer: ") + std::strerror(errno));
+            return;
+        }
+        left -= static_cast<std::size_t>(count);
+        // Skip what was written; the rest of the message stays in the iovecs
+        std::size_t written = static_cast<std::size_t>(count);
+        while (written > 0 && message.msg_iovlen > 0) {
+            const std::size_t step = std::min(written, message.msg_iov[0].iov_len);
+            message.msg_iov[0].iov_base = static_cast<char*>(message.msg_iov[0].iov_base) + step;
+            message.msg_iov[0].iov_len -= step;
+            written -= step;
+            if (message.msg_iov[0].iov_len == 0) {
+                ++message.msg_iov;
+                --message.msg_iovlen;
+            }
+        }
+    }
+}
+
+void RemotePeer::sendHello(SimTime lookahead, SimTime endTime) {
+    sendMessage(HELLO, 0, 0, false, 0, lookahead, endTime, nullptr, 0);
+}
+
+RemotePeer::Hello RemotePeer::awaitHello() {
+    std::unique_lock<std::mutex> lock(receiveMutex);
+    receiveSignal.wait(lock, [this]() { return failed || !hellos.empty(); });
+    if (hellos.empty()) {
+        throw std::runtime_error(failure);
+    }
+    const Hello hello = hellos.front();
+    hellos.pop_front();
+    return hello;
+}
+
+void RemotePeer::sendWindowEnd(SimTime earliest) {
+    sendMessage(WINDOW_END, 0, 0, false, 0, earliest, 0, nullptr, 0);
+}
+
+SimTime RemotePeer::awaitWindowEnd(std::vector<IncomingFrame>& out) {
+    std::unique_lock<std::mutex> lock(receiveMutex);
+    receiveSignal.wait(lock, [this]() { return failed || !windows.empty(); });
+    if (windows.empty()) {
+        throw std::runtime_error(failure);
+    }
+    Window& window = windows.front();
+    const SimTime earliest = window.earliest;
+    for (IncomingFrame& frame : window.frames) {
+        out.push_back(std::move(frame));
+    }
+    windows.pop_front();
+    windowCount.fetch_add(1, std::memory_order_relaxed);
+    return earliest;
+}
+
+RemoteLink::RemoteLink(Shard& from, RemotePeer& peer, std::uint32_t id, SimTime latency, const RemoteLinkConfig& config)
+    : from(from), peer(peer), id(id), latency(latency), config(config), earliestArrival(NEVER) {}
+
+// Appends the frame to the batch, which goes out early if it is big enough or old enough
+void RemoteLink::send(RawPacket&& packet) {
+    const std::uint64_t arrival = from.getScheduler().now() + latency;
+    const std::uint32_t length = static_cast<std::uint32_t>(packet.data.size());
+    const std::size_t offset = batch.size();
+    batch.resize(offset + FRAME_RECORD_BYTES + length);
+    std::memcpy(batch.data() + offset, &arrival, sizeof(arrival));
+    std::memcpy(batch.data() + offset + sizeof(arrival), &length, sizeof(length));
+    std::memcpy(batch.data() + offset + FRAME_RECORD_BYTES, packet.view().data(), length);
+    packet = RawPacket();
+    earliestArrival = std::min<SimTime>(earliestArrival, arrival);
+
+    if (batchFrames++ == 0 && config.maxBatchDelay.count() > 0) {
+        batchStarted = std::chrono::steady_clock::now();
+    }
+    if (batch.size() >= std::min(config.maxBatchBytes, MAX_BATCH_BYTES) ||
+        (config.maxBatchDelay.count() > 0 && std::chrono::steady_clock::now() - batchStarted >= config.maxBatchDelay)) {
+        flush();
+    }
+}
+
+void RemoteLink::flush() {
+    if (batchFrames == 0) {
+        return;
+    }
+    const char* payload = batch.data();
+    std::size_t length = batch.size();
+    bool packed = false;
+    if (config.compress) {
+        compressBlock(batch.data(), batch.size(), compressed);
+        if (compressed.size() < batch.size()) {
+            payload = compressed.data();
+            length = compressed.size();
+            packed = true;
+        }
+    }
+    peer.sendMessage(BATCH, id, batchFrames, packed, static_cast<std::uint32_t>(batch.size()), 0, 0, payload, length);
+    peer.batchesOut.fetch_add(1, std::memory_order_relaxed);
+    peer.framesOut.fetch_add(batchFrames, std::memory_order_relaxed);
+    peer.bytesOut.fetch_add(batch.size() - std::size_t(batchFrames) * FRAME_RECORD_BYTES, std::memory_order_relaxed);
+    batch.clear();
+    batchFrames = 0;
+}
+
+SimTime RemoteLink::takeEarliestArrival() {
+    const SimTime earliest = earliestArrival;
+    earliestArrival = NEVER;
+    return earliest;
+}
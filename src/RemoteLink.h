@@ -0,0 +1,184 @@
+#ifndef REMOTE_LINK_H    // This will ensure no repeat definition of this header file.
+#define REMOTE_LINK_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "RawPacket.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Shard;
+class ParallelSimulation;
+
+// How a RemoteLink groups its frames before they go on the network.
+struct RemoteLinkConfig {
+    std::size_t maxBatchBytes = 256 * 1024;         // A batch is shipped once it holds this many bytes (64 MiB at most), even in the middle of a window.
+    std::chrono::microseconds maxBatchDelay{0};     // Also shipped once its first frame has waited this long (in real time); 0 waits for the window to end.
+    bool compress = false;                          // Compress batches (see Compression.h); one that does not get smaller is sent as it is.
+};
+
+// What a connection to another host has carried so far.
+struct RemotePeerCounters {
+    std::uint64_t batchesOut = 0;
+    std::uint64_t framesOut = 0;
+    std::uint64_t bytesOut = 0;         // Frame bytes sent, before compression.
+    std::uint64_t wireBytesOut = 0;     // Bytes actually written to the socket, headers included.
+    std::uint64_t batchesIn = 0;
+    std::uint64_t framesIn = 0;
+    std::uint64_t bytesIn = 0;
+    std::uint64_t wireBytesIn = 0;
+    std::uint64_t windows = 0;          // Synchronization rounds with the peer.
+};
+
+/*
+RemotePeer is the TCP connection to another host that runs part of the same emulation (see
+ParallelSimulation::addPeer()). Its own thread reads everything the peer sends as it comes
+in, so both hosts can keep writing batches without waiting for each other. The two hosts
+must run on the same byte order; the greeting checks that.
+
+RDMA is not supported; it would need libibverbs, and TCP with large batches already leaves
+the hosts one round trip per window apart.
+*/
+class RemotePeer{
+public:
+    // Waits on 'port' for the peer to connect and returns the connected socket. Throws
+    // std::runtime_error if the port cannot be listened on.
+    static int acceptConnection(std::uint16_t port);
+
+    // Connects to the peer at 'host':'port', retrying until 'timeout' has passed (the peer
+    // may not be listening yet), and returns the connected socket. Throws std::runtime_error
+    // if no connection could be made.
+    static int openConnection(const std::string& host, std::uint16_t port,
+                              std::chrono::milliseconds timeout = std::chrono::seconds(10));
+
+    ~RemotePeer();
+
+    RemotePeer(const RemotePeer&) = delete;
+    RemotePeer& operator=(const RemotePeer&) = delete;
+
+    RemotePeerCounters getCounters() const;
+
+private:
+    friend class ParallelSimulation;
+    friend class RemoteLink;
+
+    // A frame read from the peer, not yet handed to its destination shard.
+    struct IncomingFrame {
+        SimTime arrival;
+        std::uint32_t linkId;
+        RawPacket packet;
+    };
+
+    // Everything the peer sent in one window: the frames and its earliest event time.
+    struct Window {
+        SimTime earliest;
+        std::vector<IncomingFrame> frames;
+    };
+
+    // What the peer announced at the start of a run.
+    struct Hello {
+        SimTime lookahead;
+        SimTime endTime;
+    };
+
+    explicit RemotePeer(int socket);
+
+    int socket;
+    std::mutex sendMutex;       // RemoteLinks of several shards share the connection.
+
+    // Filled by the reader thread, taken by ParallelSimulation under 'receiveMutex'
+    std::thread reader;
+    std::mutex receiveMutex;
+    std::condition_variable receiveSignal;
+    std::vector<IncomingFrame> current;     // Frames of the window still being read; reader thread only.
+    std::deque<Window> windows;
+    std::deque<Hello> hellos;
+    bool failed = false;
+    std::string failure;
+
+    std::atomic<std::uint64_t> batchesOut{0};
+    std::atomic<std::uint64_t> framesOut{0};
+    std::atomic<std::uint64_t> bytesOut{0};
+    std::atomic<std::uint64_t> wireBytesOut{0};
+    std::atomic<std::uint64_t> batchesIn{0};
+    std::atomic<std::uint64_t> framesIn{0};
+    std::atomic<std::uint64_t> bytesIn{0};
+    std::atomic<std::uint64_t> wireBytesIn{0};
+    std::atomic<std::uint64_t> windowCount{0};
+
+    void readLoop();
+
+    // Writes one message. A failure does not throw, since the sender may be a shard thread in
+    // the middle of a window; it marks the connection as failed instead.
+    void sendMessage(std::uint32_t type, std::uint32_t linkId, std::uint32_t frameCount, bool compressed,
+                     std::uint32_t rawBytes, SimTime time, SimTime endTime, const char* payload, std::size_t length);
+
+    void markFailed(const std::string& what);
+
+    void sendHello(SimTime lookahead, SimTime endTime);
+    Hello awaitHello();
+
+    // Closes the peer's window: every batch of it has been sent before this.
+    void sendWindowEnd(SimTime earliest);
+
+    // Waits for the peer to close its next window, appends the window's frames to 'out' and
+    // returns its earliest event time. Throws std::runtime_error if the connection failed.
+    SimTime awaitWindowEnd(std::vector<IncomingFrame>& out);
+
+    // Shuts the connection down, so that the peer (and our reader thread) give up too.
+    void abort();
+};
+
+/*
+RemoteLink is a one-way link from a node in one shard to a medium on another host. It is the
+cross-host counterpart of a CrossShardLink: a frame sent at time t arrives at t + latency, and
+the latency is part of the lookahead that lets the hosts run a window without talking.
+
+Frames are not sent one by one. The link appends them to a batch, which goes out as one
+message when the window ends (or earlier, see RemoteLinkConfig), optionally compressed. A
+link is used by its sending shard's thread only, so the batch needs no lock.
+*/
+class RemoteLink{
+public:
+    SimTime getLatency() const { return latency; }
+    std::uint32_t getId() const { return id; }
+    const RemoteLinkConfig& getConfig() const { return config; }
+
+    // Sends a frame to the far end; it arrives 'latency' after the sender's current time.
+    // Must be called from the sending shard's thread.
+    void send(RawPacket&& packet);
+
+private:
+    friend class ParallelSimulation;
+
+    RemoteLink(Shard& from, RemotePeer& peer, std::uint32_t id, SimTime latency, const RemoteLinkConfig& config);
+
+    Shard& from;
+    RemotePeer& peer;
+    const std::uint32_t id;
+    const SimTime latency;
+    const RemoteLinkConfig config;
+
+    std::vector<char> batch;            // Frame records: arrival time, length, bytes.
+    std::uint32_t batchFrames = 0;
+    std::chrono::steady_clock::time_point batchStarted;
+    std::vector<char> compressed;       // Scratch space of flush().
+    SimTime earliestArrival;            // Of the frames sent since the last window ended.
+
+    // Ships the batch, if it holds any frames.
+    void flush();
+
+    // The earliest arrival of the frames sent since the last call (NEVER if none were).
+    SimTime takeEarliestArrival();
+};
+
+
+#endif  // End REMOTE_LINK_H
@@ -0,0 +1,187 @@
+#include "SharedFrameRing.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// "NETEMURG" in ASCII; tells a frame ring from any other segment
+constexpr std::uint64_t SEGMENT_MAGIC = 0x4E4554454D555247;
+constexpr std::uint32_t SEGMENT_VERSION = 1;
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// Not FUTEX_PRIVATE_FLAG: the sleeper and the waker live in different processes
+long futex(std::atomic<std::uint32_t>& word, int operation, std::uint32_t value, const timespec* timeout) {
+    return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), operation, value, timeout, nullptr, 0);
+}
+
+} // namespace
+
+// Slots are cache-line aligned, like the slots of MpscRing
+std::size_t SharedFrameRing::segmentSize(std::size_t slotCount, std::size_t slotStride) {
+    return sizeof(Header) + slotCount * slotStride;
+}
+
+// Sets up the header and the slot sequence numbers, then publishes the magic number
+void SharedFrameRing::create(const std::string& name, const SharedRingConfig& config) {
+    if (config.slotCount == 0 || config.slotSize == 0 || config.slotSize > UINT32_MAX) {
+        throw std::invalid_argument("A shared frame ring needs at least one slot of 1 to 4294967295 bytes");
+    }
+    const std::size_t slotCount = roundUpToPowerOfTwo(config.slotCount);
+    const std::size_t stride = (sizeof(SlotHeader) + config.slotSize + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    const std::size_t size = segmentSize(slotCount, stride);
+
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        throw systemError("Cannot create the shared-memory segment " + name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        const std::runtime_error error = systemError("Cannot size the shared-memory segment " + name);
+        ::close(fd);
+        shm_unlink(name.c_str());
+        throw error;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        const std::runtime_error error = systemError("Cannot map the shared-memory segment " + name);
+        shm_unlink(name.c_str());
+        throw error;
+    }
+
+    Header* header = new (mapping) Header();
+    header->version = SEGMENT_VERSION;
+    header->slotSize = static_cast<std::uint32_t>(config.slotSize);
+    header->slotCount = slotCount;
+    header->slotStride = stride;
+    char* slots = static_cast<char*>(mapping) + sizeof(Header);
+    for (std::size_t index = 0; index < slotCount; ++index) {
+        SlotHeader* slot = new (slots + index * stride) SlotHeader();
+        slot->sequence.store(index, std::memory_order_relaxed);
+    }
+    header->magic.store(SEGMENT_MAGIC, std::memory_order_release);
+    munmap(mapping, size);
+}
+
+bool SharedFrameRing::remove(const std::string& name) {
+    return shm_unlink(name.c_str()) == 0;
+}
+
+// Maps the segment and checks that its header describes a ring that fits in it
+SharedFrameRing::SharedFrameRing(const std::string& name) : name(name) {
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        throw systemError("Cannot open the shared-memory segment " + name);
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        const std::runtime_error error = systemError("Cannot read the size of the shared-memory segment " + name);
+        ::close(fd);
+        throw error;
+    }
+    mappingSize = static_cast<std::size_t>(status.st_size);
+    if (mappingSize < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("The shared-memory segment " + name + " is not a frame ring (or is still being created)");
+    }
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw systemError("Cannot map the shared-memory segment " + name);
+    }
+
+    header = static_cast<Header*>(mapping);
+    const std::uint64_t count = header->slotCount;
+    const bool valid = header->magic.load(std::memory_order_acquire) == SEGMENT_MAGIC &&
+                       header->version == SEGMENT_VERSION && count >= 2 && (count & (count - 1)) == 0 &&
+                       header->slotStride >= sizeof(SlotHeader) + header->slotSize &&
+                       segmentSize(count, header->slotStride) == mappingSize;
+    if (!valid) {
+        munmap(mapping, mappingSize);
+        throw std::runtime_error("The shared-memory segment " + name + " is not a frame ring (or is still being created)");
+    }
+    slots = static_cast<char*>(mapping) + sizeof(Header);
+    mask = count - 1;
+    slotSize = header->slotSize;
+    slotStride = header->slotStride;
+}
+
+SharedFrameRing::~SharedFrameRing() {
+    munmap(mapping, mappingSize);
+}
+
+// Claims a slot as MpscRing does, then copies the frame into it
+bool SharedFrameRing::tryPush(const char* bytes, std::size_t length, SimTime readyTime) {
+    if (length > slotSize) {
+        return false;
+    }
+    std::uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    for (;;) {
+        SlotHeader& slot = slotAt(tail);
+        const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const std::int64_t difference = static_cast<std::int64_t>(sequence - tail);
+        if (difference == 0) {
+            if (header->tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                std::memcpy(frameBytes(slot), bytes, length);
+                slot.length = static_cast<std::uint32_t>(length);
+                slot.readyTime = readyTime;
+                slot.sequence.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            return false;   // Still holds a frame from one lap earlier: the ring is full
+        } else {
+            tail = header->tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Pairs with the fence in wait(): either the sender sees the sleeper, or the sleeper sees the frame
+void SharedFrameRing::notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->sleepers.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    header->doorbell.fetch_add(1, std::memory_order_release);
+    futex(header->doorbell, FUTEX_WAKE, INT_MAX, nullptr);
+}
+
+// The futex only sleeps while the doorbell still has the value read before the last look at the ring
+bool SharedFrameRing::wait(std::chrono::nanoseconds timeout) {
+    const std::uint32_t bell = header->doorbell.load(std::memory_order_acquire);
+    header->sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!empty()) {
+        header->sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    const std::int64_t nanoseconds = timeout.count() > 0 ? timeout.count() : 0;
+    const timespec relative{static_cast<time_t>(nanoseconds / 1000000000), static_cast<long>(nanoseconds % 1000000000)};
+    const long result = futex(header->doorbell, FUTEX_WAIT, bell, &relative);
+    const bool timedOut = result != 0 && errno == ETIMEDOUT;
+    header->sleepers.fetch_sub(1, std::memory_order_relaxed);
+    return !timedOut;
+}
+
+bool SharedFrameRing::empty() const {
+    const std::uint64_t head = header->head.load(std::memory_order_relaxed);
+    return slotAt(head).sequence.load(std::memory_order_acquire) != head + 1;
+}
+
+std::size_t SharedFrameRing::size() const {
+    const std::uint64_t tail = header->tail.load(std::memory_order_acquire);
+    const std::uint64_t head = header->head.load(std::memory_order_acquire);
+    return tail > head ? static_cast<std::size_t>(tail - head) : 0;
+}
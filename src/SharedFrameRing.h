@@ -0,0 +1,148 @@
+#ifndef SHARED_FRAME_RING_H    // This will ensure no repeat definition of this header file.
+#define SHARED_FRAME_RING_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "PacketRing.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Size and shape of a shared-memory segment, fixed when it is created.
+struct SharedRingConfig {
+    std::size_t slotCount = 1024;   // Frames the ring holds; rounded up to a power of two.
+    std::size_t slotSize = 1518;    // Largest frame a slot takes; longer frames are refused.
+};
+
+/*
+SharedFrameRing is a ring of fixed-size frame slots in a POSIX shared-memory segment, so that
+emulator processes (and third-party programs that follow the layout) exchange frames without
+sockets or copies through the kernel. One process creates the segment with create(); every
+process, the creator included, then maps it by name with the constructor.
+
+The ring is Vyukov's bounded queue again (see MpscRing), laid out so that it works between
+address spaces: the indices and slot sequence numbers are lock-free atomics in the segment,
+and a frame is copied into its slot by the sender and out of it by the receiver, since the
+pointers of one process mean nothing in another. Any number of processes may send and
+receive; receivers claim slots with a compare-and-swap, as senders do.
+
+A receiver with nothing to do sleeps on a doorbell, a futex word in the segment. A sender
+only rings it (one FUTEX_WAKE system call) when the sleeper count in the segment says that
+somebody is asleep, so a busy ring makes no system calls at all.
+
+A process that dies between claiming a slot and filling it leaves the ring stuck at that slot;
+the segment has to be created anew.
+*/
+class SharedFrameRing{
+public:
+    // Creates the segment 'name', a shm_open() name such as "/netemu-link0". Throws
+    // std::invalid_argument for an unusable configuration and std::runtime_error if the
+    // segment already exists or cannot be created.
+    static void create(const std::string& name, const SharedRingConfig& config = SharedRingConfig());
+
+    // Removes the segment's name; processes that mapped it keep using it. Returns false if there was no such segment.
+    static bool remove(const std::string& name);
+
+    // Maps the existing segment 'name'. Throws std::runtime_error if there is none, or if it
+    // is not a frame ring of this layout.
+    explicit SharedFrameRing(const std::string& name);
+    ~SharedFrameRing();
+
+    SharedFrameRing(const SharedFrameRing&) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+    // Copies the frame into a free slot and returns true, or returns false if the ring is full
+    // or the frame is longer than a slot.
+    bool tryPush(const char* bytes, std::size_t length, SimTime readyTime);
+
+    // Calls 'take(bytes, length, readyTime)' with the oldest frame, which is valid only during
+    // the call, and returns true; returns false if the ring is empty.
+    template <typename Take>
+    bool tryPopWith(Take&& take) {
+        std::uint64_t head = header->head.load(std::memory_order_relaxed);
+        for (;;) {
+            SlotHeader& slot = slotAt(head);
+            const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::int64_t difference = static_cast<std::int64_t>(sequence - (head + 1));
+            if (difference == 0) {
+                if (header->head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                    take(frameBytes(slot), std::size_t(slot.length), SimTime(slot.readyTime));
+                    slot.sequence.store(head + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;   // Not filled yet: the ring is empty
+            } else {
+                head = header->head.load(std::memory_order_relaxed);    // Another receiver took it
+            }
+        }
+    }
+
+    // Wakes the receivers sleeping in wait(), if there are any. Called after a push.
+    void notify();
+
+    // Sleeps until a frame may have arrived or 'timeout' has passed; returns false in the
+    // latter case. Returns at once if a frame is already waiting.
+    bool wait(std::chrono::nanoseconds timeout);
+
+    // True if no frame is waiting (a snapshot while other processes keep running).
+    bool empty() const;
+
+    // Number of claimed slots (a snapshot while other processes keep running).
+    std::size_t size() const;
+
+    std::size_t capacity() const { return mask + 1; }
+    std::size_t getSlotSize() const { return slotSize; }
+    const std::string& getName() const { return name; }
+
+private:
+    // Start of the segment. 'magic' is written last by create(), so a process that maps a
+    // segment still being set up does not take it for a ring.
+    struct Header {
+        std::atomic<std::uint64_t> magic;
+        std::uint32_t version;
+        std::uint32_t slotSize;
+        std::uint64_t slotCount;
+        std::uint64_t slotStride;
+        alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> tail;   // Claimed by senders.
+        alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> head;   // Claimed by receivers.
+        alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> doorbell;   // Futex word; bumped to wake sleepers.
+        std::atomic<std::uint32_t> sleepers;    // Receivers in wait().
+    };
+
+    // Start of every slot; the frame's bytes follow it.
+    struct SlotHeader {
+        std::atomic<std::uint64_t> sequence;
+        std::uint64_t readyTime;
+        std::uint32_t length;
+        std::uint32_t reserved;
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+                  "Atomics in shared memory must not need a lock, which would live in one process only");
+
+    static std::size_t segmentSize(std::size_t slotCount, std::size_t slotStride);
+
+    std::string name;
+    void* mapping = nullptr;
+    std::size_t mappingSize = 0;
+    Header* header = nullptr;
+    char* slots = nullptr;
+    std::uint64_t mask = 0;
+    std::size_t slotSize = 0;
+    std::size_t slotStride = 0;
+
+    SlotHeader& slotAt(std::uint64_t index) const {
+        return *reinterpret_cast<SlotHeader*>(slots + (index & mask) * slotStride);
+    }
+
+    // The frame's bytes, right behind the slot header.
+    static char* frameBytes(SlotHeader& slot) {
+        return reinterpret_cast<char*>(&slot + 1);
+    }
+};
+
+
+#endif  // End SHARED_FRAME_RING_H
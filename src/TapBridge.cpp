@@ -0,0 +1,311 @@
+#include "TapBridge.h"
+#include "IoUring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/if_tun.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// user_data of the requests that are not writes; writes carry the index of their slot
+constexpr std::uint64_t READ_REQUEST = ~std::uint64_t(0);
+constexpr std::uint64_t CANCEL_REQUEST = ~std::uint64_t(0) - 1;
+
+constexpr std::uint16_t BUFFER_GROUP = 0;
+
+// Stopping waits this long at most for the kernel to give the buffers back
+constexpr std::chrono::milliseconds DRAIN_STEP{10};
+constexpr int DRAIN_STEPS = 100;
+
+bool hasRingBackend(const NetworkMedium& medium) {
+    const MediumBackend backend = medium.getBackend();
+    return backend == MediumBackend::SpscRing || backend == MediumBackend::MpscRing || backend == MediumBackend::SharedMemory;
+}
+
+} // namespace
+
+TapBridge::TapBridge(const TapBridgeConfig& config, NetworkMedium& toEmulation, NetworkMedium& fromEmulation)
+    : config(config), toEmulation(toEmulation), fromEmulation(fromEmulation) {
+    if (config.maxFrameSize < 60 || config.maxFrameSize > 65535) {
+        throw std::invalid_argument("A TAP bridge needs a maximum frame size between 60 and 65535 bytes");
+    }
+    if (config.receiveBuffers == 0 || config.receiveBuffers > 32768 || config.batchSize == 0) {
+        throw std::invalid_argument("A TAP bridge needs 1 to 32768 receive buffers and a batch size greater than zero");
+    }
+    if (!hasRingBackend(toEmulation) || !hasRingBackend(fromEmulation)) {
+        throw std::invalid_argument("A TAP bridge uses its media from its own thread, so they need a ring backend");
+    }
+    openInterface();
+    if (config.useIoUring) {
+        try {
+            setUpIoUring();
+        } catch (const std::runtime_error&) {
+            // No usable io_uring here (too old, or forbidden by a seccomp filter): use plain system calls
+            bufferRing.reset();
+            uring.reset();
+            receiveBuffers.clear();
+            multishot = false;
+        }
+    }
+    worker = std::thread([this] {
+        if (uring) {
+            runIoUring();
+        } else {
+            runSyscalls();
+        }
+    });
+}
+
+// The kernel may still hold buffers until the ring is gone, so the ring goes before them
+TapBridge::~TapBridge() {
+    stop();
+    bufferRing.reset();
+    uring.reset();
+    ::close(tapFd);
+}
+
+void TapBridge::stop() {
+    running.store(false, std::memory_order_release);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+TapBridgeCounters TapBridge::getCounters() const {
+    TapBridgeCounters counters;
+    counters.framesIn = framesIn.load(std::memory_order_relaxed);
+    counters.bytesIn = bytesIn.load(std::memory_order_relaxed);
+    counters.droppedIn = droppedIn.load(std::memory_order_relaxed);
+    counters.framesOut = framesOut.load(std::memory_order_relaxed);
+    counters.bytesOut = bytesOut.load(std::memory_order_relaxed);
+    counters.writeErrors = writeErrors.load(std::memory_order_relaxed);
+    counters.readErrors = readErrors.load(std::memory_order_relaxed);
+    return counters;
+}
+
+// Creates the interface (or attaches to an existing one of the same name) and sets it up
+void TapBridge::openInterface() {
+    if (config.interfaceName.size() >= IFNAMSIZ) {
+        throw std::invalid_argument("TAP interface name '" + config.interfaceName + "' is too long");
+    }
+    tapFd = ::open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (tapFd < 0) {
+        throw std::runtime_error(std::string("Cannot open /dev/net/tun: ") + std::strerror(errno));
+    }
+    ifreq request;
+    std::memset(&request, 0, sizeof(request));
+    request.ifr_flags = IFF_TAP | IFF_NO_PI;
+    std::memcpy(request.ifr_name, config.interfaceName.c_str(), config.interfaceName.size());
+    if (ioctl(tapFd, TUNSETIFF, &request) < 0) {
+        const std::string reason = std::strerror(errno);
+        ::close(tapFd);
+        throw std::runtime_error("Cannot create TAP interface '" + config.interfaceName + "': " + reason);
+    }
+    interfaceName = request.ifr_name;
+    if (!config.bringUp) {
+        return;
+    }
+    const int control = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    bool up = control >= 0 && ioctl(control, SIOCGIFFLAGS, &request) == 0;
+    if (up) {
+        request.ifr_flags = static_cast<short>(request.ifr_flags | IFF_UP);
+        up = ioctl(control, SIOCSIFFLAGS, &request) == 0;
+    }
+    const std::string reason = std::strerror(errno);
+    if (control >= 0) {
+        ::close(control);
+    }
+    if (!up) {
+        ::close(tapFd);
+        throw std::runtime_error("Cannot bring TAP interface '" + interfaceName + "' up: " + reason);
+    }
+}
+
+// One submission entry per read and write that can be in flight, and one for cancelling the reads
+void TapBridge::setUpIoUring() {
+    const std::size_t buffers = std::min<std::size_t>(roundUpToPowerOfTwo(config.receiveBuffers), 32768);
+    uring = std::make_unique<IoUring>(static_cast<unsigned>(std::max(buffers, 2 * config.batchSize + 1)));
+    bufferRing = std::make_unique<IoUringBufferRing>(*uring, BUFFER_GROUP, static_cast<unsigned>(buffers));
+    multishot = uring->supports(IORING_OP_READ_MULTISHOT_CODE);
+    receiveBuffers.reserve(buffers);
+    for (std::size_t id = 0; id < buffers; ++id) {
+        receiveBuffers.emplace_back(config.maxFrameSize, 0);
+        bufferRing->add(receiveBuffers.back().data(), static_cast<unsigned>(config.maxFrameSize), static_cast<std::uint16_t>(id));
+    }
+    bufferRing->publish();
+    writes.resize(config.batchSize);
+    for (std::size_t slot = config.batchSize; slot-- > 0;) {
+        freeWrites.push_back(static_cast<std::uint32_t>(slot));
+    }
+}
+
+// Each round queues writes, then submits them and waits for the interface in one system call
+void TapBridge::runIoUring() {
+    const unsigned waitFor = config.pollInterval.count() > 0 ? 1 : 0;
+    while (running.load(std::memory_order_acquire)) {
+        armReads();
+        queueWrites();
+        uring->submitAndWait(waitFor, config.pollInterval);
+        uring->forEachCompletion([this](const io_uring_cqe& cqe) { complete(cqe); });
+        sendIncoming();
+        bufferRing->publish();
+    }
+    drainIoUring();
+}
+
+// A multishot read stays armed until the kernel ends it (no buffer left, say); single reads are re-armed one by one
+void TapBridge::armReads() {
+    const std::size_t wanted = multishot ? 1 : std::min(config.batchSize, receiveBuffers.size());
+    while (readsInFlight < wanted) {
+        io_uring_sqe* sqe = uring->getSqe();
+        if (sqe == nullptr) {
+            return;
+        }
+        sqe->opcode = multishot ? IORING_OP_READ_MULTISHOT_CODE : std::uint8_t(IORING_OP_READ);
+        sqe->fd = tapFd;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->len = multishot ? 0 : static_cast<std::uint32_t>(config.maxFrameSize);
+        sqe->user_data = READ_REQUEST;
+        ++readsInFlight;
+    }
+}
+
+// The frame stays in its slot until the write completes, so the kernel reads it in place
+void TapBridge::queueWrites() {
+    while (!freeWrites.empty() && uring->sqeSpace() > 1) {
+        const std::uint32_t slot = freeWrites.back();
+        RawPacket& frame = writes[slot];
+        if (!fromEmulation.tryReceive(frame)) {
+            return;
+        }
+        freeWrites.pop_back();
+        io_uring_sqe* sqe = uring->getSqe();
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = tapFd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(frame.view().data());
+        sqe->len = static_cast<std::uint32_t>(frame.data.size());
+        sqe->user_data = slot;
+    }
+}
+
+void TapBridge::complete(const io_uring_cqe& cqe) {
+    if (cqe.user_data == CANCEL_REQUEST) {
+        return;
+    }
+    if (cqe.user_data == READ_REQUEST) {
+        if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+            --readsInFlight;
+        }
+        if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER) != 0) {
+            const std::uint16_t id = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            PacketBuffer& buffer = receiveBuffers[id];
+            deliver(buffer, static_cast<std::size_t>(cqe.res));
+            bufferRing->add(buffer.data(), static_cast<unsigned>(config.maxFrameSize), id);
+        } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED && cqe.res != -EAGAIN) {
+            readErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    RawPacket& frame = writes[cqe.user_data];
+    if (cqe.res >= 0 && static_cast<std::size_t>(cqe.res) == frame.data.size()) {
+        framesOut.fetch_add(1, std::memory_order_relaxed);
+        bytesOut.fetch_add(frame.data.size(), std::memory_order_relaxed);
+    } else {
+        writeErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+    frame = RawPacket();
+    freeWrites.push_back(static_cast<std::uint32_t>(cqe.user_data));
+}
+
+// Cancels the reads and waits until neither reads nor writes are in flight
+void TapBridge::drainIoUring() {
+    if (readsInFlight > 0) {
+        io_uring_sqe* sqe = uring->getSqe();
+        if (sqe != nullptr) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = READ_REQUEST;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = CANCEL_REQUEST;
+        }
+    }
+    for (int step = 0; step < DRAIN_STEPS && (readsInFlight > 0 || freeWrites.size() < writes.size()); ++step) {
+        uring->submitAndWait(1, DRAIN_STEP);
+        uring->forEachCompletion([this](const io_uring_cqe& cqe) { complete(cqe); });
+        sendIncoming();
+    }
+}
+
+// The fallback: a write() per frame going out, and a read() per frame coming in while the interface has any
+void TapBridge::runSyscalls() {
+    PacketBuffer buffer(config.maxFrameSize, 0);
+    RawPacket frame;
+    pollfd descriptor{tapFd, POLLIN, 0};
+    timespec wait{};
+    wait.tv_sec = config.pollInterval.count() / 1000000;
+    wait.tv_nsec = (config.pollInterval.count() % 1000000) * 1000;
+    while (running.load(std::memory_order_acquire)) {
+        for (std::size_t count = 0; count < config.batchSize && fromEmulation.tryReceive(frame); ++count) {
+            const ssize_t written = ::write(tapFd, frame.view().data(), frame.data.size());
+            if (written >= 0 && static_cast<std::size_t>(written) == frame.data.size()) {
+                framesOut.fetch_add(1, std::memory_order_relaxed);
+                bytesOut.fetch_add(frame.data.size(), std::memory_order_relaxed);
+            } else {
+                writeErrors.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (ppoll(&descriptor, 1, &wait, nullptr) <= 0 || (descriptor.revents & POLLIN) == 0) {
+            continue;
+        }
+        for (std::size_t count = 0; count < config.batchSize; ++count) {
+            const ssize_t length = ::read(tapFd, buffer.data(), config.maxFrameSize);
+            if (length <= 0) {
+                if (length < 0 && errno != EAGAIN && errno != EINTR) {
+                    readErrors.fetch_add(1, std::memory_order_relaxed);
+                }
+                break;
+            }
+            deliver(buffer, static_cast<std::size_t>(length));
+        }
+        sendIncoming();
+    }
+}
+
+// Large frames keep the buffer the kernel wrote them into; small ones are copied into inline storage
+void TapBridge::deliver(PacketBuffer& buffer, std::size_t length) {
+    RawPacket packet;
+    if (length <= PacketBuffer::INLINE_CAPACITY) {
+        packet = RawPacket(buffer.data(), length);
+    } else {
+        buffer.trimBack(buffer.size() - length);
+        packet = RawPacket(std::move(buffer));
+        buffer = PacketBuffer(config.maxFrameSize, 0);
+    }
+    incoming.push_back(std::move(packet));
+}
+
+// A frame the emulation does not take is dropped, as a full receive queue would drop it
+void TapBridge::sendIncoming() {
+    if (incoming.empty()) {
+        return;
+    }
+    std::size_t bytes = 0;
+    for (const RawPacket& packet : incoming) {
+        bytes += packet.data.size();
+    }
+    const std::size_t sent = toEmulation.sendBatch(incoming);
+    for (std::size_t index = sent; index < incoming.size(); ++index) {
+        bytes -= incoming[index].data.size();
+    }
+    framesIn.fetch_add(sent, std::memory_order_relaxed);
+    bytesIn.fetch_add(bytes, std::memory_order_relaxed);
+    droppedIn.fetch_add(incoming.size() - sent, std::memory_order_relaxed);
+    incoming.clear();
+}
@@ -0,0 +1,140 @@
+#ifndef TAP_BRIDGE_H    // This will ensure no repeat definition of this header file.
+#define TAP_BRIDGE_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "NetworkMedium.h"
+#include "PacketBuffer.h"
+#include "RawPacket.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class IoUring;
+class IoUringBufferRing;
+struct io_uring_cqe;
+
+struct TapBridgeConfig {
+    std::string interfaceName;              // The TAP interface to create or attach to; empty lets the kernel pick "tapN".
+    bool bringUp = true;                    // Set the interface up, as 'ip link set <name> up' would.
+    std::size_t maxFrameSize = 1518;        // Largest frame exchanged: 1500 bytes of MTU, the header and a VLAN tag.
+    std::size_t receiveBuffers = 256;       // Buffers the kernel can fill before the bridge picks the frames up.
+    std::size_t batchSize = 64;             // Frames written to the interface per system call at most.
+    std::chrono::microseconds pollInterval{50};     // Longest wait for the interface before the media are looked at again; 0 spins.
+    bool useIoUring = true;                 // Fall back to read()/write() calls (one per frame) if false.
+};
+
+// What a bridge has done so far.
+struct TapBridgeCounters {
+    std::uint64_t framesIn = 0;     // Frames read from the interface and sent into the emulation.
+    std::uint64_t bytesIn = 0;
+    std::uint64_t droppedIn = 0;    // Read from the interface, but refused by the medium (usually a full ring).
+    std::uint64_t framesOut = 0;    // Frames received from the emulation and written to the interface.
+    std::uint64_t bytesOut = 0;
+    std::uint64_t writeErrors = 0;  // Writes the interface refused or cut short; their frames are lost.
+    std::uint64_t readErrors = 0;
+};
+
+/*
+TapBridge plugs a Linux TAP interface into the emulation, so real hosts, containers and VMs
+can exchange Ethernet frames with emulated nodes. Frames the host sends on the interface are
+sent into 'toEmulation'; frames received from 'fromEmulation' are written to the interface.
+Both media are used from the bridge's own thread, which runs in real time, so they need a
+ring backend (an emulated node receives from 'toEmulation' and sends into 'fromEmulation').
+A SharedMemory medium works as well, which lets the emulation run in another process.
+
+The I/O goes through io_uring in batches. Reading uses a multishot read (Linux 6.7; single
+reads for each free buffer on older kernels) on a provided buffer ring made of pooled
+PacketBuffers: the kernel writes each frame straight into a buffer, which is then handed to
+the medium as the RawPacket itself, and a fresh buffer takes its place. Frames small enough
+to be stored inline (see PacketBuffer) are copied out instead, and their buffer goes back to
+the kernel at once. Writing queues a write per frame and submits the batch with the same
+io_uring_enter() call that collects completions, so in steady state the bridge makes one
+system call per loop, however many frames it moves.
+
+Where io_uring is missing or forbidden, the bridge falls back to one read() or write() per
+frame. usesIoUring() tells which way it runs.
+
+AF_XDP is not supported: it needs an XDP program loaded on the interface, which is more
+than a TAP device (or this dependency-free tree) can offer.
+*/
+class TapBridge{
+public:
+    // Creates (or attaches to) the TAP interface and starts the bridge thread. Throws
+    // std::runtime_error if the interface cannot be opened (which needs CAP_NET_ADMIN), and
+    // std::invalid_argument for an unusable configuration or a medium without a ring backend.
+    TapBridge(const TapBridgeConfig& config, NetworkMedium& toEmulation, NetworkMedium& fromEmulation);
+
+    // Stops the thread and closes the interface (a non-persistent TAP interface disappears).
+    ~TapBridge();
+
+    TapBridge(const TapBridge&) = delete;
+    TapBridge& operator=(const TapBridge&) = delete;
+
+    // Stops exchanging frames; frames still waiting in 'fromEmulation' stay there.
+    void stop();
+
+    // The name the interface got, e.g. "tap0".
+    const std::string& getInterfaceName() const { return interfaceName; }
+
+    bool usesIoUring() const { return uring != nullptr; }
+
+    // True if reads are multishot (one request for all frames) rather than one request per buffer.
+    bool usesMultishotReads() const { return multishot; }
+
+    TapBridgeCounters getCounters() const;
+
+    const TapBridgeConfig& getConfig() const { return config; }
+
+private:
+    const TapBridgeConfig config;
+    NetworkMedium& toEmulation;
+    NetworkMedium& fromEmulation;
+    int tapFd = -1;
+    std::string interfaceName;
+
+    // io_uring state; used only by the bridge thread once it runs
+    std::unique_ptr<IoUring> uring;
+    std::unique_ptr<IoUringBufferRing> bufferRing;
+    bool multishot = false;
+    std::vector<PacketBuffer> receiveBuffers;   // Indexed by buffer id; each is owned by the kernel until it is filled.
+    std::size_t readsInFlight = 0;
+    std::vector<RawPacket> writes;              // Frames being written, by slot; kept alive until their write completes.
+    std::vector<std::uint32_t> freeWrites;      // Slots of 'writes' that are free.
+    std::vector<RawPacket> incoming;            // Frames read in the current round, sent to the emulation as one burst.
+
+    std::atomic<bool> running{true};
+    std::thread worker;
+
+    std::atomic<std::uint64_t> framesIn{0};
+    std::atomic<std::uint64_t> bytesIn{0};
+    std::atomic<std::uint64_t> droppedIn{0};
+    std::atomic<std::uint64_t> framesOut{0};
+    std::atomic<std::uint64_t> bytesOut{0};
+    std::atomic<std::uint64_t> writeErrors{0};
+    std::atomic<std::uint64_t> readErrors{0};
+
+    void openInterface();
+    void setUpIoUring();
+
+    void runIoUring();
+    void armReads();
+    void queueWrites();
+    void complete(const io_uring_cqe& cqe);
+    void drainIoUring();
+
+    void runSyscalls();
+
+    // Queues a frame read into 'buffer' for the emulation, keeping the buffer if it copied the frame.
+    void deliver(PacketBuffer& buffer, std::size_t length);
+
+    // Sends the frames queued by deliver() with one sendBatch().
+    void sendIncoming();
+};
+
+
+#endif  // End TAP_BRIDGE_H
@@ -0,0 +1,445 @@
+#include "Topology.h"
+#include "Checkpoint.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// Splits a line into whitespace separated words, dropping a '#' comment
+void splitWords(const std::string& line, std::vector<std::string>& words) {
+    words.clear();
+    std::size_t position = 0;
+    while (position < line.size()) {
+        while (position < line.size() && std::isspace(static_cast<unsigned char>(line[position]))) {
+            ++position;
+        }
+        if (position == line.size() || line[position] == '#') {
+            return;
+        }
+        const std::size_t start = position;
+        while (position < line.size() && !std::isspace(static_cast<unsigned char>(line[position])) && line[position] != '#') {
+            ++position;
+        }
+        words.emplace_back(line, start, position - start);
+    }
+}
+
+// Parses a number followed by one of the given suffixes, e.g. "10G" or "5us"
+bool parseQuantity(const std::string& text, const std::vector<std::pair<std::string, std::uint64_t>>& units, std::uint64_t& value) {
+    char* end = nullptr;
+    const double number = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || number < 0) {
+        return false;
+    }
+    const std::string suffix(end);
+    for (const std::pair<std::string, std::uint64_t>& unit : units) {
+        if (suffix == unit.first) {
+            value = static_cast<std::uint64_t>(number * static_cast<double>(unit.second) + 0.5);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads the "rate=" and "delay=" options at the end of a link or segment line
+bool parseTiming(const std::string& word, LinkTiming& timing) {
+    static const std::vector<std::pair<std::string, std::uint64_t>> RATE_UNITS = {
+        {"", 1}, {"k", 1000}, {"M", 1000000}, {"G", 1000000000}};
+    static const std::vector<std::pair<std::string, std::uint64_t>> TIME_UNITS = {
+        {"", NANOSECOND}, {"ns", NANOSECOND}, {"us", MICROSECOND}, {"ms", MILLISECOND}, {"s", SECOND}};
+    if (word.rfind("rate=", 0) == 0) {
+        return parseQuantity(word.substr(5), RATE_UNITS, timing.bitsPerSecond);
+    }
+    if (word.rfind("delay=", 0) == 0) {
+        return parseQuantity(word.substr(6), TIME_UNITS, timing.propagationDelay);
+    }
+    return false;
+}
+
+// Purposes of a medium's random streams, see Topology::streamSeed()
+constexpr std::uint64_t IMPAIRMENT_STREAM = 0;
+constexpr std::uint64_t QUEUE_LIMIT_STREAM = 1;
+constexpr std::uint64_t STREAM_PURPOSES = 2;
+
+[[noreturn]] void failAt(std::size_t lineNumber, const std::string& message) {
+    throw std::runtime_error("Topology line " + std::to_string(lineNumber) + ": " + message);
+}
+
+} // namespace
+
+Topology Topology::load(std::istream& input) {
+    Topology topology;
+    std::string line;
+    std::vector<std::string> words;
+    std::vector<NodeId> members;
+    std::size_t lineNumber = 0;
+
+    // Looks up a node named on the current line
+    auto nodeNamed = [&](const std::string& name) {
+        const NodeId node = topology.findNode(name);
+        if (node == NO_NODE) {
+            failAt(lineNumber, "unknown node '" + name + "'");
+        }
+        return node;
+    };
+
+    while (std::getline(input, line)) {
+        ++lineNumber;
+        splitWords(line, words);
+        if (words.empty()) {
+            continue;
+        }
+        // Everything after the names is an option: rate=... or delay=...
+        std::size_t nameCount = words.size();
+        LinkTiming timing;
+        while (nameCount > 1 && words[nameCount - 1].find('=') != std::string::npos) {
+            if (!parseTiming(words[nameCount - 1], timing)) {
+                failAt(lineNumber, "bad option '" + words[nameCount - 1] + "'");
+            }
+            --nameCount;
+        }
+
+        const std::string& keyword = words[0];
+        if (keyword == "node" && nameCount == 2) {
+            if (topology.findNode(words[1]) != NO_NODE) {
+                failAt(lineNumber, "node '" + words[1] + "' declared twice");
+            }
+            topology.addNode(words[1]);
+        } else if (keyword == "link" && nameCount == 3) {
+            topology.connect(nodeNamed(words[1]), nodeNamed(words[2]), timing);
+        } else if (keyword == "seed" && nameCount == 2) {
+            char* end = nullptr;
+            const std::uint64_t seed = std::strtoull(words[1].c_str(), &end, 0);
+            if (end == words[1].c_str() || *end != '\0') {
+                failAt(lineNumber, "bad seed '" + words[1] + "'");
+            }
+            topology.setSeed(seed);
+        } else if (keyword == "segment" && nameCount >= 4) {
+            members.clear();
+            for (std::size_t index = 2; index < nameCount; ++index) {
+                const NodeId member = nodeNamed(words[index]);
+                if (std::find(members.begin(), members.end(), member) != members.end()) {
+                    failAt(lineNumber, "node '" + words[index] + "' listed twice in segment '" + words[1] + "'");
+                }
+                members.push_back(member);
+            }
+            topology.addSegment(words[1], members, timing);
+        } else {
+            failAt(lineNumber, "expected 'node <name>', 'link <node> <node>', 'segment <name> <node> <node>...' or 'seed <number>'");
+        }
+    }
+    topology.buildForwardingTables();
+    return topology;
+}
+
+Topology Topology::loadFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open topology file " + path);
+    }
+    return load(file);
+}
+
+NodeId Topology::addNode(const std::string& name) {
+    const NodeId node = static_cast<NodeId>(nodes.size());
+    if (!nodesByName.emplace(name, node).second) {
+        throw std::invalid_argument("Node name '" + name + "' is already taken");
+    }
+    nodes.push_back(NodeEntry{name, {}, nullptr});
+    return node;
+}
+
+NodeId Topology::findNode(const std::string& name) const {
+    const auto found = nodesByName.find(name);
+    return found == nodesByName.end() ? NO_NODE : found->second;
+}
+
+NetworkMedium& Topology::addMedium(MediumBackend backend, const LinkTiming& timing) {
+    media.push_back(std::make_unique<NetworkMedium>(backend));
+    mediaTiming.push_back(timing);
+    if (scheduler != nullptr) {
+        media.back()->attachScheduler(*scheduler, timing);
+    }
+    return *media.back();
+}
+
+// One medium per direction, and a port at each end that knows the other end's port
+void Topology::connect(NodeId first, NodeId second, const LinkTiming& timing) {
+    if (first == second) {
+        throw std::invalid_argument("A link needs two different nodes");
+    }
+    NetworkMedium& forward = addMedium(MediumBackend::Queue, timing);
+    NetworkMedium& backward = addMedium(MediumBackend::Queue, timing);
+    std::vector<Port>& firstPorts = nodes[first].ports;
+    std::vector<Port>& secondPorts = nodes[second].ports;
+
+    Port atFirst;
+    atFirst.tx = &forward;
+    atFirst.rx = &backward;
+    atFirst.peer = second;
+    atFirst.peerPort = static_cast<PortId>(secondPorts.size());
+    Port atSecond;
+    atSecond.tx = &backward;
+    atSecond.rx = &forward;
+    atSecond.peer = first;
+    atSecond.peerPort = static_cast<PortId>(firstPorts.size());
+    firstPorts.push_back(atFirst);
+    secondPorts.push_back(atSecond);
+}
+
+void Topology::addSegment(const std::string& name, const std::vector<NodeId>& members, const LinkTiming& timing) {
+    for (std::size_t index = 0; index < members.size(); ++index) {
+        if (std::find(members.begin(), members.begin() + index, members[index]) != members.begin() + index) {
+            throw std::invalid_argument("Node '" + nodes[members[index]].name + "' is listed twice in segment '" + name + "'");
+        }
+    }
+    NetworkMedium& medium = addMedium(MediumBackend::Broadcast, timing);
+    const std::uint32_t segment = static_cast<std::uint32_t>(segments.size());
+    SegmentEntry entry{name, &medium, members, {}};
+    for (NodeId member : members) {
+        Port port;
+        port.tx = &medium;
+        port.rx = &medium;
+        port.segment = segment;
+        port.receiver = medium.attachReceiver();
+        entry.memberPorts.push_back(static_cast<PortId>(nodes[member].ports.size()));
+        nodes[member].ports.push_back(port);
+    }
+    segments.push_back(std::move(entry));
+}
+
+void Topology::attachScheduler(EventScheduler& eventScheduler) {
+    scheduler = &eventScheduler;
+    for (std::size_t index = 0; index < media.size(); ++index) {
+        media[index]->attachScheduler(eventScheduler, mediaTiming[index]);
+    }
+}
+
+std::string Topology::getMediumName(NodeId node, PortId port) const {
+    const Port& entry = nodes[node].ports[port];
+    if (entry.segment != NO_SEGMENT) {
+        return segments[entry.segment].name;
+    }
+    return nodes[node].name + "->" + nodes[entry.peer].name;
+}
+
+// Parallel links between the same two nodes share a name, so the sender's port goes into the index
+std::uint64_t Topology::streamSeed(NodeId node, PortId port, std::uint64_t purpose) const {
+    const bool segment = nodes[node].ports[port].segment != NO_SEGMENT;
+    const std::uint64_t index = (segment ? 0 : std::uint64_t(port)) * STREAM_PURPOSES + purpose;
+    return streams.seedFor(getMediumName(node, port), index);
+}
+
+void Topology::setImpairment(NodeId node, PortId port, ImpairmentConfig config) {
+    config.seed = streamSeed(node, port, IMPAIRMENT_STREAM);
+    nodes[node].ports[port].tx->setImpairment(config);
+}
+
+void Topology::setQueueLimit(NodeId node, PortId port, QueueLimitConfig config) {
+    config.seed = streamSeed(node, port, QUEUE_LIMIT_STREAM);
+    nodes[node].ports[port].tx->setQueueLimit(config);
+}
+
+// A medium has either a queue limit or a flow queue, so the two share a stream
+void Topology::setFlowQueue(NodeId node, PortId port, FlowQueueConfig config) {
+    config.seed = streamSeed(node, port, QUEUE_LIMIT_STREAM);
+    nodes[node].ports[port].tx->setFlowQueue(config);
+}
+
+void Topology::setNode(NodeId node, std::unique_ptr<Node> behaviour) {
+    nodes[node].behaviour = std::move(behaviour);
+}
+
+void Topology::start(EventScheduler& eventScheduler) {
+    for (NodeEntry& entry : nodes) {
+        if (entry.behaviour) {
+            entry.behaviour->start(eventScheduler);
+        }
+    }
+}
+
+std::vector<EventTarget*> Topology::eventTargets() const {
+    std::vector<EventTarget*> targets;
+    targets.reserve(media.size() + nodes.size());
+    for (const std::unique_ptr<NetworkMedium>& medium : media) {
+        targets.push_back(medium->eventTarget());
+    }
+    for (const NodeEntry& entry : nodes) {
+        targets.push_back(entry.behaviour.get());
+    }
+    return targets;
+}
+
+// One section for the topology's identity and the scheduler, then one per medium and node behaviour
+void Topology::saveCheckpoint(const EventScheduler& eventScheduler, const std::string& path) const {
+    CheckpointWriter writer;
+    writer.beginSection("topology");
+    writer.put(streams.getRunSeed());
+    writer.put<std::uint64_t>(media.size());
+    writer.put<std::uint64_t>(nodes.size());
+    for (const NodeEntry& entry : nodes) {
+        writer.putString(entry.name);
+        writer.put(entry.behaviour != nullptr);
+    }
+
+    writer.beginSection("scheduler");
+    eventScheduler.saveState(writer, eventTargets());
+    for (std::size_t index = 0; index < media.size(); ++index) {
+        writer.beginSection("medium/" + std::to_string(index));
+        media[index]->saveState(writer);
+    }
+    for (std::size_t index = 0; index < nodes.size(); ++index) {
+        if (nodes[index].behaviour) {
+            writer.beginSection("node/" + std::to_string(index));
+            nodes[index].behaviour->saveState(writer);
+        }
+    }
+    writer.save(path);
+}
+
+// The topology is checked against the saved one before anything is overwritten
+void Topology::restoreCheckpoint(EventScheduler& eventScheduler, const CheckpointFile& checkpoint) {
+    if (scheduler != nullptr && scheduler != &eventScheduler) {
+        throw std::invalid_argument("The topology runs on another scheduler than the one to restore");
+    }
+    CheckpointReader identity = checkpoint.section("topology");
+    const std::uint64_t runSeed = identity.get<std::uint64_t>();
+    if (identity.get<std::uint64_t>() != media.size() || identity.get<std::uint64_t>() != nodes.size()) {
+        throw std::runtime_error("The checkpoint was taken from a topology with other nodes or media");
+    }
+    for (const NodeEntry& entry : nodes) {
+        if (identity.getString() != entry.name || identity.get<bool>() != (entry.behaviour != nullptr)) {
+            throw std::runtime_error("The checkpoint was taken from a topology with other nodes than '" + entry.name + "'");
+        }
+    }
+
+    if (scheduler == nullptr) {
+        attachScheduler(eventScheduler);
+    }
+    streams = RandomStreams(runSeed);
+    for (std::size_t index = 0; index < media.size(); ++index) {
+        CheckpointReader reader = checkpoint.section("medium/" + std::to_string(index));
+        media[index]->restoreState(reader);
+    }
+    for (std::size_t index = 0; index < nodes.size(); ++index) {
+        if (nodes[index].behaviour) {
+            CheckpointReader reader = checkpoint.section("node/" + std::to_string(index));
+            nodes[index].behaviour->restoreState(reader, eventScheduler);
+        }
+    }
+    CheckpointReader events = checkpoint.section("scheduler");
+    eventScheduler.restoreState(events, eventTargets());
+}
+
+void Topology::restoreCheckpoint(EventScheduler& eventScheduler, const std::string& path) {
+    restoreCheckpoint(eventScheduler, CheckpointFile(path));
+}
+
+// A node with a single port is a leaf, unless it is a point-to-point link to another leaf (two nodes alone)
+bool Topology::isLeaf(NodeId node) const {
+    const std::vector<Port>& ports = nodes[node].ports;
+    if (ports.size() != 1) {
+        return false;
+    }
+    return ports[0].segment != NO_SEGMENT || nodes[ports[0].peer].ports.size() > 1;
+}
+
+// One breadth-first search per destination vertex fills that vertex's column of the table
+void Topology::buildForwardingTables() {
+    const std::size_t count = nodes.size();
+    rowOfNode.assign(count, NO_ROW);
+    vertexOfNode.assign(count, NO_ROW);
+    attachmentPort.assign(count, NO_PORT);
+
+    std::uint32_t rows = 0;
+    for (NodeId node = 0; node < count; ++node) {
+        if (!isLeaf(node)) {
+            rowOfNode[node] = rows;
+            vertexOfNode[node] = rows;
+            ++rows;
+        }
+    }
+    vertexCount = rows + static_cast<std::uint32_t>(segments.size());
+
+    // Leaves inherit the vertex of their attachment point
+    for (NodeId node = 0; node < count; ++node) {
+        if (rowOfNode[node] != NO_ROW) {
+            continue;
+        }
+        const Port& port = nodes[node].ports[0];
+        if (port.segment != NO_SEGMENT) {
+            vertexOfNode[node] = rows + port.segment;
+        } else {
+            vertexOfNode[node] = rowOfNode[port.peer];
+            attachmentPort[node] = port.peerPort;
+        }
+    }
+
+    // Routing graph in compressed form. An edge from vertex w to vertex u carries the port
+    // of u that leads back to w (none if u is a segment), which is what u has to use to
+    // reach a destination behind w.
+    std::vector<std::uint32_t> edgeStart(vertexCount + 1, 0);
+    std::vector<std::uint32_t> edgeTarget;
+    std::vector<PortId> edgePort;
+    std::vector<NodeId> nodeOfRow(rows);
+    for (NodeId node = 0; node < count; ++node) {
+        if (rowOfNode[node] != NO_ROW) {
+            nodeOfRow[rowOfNode[node]] = node;
+        }
+    }
+    for (std::uint32_t row = 0; row < rows; ++row) {
+        edgeStart[row] = static_cast<std::uint32_t>(edgeTarget.size());
+        for (const Port& port : nodes[nodeOfRow[row]].ports) {
+            if (port.segment != NO_SEGMENT) {
+                edgeTarget.push_back(rows + port.segment);
+                edgePort.push_back(NO_PORT);
+            } else if (rowOfNode[port.peer] != NO_ROW) {
+                edgeTarget.push_back(rowOfNode[port.peer]);
+                edgePort.push_back(port.peerPort);
+            }
+        }
+    }
+    for (std::uint32_t segment = 0; segment < segments.size(); ++segment) {
+        edgeStart[rows + segment] = static_cast<std::uint32_t>(edgeTarget.size());
+        const SegmentEntry& entry = segments[segment];
+        for (std::size_t index = 0; index < entry.members.size(); ++index) {
+            if (rowOfNode[entry.members[index]] != NO_ROW) {
+                edgeTarget.push_back(rowOfNode[entry.members[index]]);
+                edgePort.push_back(entry.memberPorts[index]);
+            }
+        }
+    }
+    edgeStart[vertexCount] = static_cast<std::uint32_t>(edgeTarget.size());
+
+    // The first search to reach a vertex is that of the lowest vertex of its component
+    nextPorts.assign(static_cast<std::size_t>(rows) * vertexCount, NO_PORT);
+    componentOfVertex.assign(vertexCount, NO_ROW);
+    std::vector<std::uint32_t> visitedFor(vertexCount, NO_ROW);
+    std::vector<std::uint32_t> frontier(vertexCount);
+    for (std::uint32_t destination = 0; destination < vertexCount; ++destination) {
+        std::size_t head = 0;
+        std::size_t tail = 0;
+        frontier[tail++] = destination;
+        visitedFor[destination] = destination;
+        while (head < tail) {
+            const std::uint32_t vertex = frontier[head++];
+            if (componentOfVertex[vertex] == NO_ROW) {
+                componentOfVertex[vertex] = destination;
+            }
+            for (std::uint32_t edge = edgeStart[vertex]; edge < edgeStart[vertex + 1]; ++edge) {
+                const std::uint32_t next = edgeTarget[edge];
+                if (visitedFor[next] == destination) {
+                    continue;
+                }
+                visitedFor[next] = destination;
+                frontier[tail++] = next;
+                if (next < rows) {
+                    nextPorts[static_cast<std::size_t>(next) * vertexCount + destination] = edgePort[edge];
+                }
+            }
+        }
+    }
+}
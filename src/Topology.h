@@ -0,0 +1,204 @@
+#ifndef TOPOLOGY_H    // This will ensure no repeat definition of this header file.
+#define TOPOLOGY_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "NetworkMedium.h"
+#include "Node.h"
+#include "Random.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using NodeId = std::uint32_t;
+using PortId = std::uint32_t;
+constexpr NodeId NO_NODE = std::numeric_limits<NodeId>::max();
+constexpr PortId NO_PORT = std::numeric_limits<PortId>::max();
+constexpr std::uint32_t NO_SEGMENT = std::numeric_limits<std::uint32_t>::max();
+
+class CheckpointFile;
+
+/*
+A Port is one network interface of a node: where it sends frames and where it receives them.
+A point-to-point link gives each of its two nodes a port with a medium per direction; a LAN
+segment gives each member a port on the segment's shared Broadcast medium.
+*/
+struct Port {
+    NetworkMedium* tx = nullptr;        // The medium this node sends into.
+    NetworkMedium* rx = nullptr;        // The medium this node receives from (the same as 'tx' on a segment).
+    NodeId peer = NO_NODE;              // The node at the other end of a point-to-point link,
+    PortId peerPort = NO_PORT;          // and its port; both unset on a segment.
+    std::uint32_t segment = NO_SEGMENT; // Index of the segment, or NO_SEGMENT on a point-to-point link.
+    ReceiverId receiver = NO_RECEIVER;  // This node's receiver id on the segment's medium.
+};
+
+/*
+Topology owns the nodes and media of a network: point-to-point links (two media, one per
+direction) and LAN segments (one Broadcast medium shared by all members). It can be built in
+code or loaded from a text file, and it precomputes where every node has to send a frame to
+reach any other node, so forwarding a frame is a single array lookup.
+
+Forwarding follows the shortest path in hops. To keep the table small for large networks,
+nodes with a single port ("leaves", typically hosts) get no table of their own: they always
+send through that port, and the other nodes route to the leaf's attachment point (the node
+or segment it hangs off). The table then only has a row per non-leaf node and a column per
+non-leaf node and segment.
+*/
+class Topology{
+public:
+    Topology() = default;
+    Topology(Topology&&) = default;
+    Topology& operator=(Topology&&) = default;
+
+    // Reads a topology from a text file, one declaration per line ('#' starts a comment):
+    //
+    //   node <name>
+    //   link <node> <node> [rate=<bits/s>] [delay=<time>]
+    //   segment <name> <node> <node> ... [rate=<bits/s>] [delay=<time>]
+    //   seed <number>
+    //
+    // Rates take the suffixes k, M and G (e.g. rate=10G); times take ns, us, ms and s
+    // (e.g. delay=5us) and are nanoseconds without one. The forwarding tables are built
+    // before the topology is returned. Throws std::runtime_error naming the offending line.
+    static Topology load(std::istream& input);
+    static Topology loadFile(const std::string& path);
+
+    // Adds a node and returns its id; ids are handed out in order, starting at 0.
+    // Throws std::invalid_argument if the name is already taken.
+    NodeId addNode(const std::string& name);
+
+    // Connects two different nodes by a point-to-point link; throws std::invalid_argument
+    // if both are the same node.
+    void connect(NodeId first, NodeId second, const LinkTiming& timing = LinkTiming());
+
+    // Connects the given nodes by one shared LAN segment; throws std::invalid_argument if a
+    // node is listed more than once.
+    void addSegment(const std::string& name, const std::vector<NodeId>& members, const LinkTiming& timing = LinkTiming());
+
+    // Puts every medium, including the ones added later, on the scheduler's virtual clock.
+    void attachScheduler(EventScheduler& eventScheduler);
+
+    // Computes the forwarding tables. Has to be called again after the topology changed and
+    // before nextPort() is used (load() does it already).
+    void buildForwardingTables();
+
+    // The port 'from' has to send a frame out of for it to reach 'to', or NO_PORT if 'to'
+    // cannot be reached (or is 'from' itself).
+    PortId nextPort(NodeId from, NodeId to) const {
+        if (from == to) {
+            return NO_PORT;
+        }
+        const std::uint32_t row = rowOfNode[from];
+        const std::uint32_t vertex = vertexOfNode[to];
+        if (row == NO_ROW) {
+            // A leaf only has one way out, which leads wherever its attachment point does
+            return componentOfVertex[vertexOfNode[from]] == componentOfVertex[vertex] ? 0 : NO_PORT;
+        }
+        if (vertex == row) {
+            return attachmentPort[to];  // A leaf hanging off this node
+        }
+        return nextPorts[static_cast<std::size_t>(row) * vertexCount + vertex];
+    }
+
+    std::size_t nodeCount() const { return nodes.size(); }
+    std::size_t segmentCount() const { return segments.size(); }
+    std::size_t mediumCount() const { return media.size(); }
+
+    // The id of the node with the given name, or NO_NODE.
+    NodeId findNode(const std::string& name) const;
+    const std::string& getName(NodeId node) const { return nodes[node].name; }
+    const std::string& getSegmentName(std::uint32_t segment) const { return segments[segment].name; }
+
+    // The name of the medium a port sends into: "<node>-><peer>" on a point-to-point link,
+    // the segment's name on a segment.
+    std::string getMediumName(NodeId node, PortId port) const;
+
+    // Sets the seed of the run (1 by default). Every random stream of the topology derives
+    // from it, see RandomStreams.
+    void setSeed(std::uint64_t seed) { streams = RandomStreams(seed); }
+    const RandomStreams& getRandomStreams() const { return streams; }
+
+    // Impairs (or bounds) the medium a port sends into. The configuration's seed is replaced
+    // by the seed of that medium's own stream, so every medium draws different random numbers
+    // and a run replays exactly for the same topology seed.
+    void setImpairment(NodeId node, PortId port, ImpairmentConfig config);
+    void setQueueLimit(NodeId node, PortId port, QueueLimitConfig config);
+    void setFlowQueue(NodeId node, PortId port, FlowQueueConfig config);
+
+    const std::vector<Port>& getPorts(NodeId node) const { return nodes[node].ports; }
+    const Port& getPort(NodeId node, PortId port) const { return nodes[node].ports[port]; }
+
+    // Gives a node its behaviour; the topology takes ownership of it.
+    void setNode(NodeId node, std::unique_ptr<Node> behaviour);
+    Node* getNode(NodeId node) const { return nodes[node].behaviour.get(); }
+
+    // Calls start() on every node that has a behaviour.
+    void start(EventScheduler& eventScheduler);
+
+    // Saves the dynamic state of a run to the checkpoint 'path': the scheduler's clock and
+    // pending events, every medium's frames (waiting and on the wire) with its impairment and
+    // queue limit, the run seed and the state of every node behaviour. The structure itself
+    // (nodes, links, segments, timings) is not saved. Call it between events, while no other
+    // thread uses the media. Throws std::runtime_error if something cannot be checkpointed,
+    // such as an event for a target outside the topology.
+    void saveCheckpoint(const EventScheduler& eventScheduler, const std::string& path) const;
+
+    // Continues a run from a checkpoint, on a topology built the same way as the saved one
+    // (same declarations, node behaviours of the same configuration) and not start()ed: the
+    // checkpoint replaces the state start() and the warm-up would have produced. The topology
+    // is attached to 'eventScheduler' if it is not attached yet. One CheckpointFile can be
+    // restored from any number of times. Throws std::runtime_error if the checkpoint was taken
+    // from another topology, and std::invalid_argument if the topology runs on another scheduler.
+    void restoreCheckpoint(EventScheduler& eventScheduler, const CheckpointFile& checkpoint);
+    void restoreCheckpoint(EventScheduler& eventScheduler, const std::string& path);
+
+private:
+    static constexpr std::uint32_t NO_ROW = std::numeric_limits<std::uint32_t>::max();
+
+    struct NodeEntry {
+        std::string name;
+        std::vector<Port> ports;
+        std::unique_ptr<Node> behaviour;
+    };
+    struct SegmentEntry {
+        std::string name;
+        NetworkMedium* medium;
+        std::vector<NodeId> members;
+        std::vector<PortId> memberPorts;    // Each member's port on this segment.
+    };
+
+    std::vector<NodeEntry> nodes;
+    std::vector<SegmentEntry> segments;
+    std::unordered_map<std::string, NodeId> nodesByName;
+    std::vector<std::unique_ptr<NetworkMedium>> media;
+    std::vector<LinkTiming> mediaTiming;
+    EventScheduler* scheduler = nullptr;
+    RandomStreams streams;
+
+    // Forwarding state, see buildForwardingTables(). The vertices of the routing graph are
+    // the non-leaf nodes (numbered like their table rows) followed by the segments.
+    std::uint32_t vertexCount = 0;
+    std::vector<std::uint32_t> rowOfNode;       // NO_ROW for leaves.
+    std::vector<std::uint32_t> vertexOfNode;    // The node's vertex, or its attachment point's for a leaf.
+    std::vector<PortId> attachmentPort;         // For a leaf: the attachment node's port towards it.
+    std::vector<PortId> nextPorts;              // Row-major table, one row per non-leaf node.
+    std::vector<std::uint32_t> componentOfVertex;   // Lowest vertex that can reach it; equal for connected vertices.
+
+    NetworkMedium& addMedium(MediumBackend backend, const LinkTiming& timing);
+    bool isLeaf(NodeId node) const;
+
+    // Everything a scheduler event of the topology can be for: the media, then the nodes
+    // (nullptr for a node without a behaviour), so that an event's target is named by its index.
+    std::vector<EventTarget*> eventTargets() const;
+
+    // The random stream of one purpose of one port's medium.
+    std::uint64_t streamSeed(NodeId node, PortId port, std::uint64_t purpose) const;
+};
+
+
+#endif  // End TOPOLOGY_H
@@ -0,0 +1,222 @@
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+const char* categoryName(TraceCategory category) {
+    switch (category) {
+    case TraceCategory::Medium:
+        return "medium";
+    case TraceCategory::Scheduler:
+        return "scheduler";
+    case TraceCategory::Impairment:
+        return "impairment";
+    case TraceCategory::Switch:
+        return "switch";
+    }
+    return "unknown";
+}
+
+// Parents first: they start no later than their children and are less deep
+std::vector<TraceRecord> inStartOrder(std::vector<TraceRecord> records) {
+    std::sort(records.begin(), records.end(), [](const TraceRecord& a, const TraceRecord& b) {
+        return a.start != b.start ? a.start < b.start : a.depth < b.depth;
+    });
+    return records;
+}
+
+void writeFile(const std::string& path, const std::string& text) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Cannot create trace file " + path);
+    }
+    const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (std::fclose(file) != 0 || !written) {
+        throw std::runtime_error("Cannot write trace file " + path);
+    }
+}
+
+} // namespace
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+// The clock is read at the first start() after a clear(), so times count from there
+void Tracer::start(std::uint32_t period) {
+    if (period == 0) {
+        throw std::invalid_argument("Trace sample period must be at least 1");
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (startTicks == 0) {
+            startTime = std::chrono::steady_clock::now();
+            startTicks = readTraceClock();
+        }
+    }
+    samplePeriod.store(period, std::memory_order_relaxed);
+}
+
+void Tracer::stop() {
+    samplePeriod.store(0, std::memory_order_relaxed);
+}
+
+// The rings stay registered, since their threads keep pointers to them
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::unique_ptr<TraceBuffer>& buffer : buffers) {
+        buffer->written.store(0, std::memory_order_relaxed);
+    }
+    startTicks = 0;
+    if (isRecording()) {
+        startTime = std::chrono::steady_clock::now();
+        startTicks = readTraceClock();
+    }
+}
+
+TraceBuffer& Tracer::attach() {
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers.push_back(std::make_unique<TraceBuffer>());
+    TraceBuffer& buffer = *buffers.back();
+    buffer.records.resize(BUFFER_RECORDS);
+    buffer.thread = static_cast<std::uint32_t>(buffers.size());
+    return buffer;
+}
+
+std::size_t Tracer::recordCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t count = 0;
+    for (const std::unique_ptr<TraceBuffer>& buffer : buffers) {
+        count += std::min<std::uint64_t>(buffer->written.load(std::memory_order_acquire), BUFFER_RECORDS);
+    }
+    return count;
+}
+
+std::uint64_t Tracer::overwrittenCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::uint64_t count = 0;
+    for (const std::unique_ptr<TraceBuffer>& buffer : buffers) {
+        const std::uint64_t written = buffer->written.load(std::memory_order_acquire);
+        count += written - std::min<std::uint64_t>(written, BUFFER_RECORDS);
+    }
+    return count;
+}
+
+// A full ring starts with its oldest kept record, the one the next record would overwrite
+std::vector<std::vector<TraceRecord>> Tracer::records() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::vector<TraceRecord>> result;
+    result.reserve(buffers.size());
+    for (const std::unique_ptr<TraceBuffer>& buffer : buffers) {
+        const std::uint64_t written = buffer->written.load(std::memory_order_acquire);
+        const std::uint64_t first = written - std::min<std::uint64_t>(written, BUFFER_RECORDS);
+        std::vector<TraceRecord>& records = result.emplace_back();
+        records.reserve(written - first);
+        for (std::uint64_t index = first; index < written; ++index) {
+            records.push_back(buffer->records[index & (BUFFER_RECORDS - 1)]);
+        }
+    }
+    return result;
+}
+
+// Falls back to one tick per nanosecond if too little time has passed to tell
+double Tracer::ticksPerNanosecond() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::uint64_t ticks = readTraceClock() - startTicks;
+    const double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+    if (startTicks == 0 || nanoseconds < 1000.0 || ticks == 0) {
+        return 1.0;
+    }
+    return static_cast<double>(ticks) / nanoseconds;
+}
+
+std::string Tracer::toChromeTrace() const {
+    const double rate = ticksPerNanosecond();
+    const std::vector<std::vector<TraceRecord>> threads = records();
+    std::uint64_t origin;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        origin = startTicks;
+    }
+    // Ticks as signed microseconds since start(), for records made before a clear()
+    auto microseconds = [rate](std::uint64_t ticks, std::uint64_t since) {
+        return static_cast<double>(static_cast<std::int64_t>(ticks - since)) / rate / 1000.0;
+    };
+
+    std::string text = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    char line[256];
+    bool first = true;
+    for (std::size_t thread = 0; thread < threads.size(); ++thread) {
+        const unsigned tid = static_cast<unsigned>(thread + 1);
+        std::snprintf(line, sizeof(line),
+                      "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                      first ? "" : ",", tid, tid);
+        text += line;
+        first = false;
+        for (const TraceRecord& record : threads[thread]) {
+            std::snprintf(line, sizeof(line),
+                          ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+                          record.name, categoryName(record.category), microseconds(record.start, origin),
+                          microseconds(record.end, record.start), tid);
+            text += line;
+            if (record.frames != 0) {
+                std::snprintf(line, sizeof(line), ",\"args\":{\"frames\":%llu}",
+                              static_cast<unsigned long long>(record.frames));
+                text += line;
+            }
+            text += '}';
+        }
+    }
+    text += "\n]}\n";
+    return text;
+}
+
+// Each record's stack is the chain of open records it was nested in; its self time is its
+// duration less that of its children. Stacks whose parents were overwritten start lower.
+std::string Tracer::toFoldedStacks() const {
+    const double rate = ticksPerNanosecond();
+    const std::vector<std::vector<TraceRecord>> threads = records();
+    std::map<std::string, double> selfTimes;
+    for (std::size_t thread = 0; thread < threads.size(); ++thread) {
+        const std::vector<TraceRecord> ordered = inStartOrder(threads[thread]);
+        std::vector<double> self(ordered.size());
+        std::vector<std::string> stacks(ordered.size());
+        std::vector<std::size_t> open;
+        const std::string root = "thread " + std::to_string(thread + 1);
+        for (std::size_t index = 0; index < ordered.size(); ++index) {
+            const TraceRecord& record = ordered[index];
+            while (!open.empty() && ordered[open.back()].depth >= record.depth) {
+                open.pop_back();
+            }
+            const double duration = static_cast<double>(record.end - record.start) / rate;
+            self[index] = duration;
+            if (open.empty()) {
+                stacks[index] = root + ';' + record.name;
+            } else {
+                self[open.back()] -= duration;
+                stacks[index] = stacks[open.back()] + ';' + record.name;
+            }
+            open.push_back(index);
+        }
+        for (std::size_t index = 0; index < ordered.size(); ++index) {
+            selfTimes[stacks[index]] += std::max(self[index], 0.0);
+        }
+    }
+    std::string text;
+    for (const auto& [stack, nanoseconds] : selfTimes) {
+        text += stack + ' ' + std::to_string(static_cast<std::uint64_t>(nanoseconds + 0.5)) + '\n';
+    }
+    return text;
+}
+
+void Tracer::writeChromeTraceFile(const std::string& path) const {
+    writeFile(path, toChromeTrace());
+}
+
+void Tracer::writeFoldedStacksFile(const std::string& path) const {
+    writeFile(path, toFoldedStacks());
+}
@@ -0,0 +1,232 @@
+#ifndef TRACE_H    // This will ensure no repeat definition of this header file.
+#define TRACE_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+Trace points on the hot paths of the medium, the scheduler, the impairment and the switch.
+
+They are compiled in only when NETEMU_TRACE is defined (-DNETEMU_TRACE); otherwise the
+NETEMU_TRACE_* macros expand to nothing and their arguments are not even evaluated. When
+compiled in, a trace point costs one relaxed load while the Tracer is not recording.
+
+    NETEMU_TRACE_SCOPE(Medium, "NetworkMedium::sendPacket");
+    NETEMU_TRACE_SCOPE_FRAMES(Medium, "NetworkMedium::sendBatch", packets.size());
+
+Each macro opens a scope that lasts until the end of the enclosing block. Names must be string
+literals (only the pointer is recorded) without quotes or backslashes.
+*/
+#define NETEMU_TRACE_CONCAT_INNER(a, b) a##b
+#define NETEMU_TRACE_CONCAT(a, b) NETEMU_TRACE_CONCAT_INNER(a, b)
+
+#ifdef NETEMU_TRACE
+#define NETEMU_TRACE_SCOPE(category, name) \
+    TraceScope NETEMU_TRACE_CONCAT(traceScope, __LINE__)(TraceCategory::category, name)
+#define NETEMU_TRACE_SCOPE_FRAMES(category, name, frames) \
+    TraceScope NETEMU_TRACE_CONCAT(traceScope, __LINE__)(TraceCategory::category, name, frames)
+#else
+#define NETEMU_TRACE_SCOPE(category, name) static_cast<void>(0)
+#define NETEMU_TRACE_SCOPE_FRAMES(category, name, frames) static_cast<void>(0)
+#endif
+
+// The stage a trace point belongs to; the "cat" of the exported Chrome trace events.
+enum class TraceCategory : std::uint8_t {
+    Medium,
+    Scheduler,
+    Impairment,
+    Switch,
+};
+
+// Reads the clock trace points are timed with: the time stamp counter on x86, the virtual
+// counter on ARMv8, the steady clock in nanoseconds elsewhere. Ticks are converted to time
+// when a trace is exported.
+inline std::uint64_t readTraceClock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// One scope a thread has left.
+struct TraceRecord {
+    std::uint64_t start = 0;            // Clock ticks, see readTraceClock().
+    std::uint64_t end = 0;
+    const char* name = nullptr;
+    std::uint64_t frames = 0;           // Frames the scope handled, if it said; 0 otherwise.
+    std::uint32_t depth = 0;            // Scopes of the same thread it was opened in.
+    TraceCategory category = TraceCategory::Medium;
+};
+
+// The records of one thread: a ring that keeps the most recent ones.
+struct TraceBuffer {
+    std::vector<TraceRecord> records;   // Tracer::BUFFER_RECORDS of them.
+    std::atomic<std::uint64_t> written{0};  // Records written so far, overwritten ones included.
+    std::uint32_t thread = 0;           // Thread number in the exported trace, from 1.
+
+    // Only the owning thread pushes; 'written' is published after the record is complete.
+    void push(const TraceRecord& record) {
+        const std::uint64_t index = written.load(std::memory_order_relaxed);
+        records[index & (records.size() - 1)] = record;
+        written.store(index + 1, std::memory_order_release);
+    }
+};
+
+// What a thread's trace points need between a scope's start and its end.
+struct TraceThread {
+    TraceBuffer* buffer = nullptr;      // Registered on the first record.
+    std::uint32_t depth = 0;            // Scopes open now.
+    std::uint32_t skipped = 0;          // Outermost scopes since the last one sampled.
+    bool sampling = false;              // Whether the current outermost scope is recorded.
+};
+
+inline constinit thread_local TraceThread traceThread;
+
+/*
+Tracer is the process-wide switch and store of the trace points (see NETEMU_TRACE_SCOPE).
+
+Every thread records into its own ring of BUFFER_RECORDS records, so recording takes no lock
+and shares no cache line; a full ring overwrites its oldest records. Rings are registered the
+first time their thread records, and stay with the Tracer after the thread has exited, so the
+worker threads of a ParallelSimulation can be exported once they are done.
+
+Sampling works on whole call trees: with a period of N, every Nth outermost scope of a thread
+is recorded together with everything nested in it, and the others are not timed at all. The
+sampled trees are complete, so flame graphs built from them show the true proportions.
+
+Recording is controlled from any thread. Exporting reads the rings without locking them, so
+it is done while the traced threads are stopped or idle.
+*/
+class Tracer{
+public:
+    // Records per thread; a power of two.
+    static constexpr std::size_t BUFFER_RECORDS = 65536;
+
+    // The process-wide tracer.
+    static Tracer& instance();
+
+    // Starts recording every 'samplePeriod'th outermost scope of each thread. Throws
+    // std::invalid_argument for a period of 0.
+    void start(std::uint32_t samplePeriod = 1);
+
+    // Stops recording; scopes already open are still recorded when they end.
+    void stop();
+
+    bool isRecording() const { return samplePeriod.load(std::memory_order_relaxed) != 0; }
+
+    // Forgets every record.
+    void clear();
+
+    // Records kept over all threads, and records lost because a ring was full.
+    std::size_t recordCount() const;
+    std::uint64_t overwrittenCount() const;
+
+    // The kept records of every thread, in the order they were written.
+    std::vector<std::vector<TraceRecord>> records() const;
+
+    // The records in Chrome's trace event format (JSON), which chrome://tracing and Perfetto
+    // open: one complete event per scope, with microsecond times since start().
+    std::string toChromeTrace() const;
+
+    // The records as folded stacks ("thread 1;outer;inner 1234" per line, nanoseconds of
+    // self time), the input of flamegraph.pl and speedscope.
+    std::string toFoldedStacks() const;
+
+    // Write the formats above to 'path'. Throw std::runtime_error if the file cannot be written.
+    void writeChromeTraceFile(const std::string& path) const;
+    void writeFoldedStacksFile(const std::string& path) const;
+
+    // Registers the calling thread's ring; called by the first record of a thread.
+    TraceBuffer& attach();
+
+    // Read by every trace point: 0 while not recording, the sample period otherwise.
+    static inline std::atomic<std::uint32_t> samplePeriod{0};
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+private:
+    Tracer() = default;
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+    // A clock reading and the steady time taken with it at start(), to convert ticks.
+    std::uint64_t startTicks = 0;
+    std::chrono::steady_clock::time_point startTime;
+
+    // Ticks of readTraceClock() per nanosecond, measured between start() and now.
+    double ticksPerNanosecond() const;
+};
+
+/*
+TraceScope times the block it lives in, if the Tracer is recording and the scope is sampled.
+Use it through NETEMU_TRACE_SCOPE, so that it can be compiled out.
+*/
+class TraceScope{
+public:
+    TraceScope(TraceCategory category, const char* name, std::uint64_t frames = 0) {
+        const std::uint32_t period = Tracer::samplePeriod.load(std::memory_order_relaxed);
+        if (period == 0) {
+            return;
+        }
+        TraceThread& thread = traceThread;
+        if (thread.depth == 0) {
+            thread.sampling = ++thread.skipped >= period;
+            if (thread.sampling) {
+                thread.skipped = 0;
+            }
+        }
+        active = true;
+        record.depth = thread.depth++;
+        if (thread.sampling) {
+            record.category = category;
+            record.name = name;
+            record.frames = frames;
+            record.start = readTraceClock();
+        }
+    }
+
+    ~TraceScope() {
+        if (!active) {
+            return;
+        }
+        TraceThread& thread = traceThread;
+        --thread.depth;
+        if (record.name == nullptr) {
+            return;
+        }
+        record.end = readTraceClock();
+        if (thread.buffer == nullptr) {
+            thread.buffer = &Tracer::instance().attach();
+        }
+        thread.buffer->push(record);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceRecord record;
+    bool active = false;
+};
+
+
+#endif  // End TRACE_H
@@ -0,0 +1,377 @@
+#include "TraceReplay.h"
+#include "Checkpoint.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::uint32_t PCAP_MAGIC = 0xA1B2C3D4;
+constexpr std::uint32_t PCAP_MAGIC_SWAPPED = 0xD4C3B2A1;
+constexpr std::uint32_t PCAP_NANOSECOND_MAGIC = 0xA1B23C4D;
+constexpr std::uint32_t PCAP_NANOSECOND_MAGIC_SWAPPED = 0x4D3CB2A1;
+constexpr std::size_t PCAP_HEADER_SIZE = 24;
+constexpr std::size_t PCAP_RECORD_HEADER_SIZE = 16;
+
+constexpr std::uint32_t SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+constexpr std::uint32_t INTERFACE_DESCRIPTION_BLOCK = 0x00000001;
+constexpr std::uint32_t OBSOLETE_PACKET_BLOCK = 0x00000002;
+constexpr std::uint32_t SIMPLE_PACKET_BLOCK = 0x00000003;
+constexpr std::uint32_t ENHANCED_PACKET_BLOCK = 0x00000006;
+constexpr std::uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+constexpr std::uint32_t BYTE_ORDER_MAGIC_SWAPPED = 0x4D3C2B1A;
+constexpr std::uint16_t OPTION_END = 0;
+constexpr std::uint16_t OPTION_IF_TSRESOL = 9;
+
+std::uint32_t readNative32(const char* bytes) {
+    std::uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+// A stretch of trace time as it is played back at the given speed
+std::uint64_t scaled(SimTime traceTime, double speed) {
+    return static_cast<std::uint64_t>(static_cast<double>(traceTime) / speed);
+}
+
+} // namespace
+
+TraceFile::TraceFile(const std::string& path) {
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::runtime_error("Cannot open trace file " + path);
+    }
+    struct stat status;
+    if (::fstat(descriptor, &status) != 0 || status.st_size < 4) {
+        ::close(descriptor);
+        throw std::runtime_error("Trace file " + path + " is empty or unreadable");
+    }
+    size = static_cast<std::size_t>(status.st_size);
+    // Read-only; a writable private mapping would be charged in full against the commit
+    // limit, so traces bigger than memory could not be opened
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map trace file " + path);
+    }
+    mapping = static_cast<char*>(mapped);
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const std::uint32_t magic = readNative32(mapping);
+    if (magic == SECTION_HEADER_BLOCK) {
+        format = TraceFormat::Pcapng;
+        if (!startSection(0)) {
+            ::munmap(mapping, size);
+            throw std::runtime_error("Trace file " + path + " has a damaged pcapng section header");
+        }
+        firstRecord = 0;
+        // The link type is in the first interface description, normally right after the header
+        for (std::size_t block = 0; size - block >= 12;) {
+            const std::size_t length = read32(block + 4);
+            if (length < 12 || length % 4 != 0 || length > size - block) {
+                break;
+            }
+            if (read32(block) == INTERFACE_DESCRIPTION_BLOCK && length >= 20) {
+                linkType = read16(block + 8);
+                break;
+            }
+            block += length;
+        }
+    } else if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_SWAPPED || magic == PCAP_NANOSECOND_MAGIC ||
+               magic == PCAP_NANOSECOND_MAGIC_SWAPPED) {
+        if (size < PCAP_HEADER_SIZE) {
+            ::munmap(mapping, size);
+            throw std::runtime_error("Trace file " + path + " is too short for a pcap header");
+        }
+        format = TraceFormat::Pcap;
+        swapped = magic == PCAP_MAGIC_SWAPPED || magic == PCAP_NANOSECOND_MAGIC_SWAPPED;
+        nanosecondPcap = magic == PCAP_NANOSECOND_MAGIC || magic == PCAP_NANOSECOND_MAGIC_SWAPPED;
+        linkType = static_cast<std::uint16_t>(read32(20));
+        firstRecord = PCAP_HEADER_SIZE;
+    } else {
+        ::munmap(mapping, size);
+        throw std::runtime_error("Trace file " + path + " is neither pcap nor pcapng");
+    }
+    position = firstRecord;
+}
+
+TraceFile::~TraceFile() {
+    ::munmap(mapping, size);
+}
+
+std::uint16_t TraceFile::read16(std::size_t offset) const {
+    std::uint16_t value;
+    std::memcpy(&value, mapping + offset, sizeof(value));
+    return swapped ? static_cast<std::uint16_t>((value >> 8) | (value << 8)) : value;
+}
+
+std::uint32_t TraceFile::read32(std::size_t offset) const {
+    const std::uint32_t value = readNative32(mapping + offset);
+    return swapped ? __builtin_bswap32(value) : value;
+}
+
+bool TraceFile::next(TraceFrame& frame) {
+    return format == TraceFormat::Pcap ? nextPcap(frame) : nextPcapng(frame);
+}
+
+void TraceFile::rewind() {
+    position = firstRecord;
+    truncated = false;
+    lastTime = 0;
+    if (format == TraceFormat::Pcapng) {
+        interfaces.clear();
+    }
+}
+
+RawPacket TraceFile::borrow(const TraceFrame& frame) const {
+    return RawPacket(PacketBuffer::borrow(const_cast<char*>(frame.bytes.data()), frame.bytes.size()));
+}
+
+bool TraceFile::nextPcap(TraceFrame& frame) {
+    if (position == size) {
+        return false;
+    }
+    if (size - position < PCAP_RECORD_HEADER_SIZE) {
+        truncated = true;
+        return false;
+    }
+    const std::uint32_t seconds = read32(position);
+    const std::uint32_t fraction = read32(position + 4);
+    const std::uint32_t captured = read32(position + 8);
+    if (captured > size - position - PCAP_RECORD_HEADER_SIZE) {
+        truncated = true;
+        return false;
+    }
+    frame.time = static_cast<SimTime>(seconds) * SECOND + (nanosecondPcap ? fraction : static_cast<SimTime>(fraction) * MICROSECOND);
+    frame.bytes = PacketView(mapping + position + PCAP_RECORD_HEADER_SIZE, captured);
+    frame.originalLength = read32(position + 12);
+    frame.interface = 0;
+    position += PCAP_RECORD_HEADER_SIZE + captured;
+    return true;
+}
+
+// Reads the byte order of a section header block and forgets the interfaces of the previous section
+bool TraceFile::startSection(std::size_t offset) {
+    if (size - offset < 28) {
+        return false;
+    }
+    const std::uint32_t magic = readNative32(mapping + offset + 8);
+    if (magic != BYTE_ORDER_MAGIC && magic != BYTE_ORDER_MAGIC_SWAPPED) {
+        return false;
+    }
+    swapped = magic == BYTE_ORDER_MAGIC_SWAPPED;
+    interfaces.clear();
+    return true;
+}
+
+void TraceFile::addInterface(std::size_t offset, std::size_t length) {
+    Interface interface;
+    // Options follow link type, reserved and snap length; each is padded to 32 bits
+    std::size_t option = offset + 16;
+    const std::size_t end = offset + length - 4;
+    while (option + 4 <= end) {
+        const std::uint16_t code = read16(option);
+        const std::uint16_t optionLength = read16(option + 2);
+        if (code == OPTION_END || option + 4 + optionLength > end) {
+            break;
+        }
+        if (code == OPTION_IF_TSRESOL && optionLength >= 1) {
+            // Bit 7 clear: units of 10^-n seconds; set: units of 2^-n seconds
+            const std::uint8_t resolution = static_cast<std::uint8_t>(mapping[option + 4]);
+            const unsigned exponent = resolution & 0x7F;
+            std::uint64_t units = 1;
+            for (unsigned step = 0; step < exponent && units <= ~std::uint64_t(0) / 10; ++step) {
+                units *= (resolution & 0x80) ? 2 : 10;
+            }
+            interface.unitsPerSecond = units;
+        }
+        option += 4 + ((optionLength + 3u) & ~3u);
+    }
+    interfaces.push_back(interface);
+}
+
+SimTime TraceFile::toNanoseconds(std::uint64_t timestamp, std::uint32_t interface) const {
+    const std::uint64_t unitsPerSecond = interface < interfaces.size() ? interfaces[interface].unitsPerSecond : 1000000;
+    if (unitsPerSecond == SECOND) {
+        return timestamp;
+    }
+    const unsigned __int128 nanoseconds = static_cast<unsigned __int128>(timestamp) * SECOND / unitsPerSecond;
+    return static_cast<SimTime>(nanoseconds);
+}
+
+bool TraceFile::nextPcapng(TraceFrame& frame) {
+    while (position < size) {
+        if (size - position < 12) {
+            truncated = true;
+            return false;
+        }
+        // The section header's type reads the same in both byte orders and tells the order of the rest
+        if (readNative32(mapping + position) == SECTION_HEADER_BLOCK && !startSection(position)) {
+            truncated = true;
+            return false;
+        }
+        const std::uint32_t type = read32(position);
+        const std::size_t length = read32(position + 4);
+        if (length < 12 || length % 4 != 0 || length > size - position) {
+            truncated = true;
+            return false;
+        }
+        const std::size_t block = position;
+        position += length;
+
+        if (type == INTERFACE_DESCRIPTION_BLOCK && length >= 20) {
+            addInterface(block, length);
+        } else if ((type == ENHANCED_PACKET_BLOCK || type == OBSOLETE_PACKET_BLOCK) && length >= 32) {
+            const std::uint32_t interface = type == ENHANCED_PACKET_BLOCK ? read32(block + 8) : read16(block + 8);
+            const std::uint64_t timestamp = (static_cast<std::uint64_t>(read32(block + 12)) << 32) | read32(block + 16);
+            const std::uint32_t captured = read32(block + 20);
+            if (captured > length - 32) {
+                truncated = true;
+                return false;
+            }
+            frame.time = lastTime = toNanoseconds(timestamp, interface);
+            frame.bytes = PacketView(mapping + block + 28, captured);
+            frame.originalLength = read32(block + 24);
+            frame.interface = interface;
+            return true;
+        } else if (type == SIMPLE_PACKET_BLOCK && length >= 16) {
+            // No timestamp and no captured length: the data fills the block up to the trailer
+            frame.originalLength = read32(block + 8);
+            frame.time = lastTime;
+            frame.bytes = PacketView(mapping + block + 12, std::min<std::size_t>(frame.originalLength, length - 16));
+            frame.interface = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TraceFile::saveState(CheckpointWriter& writer) const {
+    writer.put<std::uint64_t>(size);
+    writer.put<std::uint64_t>(position);
+    writer.put(swapped);
+    writer.put(truncated);
+    writer.put(lastTime);
+    writer.putArray(interfaces.data(), interfaces.size());
+}
+
+void TraceFile::restoreState(CheckpointReader& reader) {
+    if (reader.get<std::uint64_t>() != size) {
+        throw std::runtime_error("The checkpointed trace file had another size; it is not the same trace");
+    }
+    position = static_cast<std::size_t>(reader.get<std::uint64_t>());
+    reader.get(swapped);
+    reader.get(truncated);
+    reader.get(lastTime);
+    reader.getArray(interfaces);
+}
+
+// The bytes are named by their offset in the mapping, which is the same in every run
+void TraceFile::saveFrame(CheckpointWriter& writer, const TraceFrame& frame) const {
+    writer.put(frame.time);
+    writer.put<std::uint64_t>(frame.bytes.empty() ? 0 : static_cast<std::uint64_t>(frame.bytes.data() - mapping));
+    writer.put<std::uint64_t>(frame.bytes.size());
+    writer.put(frame.originalLength);
+    writer.put(frame.interface);
+}
+
+TraceFrame TraceFile::restoreFrame(CheckpointReader& reader) const {
+    TraceFrame frame;
+    reader.get(frame.time);
+    const std::uint64_t offset = reader.get<std::uint64_t>();
+    const std::uint64_t length = reader.get<std::uint64_t>();
+    if (offset > size || length > size - offset) {
+        throw std::runtime_error("A checkpointed trace frame lies outside the trace file");
+    }
+    frame.bytes = PacketView(mapping + offset, static_cast<std::size_t>(length));
+    reader.get(frame.originalLength);
+    reader.get(frame.interface);
+    return frame;
+}
+
+TraceReplay::TraceReplay(std::string name, TraceFile& trace, NetworkMedium& medium, const ReplayConfig& config)
+    : Node(std::move(name)), trace(trace), medium(medium), config(config) {
+    if (!(config.speed > 0) || config.maxBurst == 0) {
+        throw std::invalid_argument("A replay needs a speed and a burst size greater than zero");
+    }
+}
+
+void TraceReplay::start(EventScheduler& eventScheduler) {
+    scheduler = &eventScheduler;
+    trace.rewind();
+    passStart = scheduler->now();
+    if (!trace.next(pending)) {
+        finished = true;
+        return;
+    }
+    firstFrameTime = pending.time;
+    pendingTime = passStart;
+    scheduler->schedule(pendingTime, this);
+}
+
+// Sends every frame that is due, then sleeps until the next one
+void TraceReplay::onEvent(SimTime now, std::uint64_t cookie) {
+    (void)cookie;
+    for (std::size_t burst = 0; burst < config.maxBurst; ++burst) {
+        if (medium.sendPacket(trace.borrow(pending))) {
+            ++counters.sent;
+            counters.bytes += pending.bytes.size();
+        } else {
+            ++counters.refused;
+        }
+        lastSendTime = pendingTime;
+        if (!advance()) {
+            finished = true;
+            return;
+        }
+        if (pendingTime > now) {
+            break;
+        }
+    }
+    scheduler->schedule(std::max(pendingTime, now), this);
+}
+
+void TraceReplay::saveState(CheckpointWriter& writer) const {
+    trace.saveState(writer);
+    trace.saveFrame(writer, pending);
+    writer.put(counters);
+    writer.put(pendingTime);
+    writer.put(finished);
+    writer.put(passStart);
+    writer.put(firstFrameTime);
+    writer.put(lastSendTime);
+}
+
+void TraceReplay::restoreState(CheckpointReader& reader, EventScheduler& eventScheduler) {
+    scheduler = &eventScheduler;
+    trace.restoreState(reader);
+    pending = trace.restoreFrame(reader);
+    reader.get(counters);
+    reader.get(pendingTime);
+    reader.get(finished);
+    reader.get(passStart);
+    reader.get(firstFrameTime);
+    reader.get(lastSendTime);
+}
+
+bool TraceReplay::advance() {
+    if (!trace.next(pending)) {
+        ++counters.passes;
+        if (config.loops != 0 && counters.passes >= config.loops) {
+            return false;
+        }
+        trace.rewind();
+        if (!trace.next(pending)) {
+            return false;
+        }
+        passStart = lastSendTime + config.loopGap;
+    }
+    // Frames that go back in time (merged captures) are sent right after the previous one
+    const SimTime offset = pending.time > firstFrameTime ? scaled(pending.time - firstFrameTime, config.speed) : 0;
+    pendingTime = std::max(passStart + offset, lastSendTime);
+    return true;
+}
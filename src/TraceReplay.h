@@ -0,0 +1,168 @@
+#ifndef TRACE_REPLAY_H    // This will ensure no repeat definition of this header file.
+#define TRACE_REPLAY_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EventScheduler.h"
+#include "NetworkMedium.h"
+#include "Node.h"
+#include "RawPacket.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The two capture file formats TraceFile reads.
+enum class TraceFormat {
+    Pcap,       // The classic libpcap format, with microsecond or nanosecond timestamps.
+    Pcapng,     // pcapng, as written by Wireshark, dumpcap and CaptureTap.
+};
+
+// One frame of a trace. 'bytes' points into the trace file's mapping.
+struct TraceFrame {
+    SimTime time = 0;                   // Capture time in nanoseconds (usually since 1970).
+    PacketView bytes;                   // The captured bytes (possibly cut to the snap length).
+    std::uint32_t originalLength = 0;   // Length of the frame on the wire.
+    std::uint32_t interface = 0;        // pcapng interface id; 0 for pcap files.
+};
+
+/*
+TraceFile reads a pcap or pcapng file through a memory mapping instead of read() calls, so a
+trace of tens of gigabytes costs no heap memory and no copying: the kernel pages the file in
+as it is read (advised to expect a sequential scan) and can drop those pages again whenever
+it needs the memory. Frames come out as views into the mapping, and borrow() turns one into a
+RawPacket that uses the mapped bytes in place.
+
+The mapping is read-only, so it costs no commit charge however big the file is. A borrowed
+frame is never written to: anything that modifies one (corruption in a LinkImpairment, or
+EthernetFrame::encapsulate()) first has PacketBuffer copy it into a buffer of its own, so
+neither the file nor a later pass over the trace after rewind() sees the change.
+
+Both byte orders are accepted, and pcapng files may have several sections and interfaces,
+each with its own timestamp resolution. Blocks other than packets are skipped.
+*/
+class TraceFile{
+public:
+    // Maps the file and checks its header; throws std::runtime_error if it cannot be opened
+    // or is neither pcap nor pcapng.
+    explicit TraceFile(const std::string& path);
+    ~TraceFile();
+
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+    // Reads the next frame into 'frame'. Returns false at the end of the file, or where the
+    // file is cut off or damaged (see isTruncated()).
+    bool next(TraceFrame& frame);
+
+    // Starts reading from the first frame again.
+    void rewind();
+
+    // A packet holding the frame's bytes without copying them (PacketBuffer::borrow()). It
+    // must not outlive the TraceFile, and its bytes are read-only (see makeWritable()).
+    RawPacket borrow(const TraceFrame& frame) const;
+
+    TraceFormat getFormat() const { return format; }
+    std::size_t fileSize() const { return size; }
+
+    // Link type of the first pcap or pcapng interface (1 is Ethernet).
+    std::uint16_t getLinkType() const { return linkType; }
+
+    // True if reading stopped at a block or record that runs past the end of the file or
+    // makes no sense.
+    bool isTruncated() const { return truncated; }
+
+    // Writes the reading position to a checkpoint, and reads it back into a TraceFile of the
+    // same file. Throws std::runtime_error if the file now has another size.
+    void saveState(CheckpointWriter& writer) const;
+    void restoreState(CheckpointReader& reader);
+
+    // Writes a frame read from this file as its place in the file, and reads it back.
+    void saveFrame(CheckpointWriter& writer, const TraceFrame& frame) const;
+    TraceFrame restoreFrame(CheckpointReader& reader) const;
+
+private:
+    // What the current pcapng section says about one of its interfaces.
+    struct Interface {
+        std::uint64_t unitsPerSecond = 1000000;     // From if_tsresol; microseconds by default.
+    };
+
+    char* mapping = nullptr;
+    std::size_t size = 0;
+    TraceFormat format = TraceFormat::Pcap;
+    std::uint16_t linkType = 0;
+
+    std::size_t position = 0;       // Offset of the next block or record.
+    std::size_t firstRecord = 0;    // Where rewind() starts from.
+    bool swapped = false;           // The current section is in the other byte order.
+    bool nanosecondPcap = false;    // A pcap file with nanosecond timestamps.
+    bool truncated = false;
+    std::vector<Interface> interfaces;
+    SimTime lastTime = 0;           // For pcapng simple packet blocks, which carry no time.
+
+    std::uint16_t read16(std::size_t offset) const;
+    std::uint32_t read32(std::size_t offset) const;
+
+    bool nextPcap(TraceFrame& frame);
+    bool nextPcapng(TraceFrame& frame);
+    bool startSection(std::size_t offset);
+    void addInterface(std::size_t offset, std::size_t length);
+    SimTime toNanoseconds(std::uint64_t timestamp, std::uint32_t interface) const;
+};
+
+struct ReplayConfig {
+    double speed = 1.0;             // 2.0 plays the trace twice as fast as it was recorded.
+    std::size_t loops = 1;          // Passes over the trace; 0 repeats it forever.
+    SimTime loopGap = MICROSECOND;  // Pause between the last frame of a pass and the first of the next.
+    std::size_t maxBurst = 64;      // Frames sent per event at most, when many are due at once.
+};
+
+// What a replay has done so far.
+struct ReplayCounters {
+    std::uint64_t sent = 0;
+    std::uint64_t refused = 0;      // Frames the medium did not accept (a full ring, say).
+    std::uint64_t bytes = 0;
+    std::uint64_t passes = 0;       // Completed passes over the trace.
+};
+
+/*
+TraceReplay is a node that plays a TraceFile into a medium in virtual time, keeping the gaps
+between the recorded timestamps (divided by 'speed'). The first frame is sent when the node
+is start()ed; every frame is a RawPacket borrowing its bytes from the mapping, so replaying
+never copies a payload. The trace file has to outlive every frame the replay sent.
+*/
+class TraceReplay : public Node{
+public:
+    TraceReplay(std::string name, TraceFile& trace, NetworkMedium& medium, const ReplayConfig& config = ReplayConfig());
+
+    void start(EventScheduler& scheduler) override;
+    void onEvent(SimTime now, std::uint64_t cookie) override;
+
+    // The replay's progress, together with the trace file's reading position.
+    void saveState(CheckpointWriter& writer) const override;
+    void restoreState(CheckpointReader& reader, EventScheduler& scheduler) override;
+
+    // True once every pass is over.
+    bool isFinished() const { return finished; }
+
+    const ReplayCounters& getCounters() const { return counters; }
+
+private:
+    TraceFile& trace;
+    NetworkMedium& medium;
+    ReplayConfig config;
+    ReplayCounters counters;
+    EventScheduler* scheduler = nullptr;
+
+    TraceFrame pending;             // The next frame to send,
+    SimTime pendingTime = 0;        // and when.
+    bool finished = false;
+    SimTime passStart = 0;          // Virtual time at which the current pass started.
+    SimTime firstFrameTime = 0;     // Trace time of the first frame of the trace.
+    SimTime lastSendTime = 0;
+
+    // Reads the next frame, moving on to the next pass at the end of the trace. Returns false when done.
+    bool advance();
+};
+
+
+#endif  // End TRACE_REPLAY_H
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "TrafficGenerator.h"
+#include "Checkpoint.h"
+#include "Crc32.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+
+// The two kinds of events a generator schedules for itself
+constexpr std::uint64_t SEND = 0;
+constexpr std::uint64_t RECEIVE = 1;
+
+constexpr std::size_t IPV4_HEADER_SIZE = 20;
+constexpr std::uint8_t PROTOCOL_UDP = 17;
+
+// Sequence number and send time, right in front of the FCS
+constexpr std::size_t STAMP_SIZE = 16;
+constexpr std::size_t STAMP_OFFSET_FROM_END = STAMP_SIZE + EthernetFrame::FCS_SIZE;
+
+constexpr std::size_t MAX_FRAME_SIZE = 65535 + EthernetFrame::HEADER_SIZE + EthernetFrame::FCS_SIZE;
+
+void writeBigEndian16(char* bytes, std::uint16_t value) {
+    bytes[0] = static_cast<char>(value >> 8);
+    bytes[1] = static_cast<char>(value);
+}
+
+void writeBigEndian32(char* bytes, std::uint32_t value) {
+    writeBigEndian16(bytes, static_cast<std::uint16_t>(value >> 16));
+    writeBigEndian16(bytes + 2, static_cast<std::uint16_t>(value));
+}
+
+std::uint16_t readBigEndian16(const char* bytes) {
+    return static_cast<std::uint16_t>((static_cast<std::uint8_t>(bytes[0]) << 8) | static_cast<std::uint8_t>(bytes[1]));
+}
+
+// The ones' complement sum of the header's 16-bit words (RFC 791)
+std::uint16_t ipv4Checksum(const char* header) {
+    std::uint32_t sum = 0;
+    for (std::size_t offset = 0; offset < IPV4_HEADER_SIZE; offset += 2) {
+        sum += readBigEndian16(header + offset);
+    }
+    while (sum > 0xFFFF) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return static_cast<std::uint16_t>(~sum);
+}
+
+// An IPv4 header without options and a UDP header without a checksum (allowed over IPv4),
+// so the stamp can change without either header changing
+std::vector<char> datagram(const TrafficEndpoint& source, const TrafficEndpoint& destination, std::uint16_t sourcePort,
+                           const TrafficConfig& config) {
+    std::vector<char> bytes(config.frameSize - EthernetFrame::HEADER_SIZE - EthernetFrame::FCS_SIZE, 0);
+    char* ip = bytes.data();
+    ip[0] = 0x45;
+    ip[1] = static_cast<char>(config.tos);
+    writeBigEndian16(ip + 2, static_cast<std::uint16_t>(bytes.size()));
+    writeBigEndian16(ip + 6, 0x4000);   // Don't fragment
+    ip[8] = 64;
+    ip[9] = static_cast<char>(PROTOCOL_UDP);
+    writeBigEndian32(ip + 12, source.address);
+    writeBigEndian32(ip + 16, destination.address);
+    writeBigEndian16(ip + 10, ipv4Checksum(ip));
+    char* udp = ip + IPV4_HEADER_SIZE;
+    writeBigEndian16(udp, sourcePort);
+    writeBigEndian16(udp + 2, config.destinationPort);
+    writeBigEndian16(udp + 4, static_cast<std::uint16_t>(bytes.size() - IPV4_HEADER_SIZE));
+    return bytes;
+}
+
+// Ports of the one-port nodes the helpers turn into generators
+const Port& onlyPort(const Topology& topology, NodeId node) {
+    if (topology.getPorts(node).size() != 1) {
+        throw std::invalid_argument("Traffic generators need nodes with exactly one port; '" + topology.getName(node) +
+                                    "' has " + std::to_string(topology.getPorts(node).size()));
+    }
+    return topology.getPort(node, 0);
+}
+
+} // namespace
+
+// Every template is a complete frame; only its stamp and FCS change when it is sent
+TrafficGenerator::TrafficGenerator(std::string name, const Port& port, const TrafficEndpoint& source,
+                                   std::vector<TrafficEndpoint> destinations, const TrafficConfig& config)
+    : Node(std::move(name)), port(port), config(config), random(config.seed) {
+    if (config.frameSize < EthernetFrame::MIN_FRAME_SIZE || config.frameSize > MAX_FRAME_SIZE) {
+        throw std::invalid_argument("Generated frames are between 64 and " + std::to_string(MAX_FRAME_SIZE) + " bytes long");
+    }
+    if (config.bitsPerSecond == 0 || config.maxBurst == 0 || config.flows == 0) {
+        throw std::invalid_argument("A traffic generator needs a rate, a burst size and a flow count greater than zero");
+    }
+    if (config.pattern == TrafficPattern::Burst && (config.burstFrames == 0 || config.burstPeriod == 0)) {
+        throw std::invalid_argument("A Burst pattern needs a burst size and a burst period greater than zero");
+    }
+    if (config.pattern == TrafficPattern::OnOff && config.onTime == 0) {
+        throw std::invalid_argument("An OnOff pattern needs an on time greater than zero");
+    }
+
+    templateCount = destinations.size() * config.flows;
+    templates.reserve(templateCount * config.frameSize);
+    prefixCrcs.reserve(templateCount);
+    for (std::size_t flow = 0; flow < config.flows; ++flow) {
+        const std::uint16_t sourcePort = static_cast<std::uint16_t>(config.sourcePort + flow);
+        for (const TrafficEndpoint& destination : destinations) {
+            const std::vector<char> payload = datagram(source, destination, sourcePort, config);
+            const RawPacket frame = EthernetFrame::build(destination.mac, source.mac, EtherType::IPV4,
+                                                         PacketView(payload.data(), payload.size()));
+            templates.insert(templates.end(), frame.data.begin(), frame.data.end());
+            prefixCrcs.push_back(crc32(frame.data.data(), config.frameSize - STAMP_OFFSET_FROM_END));
+        }
+    }
+    burst.resize(config.maxBurst);
+    packets.reserve(config.maxBurst);
+    sharedPackets.reserve(config.maxBurst);
+}
+
+void TrafficGenerator::start(EventScheduler& eventScheduler) {
+    scheduler = &eventScheduler;
+    periodStart = scheduler->now() + config.startTime;
+    periodEnd = config.pattern == TrafficPattern::OnOff ? periodStart + std::max<SimTime>(exponential(static_cast<double>(config.onTime)), 1) : 0;
+    nextTime = periodStart;
+    finished = templateCount == 0;
+    if (!finished) {
+        scheduler->schedule(nextTime, this, SEND);
+    }
+    if (config.pollInterval != 0) {
+        scheduler->scheduleAfter(config.pollInterval, this, RECEIVE);
+    }
+}
+
+void TrafficGenerator::onEvent(SimTime now, std::uint64_t cookie) {
+    if (cookie == RECEIVE) {
+        poll(now);
+        scheduler->scheduleAfter(config.pollInterval, this, RECEIVE);
+        return;
+    }
+    sendDue(now);
+    if (!finished) {
+        scheduler->schedule(std::max(nextTime, now), this, SEND);
+    }
+}
+
+// Exact to the nanosecond however many frames have been sent, so a long run does not drift
+SimTime TrafficGenerator::framesTime(std::uint64_t frames) const {
+    const unsigned __int128 bits = static_cast<unsigned __int128>(frames) * config.frameSize * 8;
+    return static_cast<SimTime>(bits * SECOND / config.bitsPerSecond);
+}
+
+SimTime TrafficGenerator::exponential(double mean) {
+    return static_cast<SimTime>(-std::log(1.0 - random.nextUnit()) * mean);
+}
+
+void TrafficGenerator::advance() {
+    ++sequence;
+    ++periodFrames;
+    if (config.maxFrames != 0 && sequence >= config.maxFrames) {
+        finished = true;
+        return;
+    }
+    SimTime due = periodStart + framesTime(periodFrames);
+    switch (config.pattern) {
+    case TrafficPattern::ConstantRate:
+        break;
+    case TrafficPattern::Poisson:
+        due = nextTime + exponential(static_cast<double>(config.frameSize * 8) * SECOND / static_cast<double>(config.bitsPerSecond));
+        break;
+    case TrafficPattern::OnOff:
+        // An on period always starts with a frame, however short it is drawn
+        if (due >= periodEnd) {
+            periodStart = periodEnd + exponential(static_cast<double>(config.offTime));
+            periodEnd = periodStart + std::max<SimTime>(exponential(static_cast<double>(config.onTime)), 1);
+            periodFrames = 0;
+            due = periodStart;
+        }
+        break;
+    case TrafficPattern::Burst:
+        if (periodFrames == config.burstFrames) {
+            periodStart += config.burstPeriod;
+            periodFrames = 0;
+            due = periodStart;
+        }
+        break;
+    }
+    nextTime = std::max(due, nextTime);    // A burst longer than its period delays the next one
+}
+
+// The FCS continues the template's CRC over the stamp, instead of covering the whole frame again
+void TrafficGenerator::fill(RawPacket& packet, SimTime now) {
+    const char* frame = templates.data() + nextTemplate * config.frameSize;
+    packet.data.assign(frame, frame + config.frameSize);
+    char* stamp = packet.data.data() + config.frameSize - STAMP_OFFSET_FROM_END;
+    std::memcpy(stamp, &sequence, sizeof(sequence));
+    std::memcpy(stamp + sizeof(sequence), &now, sizeof(now));
+    const std::uint32_t checksum = crc32(stamp, STAMP_SIZE, prefixCrcs[nextTemplate]);
+    char* trailer = stamp + STAMP_SIZE;
+    for (std::size_t index = 0; index < EthernetFrame::FCS_SIZE; ++index) {
+        trailer[index] = static_cast<char>(checksum >> (8 * index));
+    }
+    nextTemplate = nextTemplate + 1 == templateCount ? 0 : nextTemplate + 1;
+}
+
+// Everything due within the next tick goes out as one burst
+void TrafficGenerator::sendDue(SimTime now) {
+    std::size_t count = 0;
+    while (!finished && count < config.maxBurst && (nextTime <= now || nextTime - now < config.tick)) {
+        fill(burst[count], now);
+        ++count;
+        advance();
+    }
+    std::size_t sent = 0;
+    if (port.segment != NO_SEGMENT) {
+        for (std::size_t index = 0; index < count; ++index) {
+            sent += port.tx->sendPacketFrom(port.receiver, std::move(burst[index])) ? 1 : 0;
+        }
+    } else {
+        sent = port.tx->sendBatch(std::span<RawPacket>(burst.data(), count));
+    }
+    counters.sent += sent;
+    counters.refused += count - sent;
+    counters.bytes += sent * config.frameSize;
+}
+
+std::size_t TrafficGenerator::poll(SimTime now) {
+    std::size_t total = 0;
+    for (;;) {
+        std::size_t taken;
+        if (port.segment != NO_SEGMENT) {
+            sharedPackets.clear();
+            taken = port.rx->receiveBatch(port.receiver, sharedPackets, config.maxBurst);
+            for (const SharedPacket& packet : sharedPackets) {
+                count(packet->view(), now);
+            }
+        } else {
+            packets.clear();
+            taken = port.rx->receiveBatch(packets, config.maxBurst);
+            for (const RawPacket& packet : packets) {
+                count(packet.view(), now);
+            }
+        }
+        total += taken;
+        if (taken < config.maxBurst) {
+            return total;
+        }
+    }
+}
+
+void TrafficGenerator::count(PacketView frame, SimTime now) {
+    ++counters.received;
+    counters.receivedBytes += frame.size();
+    std::uint64_t frameSequence;
+    SimTime sentAt;
+    if (!readStamp(frame, config.destinationPort, frameSequence, sentAt) || sentAt > now) {
+        return;
+    }
+    ++counters.stamped;
+    counters.latencySum += now - sentAt;
+    counters.latencyMax = std::max(counters.latencyMax, now - sentAt);
+}
+
+bool TrafficGenerator::readStamp(PacketView frame, std::uint16_t destinationPort, std::uint64_t& sequence, SimTime& sentAt) {
+    constexpr std::size_t IP = EthernetFrame::HEADER_SIZE;
+    if (frame.size() < EthernetFrame::MIN_FRAME_SIZE || readBigEndian16(frame.data() + IP - 2) != EtherType::IPV4 ||
+        frame[IP] != 0x45 || static_cast<std::uint8_t>(frame[IP + 9]) != PROTOCOL_UDP ||
+        readBigEndian16(frame.data() + IP + IPV4_HEADER_SIZE + 2) != destinationPort) {
+        return false;
+    }
+    const char* stamp = frame.data() + frame.size() - STAMP_OFFSET_FROM_END;
+    std::memcpy(&sequence, stamp, sizeof(sequence));
+    std::memcpy(&sentAt, stamp + sizeof(sequence), sizeof(sentAt));
+    return true;
+}
+
+void TrafficGenerator::saveState(CheckpointWriter& writer) const {
+    writer.put(counters);
+    writer.put(random);
+    writer.put(sequence);
+    writer.put<std::uint64_t>(nextTemplate);
+    writer.put(nextTime);
+    writer.put(periodStart);
+    writer.put(periodEnd);
+    writer.put(periodFrames);
+    writer.put(finished);
+}
+
+void TrafficGenerator::restoreState(CheckpointReader& reader, EventScheduler& eventScheduler) {
+    scheduler = &eventScheduler;
+    reader.get(counters);
+    reader.get(random);
+    reader.get(sequence);
+    nextTemplate = static_cast<std::size_t>(reader.get<std::uint64_t>());
+    if (nextTemplate != 0 && nextTemplate >= templateCount) {
+        throw std::runtime_error("Checkpoint section '" + reader.getName() + "' was saved from a generator with more destinations or flows");
+    }
+    reader.get(nextTime);
+    reader.get(periodStart);
+    reader.get(periodEnd);
+    reader.get(periodFrames);
+    reader.get(finished);
+}
+
+TrafficEndpoint trafficEndpoint(NodeId node) {
+    return TrafficEndpoint{MacAddress::fromValue(0x020000000001ull + node), 0x0A000001u + node};
+}
+
+void addIncast(Topology& topology, const std::vector<NodeId>& senders, NodeId receiver, TrafficConfig config) {
+    config.pattern = TrafficPattern::Burst;
+    const std::vector<TrafficEndpoint> target{trafficEndpoint(receiver)};
+    for (NodeId sender : senders) {
+        TrafficConfig own = config;
+        own.seed = topology.getRandomStreams().seedFor(topology.getName(sender));
+        topology.setNode(sender, std::make_unique<TrafficGenerator>(topology.getName(sender), onlyPort(topology, sender),
+                                                                    trafficEndpoint(sender), target, own));
+    }
+    topology.setNode(receiver, std::make_unique<TrafficGenerator>(topology.getName(receiver), onlyPort(topology, receiver),
+                                                                  trafficEndpoint(receiver), std::vector<TrafficEndpoint>(), config));
+}
+
+// Node i sends to i+1, i+2, ... first, wrapping around
+void addAllToAll(Topology& topology, const std::vector<NodeId>& nodes, TrafficConfig config) {
+    for (std::size_t index = 0; index < nodes.size(); ++index) {
+        std::vector<TrafficEndpoint> destinations;
+        for (std::size_t offset = 1; offset < nodes.size(); ++offset) {
+            destinations.push_back(trafficEndpoint(nodes[(index + offset) % nodes.size()]));
+        }
+        const NodeId node = nodes[index];
+        config.seed = topology.getRandomStreams().seedFor(topology.getName(node));
+        topology.setNode(node, std::make_unique<TrafficGenerator>(topology.getName(node), onlyPort(topology, node),
+                                                                  trafficEndpoint(node), std::move(destinations), config));
+    }
+}
@@ -0,0 +1,175 @@
+#ifndef TRAFFIC_GENERATOR_H    // This will ensure no repeat definition of this header file.
+#define TRAFFIC_GENERATOR_H    // If the header file is not defined then only define it for use.
+
+// Including the necessary header files
+#include "EthernetFrame.h"
+#include "EventScheduler.h"
+#include "Node.h"
+#include "Random.h"
+#include "RawPacket.h"
+#include "Topology.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// When a TrafficGenerator sends its frames.
+enum class TrafficPattern {
+    ConstantRate,   // Evenly spaced frames at 'bitsPerSecond'.
+    Poisson,        // Exponentially distributed gaps, 'bitsPerSecond' on average.
+    OnOff,          // 'bitsPerSecond' during on periods, nothing during off periods; both
+                    // exponentially distributed, with means 'onTime' and 'offTime'.
+    Burst,          // 'burstFrames' frames at 'bitsPerSecond' every 'burstPeriod', at the same
+                    // instants in every generator with the same 'startTime' (incast).
+};
+
+// A host a generator sends as or sends to.
+struct TrafficEndpoint {
+    MacAddress mac;
+    std::uint32_t address = 0;      // IPv4 address, e.g. 0x0A000001 for 10.0.0.1.
+};
+
+struct TrafficConfig {
+    TrafficPattern pattern = TrafficPattern::ConstantRate;
+    std::uint64_t bitsPerSecond = 1000000000;   // Offered load, counting every byte of the frame.
+    std::size_t frameSize = 64;                 // Whole frame, FCS included; at least 64 bytes.
+
+    // The frames are UDP datagrams from 'flows' source ports, starting at 'sourcePort', to
+    // 'destinationPort'; the flows take turns, and so do the destinations.
+    std::size_t flows = 1;
+    std::uint16_t sourcePort = 49152;
+    std::uint16_t destinationPort = 9;          // The discard port.
+    std::uint8_t tos = 0;                       // IPv4 type of service (DSCP and ECN).
+
+    SimTime onTime = MILLISECOND;               // OnOff: mean length of an on period,
+    SimTime offTime = MILLISECOND;              // and of an off period.
+    SimTime burstPeriod = 100 * MICROSECOND;    // Burst: time from one burst to the next,
+    std::size_t burstFrames = 32;               // and frames per burst.
+
+    SimTime startTime = 0;                      // When the first frame is due, after start().
+    std::uint64_t maxFrames = 0;                // Frames to generate; 0 never stops.
+
+    // The generator wakes at most once per 'tick' and hands every frame due by the end of it
+    // to the medium in one sendBatch(), up to 'maxBurst' frames. Frames leave up to a tick
+    // early; a 'tick' of 0 wakes the generator for every frame.
+    SimTime tick = MICROSECOND;
+    std::size_t maxBurst = 256;
+
+    // How often frames are taken from the generator's own port and counted; 0 never.
+    SimTime pollInterval = MICROSECOND;
+
+    std::uint64_t seed = 1;                     // Seed of the Poisson and on/off random numbers.
+};
+
+// What a generator has sent and received so far.
+struct TrafficCounters {
+    std::uint64_t sent = 0;
+    std::uint64_t refused = 0;          // Frames the medium did not accept (a full ring, say).
+    std::uint64_t bytes = 0;
+    std::uint64_t received = 0;
+    std::uint64_t receivedBytes = 0;
+    std::uint64_t stamped = 0;          // Received frames that a generator sent,
+    SimTime latencySum = 0;             // their time from sendBatch() to being received,
+    SimTime latencyMax = 0;             // and the longest of those times.
+};
+
+/*
+TrafficGenerator is a node that offers synthetic UDP load to the network from one port, and
+counts what arrives at that port.
+
+It sends frames cheaply enough to keep up with line rate on one core. Every combination of
+destination and flow has a template frame, fully built once, header and IPv4 checksum
+included, together with the CRC of everything but its last 16 payload bytes. Those 16 bytes
+are the only fields that change: a sequence number and the send time. So a frame costs a copy
+of the template into a pooled buffer, a 16-byte stamp and a CRC over those 16 bytes. Frames
+that are due together go out through sendBatch(). The templates take destinations x flows x
+'frameSize' bytes.
+
+A generator without destinations only receives (the receiver of an incast, say). When it
+receives a frame stamped by a generator with the same 'destinationPort', it counts how long
+ago the frame was sent.
+*/
+class TrafficGenerator : public Node{
+public:
+    // Throws std::invalid_argument for a frame size below 64 bytes or above what an IPv4
+    // datagram can hold, for a zero rate, 'maxBurst' or 'flows', for a Burst pattern without
+    // a burst size or period, and for an OnOff pattern without an on time.
+    TrafficGenerator(std::string name, const Port& port, const TrafficEndpoint& source,
+                     std::vector<TrafficEndpoint> destinations, const TrafficConfig& config = TrafficConfig());
+
+    void start(EventScheduler& scheduler) override;
+    void onEvent(SimTime now, std::uint64_t cookie) override;
+
+    // The counters, the random numbers and where the pattern stands.
+    void saveState(CheckpointWriter& writer) const override;
+    void restoreState(CheckpointReader& reader, EventScheduler& scheduler) override;
+
+    // Takes the frames waiting at the generator's port and counts them, as of time 'now'.
+    // Returns the number of frames taken.
+    std::size_t poll(SimTime now);
+
+    // True once 'maxFrames' frames have been generated.
+    bool isFinished() const { return finished; }
+
+    const TrafficCounters& getCounters() const { return counters; }
+    const TrafficConfig& getConfig() const { return config; }
+
+    // Reads the sequence number and send time a generator stamped into a frame. Returns false
+    // if the frame is not a UDP datagram to 'destinationPort' long enough to carry a stamp.
+    static bool readStamp(PacketView frame, std::uint16_t destinationPort, std::uint64_t& sequence, SimTime& sentAt);
+
+private:
+    Port port;
+    TrafficConfig config;
+    TrafficCounters counters;
+    EventScheduler* scheduler = nullptr;
+
+    std::vector<char> templates;            // 'frameSize' bytes per destination and flow,
+    std::vector<std::uint32_t> prefixCrcs;  // and the CRC of each template up to its stamp.
+    std::size_t templateCount = 0;
+    std::size_t nextTemplate = 0;
+
+    RandomBatch random;
+    std::uint64_t sequence = 0;             // Frames generated so far.
+    SimTime nextTime = 0;                   // When the next frame is due.
+    SimTime periodStart = 0;                // Start of the current on period or burst,
+    SimTime periodEnd = 0;                  // end of the on period (OnOff),
+    std::uint64_t periodFrames = 0;         // and frames generated in it.
+    bool finished = false;
+
+    // Reused for every burst so that sending does not allocate.
+    std::vector<RawPacket> burst;
+    std::vector<RawPacket> packets;
+    std::vector<SharedPacket> sharedPackets;
+
+    // Time 'frames' frames take at 'bitsPerSecond'.
+    SimTime framesTime(std::uint64_t frames) const;
+    SimTime exponential(double mean);
+
+    // Moves 'nextTime' on to the frame after the one just generated.
+    void advance();
+
+    // Copies the next template into 'packet' and stamps it.
+    void fill(RawPacket& packet, SimTime now);
+
+    void sendDue(SimTime now);
+    void count(PacketView frame, SimTime now);
+};
+
+// The addresses the helpers below give node 'node': 02:00:00:00:00:01 and
+// 10.0.0.1 for node 0, and so on.
+TrafficEndpoint trafficEndpoint(NodeId node);
+
+// Makes every sender a TrafficGenerator that sends bursts (TrafficPattern::Burst, whatever
+// 'config' says) to 'receiver', all starting at the same instants, and 'receiver' a generator
+// that only receives. Each generator's seed comes from the topology's stream for its node.
+// Throws std::invalid_argument if one of the nodes does not have exactly one port.
+void addIncast(Topology& topology, const std::vector<NodeId>& senders, NodeId receiver, TrafficConfig config);
+
+// Makes every node a TrafficGenerator that sends to all the others in turn. Each starts with
+// the node after itself, so the nodes do not all send to the same node at the same time.
+// Throws std::invalid_argument if one of the nodes does not have exactly one port.
+void addAllToAll(Topology& topology, const std::vector<NodeId>& nodes, TrafficConfig config);
+
+
+#endif  // End TRAFFIC_GENERATOR_H